@@ -89,6 +89,15 @@ func (client *Client) SendHandshake() error {
 }
 
 func (client *Client) Send(cmd proto_res.ProtoCmd, message proto.Message) error {
+	return client.send(cmd, message, 0, false)
+}
+
+// 应答RPC请求 原样带回请求包的RpcId
+func (client *Client) Reply(req *proto_res.ProtoPackage, cmd proto_res.ProtoCmd, message proto.Message) error {
+	return client.send(cmd, message, req.RpcId, true)
+}
+
+func (client *Client) send(cmd proto_res.ProtoCmd, message proto.Message, rpcId uint64, rpcReply bool) error {
 	protoData, err := proto.Marshal(message)
 	if err != nil {
 		return fmt.Errorf("marshal message failed: %w", err)
@@ -97,6 +106,8 @@ func (client *Client) Send(cmd proto_res.ProtoCmd, message proto.Message) error
 	pkg := &proto_res.ProtoPackage{
 		Cmd:      cmd,
 		Protocol: protoData,
+		RpcId:    rpcId,
+		RpcReply: rpcReply,
 	}
 
 	encoded, err := proto.Marshal(pkg)
@@ -292,7 +292,7 @@ func (w *Worker) handleSelectUserRecord(pkg *proto_res.ProtoPackage) {
 	}
 
 	log.Println(prototext.Format(resMsg))
-	w.client.Send(proto_res.ProtoCmd_PROTO_CMD_DBSVRGO_SELECT_DBUSERRECORD_RES, resMsg)
+	w.client.Reply(pkg, proto_res.ProtoCmd_PROTO_CMD_DBSVRGO_SELECT_DBUSERRECORD_RES, resMsg)
 }
 
 func (w *Worker) handleInsertDbUserRecordReq(pkg *proto_res.ProtoPackage) {
@@ -329,7 +329,7 @@ func (w *Worker) handleInsertDbUserRecordReq(pkg *proto_res.ProtoPackage) {
 		}
 	}
 
-	w.client.Send(proto_res.ProtoCmd_PROTO_CMD_DBSVRGO_INSERT_DBUSERRECORD_RES, &msgRes)
+	w.client.Reply(pkg, proto_res.ProtoCmd_PROTO_CMD_DBSVRGO_INSERT_DBUSERRECORD_RES, &msgRes)
 
 	log.Println(prototext.Format(&msgRes))
 }
@@ -363,7 +363,7 @@ func (w *Worker) handleSelectDbUserRecordLoginReq(pkg *proto_res.ProtoPackage) {
 
 	}
 
-	w.client.Send(proto_res.ProtoCmd_PROTO_CMD_DBSVRGO_SELECT_DBUSERRECORD_LOGIN_RES, &res)
+	w.client.Reply(pkg, proto_res.ProtoCmd_PROTO_CMD_DBSVRGO_SELECT_DBUSERRECORD_LOGIN_RES, &res)
 }
 
 func (w *Worker) registerHandlers() {
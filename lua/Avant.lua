@@ -1,15 +1,112 @@
 ---@class avant
 ---@field Logger function avant.Logger(str):integer
----@field Lua2Protobuf function Client:avant.Lua2Protobuf(message, 1, cmd, clientGID, workerIdx, ""); IPC:avant.Lua2Protobuf(message, 2, cmd, 0, -1, appId); UDP:avant.Lua2Protobuf(message, 3, cmd, 0, port, ip);
+---@field Lua2Protobuf function Client:avant.Lua2Protobuf(message, 1, cmd, clientGID, workerIdx, ""); IPC:avant.Lua2Protobuf(message, 2, cmd, 0, peerHandle, ""); UDP:avant.Lua2Protobuf(message, 3, cmd, 0, port, ip);
 ---@field CreateNewProtobufByCmd function avant.CreateNewProtobufByCmd(cmd)->table:Message|nil
 ---@field HighresTime function avant.HighresTime():seconds:number, nanoseconds:integer
 ---@field Monotonic function avant.Monotonic():steady_clocknanoseconds:integer
+---@field UDPSessionCreate function avant.UDPSessionCreate(clientGID, workerIdx)->udpToken:string 为客户端连接创建UDP会话(仅OtherVM)
+---@field UDPSessionSetCmdMode function avant.UDPSessionSetCmdMode(cmd, ProtoLua_ProtoUDPCmdMode)->integer 配置cmd发往客户端的通道(仅OtherVM)
+---@field GetIPCPeerHandle function avant.GetIPCPeerHandle(appId)->peerHandle:integer IPC对端AppID转整数handle 进程内不变(仅OtherVM)
+---@field IPCCall function avant.IPCCall(message, cmd, peerHandle, timeoutMs)->rpcId:string|nil 发起IPC RPC请求 timeoutMs必须大于0(仅OtherVM)
+---@field IPCReply function avant.IPCReply(rpcId, message, cmd, peerHandle)->boolean 应答其他进程发来的IPC RPC请求(仅OtherVM)
+---@field HttpSetAPIPrefix function avant.HttpSetAPIPrefix(prefix)->integer 以prefix开头的HTTP请求交给本worker的OnHttpRequest 空串关闭(仅WorkerVM)
+---@field HttpWrite function avant.HttpWrite(connGID, data)->boolean 向流式HTTP响应追加数据 连接已断开或积压过多返回false(仅WorkerVM)
+---@field HttpEnd function avant.HttpEnd(connGID)->boolean 结束流式HTTP响应(仅WorkerVM)
+---@field QuadTreeCreate function avant.QuadTreeCreate(x, y, w, h, maxDepth, leafCapacity)->treeId:integer 创建原生松散四叉树 maxDepth/leafCapacity传0用默认值(仅OtherVM)
+---@field QuadTreeDestroy function avant.QuadTreeDestroy(treeId)->integer 销毁四叉树(仅OtherVM)
+---@field QuadTreeInsert function avant.QuadTreeInsert(treeId, x, y, radius)->handle:integer|nil 插入实体 handle在移除前不变(仅OtherVM)
+---@field QuadTreeUpdate function avant.QuadTreeUpdate(treeId, handle, x, y)->boolean 更新实体坐标(仅OtherVM)
+---@field QuadTreeRemove function avant.QuadTreeRemove(treeId, handle)->boolean 移除实体(仅OtherVM)
+---@field QuadTreeQuery function avant.QuadTreeQuery(treeId, x, y, w, h, out)->count:integer 包围盒与矩形相交的实体handle写入out[1..count](仅OtherVM)
+---@field VoxelIndexCreate function avant.VoxelIndexCreate(cellSize)->indexId:integer 创建3D稀疏体素索引 cellSize传0用默认值(仅OtherVM)
+---@field VoxelIndexDestroy function avant.VoxelIndexDestroy(indexId)->integer 销毁体素索引(仅OtherVM)
+---@field VoxelIndexInsert function avant.VoxelIndexInsert(indexId, x, y, z, radius)->handle:integer|nil 插入实体 handle在移除前不变(仅OtherVM)
+---@field VoxelIndexUpdate function avant.VoxelIndexUpdate(indexId, handle, x, y, z)->boolean 更新实体坐标(仅OtherVM)
+---@field VoxelIndexRemove function avant.VoxelIndexRemove(indexId, handle)->boolean 移除实体(仅OtherVM)
+---@field VoxelIndexQueryBox function avant.VoxelIndexQueryBox(indexId, x, y, z, w, h, d, out)->count:integer 包围盒与长方体相交的实体handle写入out[1..count](仅OtherVM)
+---@field VoxelIndexQuerySphere function avant.VoxelIndexQuerySphere(indexId, x, y, z, radius, out)->count:integer 与球相交的实体handle写入out[1..count](仅OtherVM)
+---@field VoxelIndexQueryNearest function avant.VoxelIndexQueryNearest(indexId, x, y, z, k, maxDist, out)->count:integer 最近的至多k个实体按距离从近到远写入out maxDist<=0不限距离(仅OtherVM)
+---@field AOICreate function avant.AOICreate(x, y, w, h, enterRange, leaveRange)->aoiId:integer 创建增量AOI 距离按x y方向分别比较 leaveRange>=enterRange防止边界抖动(仅OtherVM)
+---@field AOIDestroy function avant.AOIDestroy(aoiId)->integer 销毁AOI(仅OtherVM)
+---@field AOIInsert function avant.AOIInsert(aoiId, x, y)->handle:integer|nil 加入实体 下一次AOIFlush产生进入事件(仅OtherVM)
+---@field AOIUpdate function avant.AOIUpdate(aoiId, handle, x, y)->boolean 标记实体状态变化(仅OtherVM)
+---@field AOIRemove function avant.AOIRemove(aoiId, handle)->boolean 移除实体 handle在下一次AOIFlush后才会复用(仅OtherVM)
+---@field AOIFlush function avant.AOIFlush(aoiId, out)->count:integer 处理本步变化 有事件的观察者handle写入out[1..count](仅OtherVM)
+---@field AOIFetch function avant.AOIFetch(aoiId, handle, enterOut, leaveOut, moveOut)->enterCount:integer, leaveCount:integer, moveCount:integer 取出观察者的进入 离开 移动事件(仅OtherVM)
+---@field SnapshotCreate function avant.SnapshotCreate(aoiId, posQuant, velQuant)->encoderId:integer 创建挂在AOI上的增量快照编码器 实体与客户端都用AOI handle(仅OtherVM)
+---@field SnapshotDestroy function avant.SnapshotDestroy(encoderId)->integer 销毁快照编码器(仅OtherVM)
+---@field SnapshotSetEntity function avant.SnapshotSetEntity(encoderId, handle, userId)->boolean 登记实体 同一handle重新登记视为新实体(仅OtherVM)
+---@field SnapshotSetState function avant.SnapshotSetState(encoderId, handle, x, y, vX, vY, lastSeq, lastClientTime)->boolean 更新实体状态 lastClientTime为字符串(仅OtherVM)
+---@field SnapshotRemove function avant.SnapshotRemove(encoderId, handle)->boolean 移除实体及其客户端基线(仅OtherVM)
+---@field SnapshotAck function avant.SnapshotAck(encoderId, handle, ackSnapshotId)->boolean 客户端确认收到快照(仅OtherVM)
+---@field SnapshotSetClient function avant.SnapshotSetClient(encoderId, handle, clientGID, workerIdx)->boolean 登记客户端连接 MapSimTick只给登记过的客户端发快照(仅OtherVM)
+---@field SnapshotSetLOD function avant.SnapshotSetLOD(encoderId, ranges, periods)->boolean 按与客户端自身的距离分层降频 小于ranges[k]的实体每periods[k]次编码更新一次 超出的属于最后一层 传空表关闭(仅OtherVM)
+---@field SnapshotLODStat function avant.SnapshotLODStat(encoderId, updatesOut, savedOut)->tierCount:integer 取出并清零各层带上新状态的条目数与因推迟而省掉的条目数(仅OtherVM)
+---@field SnapshotSend function avant.SnapshotSend(encoderId, handle, clientGID, workerIdx, serverTime)->bytes:integer 编码相对确认基线的增量快照并发给客户端 无需发送返回0 须在AOIFlush之后调用(仅OtherVM)
+---@field PhysicsCreate function avant.PhysicsCreate(width, height, aoiId, encoderId)->physicsId:integer 创建2D移动批量积分 状态变化的实体同步到AOI与快照编码器 不需要时传0(仅OtherVM)
+---@field PhysicsDestroy function avant.PhysicsDestroy(physicsId)->integer 销毁移动积分(仅OtherVM)
+---@field PhysicsAdd function avant.PhysicsAdd(physicsId, handle, x, y, maxSpeed, accel, speedRatio, friction, bodyRadius, bodyMass, bounce)->boolean 加入实体 handle与AOI handle相同(仅OtherVM)
+---@field PhysicsRemove function avant.PhysicsRemove(physicsId, handle)->boolean 移除实体(仅OtherVM)
+---@field PhysicsSetCollision function avant.PhysicsSetCollision(physicsId, gridId, tileSize, playerCollision)->boolean 开启积分后的碰撞阶段 圆对瓦片网格扫掠碰撞(gridId为0不检测)与实体之间的圆碰撞(仅OtherVM)
+---@field PhysicsSetInput function avant.PhysicsSetInput(physicsId, handle, dirX, dirY, seq, clientTime)->boolean 设置归一化后的输入方向 clientTime为字符串(仅OtherVM)
+---@field PhysicsPushInput function avant.PhysicsPushInput(physicsId, handle, dirX, dirY, seq, clientTime)->result:integer 输入放进抖动缓冲 之后每步按seq最多应用一条 0排队 1重复 2迟到 3丢弃(仅OtherVM)
+---@field PhysicsSetInputDelay function avant.PhysicsSetInputDelay(physicsId, delaySteps, reorderSteps)->boolean 输入到达后等几步再应用 缺seq时后面的输入再多等几步后跳过(仅OtherVM)
+---@field PhysicsInputStat function avant.PhysicsInputStat(physicsId)->applied:integer|nil, late:integer, dropped:integer, duplicate:integer, skipped:integer 取出并清零输入抖动缓冲统计(仅OtherVM)
+---@field PhysicsGet function avant.PhysicsGet(physicsId, handle)->x:number|nil, y:number, vX:number, vY:number 取实体当前坐标与速度(仅OtherVM)
+---@field PhysicsExport function avant.PhysicsExport(physicsId, handles)->blob:string|nil 地图迁移 按handles顺序导出实体参数 运动状态与暂存输入的紧凑二进制(仅OtherVM)
+---@field PhysicsImport function avant.PhysicsImport(physicsId, blob, handles)->count:integer|nil 按handles顺序导入PhysicsExport的结果并同步到AOI与快照 失败时不加入任何实体(仅OtherVM)
+---@field PhysicsStep function avant.PhysicsStep(physicsId, dtMS)->changedCount:integer 推进一个固定步长 未开碰撞时结果与Lua版Map:PlayerPhysicsMove逐位相同(仅OtherVM)
+---@field MapSimCreate function avant.MapSimCreate(physicsId, aoiId, encoderId, dtMS)->simId:integer 创建地图原生模拟上下文 一步依次为移动积分 AOI判定 快照编码(仅OtherVM)
+---@field MapSimDestroy function avant.MapSimDestroy(simId)->integer 销毁地图模拟上下文(仅OtherVM)
+---@field MapSimSetThreads function avant.MapSimSetThreads(threadCnt)->integer 设置地图tick线程池额外线程数 0为串行 返回实际线程数(仅OtherVM)
+---@field MapSimTick function avant.MapSimTick(simIds, stepCounts, syncFlags, serverTime)->sendCount:integer simIds[i]推进stepCounts[i]步 syncFlags[i]为true时再做一次AOI判定与快照编码 多张地图在线程池并行 全部完成后发出快照(仅OtherVM)
+---@field MapSimStat function avant.MapSimStat(simId)->ticks:integer|nil, costUsSum:integer, costUsMax:integer, bytes:integer, sends:integer, steps:integer, syncs:integer 取出并清零上次调用以来的tick耗时 快照流量 推进步数与同步次数(仅OtherVM)
+---@field TileGridCreate function avant.TileGridCreate(width, height, bitsPerTile)->gridId:integer 创建全0的可写瓦片网格 每格1/2/4/8位 坐标从0开始(仅OtherVM)
+---@field TileGridLoad function avant.TileGridLoad(path)->gridId:integer|nil mmap只读加载预生成的瓦片文件 同一文件共用一份并增加引用(仅OtherVM)
+---@field TileGridSave function avant.TileGridSave(gridId, path)->boolean 把网格写成可被TileGridLoad加载的文件(仅OtherVM)
+---@field TileGridDestroy function avant.TileGridDestroy(gridId)->integer 减少引用 最后一个使用者释放网格(仅OtherVM)
+---@field TileGridInfo function avant.TileGridInfo(gridId)->width:integer|nil, height:integer, bitsPerTile:integer, readOnly:boolean 网格尺寸与位宽(仅OtherVM)
+---@field TileGridGetTile function avant.TileGridGetTile(gridId, x, y)->tile:integer|nil 越界返回nil(仅OtherVM)
+---@field TileGridSetTile function avant.TileGridSetTile(gridId, x, y, tile)->boolean 只读网格 越界 超出位宽返回false(仅OtherVM)
+---@field TileGridSetWalkable function avant.TileGridSetWalkable(gridId, tile, walkable)->boolean 设置某种瓦片是否可行走 默认只有0可行走 建过分层寻路的网格需再按整张网格HPAUpdate(仅OtherVM)
+---@field TileGridIsWalkable function avant.TileGridIsWalkable(gridId, x, y)->boolean 越界不可行走(仅OtherVM)
+---@field TileGridRaycast function avant.TileGridRaycast(gridId, x0, y0, x1, y1)->hit:boolean, tileX:integer|nil, tileY:integer|nil 瓦片坐标系下线段经过的第一个不可行走格子(仅OtherVM)
+---@field PathFind function avant.PathFind(gridId, startX, startY, endX, endY, useJPS, out)->points:integer|nil 网格上4方向A* 路径每格按x, y写入out 按网格版本缓存 不可达返回nil(仅OtherVM)
+---@field PathFindStat function avant.PathFindStat()->searches:integer, cacheHits:integer, expanded:integer, failed:integer 取出并清零寻路统计(仅OtherVM)
+---@field HPACreate function avant.HPACreate(gridId, clusterSize)->hpaId:integer|nil 拷贝网格的可行走位 在寻路线程建分层寻路(HPA*)的抽象图(仅OtherVM)
+---@field HPADestroy function avant.HPADestroy(hpaId)->integer 销毁分层寻路 已提交的查询仍会返回结果(仅OtherVM)
+---@field HPAUpdate function avant.HPAUpdate(hpaId, gridId, x, y, w, h)->boolean 网格区域变化后增量更新抽象图(仅OtherVM)
+---@field HPAFindPath function avant.HPAFindPath(hpaId, startX, startY, endX, endY)->requestId:integer 提交到寻路线程 结果由HPAPoll取回 失败返回0(仅OtherVM)
+---@field HPAPoll function avant.HPAPoll(ids, paths)->count:integer 取走已完成的查询 paths[i]为每格按x, y排开的数组 不可达为false(仅OtherVM)
+---@field FlowFieldGet function avant.FlowFieldGet(gridId, goalX, goalY)->fieldId:integer|nil 走向同一终点的流场 按网格版本与终点缓存 终点不可行走返回nil(仅OtherVM)
+---@field FlowFieldDir function avant.FlowFieldDir(fieldId, x, y)->dx:integer|nil, dy:integer 格子下一步的偏移 终点为0, 0 到不了 场已淘汰或网格已变化返回nil(仅OtherVM)
+---@field FlowFieldDirs function avant.FlowFieldDirs(fieldId, points, out)->count:integer|nil 批量查询 points与out均按x, y平铺 场已淘汰或网格已变化返回nil(仅OtherVM)
+---@field FlowFieldStat function avant.FlowFieldStat()->requests:integer, cacheHits:integer, builds:integer, visited:integer 取出并清零流场统计(仅OtherVM)
+---@field HPAInfo function avant.HPAInfo(hpaId)->ready:boolean|nil, nodes:integer 抽象图是否已建好与抽象节点数(仅OtherVM)
+---@field InputBufferCreate function avant.InputBufferCreate(delaySteps, reorderSteps)->bufferId:integer 创建输入抖动缓冲 给Lua自己积分的地图用(仅OtherVM)
+---@field InputBufferDestroy function avant.InputBufferDestroy(bufferId)->integer 销毁输入抖动缓冲(仅OtherVM)
+---@field InputBufferRemove function avant.InputBufferRemove(bufferId, handle)->boolean 丢弃实体暂存的输入 下次从seq 1开始(仅OtherVM)
+---@field InputBufferPush function avant.InputBufferPush(bufferId, handle, dirX, dirY, dirZ, seq, clientTime)->result:integer 0排队 1重复 2迟到 3丢弃 clientTime为字符串(仅OtherVM)
+---@field InputBufferStep function avant.InputBufferStep(bufferId, out)->count:integer 推进一步 本步应用的输入按handle, dirX, dirY, dirZ, seq, clientTime每6个一组写入out(仅OtherVM)
+---@field InputBufferStat function avant.InputBufferStat(bufferId)->applied:integer|nil, late:integer, dropped:integer, duplicate:integer, skipped:integer 取出并清零统计(仅OtherVM)
+---@field FSFrameStoreCreate function avant.FSFrameStoreCreate(capacityFrames, capacityBytes)->storeId:integer 创建帧同步历史帧环形缓冲 帧数或字节数超出时淘汰最老的帧(仅OtherVM)
+---@field FSFrameStoreDestroy function avant.FSFrameStoreDestroy(storeId)->integer 销毁历史帧缓冲(仅OtherVM)
+---@field FSFrameStoreAppend function avant.FSFrameStoreAppend(storeId, frameId, timestamp, commands, broadcastId)->bytes:integer|nil 编码一帧存入 commands为{userId, commandType, data}数组 data须为字符串 timestamp为字符串 帧号须连续 broadcastId非0时同一份编码放进广播窗口(仅OtherVM)
+---@field FSFrameStoreSince function avant.FSFrameStoreSince(storeId, frameId)->blob:string|nil, count:integer frameId之后所有帧 blob即ProtoCSFSNotifyFrames编码 已淘汰返回nil(仅OtherVM)
+---@field FSFrameStoreSendSince function avant.FSFrameStoreSendSince(storeId, frameId, clientGID, workerIdx)->count:integer frameId之后所有帧直接发给客户端 不重新编码 已淘汰返回-1(仅OtherVM)
+---@field FSBroadcastCreate function avant.FSBroadcastCreate(redundancy)->broadcastId:integer 创建帧广播 每个包携带最近redundancy帧 相邻帧增量编码(仅OtherVM)
+---@field FSBroadcastDestroy function avant.FSBroadcastDestroy(broadcastId)->integer 销毁帧广播(仅OtherVM)
+---@field FSBroadcastSend function avant.FSBroadcastSend(broadcastId, members, behindOut)->sent:integer members按clientGID, workerIdx, lastFrameId每3个一组 同一份包发给未确认最新帧的成员 落后超出窗口的组下标写入behindOut(仅OtherVM)
+---@field FSBroadcastStat function avant.FSBroadcastStat(broadcastId)->packets:integer|nil, bytes:integer, frames:integer, redundantFrames:integer, redundancyHits:integer, windowMisses:integer, deltaSavedBytes:integer 取出并清零统计(仅OtherVM)
+---@field FSFrameStoreStat function avant.FSFrameStoreStat(storeId)->firstFrameId:integer|nil, lastFrameId:integer, frames:integer, bytes:integer 历史帧缓冲状态(仅OtherVM)
 ---@field LuaDir string LuaDir路径
 ---@field AppID string 本服务AppID 大区.服.服务ID.实例ID
 ---@field GetAppID function 返回本服务AppID
 ---@field GetDBSvrGoAppID function ():string 获取与之对应的DBSvrGO进程的AppID
+---@field GetDBSvrGoPeerHandle function ():integer 获取与之对应的DBSvrGO进程的IPC对端handle
 ---@field GetThisServiceAppIDParts function ():list 返回{"大区","服","服务ID","实例ID"}
 ---@field AVANT_DBSVRGO_APPID string|nil 缓存对应DbSvrGO进程的AppID
+---@field AVANT_DBSVRGO_PEER_HANDLE integer|nil 缓存对应DbSvrGO进程的IPC对端handle
 ---@field AVANT_THISSERVICEINSTANCE_APPID_PARTS table|nil 返回本服务实例的{"大区","服","服务ID","实例ID"}
 ---@field INT32_MAX integer int32最大值=2147483647
 ---@field INT32_MIN integer int32最小值=-2147483648
@@ -91,4 +188,13 @@ function avant:GetDBSvrGoAppID()
     return self.AVANT_DBSVRGO_APPID
 end
 
+---@return integer 返回本服务对应的DBSvrGO进程的IPC对端handle
+function avant:GetDBSvrGoPeerHandle()
+    if self.AVANT_DBSVRGO_PEER_HANDLE == nil then
+        self.AVANT_DBSVRGO_PEER_HANDLE = self.GetIPCPeerHandle(self:GetDBSvrGoAppID())
+    end
+
+    return self.AVANT_DBSVRGO_PEER_HANDLE
+end
+
 return avant;
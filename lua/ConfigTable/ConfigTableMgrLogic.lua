@@ -5,6 +5,36 @@ ConfigTableMgr.Map2DConfig = {
         1,
         2
     },
+    -- 预生成的瓦片文件 由avant.TileGridSave写出 布局相同的地图填同一文件即共用一份只读映射
+    -- 没有配置或加载失败时地图使用全空网格
+    tileFiles = {
+        -- [1] = "./mapdata/map2d_1.avtm",
+        -- [2] = "./mapdata/map2d_1.avtm",
+    },
+    -- 快照按距离分层降频 距离为x与y方向较大者(像素) 小于ranges[k]属于第k层 超出的属于最后一层
+    -- 第k层每periods[k]步更新一次 默认250内每步 450内每5步 其余每10步
+    -- 推迟的状态要等客户端确认后才真正省掉增量 period小于确认往返的步数时几乎没有收益
+    snapshotLOD = {
+        ranges = { 250, 450, 0 },
+        periods = { 1, 5, 10 },
+    },
+    -- 按mapId覆盖默认分层 periods全为1即关闭降频
+    snapshotLODByMap = {
+        -- [2] = { ranges = { 300, 0 }, periods = { 1, 3 } },
+    },
+    -- 追帧 一次tick最多推进maxSteps个固定步长 超出的时间直接丢弃并进入降级
+    -- 降级期间每syncInterval个tick才做一次AOI判定与状态同步 连续recoverTicks个tick没有超限后恢复
+    catchUp = {
+        maxSteps = 3,
+        syncInterval = 2,
+        recoverTicks = 100,
+    },
+    -- 客户端输入的抖动缓冲 收到后等delaySteps步再应用 每步每个玩家最多应用一条
+    -- 前一个seq没到时后面的输入再多等reorderSteps步 之后跳过缺口
+    inputBuffer = {
+        delaySteps = 1,
+        reorderSteps = 2,
+    },
 };
 
 ---@return integer
@@ -19,11 +49,46 @@ function ConfigTableMgr.Map2DConfig:GetMapIdAt(iIdx)
     return self.mapIdList[iIdx];
 end
 
+---@param mapId integer
+---@return string|nil
+function ConfigTableMgr.Map2DConfig:GetTileFile(mapId)
+    return self.tileFiles[mapId];
+end
+
+---@param mapId integer
+---@return {ranges:number[], periods:integer[]}
+function ConfigTableMgr.Map2DConfig:GetSnapshotLOD(mapId)
+    return self.snapshotLODByMap[mapId] or self.snapshotLOD;
+end
+
+---@return MapCatchUpConfType
+function ConfigTableMgr.Map2DConfig:GetCatchUp()
+    return self.catchUp;
+end
+
+---@return MapInputBufferConfType
+function ConfigTableMgr.Map2DConfig:GetInputBuffer()
+    return self.inputBuffer;
+end
+
 ConfigTableMgr.Map3DConfig = {
     mapIdList = {
         4,
         5
     },
+    -- 追帧 一次tick最多推进maxSteps个固定步长 超出的时间直接丢弃并进入降级
+    -- 降级期间每syncInterval个tick才做一次AOI判定与状态同步 连续recoverTicks个tick没有超限后恢复
+    catchUp = {
+        maxSteps = 3,
+        syncInterval = 2,
+        recoverTicks = 100,
+    },
+    -- 客户端输入的抖动缓冲 收到后等delaySteps步再应用 每步每个玩家最多应用一条
+    -- 前一个seq没到时后面的输入再多等reorderSteps步 之后跳过缺口
+    inputBuffer = {
+        delaySteps = 1,
+        reorderSteps = 2,
+    },
 };
 
 ---@return integer
@@ -38,6 +103,44 @@ function ConfigTableMgr.Map3DConfig:GetMap3DIdAt(iIdx)
     return self.mapIdList[iIdx];
 end
 
+---@return MapCatchUpConfType
+function ConfigTableMgr.Map3DConfig:GetCatchUp()
+    return self.catchUp;
+end
+
+---@return MapInputBufferConfType
+function ConfigTableMgr.Map3DConfig:GetInputBuffer()
+    return self.inputBuffer;
+end
+
+-- 2D地图跨进程迁移 由MapMgr.HandoffMap发起
+ConfigTableMgr.MapHandoffConfig = {
+    -- 源进程发出状态后等待确认 超时后恢复推进 目标进程导入后等待补发两倍于此 超时后丢弃导入的地图
+    ackTimeoutMS = 3000,
+    -- 迁移过来的玩家等待客户端重连进入的时间 超时移出地图
+    reserveMS = 15000,
+    -- 各地图服对客户端开放的地址 按app_id查 重定向时下发给客户端
+    clientAddrs = {
+        ["1.1.1.1"] = { ip = "127.0.0.1", port = 20025 },
+    },
+};
+
+---@return integer
+function ConfigTableMgr.MapHandoffConfig:GetAckTimeoutMS()
+    return self.ackTimeoutMS;
+end
+
+---@return integer
+function ConfigTableMgr.MapHandoffConfig:GetReserveMS()
+    return self.reserveMS;
+end
+
+---@param appId string
+---@return {ip:string, port:integer}|nil
+function ConfigTableMgr.MapHandoffConfig:GetClientAddr(appId)
+    return self.clientAddrs[appId];
+end
+
 ConfigTableMgr.FSRoomConfig = {
     roomIdList = {
         6,
@@ -26,6 +26,204 @@ function Debug:DebugTableToString(t, indent)
     return str
 end
 
+--- 对比Lua四叉树与原生四叉树 每个实体移动一步后以1200x1200范围查询周围实体
+---@param count integer 实体数量
+---@return number luaMs, number nativeMs 平均每轮耗时(毫秒)
+function Debug:BenchMapQuadTree(count)
+    local MapQuadTree = require("MapQuadTreeLogic");
+    local Log = require("Log");
+    local W, H, STEP, ROUNDS = 20000, 20000, 16, 10;
+
+    local objs = {};
+    for i = 1, count do
+        objs[i] = { userId = i, x = math.random(0, W - 1), y = math.random(0, H - 1), bodyRadius = 16 };
+    end
+
+    local function move(o)
+        o.x = math.min(W - 1, math.max(0, o.x + math.random(-STEP, STEP)));
+        o.y = math.min(H - 1, math.max(0, o.y + math.random(-STEP, STEP)));
+    end
+
+    -- Lua四叉树 旧实现移动时先移除再插入
+    local luaTree = MapQuadTree.new(0, 0, W, H, 0);
+    for _, o in ipairs(objs) do
+        MapQuadTree.QtInert(luaTree, o);
+    end
+    local begin = avant.Monotonic();
+    for _ = 1, ROUNDS do
+        for _, o in ipairs(objs) do
+            move(o);
+            MapQuadTree.RemoveItemFromList(o.mapQuadTree, o.userId);
+            o.mapQuadTree = nil;
+            MapQuadTree.QtInert(luaTree, o);
+        end
+        for _, o in ipairs(objs) do
+            MapQuadTree.QtQuery(luaTree, { x = o.x - 600, y = o.y - 600, w = 1200, h = 1200 }, {}, {});
+        end
+    end
+    local luaMs = (avant.Monotonic() - begin) / 1e6 / ROUNDS;
+
+    local treeId = avant.QuadTreeCreate(0, 0, W, H, 8, 8);
+    for _, o in ipairs(objs) do
+        o.quadHandle = avant.QuadTreeInsert(treeId, o.x, o.y, o.bodyRadius);
+    end
+    local out = {};
+    begin = avant.Monotonic();
+    for _ = 1, ROUNDS do
+        for _, o in ipairs(objs) do
+            move(o);
+            avant.QuadTreeUpdate(treeId, o.quadHandle, o.x, o.y);
+        end
+        for _, o in ipairs(objs) do
+            avant.QuadTreeQuery(treeId, o.x - 600, o.y - 600, 1200, 1200, out);
+        end
+    end
+    local nativeMs = (avant.Monotonic() - begin) / 1e6 / ROUNDS;
+    avant.QuadTreeDestroy(treeId);
+
+    Log:Error("BenchMapQuadTree count %d lua %.3fms native %.3fms", count, luaMs, nativeMs);
+    return luaMs, nativeMs;
+end
+
+--- 对比Lua八叉树与原生稀疏体素索引 每个实体移动一步后以1200^3范围查询周围实体
+---@param count integer 实体数量
+---@param span integer 实体分布的立方体边长
+---@return number luaMs, number nativeMs 平均每轮耗时(毫秒)
+function Debug:BenchMap3DIndex(count, span)
+    local Map3DOctree = require("Map3DOctreeLogic");
+    local Log = require("Log");
+    local SIZE, STEP, ROUNDS = 1000000, 50, 10;
+    local base = math.floor((SIZE - span) / 2);
+
+    local objs = {};
+    for i = 1, count do
+        objs[i] = {
+            userId = i,
+            pos = { x = base + math.random(0, span), y = base + math.random(0, span), z = base + math.random(0, span) }
+        };
+    end
+
+    local function move(o)
+        o.pos.x = o.pos.x + math.random(-STEP, STEP);
+        o.pos.y = o.pos.y + math.random(-STEP, STEP);
+        o.pos.z = o.pos.z + math.random(-STEP, STEP);
+    end
+
+    -- Lua八叉树 旧实现移动时先移除再插入
+    local luaTree = Map3DOctree.new(0, 0, 0, SIZE, SIZE, SIZE, 0);
+    for _, o in ipairs(objs) do
+        Map3DOctree.OcInsert(luaTree, o);
+    end
+    local begin = avant.Monotonic();
+    for _ = 1, ROUNDS do
+        for _, o in ipairs(objs) do
+            move(o);
+            Map3DOctree.RemoveItemFromList(o.map3DOctree, o.userId);
+            o.map3DOctree = nil;
+            Map3DOctree.OcInsert(luaTree, o);
+        end
+        for _, o in ipairs(objs) do
+            local range = { x = o.pos.x - 600, y = o.pos.y - 600, z = o.pos.z - 600, w = 1200, h = 1200, d = 1200 };
+            Map3DOctree.OcQuery(luaTree, range, {}, {});
+        end
+    end
+    local luaMs = (avant.Monotonic() - begin) / 1e6 / ROUNDS;
+
+    local indexId = avant.VoxelIndexCreate(1200);
+    for _, o in ipairs(objs) do
+        o.voxelHandle = avant.VoxelIndexInsert(indexId, o.pos.x, o.pos.y, o.pos.z, 0);
+    end
+    local out = {};
+    begin = avant.Monotonic();
+    for _ = 1, ROUNDS do
+        for _, o in ipairs(objs) do
+            move(o);
+            avant.VoxelIndexUpdate(indexId, o.voxelHandle, o.pos.x, o.pos.y, o.pos.z);
+        end
+        for _, o in ipairs(objs) do
+            avant.VoxelIndexQueryBox(indexId, o.pos.x - 600, o.pos.y - 600, o.pos.z - 600, 1200, 1200, 1200, out);
+        end
+    end
+    local nativeMs = (avant.Monotonic() - begin) / 1e6 / ROUNDS;
+    avant.VoxelIndexDestroy(indexId);
+
+    Log:Error("BenchMap3DIndex count %d span %d lua %.3fms native %.3fms", count, span, luaMs, nativeMs);
+    return luaMs, nativeMs;
+end
+
+--- 对比Lua逐玩家移动积分与原生批量积分的耗时 并校验两者结果逐位相同 原生侧不开碰撞
+---@param count integer 玩家数量
+---@param steps integer 固定步数
+---@return number luaMs, number nativeMs, integer mismatch 平均每步耗时(毫秒)与结果不同的玩家数
+function Debug:BenchMapPhysics(count, steps)
+    local Map = require("MapLogic");
+    local Log = require("Log");
+
+    local map = Map.new(0);
+    local W = map.tileMap.width * map.tileMap.tileSize;
+    local H = map.tileMap.height * map.tileMap.tileSize;
+    local DT = map.MapDbData.DT_MS;
+    local physicsId = avant.PhysicsCreate(W, H, 0, 0);
+
+    ---@type table<integer,MapPlayerType>
+    local players = {};
+    for i = 1, count do
+        local p = {
+            x = math.random(0, W), y = math.random(0, H), vX = 0, vY = 0, dirX = 0, dirY = 0,
+            maxSpeed = 0.1, accel = 1, speedRatio = 1000, bodyRadius = 12,
+            friction = math.random() < 0.5 and 1.0 or 0.9, bodyMass = 1, bounce = 0.4
+        };
+        players[i] = p;
+        avant.PhysicsAdd(physicsId, i, p.x, p.y, p.maxSpeed, p.accel, p.speedRatio, p.friction, p.bodyRadius,
+            p.bodyMass, p.bounce);
+    end
+
+    local luaNs, nativeNs = 0, 0;
+    for step = 1, steps do
+        -- 每步约5%的玩家改变输入方向 包括停下
+        for i = 1, count do
+            if math.random() < 0.05 then
+                local p = players[i];
+                local dirX, dirY = math.random(-100, 100), math.random(-100, 100);
+                local len = math.sqrt(dirX * dirX + dirY * dirY);
+                if len > 0.0001 and math.random() < 0.8 then
+                    dirX, dirY = dirX / len, dirY / len;
+                else
+                    dirX, dirY = 0, 0;
+                end
+                p.dirX, p.dirY = dirX, dirY;
+                avant.PhysicsSetInput(physicsId, i, dirX, dirY, step, "0");
+            end
+        end
+
+        local begin = avant.Monotonic();
+        for i = 1, count do
+            map:PlayerPhysicsMove(players[i]);
+        end
+        luaNs = luaNs + (avant.Monotonic() - begin);
+
+        begin = avant.Monotonic();
+        avant.PhysicsStep(physicsId, DT);
+        nativeNs = nativeNs + (avant.Monotonic() - begin);
+    end
+
+    local mismatch = 0;
+    for i = 1, count do
+        local p = players[i];
+        local x, y, vX, vY = avant.PhysicsGet(physicsId, i);
+        if x ~= p.x or y ~= p.y or vX ~= p.vX or vY ~= p.vY then
+            mismatch = mismatch + 1;
+        end
+    end
+    avant.PhysicsDestroy(physicsId);
+    map:Release();
+
+    local luaMs, nativeMs = luaNs / 1e6 / steps, nativeNs / 1e6 / steps;
+    Log:Error("BenchMapPhysics count %d steps %d lua %.3fms native %.3fms mismatch %d", count, steps, luaMs, nativeMs,
+        mismatch);
+    return luaMs, nativeMs, mismatch;
+end
+
 return Debug
 
 -- 设置你想要断下来的断点行
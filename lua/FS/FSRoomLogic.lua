@@ -7,7 +7,11 @@
 ---@field lastUpdateStateTime integer
 ---@field maxPlayers integer
 local FSRoom = require("FSRoomData")
+local FSRoomPlayer = require("FSRoomPlayerLogic")
+local FSRoomSync = require("FSRoomSyncLogic")
+local FSRoomMap = require("FSRoomMapLogic")
 local Log = require("Log")
+local TimeMgr = require("TimeMgrLogic")
 
 -- Room states
 FSRoom.STATE_WAITING = "waiting"
@@ -15,6 +19,10 @@ FSRoom.STATE_READY = "ready"
 FSRoom.STATE_RUNNING = "running"
 FSRoom.STATE_FINISHED = "finished"
 
+-- 房间地图尺寸 格子坐标从1开始
+local FS_ROOM_MAP_WIDTH = 64
+local FS_ROOM_MAP_HEIGHT = 64
+
 -- 构造新的FSRoom对象
 ---@param roomId integer
 ---@param maxPlayers integer
@@ -30,6 +38,11 @@ function FSRoom.new(roomId, maxPlayers)
     };
 
     self.roomPlayers = {};
+    self.playerCount = 0;
+    self.sync = FSRoomSync.new(self);
+    -- 寻路 射线 流场都在房间地图上 四周为墙
+    self.map = FSRoomMap.new(FS_ROOM_MAP_WIDTH, FS_ROOM_MAP_HEIGHT);
+    self.map:GenerateBorderWalls();
 
     self.state = FSRoom.STATE_WAITING;
     self.lastUpdateStateTime = 0;
@@ -42,6 +55,11 @@ function FSRoom:GetState()
     return self.state;
 end
 
+---@return FSRoomMap
+function FSRoom:GetMap()
+    return self.map;
+end
+
 ---@return FSRoomDbDataType
 function FSRoom:GetFSRoomDbData()
     return self.FSRoomDbData;
@@ -49,22 +67,83 @@ end
 
 function FSRoom:OnTick()
     -- Log:Error("FSRoom %d", self:GetFSRoomDbData().id)
+    self.sync:Update();
 end
 
+---@param state string
+function FSRoom:SetState(state)
+    self.state = state;
+    self.lastUpdateStateTime = TimeMgr.GetS();
+end
+
+--- 加入房间并绑定客户端连接 断线后重新加入的玩家保留已确认的帧 从其后补发
+--- 第一个玩家加入时开始推进帧
 ---@param playerId string
 ---@param userId string
-function FSRoom:AddPlayerToRoom(playerId, userId)
-    -- TODO
+---@param clientGID string
+---@param workerIdx integer
+---@return integer ProtoErrCode
+function FSRoom:AddPlayerToRoom(playerId, userId, clientGID, workerIdx)
+    local roomPlayer = self.roomPlayers[userId];
+    if roomPlayer == nil then
+        if self.playerCount >= self.maxPlayers then
+            return ProtoLua_ProtoErrCode.ERR_FS_ROOM_FULL;
+        end
+        roomPlayer = FSRoomPlayer.new(userId, self);
+        -- 中途加入从当前帧之后开始收 之前的帧可能早已淘汰
+        roomPlayer:ResetFrames(self.sync:GetCurrentFrame());
+        self.roomPlayers[userId] = roomPlayer;
+        self.playerCount = self.playerCount + 1;
+    end
+    roomPlayer:Bind(clientGID, workerIdx);
+
+    if self.state == FSRoom.STATE_WAITING then
+        self:SetState(FSRoom.STATE_RUNNING);
+        self.sync:Start();
+    end
+    Log:Error("FSRoom %d AddPlayerToRoom playerId %s userId %s lastFrameId %d", self.FSRoomDbData.id, playerId,
+        userId, roomPlayer.lastFrameId);
+    return ProtoLua_ProtoErrCode.OK;
+end
+
+--- 玩家断线 保留在房间内等待重新加入
+---@param playerId string
+---@param userId string
+function FSRoom:DisconnectPlayer(playerId, userId)
+    local roomPlayer = self.roomPlayers[userId];
+    if roomPlayer ~= nil then
+        roomPlayer:Disconnect();
+    end
 end
 
 ---@param playerId string
 ---@param userId string
 function FSRoom:RemovePlayerFromRoom(playerId, userId)
-    -- TODO
+    if self.roomPlayers[userId] == nil then
+        return
+    end
+    self.roomPlayers[userId] = nil;
+    self.playerCount = self.playerCount - 1;
+    if self.playerCount == 0 and self.state == FSRoom.STATE_RUNNING then
+        self.sync:Stop();
+        self:SetState(FSRoom.STATE_WAITING);
+    end
+end
+
+--- 客户端确认收到的帧
+---@param userId string
+---@param frameId integer
+function FSRoom:AckFrame(userId, frameId)
+    local roomPlayer = self.roomPlayers[userId];
+    if roomPlayer ~= nil then
+        roomPlayer:AckFrame(frameId, self.sync:GetCurrentFrame());
+    end
 end
 
 ---被FSRoomMgr删除前调用
 function FSRoom:DeleteBefore()
+    self.sync:Release();
+    self.map:Release();
 end
 
 return FSRoom;
@@ -5,3 +5,6 @@
 ---@class FSRoomType
 ---@field FSRoomDbData FSRoomDbDataType
 ---@field roomPlayers table<string,FSRoomPlayer>
+---@field playerCount integer roomPlayers中的玩家数
+---@field sync FSRoomSync 帧推进与广播
+---@field map FSRoomMap 房间地图 持有原生瓦片网格
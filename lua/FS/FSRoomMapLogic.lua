@@ -1,17 +1,19 @@
 ---@class FSRoomMap
----@field TILE_EMPTY string 地图瓦片什么都没有
----@field TILE_WALL string 地图瓦片墙
----@field TILE_WATER string 地图瓦片水
+---@field TILE_EMPTY integer 地图瓦片什么都没有
+---@field TILE_WALL integer 地图瓦片墙
+---@field TILE_WATER integer 地图瓦片水
 ---@field width integer 地图宽
 ---@field height integer 地图高
----@field tiles table<integer,table<integer,string>>
+---@field gridId integer|nil 原生瓦片网格id 每格2位 网格坐标从0开始
 local FSRoomMap = require("FSRoomMapData");
 
 local AlgorithmRandom = require("AlgorithmRandomLogic");
 
-FSRoomMap.TILE_EMPTY = '0';
-FSRoomMap.TILE_WALL = '1';
-FSRoomMap.TILE_WATER = '2';
+FSRoomMap.TILE_EMPTY = 0;
+FSRoomMap.TILE_WALL = 1;
+FSRoomMap.TILE_WATER = 2;
+-- 三种瓦片 每格2位
+local FS_ROOM_MAP_TILE_BITS = 2
 
 ---@param width integer 地图宽
 ---@param height integer 地图高
@@ -22,19 +24,20 @@ function FSRoomMap.new(width, height)
 
     self.width = width;
     self.height = height;
-    self.tiles = {};
-
-    -- 初始化空地图
-    for y = 1, height do
-        self.tiles[y] = {}
-        for x = 1, width do
-            self.tiles[y][x] = FSRoomMap.TILE_EMPTY;
-        end
-    end
+    -- 新建的网格全为0即TILE_EMPTY 默认也只有0可行走
+    self.gridId = avant.TileGridCreate(width, height, FS_ROOM_MAP_TILE_BITS);
 
     return self;
 end
 
+-- 释放原生瓦片网格
+function FSRoomMap:Release()
+    if self.gridId ~= nil then
+        avant.TileGridDestroy(self.gridId);
+        self.gridId = nil;
+    end
+end
+
 ---@param x integer
 ---@param y integer
 function FSRoomMap:IsValidPosition(x, y)
@@ -43,17 +46,17 @@ end
 
 ---@param x integer
 ---@param y integer
----@param tileType string
+---@param tileType integer
 function FSRoomMap:SetTile(x, y, tileType)
     if self:IsValidPosition(x, y) then
-        self.tiles[y][x] = tileType;
+        avant.TileGridSetTile(self.gridId, x - 1, y - 1, tileType);
     end
 end
 
----@return string tileType
+---@return integer tileType
 function FSRoomMap:GetTile(x, y)
     if self:IsValidPosition(x, y) then
-        return self.tiles[y][x];
+        return avant.TileGridGetTile(self.gridId, x - 1, y - 1);
     end
     return FSRoomMap.TILE_WALL;
 end
@@ -64,8 +67,24 @@ function FSRoomMap:IsWalkable(x, y)
         return false;
     end
 
-    local tile = self:GetTile(x, y);
-    return tile == FSRoomMap.TILE_EMPTY;
+    return avant.TileGridIsWalkable(self.gridId, x - 1, y - 1);
+end
+
+--- 从(x1,y1)格中心到(x2,y2)格中心的直线是否被不可行走的格子挡住
+---@param x1 integer
+---@param y1 integer
+---@param x2 integer
+---@param y2 integer
+---@return boolean hit
+---@return integer|nil hitX
+---@return integer|nil hitY
+function FSRoomMap:Raycast(x1, y1, x2, y2)
+    -- 1开始的格坐标x对应网格坐标系中[x-1,x)
+    local hit, hitX, hitY = avant.TileGridRaycast(self.gridId, x1 - 0.5, y1 - 0.5, x2 - 0.5, y2 - 0.5);
+    if hit then
+        return true, hitX + 1, hitY + 1;
+    end
+    return false;
 end
 
 --- 两点直线距离
@@ -112,149 +131,67 @@ function FSRoomMap:GenerateRandomObstacles(count)
     end
 end
 
---- 简单的A* 路径查找 暂不支持对角线移动 暂不支持地形权重
+--- A*路径查找 4方向移动 暂不支持地形权重 由C++在原生网格上完成 结果按地图版本缓存
+--- 返回的路径为起点到终点(含两端)每格的坐标 按x1, y1, x2, y2...平铺 终点不可行走或不可达返回nil
 ---@param startX integer
 ---@param startY integer
 ---@param endX integer
 ---@param endY integer
-function FSRoomMap:FindPath(startX, startY, endX, endY)
-    ---@class Point
-    ---@field x integer
-    ---@field y integer
-
-    -- 如果终点不可行走，直接返回nil
-    if not self:IsWalkable(endX, endY) then
+---@param useJPS boolean|nil 跳点搜索 展开的节点更少 路径与A*等长但走法可能不同
+---@return integer[]|nil
+function FSRoomMap:FindPath(startX, startY, endX, endY, useJPS)
+    if not self:IsValidPosition(startX, startY) or not self:IsWalkable(endX, endY) then
         return nil;
     end
 
-    -- 起点就是终点，路径就是自己
-    if startX == endX and startY == endY then
-        return { { x = startX, y = startY } };
+    local path = {};
+    local points = avant.PathFind(self.gridId, startX - 1, startY - 1, endX - 1, endY - 1, useJPS == true, path);
+    if points == nil then
+        return nil;
     end
-
-    -- 待评估节点集合
-    ---@type table<integer,Point>
-    local openSet = {};
-    -- 已评估节点集合
-    ---@type table<integer,boolean>
-    local closedSet = {};
-
-    -- 路径追踪表，记录每个节点来自哪里
-    ---@type table<integer,Point>
-    local cameFrom = {};
-
-    -- 从起点到当前节点的实际代价
-    ---@type table<integer,integer>
-    local gScore = {};
-
-    -- fScore = gScore + 启发式估价（曼哈顿距离）
-    ---@type table<integer,integer>
-    local fScore = {};
-
-    -- 将二维坐标映射为唯一key，方便table索引
-    local function NodeKey(x, y)
-        return y * self.width + x
+    -- 网格坐标从0开始
+    for i = 1, points * 2 do
+        path[i] = path[i] + 1;
     end
+    return path;
+end
 
-    -- 从终点反向重建路径
-    local function ReconstructPath(currentX, currentY)
-        local path = { { x = currentX, y = currentY } };
-        local key = NodeKey(currentX, currentY);
-
-        -- 不断回溯 cameFrom 直到起点
-        while cameFrom[key] ~= nil do
-            local from = cameFrom[key];
-            table.insert(path, 1, { x = from.x, y = from.y });
-            key = NodeKey(from.x, from.y);
-        end
-
-        return path;
+--- 走向(goalX,goalY)的流场 许多实体去同一终点时代替逐个FindPath
+--- 按地图版本与终点缓存 地图变化后重新生成 实体每步用FlowDirection查所在格的方向
+--- 返回的场id在淘汰或地图有任何修改后立即失效 每次使用前重新取 命中缓存时开销很小
+---@param goalX integer
+---@param goalY integer
+---@return integer|nil fieldId 终点不可行走返回nil
+function FSRoomMap:GetFlowField(goalX, goalY)
+    if not self:IsWalkable(goalX, goalY) then
+        return nil;
     end
+    return avant.FlowFieldGet(self.gridId, goalX - 1, goalY - 1);
+end
 
-    -- 初始化起点
-    local startKey = NodeKey(startX, startY);
-    openSet[startKey] = { x = startX, y = startY };
-    gScore[startKey] = 0;
-    fScore[startKey] = self:GetManhattanDistance(
-        startX,
-        startY,
-        endX,
-        endY
-    );
-
-    -- 主循环 只要 openSet 里还有节点就继续
-    while next(openSet) do
-        -- 从openSet中找fScore最小的节点
-        ---@type integer|nil
-        local currenyKey
-
-        ---@type Point|nil
-        local current
-        local lowestF = math.huge
-
-        for key, node in pairs(openSet) do
-            if fScore[key] < lowestF then
-                lowestF = fScore[key]
-                currenyKey = key
-                current = node
-            end
-        end
-
-        if not current then break end
-
-        -- 如果到达终点，回溯路径并返回
-        if current.x == endX and current.y == endY then
-            return ReconstructPath(current.x, current.y);
-        end
-
-        -- 将当前节点从 openSet 移入 closedSet
-        openSet[currenyKey] = nil;
-        closedSet[currenyKey] = true
-
-        -- 四方向邻居（上下左右）
-        ---@type table<integer,Point>
-        local neighbors = {
-            { x = current.x - 1, y = current.y },
-            { x = current.x + 1, y = current.y },
-            { x = current.x,     y = current.y - 1 },
-            { x = current.x,     y = current.y + 1 }
-        };
-
-        -- 遍历邻居节点
-        for _, neighbor in ipairs(neighbors) do
-            local nx, ny = neighbor.x, neighbor.y;
-
-            -- 只处理可行走的格子
-            if self:IsWalkable(nx, ny) then
-                local neighborKey = NodeKey(nx, ny);
-
-                -- 已处理的节点直接跳过
-                if not closedSet[neighborKey] then
-                    -- 从当前节点走到邻居的代价
-                    local tentativeGScore = gScore[currenyKey] + 1
-
-                    -- 如果是新节点 或找到更短路径
-                    if not gScore[neighborKey] or tentativeGScore < gScore[neighborKey] then
-                        -- 记录路径的来源
-                        cameFrom[neighborKey] = {
-                            x = current.x,
-                            y = current.y
-                        };
-
-                        -- 更新g/f分数
-                        gScore[neighborKey] = tentativeGScore
-                        fScore[neighborKey] = self:GetManhattanDistance(nx, ny, endX, endY) + tentativeGScore;
+--- 在(x,y)格沿流场下一步的偏移 已在终点为0, 0
+---@param fieldId integer
+---@param x integer
+---@param y integer
+---@return integer|nil dx 到不了终点或场已失效返回nil
+---@return integer|nil dy
+function FSRoomMap:FlowDirection(fieldId, x, y)
+    return avant.FlowFieldDir(fieldId, x - 1, y - 1);
+end
 
-                        -- 加入 openSet
-                        openSet[neighborKey] = { x = nx, y = ny }
-                    end
-                end
-            end
-        end
+--- 一次查一群实体的方向 points为x1, y1, x2, y2...平铺 每格的偏移按dx, dy写入out
+--- 终点与到不了终点的格子都为0, 0
+---@param fieldId integer
+---@param points integer[]
+---@param out integer[]
+---@return integer|nil count 场已失效返回nil
+function FSRoomMap:FlowDirections(fieldId, points, out)
+    -- 网格坐标从0开始 偏移与坐标原点无关
+    local gridPoints = {};
+    for i = 1, #points do
+        gridPoints[i] = points[i] - 1;
     end
-
-    -- openSet 为空仍未到达终点，说明无路可走
-    return nil;
+    return avant.FlowFieldDirs(fieldId, gridPoints, out);
 end
 
 return FSRoomMap;
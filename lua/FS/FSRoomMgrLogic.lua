@@ -88,7 +88,7 @@ end
 ---@return FSRoom|nil
 function FSRoomMgr.FindAvailableRoom()
     for _, room in pairs(FSRoomMgr.rooms) do
-        if room.state == FSRoom.STATE_WAITING and #room.roomPlayers < room.maxPlayers then
+        if room.state == FSRoom.STATE_WAITING and room.playerCount < room.maxPlayers then
             return room;
         end
     end
@@ -100,7 +100,7 @@ end
 function FSRoomMgr.CleanupFinishedRooms(currTimeS)
     local toDelete = {};
     for roomId, room in pairs(FSRoomMgr.rooms) do
-        if room.state == FSRoom.STATE_FINISHED and #room.roomPlayers == 0 then
+        if room.state == FSRoom.STATE_FINISHED and room.playerCount == 0 then
             if currTimeS - room.lastUpdateStateTime > 3 * 60 then
                 table.insert(toDelete, roomId);
             end
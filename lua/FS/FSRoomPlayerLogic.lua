@@ -11,9 +11,13 @@
 ---@field skills table<integer,boolean> 技能
 ---@field skillCooldowns table<integer,number> 技能冷却时间
 ---@field lastFrameId number 客户端最后确认接收到的帧ID
+---@field sentFrameId number 已经发给客户端的最新帧ID 确认在途时广播按它推进
+---@field catchUpFrameId number 上次从历史帧补发时的当前帧ID
 ---@field isReady boolean 是否已经就绪
 ---@field isConnected boolean 是否连接正常
 ---@field lastHeartbeat number 最后心跳上报时间
+---@field clientGID string|nil 客户端连接 为nil时不广播帧
+---@field workerIdx integer|nil 客户端连接所在worker
 local FSRoomPlayer = require("FSRoomPlayerData")
 
 local TimeMgr = require("TimeMgrLogic");
@@ -38,9 +42,13 @@ function FSRoomPlayer.new(userId, room)
     newObj.skills         = {};
     newObj.skillCooldowns = {};
     newObj.lastFrameId    = 0;
+    newObj.sentFrameId    = 0;
+    newObj.catchUpFrameId = 0;
     newObj.isReady        = false;
     newObj.isConnected    = false;
     newObj.lastHeartbeat  = 0;
+    newObj.clientGID      = nil;
+    newObj.workerIdx      = nil;
 
     return newObj;
 end
@@ -134,9 +142,45 @@ function FSRoomPlayer:IsTimeout()
     return (now - self.lastHeartbeat) > 10;
 end
 
----玩家断开连接了
+---玩家断开连接了 不再广播 已确认的帧保留到重新加入时补发
 function FSRoomPlayer:Disconnect()
     self.isConnected = false;
+    self.clientGID = nil;
+    self.workerIdx = nil;
+end
+
+---绑定客户端连接 之后的帧广播给这个连接
+---@param clientGID string
+---@param workerIdx integer
+function FSRoomPlayer:Bind(clientGID, workerIdx)
+    self.clientGID = clientGID;
+    self.workerIdx = workerIdx;
+    -- 换了连接 之前发出的帧不一定收到了 从已确认的帧之后重新发
+    self.sentFrameId = self.lastFrameId;
+    self.catchUpFrameId = 0;
+    self:Reconnect();
+end
+
+---客户端确认已连续收到frameId及之前的帧 乱序到达的旧确认与超前的确认忽略
+---@param frameId integer
+---@param currentFrame integer
+function FSRoomPlayer:AckFrame(frameId, currentFrame)
+    if frameId <= self.lastFrameId or frameId > currentFrame then
+        return;
+    end
+    self.lastFrameId = frameId;
+    if self.sentFrameId < frameId then
+        self.sentFrameId = frameId;
+    end
+    self:UpdateHeartbeat();
+end
+
+---从frameId之后开始接收帧 房间重新开始时为0 中途加入时为当前帧
+---@param frameId integer
+function FSRoomPlayer:ResetFrames(frameId)
+    self.lastFrameId = frameId;
+    self.sentFrameId = frameId;
+    self.catchUpFrameId = 0;
 end
 
 ---玩家进行了重连
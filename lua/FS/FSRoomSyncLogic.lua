@@ -2,7 +2,7 @@
 ---@class FSRoomSyncFrameCommandType
 ---@field userId string
 ---@field commandType string
----@field data table
+---@field data string 编码好的指令数据 原样存入历史帧
 ---@field frameId integer
 
 --- 每帧的数据结构
@@ -16,14 +16,29 @@
 ---@field currentFrame integer 当前帧号
 ---@field frameRate integer 帧率30FPS
 ---@field frameInterval number 每帧时间33ms
----@field frameHistory table<integer,FSRoomSyncFrameType> 历史帧
+---@field storeId integer 历史帧环形缓冲 每帧只编码一次
+---@field broadcastId integer 帧广播 冗余携带最近若干帧 所有成员共用同一份编码
+---@field broadcastMembers table 广播成员 按clientGID, workerIdx, lastFrameId每3个一组 每帧复用
+---@field broadcastPlayers table<integer,FSRoomPlayer> 与broadcastMembers的组一一对应
+---@field broadcastBehind table<integer,integer> 落后超出广播窗口的组下标
+---@field statBeginMS number 本轮广播统计开始时间
 ---@field frameCommands table<integer,FSRoomSyncFrameCommandType> 当前帧命令
 ---@field isRunning boolean 是否在运行
 ---@field lastFrameTime number 最后帧时间
 local FSRoomSync = require("FSRoomSyncData");
 
 local TimeMgr = require("TimeMgrLogic");
-
+local Log = require("Log");
+
+--- 历史帧最多保留的帧数与字节数 30FPS下约34秒 超出淘汰最老的帧
+local HISTORY_CAPACITY_FRAMES = 1024;
+local HISTORY_CAPACITY_BYTES = 4 * 1024 * 1024;
+--- 每个广播包携带的帧数 连续丢3个包仍能补上
+local BROADCAST_REDUNDANCY = 4;
+--- 确认落后已发出的帧超过这么多帧(30FPS下1秒)时认为中间有包丢了 从已确认的帧之后补发
+local FRAME_ACK_TIMEOUT_FRAMES = 30;
+--- 广播统计输出间隔
+local BROADCAST_STAT_MS = 10000;
 
 --- 创建新的FSRoom对象
 ---@param room FSRoom
@@ -35,7 +50,12 @@ function FSRoomSync.new(room)
     self.currentFrame = 0;
     self.frameRate = 30;
     self.frameInterval = 33;
-    self.frameHistory = {};
+    self.storeId = avant.FSFrameStoreCreate(HISTORY_CAPACITY_FRAMES, HISTORY_CAPACITY_BYTES);
+    self.broadcastId = avant.FSBroadcastCreate(BROADCAST_REDUNDANCY);
+    self.broadcastMembers = {};
+    self.broadcastPlayers = {};
+    self.broadcastBehind = {};
+    self.statBeginMS = 0;
     self.frameCommands = {};
 
     self.isRunning = false;
@@ -48,16 +68,36 @@ function FSRoomSync:Start()
     self.isRunning = true;
     self.currentFrame = 0;
     self.lastFrameTime = TimeMgr.GetMS();
-    self.frameHistory = {};
+    self.statBeginMS = self.lastFrameTime;
+    avant.FSFrameStoreDestroy(self.storeId);
+    self.storeId = avant.FSFrameStoreCreate(HISTORY_CAPACITY_FRAMES, HISTORY_CAPACITY_BYTES);
+    avant.FSBroadcastDestroy(self.broadcastId);
+    self.broadcastId = avant.FSBroadcastCreate(BROADCAST_REDUNDANCY);
+    for _, player in pairs(self.room.roomPlayers) do
+        player:ResetFrames(0);
+    end
 end
 
 function FSRoomSync:Stop()
     self.isRunning = false;
 end
 
+--- 房间销毁时调用 释放历史帧缓冲
+function FSRoomSync:Release()
+    self.isRunning = false;
+    if self.storeId then
+        avant.FSFrameStoreDestroy(self.storeId);
+        self.storeId = nil;
+    end
+    if self.broadcastId then
+        avant.FSBroadcastDestroy(self.broadcastId);
+        self.broadcastId = nil;
+    end
+end
+
 ---@param userId string 玩家ID
 ---@param commandType string 指令类型
----@param data any 指令数据
+---@param data string 编码好的指令数据
 ---@return boolean
 function FSRoomSync:AddCommand(userId, commandType, data)
     if not self.isRunning then
@@ -118,8 +158,13 @@ function FSRoomSync:Update()
         commands = self.frameCommands
     };
 
-    -- 将帧存到history
-    table.insert(self.frameHistory, frame);
+    -- 编码一次存入历史帧与广播窗口 补帧与广播都直接使用编码好的字节
+    if not avant.FSFrameStoreAppend(self.storeId, frame.frameId, tostring(math.floor(frame.timestamp)), frame.commands,
+            self.broadcastId) then
+        Log:Error("FSRoomSync:Update FSFrameStoreAppend failed frameId %d", frame.frameId);
+    end
+    self:Broadcast();
+    self:LogBroadcastStats(currentTimeMS);
 
     -- 清空commands为下一帧
     self.frameCommands = {}
@@ -132,50 +177,123 @@ function FSRoomSync:GetCurrentFrame()
     return self.currentFrame;
 end
 
----@return table 返回历史所有帧
-function FSRoomSync:GetFrameHistory()
-    return self.frameHistory;
-end
-
 --- 返回自从frameId之后的所有帧,不包含指定的frameId那帧
+--- blob为ProtoCSFSNotifyFrames的编码 frameId已被淘汰时返回nil 需要完整重同步
 ---@param frameId integer 帧号
----@return table<integer,FSRoomSyncFrameType>
+---@return string|nil blob
+---@return integer count
 function FSRoomSync:GetFramesSince(frameId)
-    ---@type table<integer,FSRoomSyncFrameType>
-    local missedFrames = {};
+    return avant.FSFrameStoreSince(self.storeId, frameId);
+end
+
+--- 把frameId之后的所有帧补发给客户端 不重新编码
+---@param frameId integer 客户端已收到的最后一帧
+---@param clientGID string
+---@param workerIdx integer
+---@return integer count 发出的帧数 -1表示frameId已被淘汰
+function FSRoomSync:SendFramesSince(frameId, clientGID, workerIdx)
+    return avant.FSFrameStoreSendSince(self.storeId, frameId, clientGID, workerIdx);
+end
 
-    for _, frame in ipairs(self.frameHistory) do
-        if frame.frameId > frameId then
-            table.insert(missedFrames, frame);
+--- 广播时成员的基准帧 窗口包带上基准帧之后的帧
+--- 确认要一个往返才回来 在途期间按已发出的帧乐观推进 仍带满窗口的冗余帧 不会每帧都落到补发
+--- 确认超时未跟上时退回已确认的帧 超出窗口由历史帧补发 补发后再等一个超时
+---@param player FSRoomPlayer
+---@return integer
+function FSRoomSync:GetBroadcastBaseFrame(player)
+    if self.currentFrame - player.lastFrameId > FRAME_ACK_TIMEOUT_FRAMES and
+        self.currentFrame - player.catchUpFrameId > FRAME_ACK_TIMEOUT_FRAMES then
+        return player.lastFrameId;
+    end
+    return math.max(player.lastFrameId, player.sentFrameId - BROADCAST_REDUNDANCY + 1);
+end
+
+--- 把最近几帧广播给房间内已连接的玩家 落后超出广播窗口的从历史帧补发
+function FSRoomSync:Broadcast()
+    local members, players = self.broadcastMembers, self.broadcastPlayers;
+    local count = 0;
+    for _, player in pairs(self.room.roomPlayers) do
+        if player.isConnected and player.clientGID ~= nil then
+            count = count + 1;
+            players[count] = player;
+            members[count * 3 - 2] = player.clientGID;
+            members[count * 3 - 1] = player.workerIdx;
+            members[count * 3] = self:GetBroadcastBaseFrame(player);
         end
     end
+    for i = #players, count + 1, -1 do
+        players[i] = nil;
+    end
+    for i = #members, count * 3 + 1, -1 do
+        members[i] = nil;
+    end
+    if count == 0 then
+        return;
+    end
 
-    return missedFrames;
+    avant.FSBroadcastSend(self.broadcastId, members, self.broadcastBehind);
+    local behind = self.broadcastBehind;
+    for _, idx in ipairs(behind) do
+        local player = players[idx];
+        local baseFrame = members[idx * 3];
+        if self:SendFramesSince(baseFrame, player.clientGID, player.workerIdx) < 0 then
+            -- 基准帧已被淘汰 从最老的帧开始重同步 客户端收到的第一帧不接着已确认的帧 据此重建状态
+            local firstFrameId = avant.FSFrameStoreStat(self.storeId);
+            Log:Error("FSRoomSync:Broadcast userId %s frameId %d evicted from history resync from %s", player.userId,
+                baseFrame, tostring(firstFrameId));
+            if firstFrameId ~= nil and firstFrameId > 0 then
+                player.lastFrameId = firstFrameId - 1;
+                if self:SendFramesSince(player.lastFrameId, player.clientGID, player.workerIdx) < 0 then
+                    players[idx] = false;
+                end
+            else
+                players[idx] = false;
+            end
+        end
+        -- 无论是否发出 一个超时内不再补发 避免每帧重试
+        player.catchUpFrameId = self.currentFrame;
+    end
+    for i = 1, count, 1 do
+        local player = players[i];
+        if player then
+            player.sentFrameId = self.currentFrame;
+        end
+    end
 end
 
---- 只保留keeepCount帧超过了则删除最老的
----@param keepCount integer
-function FSRoomSync:ClearOldFrames(keepCount)
-    keepCount = keepCount or 1000
-    if #self.frameHistory > keepCount then
-        local removeCount = #self.frameHistory - keepCount;
-        for i = 1, removeCount do
-            table.remove(self.frameHistory, 1);
-        end
+--- 定期输出广播带宽与冗余统计
+---@param currentTimeMS number
+function FSRoomSync:LogBroadcastStats(currentTimeMS)
+    if currentTimeMS - self.statBeginMS < BROADCAST_STAT_MS then
+        return;
+    end
+    local elapsedMS = currentTimeMS - self.statBeginMS;
+    self.statBeginMS = currentTimeMS;
+
+    local packets, bytes, frames, redundantFrames, redundancyHits, windowMisses, deltaSavedBytes =
+        avant.FSBroadcastStat(self.broadcastId);
+    if packets ~= nil and packets > 0 then
+        Log:Error(
+            "FSRoom %d broadcast packets %d bytes/s %.1f frames %d redundant %d hits %d window misses %d delta saved %d",
+            self.room:GetFSRoomDbData().id, packets, bytes * 1000 / elapsedMS, frames, redundantFrames, redundancyHits,
+            windowMisses, deltaSavedBytes);
     end
 end
 
 ---@class FSRoomSyncStatisticsType
 ---@field currentFrame integer 当前帧号
 ---@field totalFrames integer history中存了多少帧
+---@field historyBytes integer history占用的字节数
 ---@field isRunning boolean 是否在运行
 ---@field pendingCommands integer 当前帧收到多少指令了
 
 ---@return FSRoomSyncStatisticsType
 function FSRoomSync:GetStats()
+    local _, _, frames, bytes = avant.FSFrameStoreStat(self.storeId);
     return {
         currentFrame = self.currentFrame,
-        totalFrames = #self.frameHistory,
+        totalFrames = frames or 0,
+        historyBytes = bytes or 0,
         isRunning = self.isRunning,
         pendingCommands = #self.frameCommands
     };
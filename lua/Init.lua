@@ -53,6 +53,18 @@ function OnWorkerReload(workerIdx)
     Worker:OnReload(workerIdx);
 end
 
+---@param workerIdx integer
+---@param connGID string
+---@param method string
+---@param path string 带query的请求目标
+---@param headers table<string,string>
+---@param body string
+---@return integer|nil status, table|nil headers, string|nil body body为nil时为流式响应
+function OnHttpRequest(workerIdx, connGID, method, path, headers, body)
+    local Worker = require("Worker")
+    return Worker:OnHttpRequest(method, path, headers, body, connGID, workerIdx);
+end
+
 function OnOtherInit()
     local Other = require("Other")
     Other:OnInit();
@@ -1,11 +1,16 @@
 ---@class Map3D:Map3DType
 local Map3D = require("Map3DData");
 local Log = require("Log");
+local MapClock = require("MapClockLogic");
 local TimeMgr = require("TimeMgrLogic");
-local Map3DOctree = require("Map3DOctreeLogic");
 local NumericBigInt = require("NumericBigIntLogic");
 local AlgorithmRandom = require("AlgorithmRandomLogic");
 
+-- 原生稀疏体素索引格子边长 与AOI查询范围1200一致 每次查询最多覆盖27个格子
+local MAP3D_VOXEL_CELL_SIZE = 1200;
+-- 追帧统计输出周期 毫秒
+local MAP3D_STAT_MS = 10000;
+
 -- 构造新的3DMap对象
 ---@param mapId integer 地图ID
 ---@return Map3D 新的地图对象
@@ -26,12 +31,42 @@ function Map3D.new(mapId)
     ---@type table<string,Map3DPlayerType>
     self.players = {};
 
-    -- 八叉树
-    self.map3DOctree = Map3DOctree.new(0, 0, 0, self:GetSize().x, self:GetSize().y, self:GetSize().z, 0);
+    -- 原生稀疏体素索引 玩家以voxelHandle引用
+    self.voxelIndexId = avant.VoxelIndexCreate(MAP3D_VOXEL_CELL_SIZE);
+    ---@type table<integer,Map3DPlayerType>
+    self.voxelHandle2Player = {};
+    -- 复用的查询结果数组
+    self.voxelQueryResult = {};
+
+    -- 卡顿后最多追maxSteps步 追不上时降级为隔几个tick同步一次
+    local ConfigTableMgr = require("ConfigTableMgrLogic");
+    self.catchUp = ConfigTableMgr.Map3DConfig:GetCatchUp();
+    self.degradeTicks = 0;
+    self.syncSkip = 0;
+    self.catchUpStat = { catchUpTicks = 0, overrunTicks = 0, droppedSteps = 0, degradedTicks = 0, skippedSyncs = 0 };
+    self.statBeginMS = 0;
+
+    -- 客户端输入先进抖动缓冲 每步移动前按seq最多应用一条
+    local inputBuffer = ConfigTableMgr.Map3DConfig:GetInputBuffer();
+    self.inputBufferId = avant.InputBufferCreate(inputBuffer.delaySteps, inputBuffer.reorderSteps);
+    self.inputStepResult = {};
 
     return self;
 end
 
+-- 释放地图持有的原生资源
+function Map3D:Release()
+    if self.voxelIndexId ~= nil then
+        avant.VoxelIndexDestroy(self.voxelIndexId);
+        self.voxelIndexId = nil;
+    end
+    if self.inputBufferId ~= nil then
+        avant.InputBufferDestroy(self.inputBufferId);
+        self.inputBufferId = nil;
+    end
+    self.voxelHandle2Player = {};
+end
+
 ---@return Map3DDbDataType
 function Map3D:GetMapDbData()
     return self.MapDbData;
@@ -64,18 +99,46 @@ function Map3D:OnTick()
     -- Log:Error("S %s", tostring(TimeMgr.GetS()));
     -- Log:Error("NS %s", tostring(TimeMgr.GetNS()));
 
-    local frameTime = timeMS - self.MapDbData.lastTickTimeMS;
-    if frameTime > 250 then
-        frameTime = 250 -- 防止卡顿时爆炸
+    local steps, sync = MapClock.Advance(self, timeMS, "Map3D mapId");
+    -- 追帧的多步只做移动 AOI查询与状态同步每次tick最多一次
+    for step = 1, steps, 1 do
+        self:FixedUpdate(timeMS);
+    end
+    if sync then
+        self:SyncState(timeMS);
     end
 
-    self.MapDbData.lastTickTimeMS = timeMS;
-    self.MapDbData.durationAccumulator = self.MapDbData.durationAccumulator + frameTime;
+    self:TickStat(timeMS);
+end
 
-    while self.MapDbData.durationAccumulator >= self.MapDbData.DT_MS do
-        -- 一次固定步长的逻辑更新
-        self:FixedUpdate(timeMS);
-        self.MapDbData.durationAccumulator = self.MapDbData.durationAccumulator - self.MapDbData.DT_MS;
+-- 周期输出追帧与降级统计
+---@param timeMS integer
+function Map3D:TickStat(timeMS)
+    if self.statBeginMS == 0 then
+        self.statBeginMS = timeMS;
+        return
+    end
+    if timeMS - self.statBeginMS < MAP3D_STAT_MS then
+        return
+    end
+    self.statBeginMS = timeMS;
+
+    local stat = self.catchUpStat;
+    if stat.catchUpTicks > 0 or self.degradeTicks > 0 then
+        Log:Error("Map3D mapId %d catch-up ticks %d overrun %d dropped steps %d degraded %d skipped syncs %d",
+            self.MapDbData.id, stat.catchUpTicks, stat.overrunTicks, stat.droppedSteps, stat.degradedTicks,
+            stat.skippedSyncs);
+    end
+    stat.catchUpTicks = 0;
+    stat.overrunTicks = 0;
+    stat.droppedSteps = 0;
+    stat.degradedTicks = 0;
+    stat.skippedSyncs = 0;
+
+    local applied, late, dropped, duplicate, skipped = avant.InputBufferStat(self.inputBufferId);
+    if applied ~= nil and late + dropped + duplicate + skipped > 0 then
+        Log:Error("Map3D mapId %d inputs applied %d late %d dropped %d duplicate %d skipped %d", self.MapDbData.id,
+            applied, late, dropped, duplicate, skipped);
     end
 end
 
@@ -119,13 +182,17 @@ function Map3D:PlayerJoinMap(playerId, userId)
         accel = 1,       -- 加速度 px/ms^2
         friction = 1.0,  -- 无摩擦
         bodyRadius = 12,
-        octree = nil
+        voxelHandle = nil
     };
 
     self.players[userId] = newMap3DPlayer;
 
-    -- 加入地图八叉树
-    Map3DOctree.OcInsert(self.map3DOctree, newMap3DPlayer);
+    -- 加入地图体素索引 半径传0 与原先一样按坐标点判定是否在AOI内
+    newMap3DPlayer.voxelHandle = avant.VoxelIndexInsert(self.voxelIndexId,
+        newMap3DPlayer.pos.x, newMap3DPlayer.pos.y, newMap3DPlayer.pos.z, 0);
+    if newMap3DPlayer.voxelHandle ~= nil then
+        self.voxelHandle2Player[newMap3DPlayer.voxelHandle] = newMap3DPlayer;
+    end
 
     return true;
 end
@@ -141,11 +208,12 @@ function Map3D:PlayerExitMap(userId)
     ---@type Map3DPlayerType
     local targetPlayer = self.players[userId];
     if targetPlayer ~= nil then
-        -- 将玩家从八叉树中移除
-        if targetPlayer.map3DOctree ~= nil then
-            Map3DOctree.RemoveItemFromList(targetPlayer.map3DOctree, targetPlayer.userId);
-
-            targetPlayer.map3DOctree = nil;
+        -- 将玩家从体素索引中移除
+        if targetPlayer.voxelHandle ~= nil then
+            avant.InputBufferRemove(self.inputBufferId, targetPlayer.voxelHandle);
+            avant.VoxelIndexRemove(self.voxelIndexId, targetPlayer.voxelHandle);
+            self.voxelHandle2Player[targetPlayer.voxelHandle] = nil;
+            targetPlayer.voxelHandle = nil;
         end
 
         self.players[userId] = nil;
@@ -173,20 +241,6 @@ function Map3D:MapPlayerInput(userId,
         return;
     end
 
-    if map3DPlayer.lastSeq >= avant.UINT32_MAX then
-        map3DPlayer.lastSeq = 0;
-    end
-
-    if map3DPlayer.lastSeq + 1 ~= seq then
-        Log:Error("userId %s map3DPlayer.lastSeq %s + 1 ~= seq %s in mapId %s",
-            tostring(userId),
-            tostring(map3DPlayer.lastSeq),
-            tostring(seq),
-            tostring(self:GetMapId())
-        );
-        return
-    end
-
     -- 计算向量长度
     local len = math.sqrt(
         dirX * dirX +
@@ -204,11 +258,29 @@ function Map3D:MapPlayerInput(userId,
         dirZ = 0
     end
 
-    map3DPlayer.dir.x = dirX;
-    map3DPlayer.dir.y = dirY;
-    map3DPlayer.dir.z = dirZ;
-    map3DPlayer.lastSeq = seq;
-    map3DPlayer.lastClientTime = clientTime;
+    -- 乱序 重复 迟到由抖动缓冲处理 之后的固定步按seq逐条应用
+    if map3DPlayer.voxelHandle ~= nil then
+        avant.InputBufferPush(self.inputBufferId, map3DPlayer.voxelHandle, dirX, dirY, dirZ, seq,
+            tostring(math.modf(clientTime)));
+    end
+end
+
+-- 取出本步到期的输入 每个玩家最多一条
+function Map3D:ApplyBufferedInputs()
+    local result = self.inputStepResult;
+    local count = avant.InputBufferStep(self.inputBufferId, result);
+    for i = 0, count - 1 do
+        local base = i * 6;
+        ---@type Map3DPlayerType
+        local map3DPlayer = self.voxelHandle2Player[result[base + 1]];
+        if map3DPlayer ~= nil then
+            map3DPlayer.dir.x = result[base + 2];
+            map3DPlayer.dir.y = result[base + 3];
+            map3DPlayer.dir.z = result[base + 4];
+            map3DPlayer.lastSeq = result[base + 5];
+            map3DPlayer.lastClientTime = tonumber(result[base + 6]) or 0;
+        end
+    end
 end
 
 ---@param mapPlayer Map3DPlayerType
@@ -295,38 +367,39 @@ function Map3D:PlayerPhysicsMove(mapPlayer)
     if mapPlayer.pos.y > mapSize.y - playerRadius then mapPlayer.pos.y = mapSize.y - playerRadius end -- 下边界
     if mapPlayer.pos.z > mapSize.z - playerRadius then mapPlayer.pos.z = mapSize.z - playerRadius end -- 后边界
 
-    -- 从八叉树中先移除这个玩家 然后再插入 做到Octree更新
-    if mapPlayer.map3DOctree ~= nil then
-        Map3DOctree.RemoveItemFromList(mapPlayer.map3DOctree, mapPlayer.userId);
-
-        mapPlayer.map3DOctree = nil;
+    -- 更新体素索引 仍在原格子内时只改坐标
+    if mapPlayer.voxelHandle ~= nil then
+        avant.VoxelIndexUpdate(self.voxelIndexId, mapPlayer.voxelHandle, mapPlayer.pos.x, mapPlayer.pos.y, mapPlayer.pos.z);
     end
-
-    Map3DOctree.OcInsert(self.map3DOctree, mapPlayer);
 end
 
+-- 一次固定步长的移动 追帧时一个tick内会连续执行多次
 ---@param timeMS integer
 function Map3D:FixedUpdate(timeMS)
-    local MsgHandler = require("MsgHandlerLogic")
-    local PlayerMgr = require("PlayerMgrLogic")
-
     -- Log:Error("Map3D:FixedUpdate mapId %s", tostring(self.MapDbData.id));
+    self:ApplyBufferedInputs();
     for userId, mapPlayer in pairs(self.players) do
         self:PlayerPhysicsMove(mapPlayer);
     end
+end
+
+-- 按本tick推进完后的状态 给每个玩家发送视野内玩家的状态
+---@param timeMS integer
+function Map3D:SyncState(timeMS)
+    local MsgHandler = require("MsgHandlerLogic")
+    local PlayerMgr = require("PlayerMgrLogic")
 
     -- 为地图中每个玩家同步状态 PROTO_CMD_CS_MAP3D_NOTIFY_STATE_DATA
     for userId, mapPlayer in pairs(self.players) do
-        local range = { x = mapPlayer.pos.x - 600, y = mapPlayer.pos.y - 600, z = mapPlayer.pos.z - 600, w = 1200, h = 1200, d = 1200 };
-        local list = {};
-        local seen = {};
-        Map3DOctree.OcQuery(self.map3DOctree, range, list, seen);
+        local list = self.voxelQueryResult;
+        local count = avant.VoxelIndexQueryBox(self.voxelIndexId,
+            mapPlayer.pos.x - 600, mapPlayer.pos.y - 600, mapPlayer.pos.z - 600, 1200, 1200, 1200, list);
 
         ---@type table<integer, ProtoLua_ProtoMap3DPlayerPayload>
         local playersPayload = {}
-        for _, o in ipairs(list) do
+        for i = 1, count do
             ---@type Map3DPlayerType
-            local pl = self.players[o.userId];
+            local pl = self.voxelHandle2Player[list[i]];
 
             playersPayload[#playersPayload + 1] = {
                 userId = pl.userId,
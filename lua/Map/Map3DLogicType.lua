@@ -22,7 +22,7 @@
 ---@field v Vec3f 速度
 ---@field gravity integer 重力
 ---@field weight integer 重量
----@field lastSeq integer 最后收到并应用的客户端输入seq
+---@field lastSeq integer 最后应用的客户端输入seq
 ---@field lastClientTime number 客户端发送该seq时的客户端时间(ms)
 ---@field dir Vec3f 方向
 ---@field speedRatio number 速度放大比例
@@ -30,9 +30,18 @@
 ---@field accel number 加速度 px/ms^2
 ---@field friction number 每帧速度衰减系数
 ---@field bodyRadius number 角色碰撞半径
----@field map3DOctree Map3DOctree|nil 所在地图八叉树节点
+---@field voxelHandle integer|nil 在地图原生体素索引中的实体handle
 
 ---@class Map3DType
 ---@field MapDbData Map3DDbDataType
 ---@field players table<string,Map3DPlayerType>
----@field map3DOctree Map3DOctree 八叉树
+---@field voxelIndexId integer|nil 原生稀疏体素索引id
+---@field voxelHandle2Player table<integer,Map3DPlayerType> 体素索引handle到玩家
+---@field voxelQueryResult table<integer,integer> 复用的体素索引查询结果
+---@field catchUp MapCatchUpConfType
+---@field degradeTicks integer 剩余的降级tick数 0为未降级
+---@field syncSkip integer 降级期间距上次同步已跳过的tick数
+---@field catchUpStat MapCatchUpStatType
+---@field statBeginMS integer 追帧统计周期开始时间 毫秒
+---@field inputBufferId integer|nil 原生输入抖动缓冲id 玩家以voxelHandle引用
+---@field inputStepResult table 复用的每步应用输入结果 每6个一组
@@ -29,6 +29,9 @@ end
 
 ---@param mapId integer
 function Map3DMgr.RemoveMap(mapId)
+    if Map3DMgr.maps[mapId] ~= nil then
+        Map3DMgr.maps[mapId]:Release();
+    end
     Map3DMgr.maps[mapId] = nil;
     Log:Error("RemoveMap from Map3DMgr mapId %d", mapId);
 end
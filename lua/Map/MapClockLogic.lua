@@ -0,0 +1,75 @@
+---@class MapClock
+MapClock = MapClock or {}
+
+local Log = require("Log");
+
+---@class MapClockOwnerType
+---@field MapDbData MapDbDataType|Map3DDbDataType
+---@field catchUp MapCatchUpConfType
+---@field degradeTicks integer
+---@field syncSkip integer
+---@field catchUpStat MapCatchUpStatType
+
+--- 2D与3D地图共用的固定步长时钟
+--- 累计经过的时间 算出本次要推进的固定步数 卡顿后最多追catchUp.maxSteps步
+--- 追不上时进入降级 降级期间每syncInterval个推进了的tick才同步一次
+--- 降级剩余tick数只在确实推进了的tick上减少 tick频率高于固定步长时不会提前恢复
+---@param owner MapClockOwnerType
+---@param timeMS integer
+---@param logName string 日志中的地图名 如"MapId"
+---@return integer steps 本次要推进的固定步数
+---@return boolean sync 推进后是否同步
+function MapClock.Advance(owner, timeMS, logName)
+    local dbData = owner.MapDbData;
+    local frameTime = timeMS - dbData.lastTickTimeMS;
+    if frameTime > 250 then
+        frameTime = 250 -- 防止卡顿时爆炸
+    end
+    dbData.lastTickTimeMS = timeMS;
+    dbData.durationAccumulator = dbData.durationAccumulator + frameTime;
+
+    local steps = 0;
+    while dbData.durationAccumulator >= dbData.DT_MS do
+        steps = steps + 1;
+        dbData.durationAccumulator = dbData.durationAccumulator - dbData.DT_MS;
+    end
+    if steps == 0 then
+        return 0, false;
+    end
+
+    local stat = owner.catchUpStat;
+    if steps > 1 then
+        stat.catchUpTicks = stat.catchUpTicks + 1;
+    end
+    if steps > owner.catchUp.maxSteps then
+        -- 追不上了 多出的时间直接丢弃 继续追只会让下一个tick更晚
+        stat.overrunTicks = stat.overrunTicks + 1;
+        stat.droppedSteps = stat.droppedSteps + steps - owner.catchUp.maxSteps;
+        steps = owner.catchUp.maxSteps;
+        if owner.degradeTicks == 0 then
+            Log:Error("%s %d overrun enter degrade mode", logName, dbData.id);
+        end
+        owner.degradeTicks = owner.catchUp.recoverTicks;
+    elseif owner.degradeTicks > 0 then
+        owner.degradeTicks = owner.degradeTicks - 1;
+        if owner.degradeTicks == 0 then
+            Log:Error("%s %d leave degrade mode", logName, dbData.id);
+        end
+    end
+
+    if owner.degradeTicks == 0 then
+        owner.syncSkip = 0;
+        return steps, true;
+    end
+    stat.degradedTicks = stat.degradedTicks + 1;
+    owner.syncSkip = owner.syncSkip + 1;
+    if owner.syncSkip >= owner.catchUp.syncInterval then
+        owner.syncSkip = 0;
+        return steps, true;
+    end
+    stat.skippedSyncs = stat.skippedSyncs + 1;
+    return steps, false;
+end
+
+-- 返回模块
+return MapClock;
@@ -1,9 +1,68 @@
 ---@class Map:MapType
 local Map         = require("MapData")
 local Log         = require("Log")
+local MapClock    = require("MapClockLogic")
+
+-- AOI半边长 x与y方向距离都小于ENTER进入视野 任一方向超过LEAVE离开视野
+local MAP_AOI_ENTER_RANGE = 600
+local MAP_AOI_LEAVE_RANGE = 700
+-- 状态快照量化精度 坐标1像素 速度10个速度单位(0.01px/ms)
+local MAP_SNAPSHOT_POS_QUANT = 1
+local MAP_SNAPSHOT_VEL_QUANT = 10
+-- 玩家之间是否碰撞
+local MAP_PLAYER_COLLISION = true
+-- 没有预生成瓦片文件时新建网格每格的位数
+local MAP_TILE_BITS = 2
+-- 分层寻路每个簇的边长 瓦片数
+local MAP_HPA_CLUSTER = 32
+-- tick耗时与快照流量统计输出间隔 毫秒
+local MAP_STAT_MS = 10000
+
+--- 返回v的符号(1,-1,0)
+---@param v number
+---@return number
+local function sign(v)
+    if v > 0 then
+        return 1
+    elseif v < 0 then
+        return -1
+    else
+        return 0
+    end
+end
+
+-- 新建地图内玩家 移动参数所有玩家相同
+---@param playerId string
+---@param userId string
+---@param x number
+---@param y number
+---@return MapPlayerType
+local function createMapPlayer(playerId, userId, x, y)
+    ---@type MapPlayerType
+    local mapPlayer = {
+        playerId = playerId,
+        userId = userId,
+        x = x,
+        y = y,
+        vX = 0,
+        vY = 0,
+        dirX = 0,
+        dirY = 0,
+        maxSpeed = 0.1,    -- 最大速度 目标最大速度 px/ms 100px/s
+        accel = 1,         -- 加速度 px/ms^2
+        speedRatio = 1000, -- 放大倍数
+
+        bodyRadius = 12,
+        bodyMass = 1,
+        friction = 1.0, -- 无摩擦
+        bounce = 0.40,
 
-local TimeMgr     = require("TimeMgrLogic")
-local MapQuadTree = require("MapQuadTreeLogic")
+        lastSeq = 0,
+        lastClientTime = "0",
+        aoiHandle = nil
+    };
+    return mapPlayer;
+end
 
 -- 构造新的Map对象
 ---@param mapId integer 地图ID
@@ -28,24 +87,94 @@ function Map.new(mapId)
         tileSize = 50,
         width = 4000,  -- 地图宽瓦片个数
         height = 4000, -- 地图高瓦片个数
-        data = {}      -- 4000*4000=1600 0000
+        gridId = nil
     };
-    -- 初始化tileMap.data
-    -- for i = 0, self.tileMap.width * self.tileMap.height do
-    --     self.tileMap.data[i] = 0 -- 设为默认值
-    -- end
+    -- 瓦片数据放在原生按位压缩的网格里 4000*4000每格2位共4MB
+    -- 配置了预生成文件时mmap只读加载 同一文件的地图共用 否则建一张全空的网格
+    local ConfigTableMgr = require("ConfigTableMgrLogic");
+    local tileFile = ConfigTableMgr.Map2DConfig:GetTileFile(mapId);
+    if tileFile ~= nil then
+        self.tileMap.gridId = avant.TileGridLoad(tileFile);
+    end
+    if self.tileMap.gridId == nil then
+        self.tileMap.gridId = avant.TileGridCreate(self.tileMap.width, self.tileMap.height, MAP_TILE_BITS);
+    end
+    local gridWidth, gridHeight = avant.TileGridInfo(self.tileMap.gridId);
+    self.tileMap.width = gridWidth;
+    self.tileMap.height = gridHeight;
+    -- 整张地图上的远距离寻路走分层寻路 在寻路线程异步执行 见MapMgr.FindPathAsync
+    self.hpaId = avant.HPACreate(self.tileMap.gridId, MAP_HPA_CLUSTER);
 
     -- 地图内的Player
     ---@type table<string,MapPlayerType>
     self.players = {};
 
-    -- 四叉树
-    self.mapQuadTree = MapQuadTree.new(0, 0, self.tileMap.width * self.tileMap.tileSize,
-        self.tileMap.height * self.tileMap.tileSize, 0);
+    -- 原生增量AOI 玩家以aoiHandle引用
+    self.aoiId = avant.AOICreate(0, 0, self.tileMap.width * self.tileMap.tileSize,
+        self.tileMap.height * self.tileMap.tileSize, MAP_AOI_ENTER_RANGE, MAP_AOI_LEAVE_RANGE);
+
+    -- 增量快照编码器 与AOI共用handle 每个客户端只收相对其最近确认快照的变化
+    self.snapshotEncoderId = avant.SnapshotCreate(self.aoiId, MAP_SNAPSHOT_POS_QUANT, MAP_SNAPSHOT_VEL_QUANT);
+    -- 远处的玩家降频更新
+    local snapshotLOD = ConfigTableMgr.Map2DConfig:GetSnapshotLOD(mapId);
+    avant.SnapshotSetLOD(self.snapshotEncoderId, snapshotLOD.ranges, snapshotLOD.periods);
+
+    -- 原生批量移动积分 状态变化的玩家由C++直接同步到AOI与快照编码器
+    self.physicsId = avant.PhysicsCreate(self.tileMap.width * self.tileMap.tileSize,
+        self.tileMap.height * self.tileMap.tileSize, self.aoiId, self.snapshotEncoderId);
+    -- 积分后玩家之间互相推开并按bounce反弹 再与不可行走的瓦片做扫掠碰撞
+    avant.PhysicsSetCollision(self.physicsId, self.tileMap.gridId, self.tileMap.tileSize, MAP_PLAYER_COLLISION);
+    -- 客户端输入先进抖动缓冲 每步积分前按seq最多应用一条
+    local inputBuffer = ConfigTableMgr.Map2DConfig:GetInputBuffer();
+    avant.PhysicsSetInputDelay(self.physicsId, inputBuffer.delaySteps, inputBuffer.reorderSteps);
+
+    -- 以上三者组成的原生模拟上下文 与其他地图在线程池中并行推进
+    self.simId = avant.MapSimCreate(self.physicsId, self.aoiId, self.snapshotEncoderId, self.MapDbData.DT_MS);
+    self.pendingSteps = 0;
+    self.pendingSync = false;
+    self.statBeginMS = 0;
+
+    -- 卡顿后最多追maxSteps步 追不上时降级为隔几个tick同步一次
+    self.catchUp = ConfigTableMgr.Map2DConfig:GetCatchUp();
+    self.degradeTicks = 0;
+    self.syncSkip = 0;
+    self.catchUpStat = { catchUpTicks = 0, overrunTicks = 0, droppedSteps = 0, degradedTicks = 0, skippedSyncs = 0 };
+
+    -- 跨进程迁移 见MapMgr.HandoffMap
+    self.handoff = nil;
+    self.reservedCount = 0;
 
     return self
 end
 
+-- 释放地图持有的原生资源
+function Map:Release()
+    if self.simId ~= nil then
+        avant.MapSimDestroy(self.simId);
+        self.simId = nil;
+    end
+    if self.physicsId ~= nil then
+        avant.PhysicsDestroy(self.physicsId);
+        self.physicsId = nil;
+    end
+    if self.snapshotEncoderId ~= nil then
+        avant.SnapshotDestroy(self.snapshotEncoderId);
+        self.snapshotEncoderId = nil;
+    end
+    if self.aoiId ~= nil then
+        avant.AOIDestroy(self.aoiId);
+        self.aoiId = nil;
+    end
+    if self.hpaId ~= nil then
+        avant.HPADestroy(self.hpaId);
+        self.hpaId = nil;
+    end
+    if self.tileMap.gridId ~= nil then
+        avant.TileGridDestroy(self.tileMap.gridId);
+        self.tileMap.gridId = nil;
+    end
+end
+
 ---@return MapDbDataType
 function Map:GetMapDbData()
     return self.MapDbData;
@@ -76,27 +205,51 @@ function Map:GetTileMapHeight()
     return self.tileMap.height;
 end
 
+-- 修改瓦片 网格坐标从0开始 只读加载的网格返回false
+-- 分层寻路在寻路线程按变化的格子增量更新
+---@param x integer
+---@param y integer
+---@param tile integer
+---@return boolean
+function Map:SetTile(x, y, tile)
+    if not avant.TileGridSetTile(self.tileMap.gridId, x, y, tile) then
+        return false
+    end
+    if self.hpaId ~= nil then
+        avant.HPAUpdate(self.hpaId, self.tileMap.gridId, x, y, 1, 1);
+    end
+    return true
+end
+
+-- 设置某种瓦片是否可行走 影响整张网格 分层寻路整张重建
+---@param tile integer
+---@param walkable boolean
+---@return boolean
+function Map:SetTileWalkable(tile, walkable)
+    if not avant.TileGridSetWalkable(self.tileMap.gridId, tile, walkable) then
+        return false
+    end
+    if self.hpaId ~= nil then
+        avant.HPAUpdate(self.hpaId, self.tileMap.gridId, 0, 0, self.tileMap.width, self.tileMap.height);
+    end
+    return true
+end
+
 ---@param userId string
 ---@return MapPlayerType
 function Map:GetMapPlayerByUserId(userId)
     return self.players[userId]
 end
 
-function Map:OnTick()
-    local timeMS = TimeMgr.GetMS()
-
-    local frameTime = timeMS - self.MapDbData.lastTickTimeMS
-    if frameTime > 250 then
-        frameTime = 250 -- 防止卡顿时爆炸
-    end
-    self.MapDbData.lastTickTimeMS = timeMS
-    self.MapDbData.durationAccumulator = self.MapDbData.durationAccumulator + frameTime
-
-    while self.MapDbData.durationAccumulator >= self.MapDbData.DT_MS do
-        -- 一次固定步长的逻辑更新
-        self:FixedUpdate(timeMS)
-        self.MapDbData.durationAccumulator = self.MapDbData.durationAccumulator - self.MapDbData.DT_MS
-    end
+-- 累计经过的时间 算出本次要推进的固定步数与是否同步
+-- 步骤本身由MapMgr.OnTick与其他地图一起推进 无论追几步都只同步一次
+---@param timeMS integer
+---@return integer
+function Map:AdvanceClock(timeMS)
+    local steps, sync = MapClock.Advance(self, timeMS, "MapId")
+    self.pendingSync = sync
+    self.pendingSteps = steps
+    return steps
 end
 
 -- 所有玩家出生点相同（地图中心）
@@ -111,42 +264,38 @@ end
 ---@param userId string
 ---@return boolean
 function Map:PlayerJoinMap(playerId, userId)
-    if self.players[userId] ~= nil then
-        return false;
+    local reservedPlayer = self.players[userId];
+    if reservedPlayer ~= nil then
+        -- 迁移过来的玩家重连后接管原来的实体 位置与速度不变
+        if reservedPlayer.reserveUntilMS == nil then
+            return false;
+        end
+        Log:Error("HandoffPlayerJoinMap id %d playerId %s userId %s", self.MapDbData.id, playerId, userId)
+        reservedPlayer.playerId = playerId;
+        reservedPlayer.reserveUntilMS = nil;
+        self.reservedCount = self.reservedCount - 1;
+        self:SnapshotSetClient(reservedPlayer);
+        self:SyncPlayerPhysics(reservedPlayer);
+        return true;
     end
 
     Log:Error("NewPlayerJoinMap id %d playerId %s userId %s", self.MapDbData.id, playerId, userId)
 
     local spawnPoint = self:FindSpawnPoint();
-
-    ---@type MapPlayerType
-    local newMapPlayer = {
-        playerId = playerId,
-        userId = userId,
-        x = spawnPoint.x,
-        y = spawnPoint.y,
-        vX = 0,
-        vY = 0,
-        dirX = 0,
-        dirY = 0,
-        maxSpeed = 0.1,    -- 最大速度 目标最大速度 px/ms 100px/s
-        accel = 1,         -- 加速度 px/ms^2
-        speedRatio = 1000, -- 放大倍数
-
-        bodyRadius = 12,
-        bodyMass = 1,
-        friction = 1.0, -- 无摩擦
-        bounce = 0.40,
-
-        lastSeq = 0,
-        lastClientTime = "0",
-        quadTree = nil
-    };
+    local newMapPlayer = createMapPlayer(playerId, userId, spawnPoint.x, spawnPoint.y);
 
     self.players[userId] = newMapPlayer;
 
-    -- 加入地图四叉树
-    MapQuadTree.QtInert(self.mapQuadTree, newMapPlayer);
+    -- 加入地图AOI 下一步同步时自己和周围玩家互相收到进入
+    newMapPlayer.aoiHandle = avant.AOIInsert(self.aoiId, newMapPlayer.x, newMapPlayer.y);
+    if newMapPlayer.aoiHandle ~= nil then
+        avant.SnapshotSetEntity(self.snapshotEncoderId, newMapPlayer.aoiHandle, userId);
+        self:SnapshotSetClient(newMapPlayer);
+        self:SnapshotSetState(newMapPlayer);
+        avant.PhysicsAdd(self.physicsId, newMapPlayer.aoiHandle, newMapPlayer.x, newMapPlayer.y, newMapPlayer.maxSpeed,
+            newMapPlayer.accel, newMapPlayer.speedRatio, newMapPlayer.friction, newMapPlayer.bodyRadius,
+            newMapPlayer.bodyMass, newMapPlayer.bounce);
+    end
 
     return true
 end
@@ -161,11 +310,20 @@ function Map:PlayerExitMap(userId)
     local targetPlayer = self.players[userId]
 
     if targetPlayer ~= nil then
-        -- 将玩家从地图四叉树中移除
-        if targetPlayer.mapQuadTree ~= nil then
-            MapQuadTree.RemoveItemFromList(targetPlayer.mapQuadTree, targetPlayer.userId);
+        if targetPlayer.reserveUntilMS ~= nil then
+            self.reservedCount = self.reservedCount - 1;
+        end
+        -- 迁移冻结期间离开的玩家 目标进程回放时一并移除
+        if self.handoff ~= nil and self.handoff.source then
+            table.insert(self.handoff.leftUserIds, userId);
+        end
 
-            targetPlayer.mapQuadTree = nil;
+        -- 将玩家从地图AOI与快照编码器中移除 周围玩家的下一个快照里带上移除
+        if targetPlayer.aoiHandle ~= nil then
+            avant.PhysicsRemove(self.physicsId, targetPlayer.aoiHandle);
+            avant.SnapshotRemove(self.snapshotEncoderId, targetPlayer.aoiHandle);
+            avant.AOIRemove(self.aoiId, targetPlayer.aoiHandle);
+            targetPlayer.aoiHandle = nil;
         end
 
         self.players[userId] = nil
@@ -175,20 +333,22 @@ function Map:PlayerExitMap(userId)
     return false
 end
 
+-- 从原生物理取回玩家当前的坐标与速度 玩法逻辑需要读位置时先调用
 ---@param mapPlayer MapPlayerType
-function Map:PlayerPhysicsMove(mapPlayer)
-    --- 内联 math.sign：返回v的符号(1,-1,0)
-    ---@return number
-    local function sign(v)
-        if v > 0 then
-            return 1
-        elseif v < 0 then
-            return -1
-        else
-            return 0
-        end
+function Map:SyncPlayerPhysics(mapPlayer)
+    if mapPlayer.aoiHandle == nil then
+        return
     end
+    local x, y, vX, vY = avant.PhysicsGet(self.physicsId, mapPlayer.aoiHandle);
+    if x ~= nil then
+        mapPlayer.x, mapPlayer.y, mapPlayer.vX, mapPlayer.vY = x, y, vX, vY;
+    end
+end
 
+-- 单个玩家移动积分的Lua参考实现 只修改mapPlayer自身 不含碰撞
+-- 运行时由avant.PhysicsStep批量计算 两者结果逐位相同 见Debug:BenchMapPhysics
+---@param mapPlayer MapPlayerType
+function Map:PlayerPhysicsMove(mapPlayer)
     -- 计算目标速度（由方向输入 dirX、dirY 和 最大速度maxSpeed决定）
     -- 目标的X速度
     local targetVx = (mapPlayer.dirX * mapPlayer.speedRatio) * mapPlayer.maxSpeed
@@ -244,68 +404,176 @@ function Map:PlayerPhysicsMove(mapPlayer)
     if mapPlayer.y < playerRadius then mapPlayer.y = playerRadius end                             -- 上边界
     if mapPlayer.x > mapPxWidth - playerRadius then mapPlayer.x = mapPxWidth - playerRadius end   -- 右边界
     if mapPlayer.y > mapPxHeight - playerRadius then mapPlayer.y = mapPxHeight - playerRadius end -- 下边界
+end
 
-    -- 从四叉树中先移除这个玩家 然后再插入 做到QuadTree更新
-    if mapPlayer.mapQuadTree ~= nil then
-        MapQuadTree.RemoveItemFromList(mapPlayer.mapQuadTree, mapPlayer.userId);
-
-        mapPlayer.mapQuadTree = nil;
+-- 登记玩家连接 之后由MapSimTick直接给该客户端发快照 重新登录会先离开地图 加入时登记一次即可
+---@param mapPlayer MapPlayerType
+function Map:SnapshotSetClient(mapPlayer)
+    local PlayerMgr = require("PlayerMgrLogic")
+    local player = PlayerMgr.GetPlayerByUserId(mapPlayer.userId)
+    if player ~= nil then
+        avant.SnapshotSetClient(self.snapshotEncoderId, mapPlayer.aoiHandle, player:GetClientGID(),
+            player:GetWorkerIdx());
     end
+end
 
-    MapQuadTree.QtInert(self.mapQuadTree, mapPlayer);
+-- 玩家最新状态写入快照编码器
+---@param mapPlayer MapPlayerType
+function Map:SnapshotSetState(mapPlayer)
+    avant.SnapshotSetState(self.snapshotEncoderId, mapPlayer.aoiHandle, mapPlayer.x, mapPlayer.y,
+        mapPlayer.vX, mapPlayer.vY, mapPlayer.lastSeq, mapPlayer.lastClientTime);
 end
 
+-- 客户端确认收到的快照 之后的快照以它为基线做增量
+---@param userId string
+---@param snapshotId integer
+function Map:SnapshotAck(userId, snapshotId)
+    local mapPlayer = self:GetMapPlayerByUserId(userId);
+    if mapPlayer == nil or mapPlayer.aoiHandle == nil or snapshotId == nil or snapshotId <= 0 then
+        return
+    end
+    avant.SnapshotAck(self.snapshotEncoderId, mapPlayer.aoiHandle, snapshotId);
+end
+
+-- 周期输出本地图的tick耗时与快照流量
 ---@param timeMS integer
-function Map:FixedUpdate(timeMS)
-    local MsgHandler = require("MsgHandlerLogic")
-    local PlayerMgr = require("PlayerMgrLogic")
+function Map:TickStat(timeMS)
+    if self.statBeginMS == 0 then
+        self.statBeginMS = timeMS;
+        return
+    end
+    local elapsedMS = timeMS - self.statBeginMS;
+    if elapsedMS < MAP_STAT_MS then
+        return
+    end
+    self.statBeginMS = timeMS;
 
-    -- Log:Error("MapId %d FixedUpdate FinSpawnPoint x %d y %d", self.MapDbData.id, self:FindSpawnPoint().x,
-    --     self:FindSpawnPoint().y)
+    local stat = self.catchUpStat;
+    if stat.catchUpTicks > 0 or self.degradeTicks > 0 then
+        Log:Error("MapId %d catch-up ticks %d overrun %d dropped steps %d degraded %d skipped syncs %d",
+            self.MapDbData.id, stat.catchUpTicks, stat.overrunTicks, stat.droppedSteps, stat.degradedTicks,
+            stat.skippedSyncs);
+    end
+    stat.catchUpTicks = 0;
+    stat.overrunTicks = 0;
+    stat.droppedSteps = 0;
+    stat.degradedTicks = 0;
+    stat.skippedSyncs = 0;
+
+    local applied, late, dropped, duplicate, skipped = avant.PhysicsInputStat(self.physicsId);
+    if applied ~= nil and late + dropped + duplicate + skipped > 0 then
+        Log:Error("MapId %d inputs applied %d late %d dropped %d duplicate %d skipped %d", self.MapDbData.id, applied,
+            late, dropped, duplicate, skipped);
+    end
 
-    for userId, mapPlayer in pairs(self.players) do
-        self:PlayerPhysicsMove(mapPlayer);
+    local ticks, costUsSum, costUsMax, bytes, sends, steps, syncs = avant.MapSimStat(self.simId);
+    if ticks == nil or ticks == 0 then
+        return
+    end
+    local playerCount = 0;
+    for _ in pairs(self.players) do
+        playerCount = playerCount + 1;
+    end
+    if playerCount > 0 then
+        Log:Error("MapId %d players %d ticks %d steps %d syncs %d cost avg %.1fus max %dus sends %d bytes/client/s %.1f",
+            self.MapDbData.id, playerCount, ticks, steps, syncs, costUsSum / ticks, costUsMax, sends,
+            bytes * 1000 / elapsedMS / playerCount);
     end
 
-    -- 为地图中每个玩家同步状态
+    -- 各距离层带上的更新条目与降频省掉的条目
+    local lodUpdates, lodSaved = {}, {};
+    local tierCount = avant.SnapshotLODStat(self.snapshotEncoderId, lodUpdates, lodSaved);
+    for tier = 1, tierCount do
+        if lodUpdates[tier] + lodSaved[tier] > 0 then
+            Log:Error("MapId %d snapshot LOD tier %d updates %d saved %d", self.MapDbData.id, tier, lodUpdates[tier],
+                lodSaved[tier]);
+        end
+    end
+end
+
+-- 导出迁移状态 调用方随后冻结地图 直到对端确认或超时
+---@param handoffId integer
+---@return ProtoLua_ProtoIPCMapHandoffState|nil
+function Map:ExportHandoff(handoffId)
+    local players, handles = {}, {};
     for userId, mapPlayer in pairs(self.players) do
-        local range = { x = mapPlayer.x - 600, y = mapPlayer.y - 600, w = 1200, h = 1200 };
-        local list = {}
-        local seen = {}
-
-        MapQuadTree.QtQuery(self.mapQuadTree, range, list, seen)
-
-        ---@type table<integer,ProtoLua_ProtoMapPlayerPayload>
-        local playersPayload = {}
-        for _, o in ipairs(list) do
-            ---@type MapPlayerType
-            local pl = self.players[o.userId];
-
-            playersPayload[#playersPayload + 1] = {
-                userId = o.userId,
-                x = math.modf(pl.x) or 0,
-                y = math.modf(pl.y) or 0,
-                vX = math.modf(pl.vX) or 0,
-                vY = math.modf(pl.vY) or 0,
-                lastSeq = math.modf(pl.lastSeq) or 0,
-                lastClientTime = pl.lastClientTime
-            };
+        if mapPlayer.aoiHandle ~= nil then
+            table.insert(players, { userId = userId, playerId = mapPlayer.playerId });
+            table.insert(handles, mapPlayer.aoiHandle);
         end
+    end
+    local blob = avant.PhysicsExport(self.physicsId, handles);
+    if blob == nil then
+        return nil
+    end
+
+    ---@type ProtoLua_ProtoIPCMapHandoffState
+    local state = {
+        mapId = self.MapDbData.id,
+        handoffId = handoffId,
+        accumulatorMS = math.floor(self.MapDbData.durationAccumulator),
+        players = players,
+        physics = blob
+    };
+    return state;
+end
 
-        if #playersPayload == 0 then
-            Log:Error('players playersPayload len %d', #playersPayload)
+-- 导入其他进程发来的迁移状态 玩家先保留到reserveUntilMS 等客户端重连后接管
+-- AOI按导入的位置重建 客户端重连后收到全量快照
+---@param state ProtoLua_ProtoIPCMapHandoffState
+---@param reserveUntilMS integer
+---@return boolean
+function Map:ImportHandoff(state, reserveUntilMS)
+    local spawnPoint = self:FindSpawnPoint();
+    local handles = {};
+    for i, item in ipairs(state.players or {}) do
+        local mapPlayer = createMapPlayer(item.playerId, item.userId, spawnPoint.x, spawnPoint.y);
+        mapPlayer.reserveUntilMS = reserveUntilMS;
+        -- 先占一个AOI handle 导入时移到迁移时的位置
+        mapPlayer.aoiHandle = avant.AOIInsert(self.aoiId, mapPlayer.x, mapPlayer.y);
+        if mapPlayer.aoiHandle == nil then
+            return false
         end
+        avant.SnapshotSetEntity(self.snapshotEncoderId, mapPlayer.aoiHandle, item.userId);
+        self.players[item.userId] = mapPlayer;
+        handles[i] = mapPlayer.aoiHandle;
+    end
+    if avant.PhysicsImport(self.physicsId, state.physics or "", handles) == nil then
+        return false
+    end
 
-        ---@type ProtoLua_ProtoCSMapNotifyStateData
-        local protoCSMapNotifyStateData = {
-            serverTime = tostring(timeMS),
-            players = playersPayload
-        };
+    for _, mapPlayer in pairs(self.players) do
+        self:SyncPlayerPhysics(mapPlayer);
+    end
+    self.reservedCount = #handles;
+    self.MapDbData.durationAccumulator = state.accumulatorMS or 0;
+    return true
+end
 
-        local loopPlayer = PlayerMgr.GetPlayerByUserId(userId)
-        if loopPlayer ~= nil then
-            MsgHandler:Send2Client(loopPlayer:GetClientGID(), loopPlayer:GetWorkerIdx(),
-                ProtoLua_ProtoCmd.PROTO_CMD_CS_MAP_NOTIFY_STATE_DATA, protoCSMapNotifyStateData);
+-- 回放源进程冻结期间收到的输入与离开 按原seq进抖动缓冲
+---@param delta ProtoLua_ProtoIPCMapHandoffDelta
+function Map:ReplayHandoffDelta(delta)
+    for _, userId in ipairs(delta.leftUserIds or {}) do
+        self:PlayerExitMap(userId);
+    end
+    for _, input in ipairs(delta.inputs or {}) do
+        local mapPlayer = self.players[input.userId];
+        if mapPlayer ~= nil and mapPlayer.aoiHandle ~= nil then
+            avant.PhysicsPushInput(self.physicsId, mapPlayer.aoiHandle, input.dirX, input.dirY, input.seq,
+                input.clientTime);
+        end
+    end
+end
+
+-- 迁移过来的玩家超时未重连 移出地图
+---@param timeMS integer
+function Map:ExpireHandoffPlayers(timeMS)
+    if self.reservedCount <= 0 then
+        return
+    end
+    for userId, mapPlayer in pairs(self.players) do
+        if mapPlayer.reserveUntilMS ~= nil and timeMS >= mapPlayer.reserveUntilMS then
+            self:PlayerExitMap(userId);
         end
     end
 end
@@ -321,14 +589,6 @@ function Map:MapPlayerInput(userId, dirX, dirY, seq, clientTime)
         return
     end
 
-    if mapPlayer.lastSeq >= avant.UINT32_MAX then
-        mapPlayer.lastSeq = 0;
-    end
-
-    if mapPlayer.lastSeq + 1 ~= seq then
-        return
-    end
-
     -- 计算向量长度
     local len = math.sqrt(dirX * dirX + dirY * dirY);
 
@@ -341,10 +601,20 @@ function Map:MapPlayerInput(userId, dirX, dirY, seq, clientTime)
         dirY = 0;
     end
 
-    mapPlayer.dirX = dirX;
-    mapPlayer.dirY = dirY;
-    mapPlayer.lastSeq = seq;
-    mapPlayer.lastClientTime = clientTime;
+    -- 迁移冻结期间的输入转给目标进程回放
+    if self.handoff ~= nil then
+        if self.handoff.source then
+            ---@type ProtoLua_ProtoIPCMapHandoffInput
+            local input = { userId = userId, dirX = dirX, dirY = dirY, seq = seq, clientTime = clientTime };
+            table.insert(self.handoff.inputs, input);
+        end
+        return
+    end
+
+    -- 乱序 重复 迟到由抖动缓冲处理 之后的固定步按seq逐条应用
+    if mapPlayer.aoiHandle ~= nil then
+        avant.PhysicsPushInput(self.physicsId, mapPlayer.aoiHandle, dirX, dirY, seq, clientTime);
+    end
 end
 
 return Map;
@@ -1,28 +1,29 @@
 ---@class MapPlayerType 地图内的玩家
 ---@field playerId string 连接sessionID
 ---@field userId string 用户ID
----@field x number 当前所在像素坐标x 左上角为原点 向右为x正轴向下为y正轴
----@field y number 当前所在像素坐标y 左上角为原点 向右为x正轴向下为y正轴
+---@field x number 所在像素坐标x 左上角为原点 向右为x正轴向下为y正轴 移动由原生物理计算 读取前调用Map:SyncPlayerPhysics
+---@field y number 所在像素坐标y 左上角为原点 向右为x正轴向下为y正轴
 ---@field vX number x轴速度
 ---@field vY number y轴速度
----@field dirX number 客户端输入方向x 归一化后的
+---@field dirX number 客户端输入方向x 归一化后的 运行时由原生物理从输入抖动缓冲逐步应用 这里只是加入时的初值
 ---@field dirY number 客户端输入方向y 归一化后的
 ---@field maxSpeed number 目标最大速度 px/ms
 ---@field speedRatio number 速度放大比例
 ---@field accel number 加速度 px/ms^2
 ---@field bodyRadius number 角色碰撞半径
----@field bodyMass number 角色的碰撞半径
+---@field bodyMass number 角色质量 碰撞时穿透与冲量按质量反比分摊
 ---@field friction number 每帧速度衰减系数
 ---@field bounce number 角色撞到障碍物时的反弹系数
----@field lastSeq number 最后收到并应用的客户端输入seq
+---@field lastSeq number 最后应用的客户端输入seq 运行时以原生物理为准
 ---@field lastClientTime string 客户端发送该seq时的客户端时间(ms)
----@field mapQuadTree MapQuadTreeType|nil 所在地图四叉树节点
+---@field aoiHandle integer|nil 在地图AOI中的实体handle
+---@field reserveUntilMS integer|nil 从其他进程迁移过来还没重连的玩家 到该时间仍未进入则移出地图
 
 ---@class TileMapType
 ---@field tileSize integer 瓦片像素大小
 ---@field width integer 地图内宽有多少个瓦片
 ---@field height integer 地图内高有多少个瓦片
----@field data table<integer,integer> 瓦片像素数据
+---@field gridId integer|nil 原生瓦片网格id 网格坐标从0开始 以avant.TileGrid*访问
 
 ---@class MapDbDataType
 ---@field id integer 地图ID
@@ -31,8 +32,46 @@
 ---@field lastTickTimeMS integer 执行上一次tick的毫秒时间戳
 ---@field durationAccumulator number 帧时常累计时间毫秒
 
+---@class MapCatchUpConfType 追帧上限与降级配置
+---@field maxSteps integer 一次tick最多推进的固定步数 超出的时间丢弃
+---@field syncInterval integer 降级期间每几个tick同步一次
+---@field recoverTicks integer 连续多少个tick没有超限后退出降级
+
+---@class MapInputBufferConfType 输入抖动缓冲配置
+---@field delaySteps integer 输入到达后等几步再应用
+---@field reorderSteps integer 缺seq时后面的输入再多等几步后跳过缺口
+
+---@class MapCatchUpStatType 统计周期内的追帧情况
+---@field catchUpTicks integer 一次推进多于一步的tick数
+---@field overrunTicks integer 超过maxSteps的tick数
+---@field droppedSteps integer 超限丢弃的步数
+---@field degradedTicks integer 处于降级的tick数
+---@field skippedSyncs integer 降级跳过的同步次数
+
+---@class MapHandoffType 迁移中的地图 期间不推进
+---@field id integer 迁移序号 由源进程分配
+---@field source boolean true为源进程 false为目标进程
+---@field peerHandle integer 对端IPC handle
+---@field appId string|nil 目标进程app_id 仅源进程
+---@field deadlineMS integer 等待对端的截止时间
+---@field inputs table[] 源进程冻结期间收到的输入 ProtoLua_ProtoIPCMapHandoffInput
+---@field leftUserIds string[] 源进程冻结期间离开的玩家
+
 ---@class MapType
 ---@field players table<string, MapPlayerType> 地图内的所有玩家
 ---@field tileMap TileMapType
 ---@field MapDbData MapDbDataType
----@field mapQuadTree MapQuadTreeType 四叉树
+---@field aoiId integer|nil 原生增量AOI id
+---@field snapshotEncoderId integer|nil 原生增量快照编码器id
+---@field physicsId integer|nil 原生移动积分id 玩家以aoiHandle引用
+---@field hpaId integer|nil 原生分层寻路id 查询在寻路线程执行
+---@field simId integer|nil 原生模拟上下文id 由MapMgr.OnTick与其他地图并行推进
+---@field pendingSteps integer 本次MapMgr.OnTick要推进的固定步数
+---@field pendingSync boolean 本次MapMgr.OnTick推进后是否做AOI判定与快照同步
+---@field catchUp MapCatchUpConfType
+---@field degradeTicks integer 剩余的降级tick数 0为未降级
+---@field syncSkip integer 降级期间距上次同步已跳过的tick数
+---@field catchUpStat MapCatchUpStatType
+---@field statBeginMS integer tick耗时与快照流量统计周期开始时间 毫秒
+---@field handoff MapHandoffType|nil 正在跨进程迁移
+---@field reservedCount integer 等待重连的迁移玩家数
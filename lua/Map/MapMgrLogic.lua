@@ -2,9 +2,20 @@
 local MapMgr = require("MapMgrData");
 local Map = require("MapLogic");
 local Log = require("Log");
+local TimeMgr = require("TimeMgrLogic");
+
+-- 地图tick线程池额外线程数 0为在other线程串行推进
+local MAP_TICK_THREADS = 4
 
 -- 热重载lua会被重新执行
 MapMgr.maps = MapMgr.maps or {}
+MapMgr.simIds = MapMgr.simIds or {}
+MapMgr.stepCounts = MapMgr.stepCounts or {}
+MapMgr.syncFlags = MapMgr.syncFlags or {}
+MapMgr.nextHandoffId = MapMgr.nextHandoffId or 0
+MapMgr.pathCallbacks = MapMgr.pathCallbacks or {}
+MapMgr.pathIds = MapMgr.pathIds or {}
+MapMgr.paths = MapMgr.paths or {}
 
 ---@return Map
 function MapMgr.CreateMap(mapId)
@@ -29,17 +40,298 @@ end
 
 ---@param mapId integer
 function MapMgr.RemoveMap(mapId)
+    if MapMgr.maps[mapId] ~= nil then
+        MapMgr.maps[mapId]:Release()
+    end
     MapMgr.maps[mapId] = nil
     Log:Error("RemoveMap from MapMgr mapId %d", mapId)
 end
 
+-- 各地图的原生模拟互不相关 把到期的地图交给线程池并行推进
+-- 卡顿后一张地图可能要追几步 这几步只做移动积分与碰撞 AOI判定与快照编码只在最后做一次
+-- Lua这里只算出各地图本次要推进的步数与是否同步 线程池跑完后再统一发出快照
 function MapMgr.OnTick()
+    local timeMS = TimeMgr.GetMS()
+
+    local simIds = MapMgr.simIds;
+    local stepCounts = MapMgr.stepCounts;
+    local syncFlags = MapMgr.syncFlags;
+    local count = 0
     for mapId, mapItem in pairs(MapMgr.maps) do
         ---@type Map
         local mapObj = mapItem;
 
-        mapObj:OnTick();
+        if mapObj.handoff ~= nil then
+            MapMgr.CheckHandoffTimeout(mapObj, timeMS);
+        end
+        -- 迁移中的地图冻结 不推进
+        local steps = 0;
+        if mapObj.handoff == nil then
+            steps = mapObj:AdvanceClock(timeMS);
+        end
+        if steps > 0 then
+            count = count + 1
+            simIds[count] = mapObj.simId
+            stepCounts[count] = steps
+            syncFlags[count] = mapObj.pendingSync
+        end
+    end
+    for i = #simIds, count + 1, -1 do
+        simIds[i] = nil
+        stepCounts[i] = nil
+        syncFlags[i] = nil
+    end
+
+    if count > 0 then
+        avant.MapSimTick(simIds, stepCounts, syncFlags, tostring(timeMS));
+    end
+
+    for mapId, mapObj in pairs(MapMgr.maps) do
+        mapObj:ExpireHandoffPlayers(timeMS);
+        mapObj:TickStat(timeMS);
+    end
+
+    MapMgr.PollPaths();
+end
+
+-- 在地图上异步寻路 网格坐标从0开始 4方向
+-- 查询在寻路线程执行不阻塞tick 完成后的某次OnTick回调callback(path)
+-- path为起点到终点每格按x, y排开的数组 不可达为nil 路径接近最短但不保证最短
+---@param mapId integer
+---@param startX integer
+---@param startY integer
+---@param endX integer
+---@param endY integer
+---@param callback fun(path:integer[]|nil)
+---@return boolean 地图不存在或排队的查询过多时返回false
+function MapMgr.FindPathAsync(mapId, startX, startY, endX, endY, callback)
+    local mapObj = MapMgr.maps[mapId];
+    if mapObj == nil or mapObj.hpaId == nil then
+        return false
+    end
+    local requestId = avant.HPAFindPath(mapObj.hpaId, startX, startY, endX, endY);
+    if requestId == 0 then
+        return false
+    end
+    MapMgr.pathCallbacks[requestId] = callback;
+    return true
+end
+
+-- 取回寻路线程完成的查询 依次回调
+function MapMgr.PollPaths()
+    local ids = MapMgr.pathIds;
+    local paths = MapMgr.paths;
+    local count = avant.HPAPoll(ids, paths);
+    for i = 1, count do
+        local callback = MapMgr.pathCallbacks[ids[i]];
+        MapMgr.pathCallbacks[ids[i]] = nil;
+        if callback ~= nil then
+            local path = paths[i];
+            if path == false then
+                path = nil;
+            end
+            local ok, err = pcall(callback, path);
+            if not ok then
+                Log:Error("FindPathAsync callback requestId %d error %s", ids[i], tostring(err));
+            end
+        end
+    end
+end
+
+-- 迁移结束 地图从当前时间恢复推进 冻结的时间不追
+---@param mapObj Map
+---@param timeMS integer
+local function resumeMap(mapObj, timeMS)
+    mapObj.handoff = nil;
+    mapObj.MapDbData.lastTickTimeMS = timeMS;
+end
+
+---@param peerHandle integer
+---@param mapId integer
+---@param handoffId integer
+---@param cmd integer
+---@param ret integer
+local function sendHandoffAck(peerHandle, mapId, handoffId, cmd, ret)
+    local MsgHandler = require("MsgHandlerLogic");
+    ---@type ProtoLua_ProtoIPCMapHandoffAck
+    local ack = { mapId = mapId, handoffId = handoffId, cmd = cmd, ret = ret };
+    MsgHandler:Send2IPC(peerHandle, ProtoLua_ProtoCmd.PROTO_CMD_IPC_MAP_HANDOFF_ACK, ack);
+end
+
+-- 把一张2D地图连同其中的玩家迁移到appId进程
+-- 1.冻结地图 把玩家与原生物理状态(含抖动缓冲里未应用的输入)打成紧凑二进制发给目标进程
+-- 2.目标进程导入后确认 源进程补发冻结期间收到的输入与离开 目标进程回放后开始推进
+-- 3.源进程通知客户端重连到目标进程并移除地图 玩家在目标进程保留reserveMS等待重连
+-- 目标进程没有确认或确认失败时取消迁移 地图在本进程继续运行 冻结期间的输入照常应用
+---@param mapId integer
+---@param appId string
+---@return boolean
+function MapMgr.HandoffMap(mapId, appId)
+    local mapObj = MapMgr.maps[mapId];
+    if mapObj == nil or mapObj.handoff ~= nil then
+        Log:Error("HandoffMap mapId %d not found or in handoff", mapId);
+        return false
+    end
+    local ConfigTableMgr = require("ConfigTableMgrLogic");
+    if ConfigTableMgr.MapHandoffConfig:GetClientAddr(appId) == nil then
+        Log:Error("HandoffMap mapId %d appId %s no client addr", mapId, appId);
+        return false
+    end
+
+    MapMgr.nextHandoffId = MapMgr.nextHandoffId + 1;
+    local state = mapObj:ExportHandoff(MapMgr.nextHandoffId);
+    if state == nil then
+        Log:Error("HandoffMap mapId %d export failed", mapId);
+        return false
     end
+
+    local peerHandle = avant.GetIPCPeerHandle(appId);
+    mapObj.handoff = {
+        id = MapMgr.nextHandoffId,
+        source = true,
+        peerHandle = peerHandle,
+        appId = appId,
+        deadlineMS = TimeMgr.GetMS() + ConfigTableMgr.MapHandoffConfig:GetAckTimeoutMS(),
+        inputs = {},
+        leftUserIds = {}
+    };
+    local MsgHandler = require("MsgHandlerLogic");
+    MsgHandler:Send2IPC(peerHandle, ProtoLua_ProtoCmd.PROTO_CMD_IPC_MAP_HANDOFF_STATE, state);
+    Log:Error("HandoffMap mapId %d handoffId %d to appId %s players %d bytes %d", mapId, mapObj.handoff.id, appId,
+        #state.players, #state.physics);
+    return true
+end
+
+-- 源进程取消迁移 冻结期间的输入在本地补上
+---@param mapObj Map
+---@param timeMS integer
+local function abortHandoff(mapObj, timeMS)
+    local inputs = mapObj.handoff.inputs;
+    resumeMap(mapObj, timeMS);
+    for _, input in ipairs(inputs) do
+        mapObj:MapPlayerInput(input.userId, input.dirX, input.dirY, input.seq, input.clientTime);
+    end
+end
+
+-- 目标进程放弃导入的地图 保留中的玩家一并释放
+-- 冻结期间不接受进入 地图里只有还没重连的保留玩家
+---@param mapObj Map
+local function discardHandoff(mapObj)
+    for userId, _ in pairs(mapObj.players) do
+        mapObj:PlayerExitMap(userId);
+    end
+    MapMgr.RemoveMap(mapObj:GetMapId());
+end
+
+-- 等待对端超时 源进程取消迁移 地图在本进程继续运行
+-- 目标进程没等到补发 源进程可能已取消迁移并继续推进 丢弃导入的副本
+-- 只有收到补发(源进程确认迁移)后目标进程才开始推进 同一张地图不会两边同时运行
+-- 目标进程的超时比源进程多一个ackTimeoutMS 源进程在自己超时前确认的迁移 补发有一整个ackTimeoutMS送达
+---@param mapObj Map
+---@param timeMS integer
+function MapMgr.CheckHandoffTimeout(mapObj, timeMS)
+    if timeMS < mapObj.handoff.deadlineMS then
+        return
+    end
+    Log:Error("Handoff timeout mapId %d handoffId %d source %s", mapObj:GetMapId(), mapObj.handoff.id,
+        tostring(mapObj.handoff.source));
+    if mapObj.handoff.source then
+        abortHandoff(mapObj, timeMS);
+    else
+        discardHandoff(mapObj);
+    end
+end
+
+-- 目标进程 收到迁移状态
+---@param state ProtoLua_ProtoIPCMapHandoffState
+---@param peerHandle integer
+function MapMgr.OnHandoffState(state, peerHandle)
+    local cmd = ProtoLua_ProtoCmd.PROTO_CMD_IPC_MAP_HANDOFF_STATE;
+    if MapMgr.maps[state.mapId] ~= nil then
+        Log:Error("OnHandoffState mapId %d already exists", state.mapId);
+        return sendHandoffAck(peerHandle, state.mapId, state.handoffId, cmd, ProtoLua_ProtoErrCode.ERR_MAP_HANDOFF_FAILED);
+    end
+
+    local ConfigTableMgr = require("ConfigTableMgrLogic");
+    local timeMS = TimeMgr.GetMS();
+    local mapObj = Map.new(state.mapId);
+    if not mapObj:ImportHandoff(state, timeMS + ConfigTableMgr.MapHandoffConfig:GetReserveMS()) then
+        Log:Error("OnHandoffState mapId %d import failed", state.mapId);
+        mapObj:Release();
+        return sendHandoffAck(peerHandle, state.mapId, state.handoffId, cmd, ProtoLua_ProtoErrCode.ERR_MAP_HANDOFF_FAILED);
+    end
+
+    -- 源进程的超时从发出状态算起 早于这里 等到两倍超时才放弃 避免源进程已移除地图后补发才到
+    mapObj.handoff = {
+        id = state.handoffId,
+        source = false,
+        peerHandle = peerHandle,
+        deadlineMS = timeMS + 2 * ConfigTableMgr.MapHandoffConfig:GetAckTimeoutMS(),
+        inputs = {},
+        leftUserIds = {}
+    };
+    MapMgr.maps[state.mapId] = mapObj;
+    Log:Error("OnHandoffState mapId %d handoffId %d players %d", state.mapId, state.handoffId, mapObj.reservedCount);
+    sendHandoffAck(peerHandle, state.mapId, state.handoffId, cmd, ProtoLua_ProtoErrCode.OK);
+end
+
+-- 目标进程 收到冻结期间的补发 回放后开始推进
+---@param delta ProtoLua_ProtoIPCMapHandoffDelta
+---@param peerHandle integer
+function MapMgr.OnHandoffDelta(delta, peerHandle)
+    local mapObj = MapMgr.maps[delta.mapId];
+    if mapObj == nil or mapObj.handoff == nil or mapObj.handoff.source or mapObj.handoff.id ~= delta.handoffId then
+        Log:Error("OnHandoffDelta mapId %d handoffId %d not in handoff", delta.mapId, delta.handoffId);
+        return
+    end
+    resumeMap(mapObj, TimeMgr.GetMS());
+    mapObj:ReplayHandoffDelta(delta);
+    sendHandoffAck(peerHandle, delta.mapId, delta.handoffId, ProtoLua_ProtoCmd.PROTO_CMD_IPC_MAP_HANDOFF_DELTA,
+        ProtoLua_ProtoErrCode.OK);
+end
+
+-- 源进程 收到目标进程确认
+---@param ack ProtoLua_ProtoIPCMapHandoffAck
+function MapMgr.OnHandoffAck(ack)
+    if ack.cmd == ProtoLua_ProtoCmd.PROTO_CMD_IPC_MAP_HANDOFF_DELTA then
+        Log:Error("OnHandoffAck mapId %d handoffId %d done", ack.mapId, ack.handoffId);
+        return
+    end
+
+    local mapObj = MapMgr.maps[ack.mapId];
+    if mapObj == nil or mapObj.handoff == nil or not mapObj.handoff.source or mapObj.handoff.id ~= ack.handoffId then
+        Log:Error("OnHandoffAck mapId %d handoffId %d not in handoff", ack.mapId, ack.handoffId);
+        return
+    end
+    if ack.ret ~= ProtoLua_ProtoErrCode.OK then
+        Log:Error("OnHandoffAck mapId %d handoffId %d ret %d abort", ack.mapId, ack.handoffId, ack.ret);
+        return abortHandoff(mapObj, TimeMgr.GetMS());
+    end
+
+    local handoff = mapObj.handoff;
+    ---@type ProtoLua_ProtoIPCMapHandoffDelta
+    local delta = {
+        mapId = ack.mapId,
+        handoffId = ack.handoffId,
+        inputs = handoff.inputs,
+        leftUserIds = handoff.leftUserIds
+    };
+    local MsgHandler = require("MsgHandlerLogic");
+    MsgHandler:Send2IPC(handoff.peerHandle, ProtoLua_ProtoCmd.PROTO_CMD_IPC_MAP_HANDOFF_DELTA, delta);
+
+    -- 通知客户端重连 之后本进程不再有这张地图
+    local ConfigTableMgr = require("ConfigTableMgrLogic");
+    local addr = ConfigTableMgr.MapHandoffConfig:GetClientAddr(handoff.appId);
+    local PlayerMgr = require("PlayerMgrLogic");
+    for userId, _ in pairs(mapObj.players) do
+        local player = PlayerMgr.GetPlayerByUserId(userId);
+        if player ~= nil and addr ~= nil then
+            player:GetComponents().map:MapRedirect(ack.mapId, addr.ip, addr.port);
+        end
+    end
+    Log:Error("OnHandoffAck mapId %d handoffId %d redirect, inputs %d left %d", ack.mapId, ack.handoffId,
+        #handoff.inputs, #handoff.leftUserIds);
+    MapMgr.RemoveMap(ack.mapId);
 end
 
 function MapMgr.OnStop()
@@ -54,6 +346,9 @@ function MapMgr.OnSafeStop()
 end
 
 function MapMgr.OnReload()
+    local threads = avant.MapSimSetThreads(MAP_TICK_THREADS);
+    Log:Error("MapMgr tick threads %d", threads);
+
     local ConfigTableMgr = require("ConfigTableMgrLogic");
     local mapCount = ConfigTableMgr.Map2DConfig:GetMapIdCount();
 
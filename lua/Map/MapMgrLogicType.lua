@@ -1,2 +1,9 @@
 ---@class MapMgrType
 ---@field maps table<integer,Map>
+---@field simIds integer[] 复用的本次要推进的地图simId列表
+---@field stepCounts integer[] 与simIds对应的推进步数
+---@field syncFlags boolean[] 与simIds对应的是否同步
+---@field nextHandoffId integer 上一次发起迁移的序号
+---@field pathCallbacks table<integer,fun(path:integer[]|nil)> 等待寻路线程返回的查询 以请求id为键
+---@field pathIds integer[] 复用的HPAPoll输出
+---@field paths (integer[]|false)[] 复用的HPAPoll输出
@@ -73,6 +73,7 @@ function MapSvr.OnReload()
     table.insert(reloadList, "PlayerCmptMapLogic")
     table.insert(reloadList, "PlayerCmptMap3DLogic")
     table.insert(reloadList, "PlayerCmptFSRoomLogic")
+    table.insert(reloadList, "MapClockLogic")
     table.insert(reloadList, "MapLogic")
     table.insert(reloadList, "MapMgrLogic")
     table.insert(reloadList, "FSRoomPlayerLogic")
@@ -133,7 +134,19 @@ function MapSvr.OnLuaVMRecvMessage(msg_type,
         end
         MsgHandler:HandlerMsgFromClient(clientGID, workerIdx, cmd, message);
     elseif msg_type == 2 then -- ipc
-        MsgHandler:HandlerMsgFromOther(cmd, message, str_param3);
+        local peerHandle = tonumber(int64_param2_string)
+        if peerHandle == nil then
+            Log:Error("OnLuaVMRecvMessage peerHandle == nil");
+            return;
+        end
+        MsgHandler:HandlerMsgFromOther(cmd, message, peerHandle, uint64_param1_string);
+    elseif msg_type == 4 then -- ipc rpc请求 处理后以MsgHandler:ReplyIPC应答
+        local peerHandle = tonumber(int64_param2_string)
+        if peerHandle == nil then
+            Log:Error("OnLuaVMRecvMessage peerHandle == nil");
+            return;
+        end
+        MsgHandler:HandlerRPCFromOther(cmd, message, peerHandle, uint64_param1_string);
     elseif msg_type == 3 then -- udp
         MsgHandler:HandlerMsgFromUDP(cmd, message, str_param3, int64_param2_string);
     else
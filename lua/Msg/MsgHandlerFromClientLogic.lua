@@ -2,6 +2,10 @@ local Log = require("Log")
 local PlayerMgr = require("PlayerMgrLogic")
 local MsgHandler = require("MsgHandlerLogic")
 local MapSvr = require("MapSvr");
+local Debug = require("DebugLogic");
+
+-- 登录查库RPC超时毫秒
+local LOGIN_RPC_TIMEOUT_MS = 3000;
 
 ---@type table<number,function>
 MsgHandlerFromClient = {};
@@ -102,6 +106,83 @@ MsgHandlerFromClient[ProtoLua_ProtoCmd.PROTO_CMD_CS_REQ_EXAMPLE] = function(play
 end
 
 
+-- 登录查库RPC应答
+---@param playerId string
+---@param clientGID string
+---@param workerIdx integer
+---@param userId string
+---@param password string
+---@param errCode integer RPC错误码 超时为ERR_IPC_RPC_TIMEOUT
+---@param message ProtoLua_SelectDbUserRecordLoginRes|nil
+local function OnLoginSelectDbUserRecordRes(playerId, clientGID, workerIdx, userId, password, errCode, message)
+    if message ~= nil then
+        local debugStr = Debug:DebugTableToString(message);
+        if debugStr ~= nil then
+            Log:Error("login callback %s", debugStr)
+        end
+    end
+
+    if MapSvr.IsSafeStop() == true then
+        ---@type ProtoLua_ProtoCSResLogin
+        local res = {
+            ret = ProtoLua_ProtoErrCode.EERR_SERVICE_SAFESTOPED,
+            sessionId = playerId
+        };
+        MsgHandler:Send2Client(clientGID, workerIdx, ProtoLua_ProtoCmd.PROTO_CMD_CS_RES_LOGIN, res);
+        return;
+    end
+
+    -- 判断密码是否正确
+    ---@type ProtoLua_ProtoCSResLogin
+    local protoCSResLogin = {
+        ret = ProtoLua_ProtoErrCode.OK,
+        sessionId = playerId
+    };
+
+    if errCode ~= ProtoLua_ProtoErrCode.OK or message == nil then
+        Log:Error("Login rpc failed playerId %s errCode %d", playerId, errCode);
+        protoCSResLogin.ret = errCode;
+    elseif message.ret ~= 0 then
+        protoCSResLogin.ret = ProtoLua_ProtoErrCode.ERR_USERID_OR_PASSWORD_NOTMATCH;
+    elseif password ~= message.userRecord.password then
+        protoCSResLogin.ret = ProtoLua_ProtoErrCode.ERR_USERID_OR_PASSWORD_NOTMATCH;
+    elseif not PlayerMgr.IsPlayerIdOnline(playerId) then
+        Log:Error("Login callback playerId %s not online", playerId);
+    elseif nil ~= PlayerMgr.GetPlayerByPlayerId(playerId) then
+        Log:Error("already online playerId %s", playerId);
+    elseif nil ~= PlayerMgr.GetPlayerByUserId(userId) then
+        Log:Error("already online userId %s", userId);
+    else
+        -- 创建玩家对象
+        local createPlayer = PlayerMgr.CreatePlayer(playerId)
+        if createPlayer == nil then
+            Log:Error("Failed to create player for gid[%s] workerIdx[%d]", clientGID, workerIdx)
+            return
+        end
+
+        -- 将 gid_workerIdx 和 userId 关联到 Player 对象上
+        -- PlayerMgr 的 userId 与 playerId的双向映射
+        PlayerMgr.BindUserIdAndPlayerId(userId, playerId);
+        -- 设置 Player 的 userId、clientGID、workerIdx
+        createPlayer:SetUserId(userId)
+        createPlayer:SetClientGID(clientGID)
+        createPlayer:SetWorkerIdx(workerIdx)
+
+        -- 下发UDP会话token 客户端可选择用它绑定UDP通道
+        protoCSResLogin.udpToken = avant.UDPSessionCreate(clientGID, workerIdx);
+
+        MsgHandler:Send2Client(clientGID, workerIdx, ProtoLua_ProtoCmd.PROTO_CMD_CS_RES_LOGIN, protoCSResLogin);
+
+        ---@type ProtoLua_DbUserRecord
+        local dbUserRecord = message.userRecord;
+        -- 将数据库玩家数据赋值到其Player对象上
+        createPlayer:OnLogin(dbUserRecord)
+        return;
+    end
+
+    MsgHandler:Send2Client(clientGID, workerIdx, ProtoLua_ProtoCmd.PROTO_CMD_CS_RES_LOGIN, protoCSResLogin);
+end
+
 -- 登录请求处理
 ---@param message ProtoLua_ProtoCSReqLogin
 MsgHandlerFromClient[ProtoLua_ProtoCmd.PROTO_CMD_CS_REQ_LOGIN] = function(playerId, clientGID, workerIdx, cmd, message)
@@ -141,8 +222,18 @@ MsgHandlerFromClient[ProtoLua_ProtoCmd.PROTO_CMD_CS_REQ_LOGIN] = function(player
         password = message.password
     };
 
-    MsgHandler:Send2IPC(avant:GetDBSvrGoAppID(), ProtoLua_ProtoCmd.PROTO_CMD_DBSVRGO_SELECT_DBUSERRECORD_LOGIN_REQ,
-        selectDbUserRecordLoginReq);
+    -- 应答通过RPC回调找回请求方 超时则直接回复客户端
+    local userId = message.userId;
+    local password = message.password;
+    local ok = MsgHandler:CallIPC(avant:GetDBSvrGoPeerHandle(),
+        ProtoLua_ProtoCmd.PROTO_CMD_DBSVRGO_SELECT_DBUSERRECORD_LOGIN_REQ, selectDbUserRecordLoginReq,
+        LOGIN_RPC_TIMEOUT_MS, function(errCode, resCmd, resMessage)
+            OnLoginSelectDbUserRecordRes(playerId, clientGID, workerIdx, userId, password, errCode, resMessage);
+        end);
+    if not ok then
+        OnLoginSelectDbUserRecordRes(playerId, clientGID, workerIdx, userId, password,
+            ProtoLua_ProtoErrCode.ERR_IPC_RPC_BUSY, nil);
+    end
 end
 
 
@@ -179,6 +270,53 @@ MsgHandlerFromClient[ProtoLua_ProtoCmd.PROTO_CMD_CS_REQ_MAP_INPUT] = function(pl
 end
 
 
+--- PROTO_CMD_CS_REQ_MAP_SNAPSHOT_ACK 客户端确认收到地图快照 没有输入时单独发送
+---@param message ProtoLua_ProtoCSReqMapSnapshotAck
+MsgHandlerFromClient[ProtoLua_ProtoCmd.PROTO_CMD_CS_REQ_MAP_SNAPSHOT_ACK] = function(playerId, clientGID, workerIdx, cmd,
+                                                                                     message)
+    local player = PlayerMgr.GetPlayerByPlayerId(playerId);
+    if player == nil then
+        return
+    end
+
+    player:GetComponents().map:MapSnapshotAckReq(message);
+end
+
+
+--- PROTO_CMD_CS_REQ_FS_ROOM_JOIN 加入帧同步房间请求
+---@param message ProtoLua_ProtoCSReqFSRoomJoin
+MsgHandlerFromClient[ProtoLua_ProtoCmd.PROTO_CMD_CS_REQ_FS_ROOM_JOIN] = function(playerId, clientGID, workerIdx, cmd,
+                                                                                message)
+    local player = PlayerMgr.GetPlayerByPlayerId(playerId);
+    if player == nil then
+        return
+    end
+    local joinRet, currentFrameId = player:GetComponents().FSRoom:RoomJoinReq(message.roomId);
+
+    ---@type ProtoLua_ProtoCSResFSRoomJoin
+    local res = {
+        ret = joinRet,
+        roomId = message.roomId,
+        currentFrameId = currentFrameId
+    };
+
+    MsgHandler:Send2Client(clientGID, workerIdx, ProtoLua_ProtoCmd.PROTO_CMD_CS_RES_FS_ROOM_JOIN, res);
+end
+
+
+--- PROTO_CMD_CS_REQ_FS_FRAME_ACK 客户端确认收到的帧
+---@param message ProtoLua_ProtoCSReqFSFrameAck
+MsgHandlerFromClient[ProtoLua_ProtoCmd.PROTO_CMD_CS_REQ_FS_FRAME_ACK] = function(playerId, clientGID, workerIdx, cmd,
+                                                                                message)
+    local player = PlayerMgr.GetPlayerByPlayerId(playerId);
+    if player == nil then
+        return
+    end
+
+    player:GetComponents().FSRoom:FrameAckReq(message);
+end
+
+
 --- PROTO_CMD_CS_MAP_ENTER_REQ 进入地图请求
 ---@param message ProtoLua_ProtoCSMapEnterReq
 MsgHandlerFromClient[ProtoLua_ProtoCmd.PROTO_CMD_CS_MAP_ENTER_REQ] = function(playerId, clientGID, workerIdx, cmd,
@@ -328,7 +466,7 @@ MsgHandlerFromClient[ProtoLua_ProtoCmd.PROTO_CMD_CS_REQ_CREATE_USER] = function(
     insertDbUserRecordReq.dbUserRecord.user_id = message.userId;
     insertDbUserRecordReq.dbUserRecord.password = message.password;
 
-    MsgHandler:Send2IPC(avant:GetDBSvrGoAppID(),
+    MsgHandler:Send2IPC(avant:GetDBSvrGoPeerHandle(),
         ProtoLua_ProtoCmd.PROTO_CMD_DBSVRGO_INSERT_DBUSERRECORD_REQ, insertDbUserRecordReq);
 end
 
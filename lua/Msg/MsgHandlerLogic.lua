@@ -2,6 +2,10 @@
 
 ---@class MsgHandler:MsgHandlerType
 local MsgHandler = require("MsgHandlerData");
+local Log = require("Log");
+
+-- 等待应答的IPC RPC回调 rpcId -> function(errCode, cmd, message) 热重载保留
+MsgHandler.rpcCallbacks = MsgHandler.rpcCallbacks or {};
 
 --- 发送协议到客户端
 ---@param clientGID string 客户端连接gid
@@ -13,11 +17,63 @@ function MsgHandler:Send2Client(clientGID, workerIdx, cmd, message)
 end
 
 --- 发送协议到其他进程
----@param appId string 远程进程appid
+---@param peerHandle integer 远程进程handle 由avant.GetIPCPeerHandle(appId)获得
+---@param cmd number 协议号
+---@param message table protobufMessage
+function MsgHandler:Send2IPC(peerHandle, cmd, message)
+    avant.Lua2Protobuf(message, 2, cmd, 0, peerHandle, "");
+end
+
+--- 向其他进程发起RPC请求 应答或超时时调用callback
+---@param peerHandle integer 远程进程handle
+---@param cmd number 协议号
+---@param message table protobufMessage
+---@param timeoutMs integer 超时毫秒 必须大于0
+---@param callback function function(errCode, resCmd, resMessage) 超时时resMessage为nil
+---@return boolean 请求是否发出 对端未连接或未返回请求过多时返回false且不会回调
+function MsgHandler:CallIPC(peerHandle, cmd, message, timeoutMs, callback)
+    local rpcId = avant.IPCCall(message, cmd, peerHandle, timeoutMs);
+    if rpcId == nil then
+        return false;
+    end
+    MsgHandler.rpcCallbacks[rpcId] = callback;
+    return true;
+end
+
+--- 在协程内发起RPC请求并挂起 应答或超时后恢复
+---@param peerHandle integer 远程进程handle
 ---@param cmd number 协议号
 ---@param message table protobufMessage
-function MsgHandler:Send2IPC(appId, cmd, message)
-    avant.Lua2Protobuf(message, 2, cmd, 0, -1, appId);
+---@param timeoutMs integer 超时毫秒 必须大于0
+---@return integer errCode, integer|nil resCmd, table|nil resMessage
+function MsgHandler:AwaitIPC(peerHandle, cmd, message, timeoutMs)
+    local co = coroutine.running();
+    if co == nil then
+        Log:Error("AwaitIPC must be called in coroutine cmd %d", cmd);
+        return ProtoLua_ProtoErrCode.ERR_UNKNOW, nil, nil;
+    end
+
+    local ok = MsgHandler:CallIPC(peerHandle, cmd, message, timeoutMs, function(errCode, resCmd, resMessage)
+        local resumeOk, err = coroutine.resume(co, errCode, resCmd, resMessage);
+        if not resumeOk then
+            Log:Error("AwaitIPC resume err %s", tostring(err));
+        end
+    end);
+    if not ok then
+        return ProtoLua_ProtoErrCode.ERR_IPC_RPC_BUSY, nil, nil;
+    end
+
+    return coroutine.yield();
+end
+
+--- 应答其他进程发来的RPC请求
+---@param peerHandle integer 请求来自的进程handle
+---@param rpcId string 请求的rpcId
+---@param cmd number 应答协议号
+---@param message table protobufMessage
+---@return boolean 对端已断开时返回false 请求方会等到超时
+function MsgHandler:ReplyIPC(peerHandle, rpcId, cmd, message)
+    return avant.IPCReply(rpcId, message, cmd, peerHandle);
 end
 
 --- 发送UDP数据
@@ -37,6 +93,15 @@ function MsgHandler:OnReload()
     MsgHandler.MsgFromOtherCmd2Func = require("MsgHandlerFromOtherLogic");
     ---@type table<number,function>
     MsgHandler.MsgFromClientCmd2Func = require("MsgHandlerFromClientLogic");
+
+    -- 状态快照走UDP会话 客户端未绑定UDP时C++自动回落到TCP 登录/背包等其余协议保持TCP
+    avant.UDPSessionSetCmdMode(ProtoLua_ProtoCmd.PROTO_CMD_CS_MAP_NOTIFY_SNAPSHOT,
+        ProtoLua_ProtoUDPCmdMode.UDP_CMD_MODE_UNRELIABLE_LATEST);
+    avant.UDPSessionSetCmdMode(ProtoLua_ProtoCmd.PROTO_CMD_CS_MAP3D_NOTIFY_STATE_DATA,
+        ProtoLua_ProtoUDPCmdMode.UDP_CMD_MODE_UNRELIABLE_LATEST);
+    -- 帧同步广播包冗余携带最近若干帧 同一tick只需发最新的一个
+    avant.UDPSessionSetCmdMode(ProtoLua_ProtoCmd.PROTO_CMD_CS_FS_NOTIFY_FRAME_WINDOW,
+        ProtoLua_ProtoUDPCmdMode.UDP_CMD_MODE_UNRELIABLE_LATEST);
 end
 
 --- 客户端来新消息了
@@ -58,13 +123,45 @@ end
 --- 其他进程来新消息了
 ---@param cmd integer 协议号
 ---@param message_from_other table 协议
----@param app_id string 从哪个进程appid来的消息
-function MsgHandler:HandlerMsgFromOther(cmd, message_from_other, app_id)
+---@param peerHandle integer 从哪个进程来的消息 IPC对端handle
+---@param rpcId string RPC应答对应的请求序号 "0"表示不是RPC应答
+function MsgHandler:HandlerMsgFromOther(cmd, message_from_other, peerHandle, rpcId)
+    if rpcId ~= "0" then
+        local callback = MsgHandler.rpcCallbacks[rpcId];
+        MsgHandler.rpcCallbacks[rpcId] = nil;
+        if callback == nil then
+            Log:Error("HandlerMsgFromOther rpc callback not found rpcId %s cmd %d", rpcId, cmd);
+            return;
+        end
+        if cmd == ProtoLua_ProtoCmd.PROTO_CMD_IPC_RPC_TIMEOUT then
+            ---@type ProtoLua_ProtoIPCRPCTimeout
+            local timeoutMessage = message_from_other;
+            return callback(ProtoLua_ProtoErrCode.ERR_IPC_RPC_TIMEOUT, timeoutMessage.reqCmd, nil);
+        end
+        return callback(ProtoLua_ProtoErrCode.OK, cmd, message_from_other);
+    end
+
     ---@type any
     local fn = MsgHandler.MsgFromOtherCmd2Func[cmd];
     if fn ~= nil then
-        return fn(cmd, message_from_other, app_id);
+        return fn(cmd, message_from_other, peerHandle);
+    end
+end
+
+--- 其他进程发来的RPC请求 与普通消息共用MsgFromOtherCmd2Func 处理函数多收到rpcId
+--- 处理函数以MsgHandler:ReplyIPC应答 没有处理函数时请求方等到超时
+---@param cmd integer 协议号
+---@param message_from_other table 协议
+---@param peerHandle integer 请求来自的进程handle
+---@param rpcId string 请求方分配的序号
+function MsgHandler:HandlerRPCFromOther(cmd, message_from_other, peerHandle, rpcId)
+    ---@type any
+    local fn = MsgHandler.MsgFromOtherCmd2Func[cmd];
+    if fn == nil then
+        Log:Error("HandlerRPCFromOther no handler cmd %d rpcId %s", cmd, rpcId);
+        return;
     end
+    return fn(cmd, message_from_other, peerHandle, rpcId);
 end
 
 --- 接收到了新的UDP消息
@@ -9,6 +9,8 @@ local PlayerCmptFSRoom = require("PlayerCmptFSRoomData")
 local Log = require("Log")
 local TimeMgr = require("TimeMgrLogic")
 
+local FSRoomMgr = require("FSRoomMgrLogic")
+
 ---@param owner Player
 ---@return PlayerCmptFSRoom
 function PlayerCmptFSRoom.new(owner)
@@ -27,7 +29,53 @@ end
 function PlayerCmptFSRoom:OnLogin()
 end
 
+-- 断线后房间保留该玩家 重新登录后再次加入从已确认的帧之后补发
 function PlayerCmptFSRoom:OnLogout()
+    if self.nowRoomId <= 0 then
+        return
+    end
+    local room = FSRoomMgr.GetRoom(self.nowRoomId);
+    if room ~= nil then
+        room:DisconnectPlayer(self:GetPlayer():GetPlayerID(), self:GetPlayer():GetUserId());
+    end
+    self.nowRoomId = -1
+end
+
+---@param roomId integer
+---@return integer
+---@return integer currentFrameId
+function PlayerCmptFSRoom:RoomJoinReq(roomId)
+    local room = FSRoomMgr.GetRoom(roomId);
+    if room == nil then
+        return ProtoLua_ProtoErrCode.ERR_FS_ROOM_NOT_FOUND, 0;
+    end
+    if self.nowRoomId > 0 and self.nowRoomId ~= roomId then
+        local oldRoom = FSRoomMgr.GetRoom(self.nowRoomId);
+        if oldRoom ~= nil then
+            oldRoom:RemovePlayerFromRoom(self:GetPlayer():GetPlayerID(), self:GetPlayer():GetUserId());
+        end
+        self.nowRoomId = -1
+    end
+
+    local ret = room:AddPlayerToRoom(self:GetPlayer():GetPlayerID(), self:GetPlayer():GetUserId(),
+        self:GetPlayer():GetClientGID(), self:GetPlayer():GetWorkerIdx());
+    if ret ~= ProtoLua_ProtoErrCode.OK then
+        return ret, 0;
+    end
+    self.nowRoomId = roomId
+    return ret, room.sync:GetCurrentFrame();
+end
+
+---@param message ProtoLua_ProtoCSReqFSFrameAck
+function PlayerCmptFSRoom:FrameAckReq(message)
+    if self.nowRoomId <= 0 then
+        return
+    end
+    local room = FSRoomMgr.GetRoom(self.nowRoomId);
+    if room == nil then
+        return
+    end
+    room:AckFrame(self:GetPlayer():GetUserId(), message.frameId);
 end
 
 return PlayerCmptFSRoom;
@@ -58,6 +58,9 @@ function PlayerCmptMap:EnterNewMap(mapId)
     if map == nil then
         return ProtoLua_ProtoErrCode.ERR_TARGET_MAP_NOT_FOUND;
     end
+    if map.handoff ~= nil then
+        return ProtoLua_ProtoErrCode.ERR_MAP_HANDOFF_IN_PROGRESS;
+    end
     if map:PlayerJoinMap(self:GetPlayer():GetPlayerID(), self:GetPlayer():GetUserId()) ~= true then
         return ProtoLua_ProtoErrCode.ERR_UNKNOW;
     end
@@ -105,6 +108,27 @@ function PlayerCmptMap:MapLeaveReq()
     return ProtoLua_ProtoErrCode.OK;
 end
 
+-- 所在地图已迁移到其他进程 通知客户端重连 本进程不再处理该玩家的地图消息
+---@param mapId integer
+---@param ip string
+---@param port integer
+function PlayerCmptMap:MapRedirect(mapId, ip, port)
+    if self.nowMapId ~= mapId then
+        return
+    end
+    self.nowMapId = -1
+
+    ---@type ProtoLua_ProtoCSMapNotifyRedirect
+    local protoCSMapNotifyRedirect = {
+        mapId = mapId,
+        ip = ip,
+        port = port
+    };
+    local MsgHandler = require("MsgHandlerLogic");
+    MsgHandler:Send2Client(self:GetPlayer():GetClientGID(), self:GetPlayer():GetWorkerIdx(),
+        ProtoLua_ProtoCmd.PROTO_CMD_CS_MAP_NOTIFY_REDIRECT, protoCSMapNotifyRedirect);
+end
+
 ---@return integer
 function PlayerCmptMap:PingReq()
     if self:HasInMap() then
@@ -134,7 +158,23 @@ function PlayerCmptMap:MapInputReq(message)
     local seq = message.seq;
     local clientTime = message.clientTime;
 
+    -- 输入包顺带确认收到的最新快照
+    currMap:SnapshotAck(self:GetPlayer():GetUserId(), message.ackSnapshotId);
     currMap:MapPlayerInput(self:GetPlayer():GetUserId(), dirX, dirY, seq, clientTime);
 end
 
+---@param message ProtoLua_ProtoCSReqMapSnapshotAck
+function PlayerCmptMap:MapSnapshotAckReq(message)
+    if false == self:HasInMap() then
+        return
+    end
+
+    local currMap = MapMgr.GetMap(self.nowMapId);
+    if currMap == nil then
+        return
+    end
+
+    currMap:SnapshotAck(self:GetPlayer():GetUserId(), message.snapshotId);
+end
+
 return PlayerCmptMap;
@@ -116,7 +116,7 @@ function Player:OnLogout()
         local op = ProtoLua_DbOpType.OP_REPLACE;
 
         DbUserRecord.op = op; -- replace
-        MsgHandler:Send2IPC(avant:GetDBSvrGoAppID(),
+        MsgHandler:Send2IPC(avant:GetDBSvrGoPeerHandle(),
             ProtoLua_ProtoCmd.PROTO_CMD_DBSVRGO_WRITE_DBUSERRECORD_REQ,
             DbUserRecord);
     end
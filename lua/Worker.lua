@@ -1,9 +1,25 @@
 local Worker = {};
 local Log = require("Log");
 
+-- 以该前缀开头的HTTP请求在连接所属worker的LuaVM中处理(仅HTTP_TASK)
+local WORKER_HTTP_API_PREFIX = "/api/"
+
+-- path -> function(method, path, headers, body, connGID, workerIdx)->status, headers, body
+Worker.httpRoutes = Worker.httpRoutes or {}
+
+Worker.httpRoutes["/api/health"] = function(method, path, headers, body, connGID, workerIdx)
+    return 200, { ["Cache-Control"] = "no-store" }, "ok"
+end
+
+Worker.httpRoutes["/api/worker"] = function(method, path, headers, body, connGID, workerIdx)
+    return 200, { ["Content-Type"] = "application/json" },
+        string.format('{"appId":"%s","workerIdx":%d}', avant.AppID, workerIdx)
+end
+
 function Worker:OnInit(workerIdx)
     local log = "OnWorkerInit workerIdx " .. workerIdx;
     Log:Error(log);
+    avant.HttpSetAPIPrefix(WORKER_HTTP_API_PREFIX);
 end
 
 function Worker:OnStop(workerIdx)
@@ -15,6 +31,17 @@ function Worker:OnTick(workerIdx)
 
 end
 
+--- 返回status, headers, body 返回nil为404
+--- body为nil时为流式响应 之后用avant.HttpWrite(connGID, data)与avant.HttpEnd(connGID)写出
+function Worker:OnHttpRequest(method, path, headers, body, connGID, workerIdx)
+    local routePath = string.match(path, "^([^?]*)")
+    local route = self.httpRoutes[routePath]
+    if route == nil then
+        return nil
+    end
+    return route(method, path, headers, body, connGID, workerIdx)
+end
+
 function Worker:OnReload(workerIdx)
     Log:Error("luavm Worker:OnReload workerIdx " .. tostring(workerIdx));
 end
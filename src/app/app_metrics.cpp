@@ -0,0 +1,151 @@
+#include "app/app_metrics.h"
+#include <sstream>
+
+using namespace avant::app;
+
+constexpr uint64_t app_metrics::TICK_BUCKETS_US[];
+
+void app_metrics::init(int worker_cnt)
+{
+    this->worker_cnt = worker_cnt;
+    this->slots.clear();
+    for (int i = 0; i < 2 + worker_cnt; ++i)
+    {
+        this->slots.push_back(std::make_unique<thread_slot>());
+    }
+}
+
+void app_metrics::observe_tick(thread_slot &slot, uint64_t cost_us)
+{
+    int bucket = 0;
+    while (bucket < TICK_BUCKET_CNT && cost_us > TICK_BUCKETS_US[bucket])
+    {
+        ++bucket;
+    }
+    add(slot.tick_bucket[bucket]);
+    add(slot.tick_sum_us, cost_us);
+    add(slot.tick_cnt);
+}
+
+std::string app_metrics::scrape() const
+{
+    std::ostringstream oss;
+
+    struct labeled_slot
+    {
+        std::string label;
+        const thread_slot *slot;
+    };
+    std::vector<labeled_slot> all;
+    for (size_t i = 0; i < this->slots.size(); ++i)
+    {
+        std::string label = i == 0   ? "thread=\"main\""
+                            : i == 1 ? "thread=\"other\""
+                                     : "thread=\"worker\",worker=\"" + std::to_string(i - 2) + "\"";
+        all.push_back({std::move(label), this->slots[i].get()});
+    }
+
+    auto load = [](const counter &c) -> uint64_t
+    {
+        return c.load(std::memory_order_relaxed);
+    };
+
+    auto write_family = [&](const char *name, const char *type, const char *help, auto getter)
+    {
+        oss << "# HELP " << name << " " << help << "\n";
+        oss << "# TYPE " << name << " " << type << "\n";
+        for (const auto &item : all)
+        {
+            oss << name << "{" << item.label << "} " << getter(*item.slot) << "\n";
+        }
+    };
+
+    write_family("avant_connections", "gauge", "Client connections currently open.",
+                 [&](const thread_slot &s) -> int64_t
+                 { return (int64_t)load(s.conn_new_total) - (int64_t)load(s.conn_close_total); });
+    write_family("avant_connections_total", "counter", "Client connections accepted.",
+                 [&](const thread_slot &s)
+                 { return load(s.conn_new_total); });
+    write_family("avant_recv_bytes_total", "counter", "Bytes read from client connections.",
+                 [&](const thread_slot &s)
+                 { return load(s.recv_bytes_total); });
+    write_family("avant_send_bytes_total", "counter", "Bytes queued to client connections.",
+                 [&](const thread_slot &s)
+                 { return load(s.send_bytes_total); });
+    write_family("avant_recv_buffer_max_bytes", "gauge", "Largest per-connection recv buffer observed.",
+                 [&](const thread_slot &s)
+                 { return load(s.recv_buffer_max_bytes); });
+    write_family("avant_send_buffer_max_bytes", "gauge", "Largest per-connection send buffer observed.",
+                 [&](const thread_slot &s)
+                 { return load(s.send_buffer_max_bytes); });
+    write_family("avant_tunnel_send_total", "counter", "Packages forwarded into tunnels.",
+                 [&](const thread_slot &s)
+                 { return load(s.tunnel_send_total); });
+    write_family("avant_tunnel_recv_total", "counter", "Packages taken out of tunnels.",
+                 [&](const thread_slot &s)
+                 { return load(s.tunnel_recv_total); });
+    write_family("avant_lua_memory_bytes", "gauge", "Lua VM heap size at the end of the last tick.",
+                 [&](const thread_slot &s)
+                 { return load(s.lua_memory_bytes); });
+    write_family("avant_lua_memory_max_bytes", "gauge", "Largest Lua VM heap size observed.",
+                 [&](const thread_slot &s)
+                 { return load(s.lua_memory_max_bytes); });
+    write_family("avant_lua_gc_cycles_total", "counter", "Lua VM garbage collection cycles completed.",
+                 [&](const thread_slot &s)
+                 { return load(s.lua_gc_cycles_total); });
+
+    // 只有worker与other之间有tunnel 用两端计数之差估算队列深度
+    {
+        int64_t worker_send = 0;
+        int64_t worker_recv = 0;
+        for (int i = 0; i < this->worker_cnt; ++i)
+        {
+            worker_send += load(this->slots[2 + i]->tunnel_send_total);
+            worker_recv += load(this->slots[2 + i]->tunnel_recv_total);
+        }
+        const thread_slot &other = *this->slots[1];
+        oss << "# HELP avant_tunnel_queue_depth Packages forwarded but not yet handled.\n";
+        oss << "# TYPE avant_tunnel_queue_depth gauge\n";
+        oss << "avant_tunnel_queue_depth{to=\"other\"} " << worker_send - (int64_t)load(other.tunnel_recv_total) << "\n";
+        oss << "avant_tunnel_queue_depth{to=\"worker\"} " << (int64_t)load(other.tunnel_send_total) - worker_recv << "\n";
+    }
+
+    // 只输出出现过的cmd
+    auto write_cmd_family = [&](const char *name, const char *help, counter const(thread_slot::*member)[MAX_CMD])
+    {
+        oss << "# HELP " << name << " " << help << "\n";
+        oss << "# TYPE " << name << " counter\n";
+        for (const auto &item : all)
+        {
+            const counter(&arr)[MAX_CMD] = item.slot->*member;
+            for (int cmd = 0; cmd < MAX_CMD; ++cmd)
+            {
+                uint64_t val = load(arr[cmd]);
+                if (val > 0)
+                {
+                    oss << name << "{" << item.label << ",cmd=\"" << cmd << "\"} " << val << "\n";
+                }
+            }
+        }
+    };
+    write_cmd_family("avant_cmd_recv_total", "Messages received per cmd.", &thread_slot::cmd_recv_total);
+    write_cmd_family("avant_cmd_send_total", "Messages sent per cmd.", &thread_slot::cmd_send_total);
+
+    oss << "# HELP avant_tick_duration_seconds Lua tick duration.\n";
+    oss << "# TYPE avant_tick_duration_seconds histogram\n";
+    for (const auto &item : all)
+    {
+        uint64_t cumulative = 0;
+        for (int bucket = 0; bucket < TICK_BUCKET_CNT; ++bucket)
+        {
+            cumulative += load(item.slot->tick_bucket[bucket]);
+            oss << "avant_tick_duration_seconds_bucket{" << item.label << ",le=\"" << TICK_BUCKETS_US[bucket] / 1e6 << "\"} " << cumulative << "\n";
+        }
+        cumulative += load(item.slot->tick_bucket[TICK_BUCKET_CNT]);
+        oss << "avant_tick_duration_seconds_bucket{" << item.label << ",le=\"+Inf\"} " << cumulative << "\n";
+        oss << "avant_tick_duration_seconds_sum{" << item.label << "} " << load(item.slot->tick_sum_us) / 1e6 << "\n";
+        oss << "avant_tick_duration_seconds_count{" << item.label << "} " << load(item.slot->tick_cnt) << "\n";
+    }
+
+    return oss.str();
+}
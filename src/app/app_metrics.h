@@ -0,0 +1,88 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace avant::app
+{
+    // 运行时指标
+    // 每个线程独占一个槽位 只有所属线程写入(relaxed load+store 不带锁前缀)
+    // http_app收到/__metrics时才遍历所有槽位汇总成Prometheus文本
+    class app_metrics
+    {
+    public:
+        // 超过该值的cmd计入最后一个槽
+        static constexpr int MAX_CMD = 4096;
+        // tick耗时直方图上界 微秒
+        static constexpr int TICK_BUCKET_CNT = 12;
+        static constexpr uint64_t TICK_BUCKETS_US[TICK_BUCKET_CNT] = {100, 250, 500, 1000, 2500, 5000,
+                                                                       10000, 25000, 50000, 100000, 250000, 1000000};
+
+        using counter = std::atomic<uint64_t>;
+
+        struct thread_slot
+        {
+            // 连接
+            counter conn_new_total{0};
+            counter conn_close_total{0};
+            // 收发字节与缓冲区高水位
+            counter recv_bytes_total{0};
+            counter send_bytes_total{0};
+            counter recv_buffer_max_bytes{0};
+            counter send_buffer_max_bytes{0};
+            // tunnel 发出与收到的包数 两端相减即为队列深度
+            counter tunnel_send_total{0};
+            counter tunnel_recv_total{0};
+            // 按cmd统计收发包数
+            counter cmd_recv_total[MAX_CMD]{};
+            counter cmd_send_total[MAX_CMD]{};
+            // lua虚拟机
+            counter lua_memory_bytes{0};
+            counter lua_memory_max_bytes{0};
+            // 完成的GC轮数 由每轮被回收的哨兵userdata的__gc计数
+            counter lua_gc_cycles_total{0};
+            // tick耗时
+            counter tick_bucket[TICK_BUCKET_CNT + 1]{};
+            counter tick_sum_us{0};
+            counter tick_cnt{0};
+        };
+
+        // main线程初始化时调用 workers启动前分配好全部槽位
+        void init(int worker_cnt);
+
+        thread_slot &main_slot() { return *slots[0]; }
+        thread_slot &other_slot() { return *slots[1]; }
+        thread_slot &worker_slot(int worker_idx) { return *slots[2 + worker_idx]; }
+
+        static inline void add(counter &c, uint64_t n = 1)
+        {
+            c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+        static inline void set(counter &c, uint64_t v)
+        {
+            c.store(v, std::memory_order_relaxed);
+        }
+        static inline void set_max(counter &c, uint64_t v)
+        {
+            if (v > c.load(std::memory_order_relaxed))
+            {
+                c.store(v, std::memory_order_relaxed);
+            }
+        }
+        static inline void add_cmd(counter (&arr)[MAX_CMD], int cmd)
+        {
+            add(arr[(cmd >= 0 && cmd < MAX_CMD) ? cmd : MAX_CMD - 1]);
+        }
+        static void observe_tick(thread_slot &slot, uint64_t cost_us);
+
+        // 生成Prometheus text format 0.0.4
+        std::string scrape() const;
+
+    private:
+        int worker_cnt{0};
+        // [0] main [1] other [2...] worker
+        std::vector<std::unique_ptr<thread_slot>> slots;
+    };
+}
@@ -0,0 +1,176 @@
+#include "app/fs_frame_broadcast.h"
+#include <algorithm>
+
+using namespace avant::app;
+
+// frames字段 field 1 wire type 2
+static constexpr uint8_t FS_FRAME_RECORD_TAG = 0x0A;
+
+static void fs_frame_broadcast_record(std::string &out, const std::string &frame)
+{
+    out.clear();
+    out.push_back((char)FS_FRAME_RECORD_TAG);
+    uint64_t len = frame.size();
+    do
+    {
+        uint8_t b = len & 0x7F;
+        len >>= 7;
+        out.push_back((char)(len ? (b | 0x80) : b));
+    } while (len);
+    out.append(frame);
+}
+
+static bool fs_frame_broadcast_same_command(const avant::ProtoFSFrameCommand &a, const avant::ProtoFSFrameCommand &b)
+{
+    return a.data() == b.data() && a.commandtype() == b.commandtype() && a.userid() == b.userid();
+}
+
+fs_frame_broadcast::fs_frame_broadcast(int redundancy)
+    : redundancy(std::max(redundancy, 1))
+{
+}
+
+void fs_frame_broadcast::clear()
+{
+    this->window.clear();
+    this->prev.Clear();
+    this->window_packet.clear();
+}
+
+void fs_frame_broadcast::push(const ProtoFSFrame &frame, const std::string &encoded)
+{
+    if (!this->window.empty() && frame.frameid() != this->window.back().frame_id + 1)
+    {
+        clear();
+    }
+
+    const bool has_prev = !this->window.empty();
+    // 复用出窗口的记录 不重新分配
+    record rec;
+    if ((int)this->window.size() >= this->redundancy)
+    {
+        rec = std::move(this->window.front());
+        this->window.pop_front();
+    }
+    rec.frame_id = frame.frameid();
+    fs_frame_broadcast_record(rec.full, encoded);
+
+    // 相对上一帧 同位置优先 其次整帧查找相同的指令
+    this->delta_frame.Clear();
+    this->delta_frame.set_frameid(frame.frameid());
+    if (!has_prev || frame.timestamp() != this->prev.timestamp())
+    {
+        this->delta_frame.set_timestamp(frame.timestamp());
+    }
+    const int prev_cnt = has_prev ? this->prev.commands_size() : 0;
+    for (int i = 0; i < frame.commands_size(); ++i)
+    {
+        const ProtoFSFrameCommand &command = frame.commands(i);
+        int same = -1;
+        if (i < prev_cnt && fs_frame_broadcast_same_command(command, this->prev.commands(i)))
+        {
+            same = i;
+        }
+        for (int k = 0; same < 0 && k < prev_cnt; ++k)
+        {
+            if (fs_frame_broadcast_same_command(command, this->prev.commands(k)))
+            {
+                same = k;
+            }
+        }
+        if (same >= 0)
+        {
+            this->delta_frame.add_commands()->set_sameasprev(same + 1);
+        }
+        else
+        {
+            *this->delta_frame.add_commands() = command;
+        }
+    }
+    fs_frame_broadcast_record(rec.delta, this->delta_frame.SerializeAsString());
+    if (has_prev && rec.delta.size() < rec.full.size())
+    {
+        this->stats.delta_saved_bytes += rec.full.size() - rec.delta.size();
+    }
+
+    this->prev = frame;
+    this->window.push_back(std::move(rec));
+    rebuild_packet();
+}
+
+void fs_frame_broadcast::rebuild_packet()
+{
+    this->window_packet.clear();
+    for (size_t i = 0; i < this->window.size(); ++i)
+    {
+        this->window_packet.append(i == 0 ? this->window[i].full : this->window[i].delta);
+    }
+}
+
+fs_frame_broadcast::send_result fs_frame_broadcast::on_send(uint32_t acked_frame_id)
+{
+    if (this->window.empty())
+    {
+        return SEND_NONE;
+    }
+    // 按差值比较 帧号回绕后仍然成立
+    const int32_t missing = (int32_t)(this->window.back().frame_id - acked_frame_id);
+    if (missing <= 0)
+    {
+        return SEND_NONE;
+    }
+    if (missing > (int32_t)this->window.size())
+    {
+        ++this->stats.window_misses;
+        return SEND_BEHIND;
+    }
+
+    ++this->stats.packets;
+    this->stats.bytes += this->window_packet.size();
+    this->stats.frames += this->window.size();
+    this->stats.redundant_frames += this->window.size() - 1;
+    this->stats.redundancy_hits += missing - 1;
+    return SEND_PACKET;
+}
+
+fs_frame_broadcast::stat fs_frame_broadcast::take_stat()
+{
+    stat result = this->stats;
+    this->stats = stat{};
+    return result;
+}
+
+int fs_frame_broadcast_mgr::create(int redundancy)
+{
+    int broadcast_id = 0;
+    if (this->free_ids.size() > 0)
+    {
+        broadcast_id = this->free_ids.back();
+        this->free_ids.pop_back();
+    }
+    else
+    {
+        this->broadcasts.emplace_back();
+        broadcast_id = (int)this->broadcasts.size();
+    }
+    this->broadcasts[broadcast_id - 1] = std::make_unique<fs_frame_broadcast>(redundancy);
+    return broadcast_id;
+}
+
+void fs_frame_broadcast_mgr::destroy(int broadcast_id)
+{
+    if (get(broadcast_id))
+    {
+        this->broadcasts[broadcast_id - 1].reset();
+        this->free_ids.push_back(broadcast_id);
+    }
+}
+
+fs_frame_broadcast *fs_frame_broadcast_mgr::get(int broadcast_id)
+{
+    if (broadcast_id <= 0 || broadcast_id > (int)this->broadcasts.size())
+    {
+        return nullptr;
+    }
+    return this->broadcasts[broadcast_id - 1].get();
+}
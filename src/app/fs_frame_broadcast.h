@@ -0,0 +1,85 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include "proto_res/proto_example.pb.h"
+
+namespace avant::app
+{
+    // 帧同步房间的帧广播 每个包携带最近redundancy帧 单个包丢失不会卡住锁步
+    // 每帧进入时只编码一次 保留全量与相对上一帧的增量两份记录
+    // 包为最老一帧的全量记录接上其余帧的增量记录 拼成ProtoCSFSNotifyFrames 所有成员共用同一份字节
+    // 增量编码只省掉与上一帧完全相同的指令(引用其下标)与不变的时间戳 不改变指令顺序
+    class fs_frame_broadcast
+    {
+    public:
+        // 统计 take_stat取出后清零
+        struct stat
+        {
+            uint64_t packets{0};
+            uint64_t bytes{0};
+            uint64_t frames{0};
+            // 包里携带的非最新帧
+            uint64_t redundant_frames{0};
+            // 冗余帧中成员发送时尚未确认的 即可能用来补上丢包的副本
+            uint64_t redundancy_hits{0};
+            // 成员落后超出窗口 本次不发 调用方需要从历史帧补发
+            uint64_t window_misses{0};
+            // 增量编码相对全量编码省下的字节
+            uint64_t delta_saved_bytes{0};
+        };
+
+        enum send_result
+        {
+            // 成员已确认最新帧 无需发送
+            SEND_NONE = 0,
+            SEND_PACKET = 1,
+            // 落后超出窗口
+            SEND_BEHIND = 2,
+        };
+
+        explicit fs_frame_broadcast(int redundancy);
+
+        // 新帧进入窗口 frame_id须连续 encoded为frame的编码 不连续时清空窗口重新开始
+        void push(const ProtoFSFrame &frame, const std::string &encoded);
+        // 成员已确认到acked_frame_id 判断是否需要发当前窗口包并计入统计
+        send_result on_send(uint32_t acked_frame_id);
+        // 当前窗口的包 push之后才变化
+        const std::string &packet() const { return this->window_packet; }
+        void clear();
+        stat take_stat();
+
+    private:
+        struct record
+        {
+            uint32_t frame_id{0};
+            std::string full;
+            std::string delta;
+        };
+
+        void rebuild_packet();
+
+    private:
+        int redundancy;
+        std::deque<record> window;
+        ProtoFSFrame prev;
+        ProtoFSFrame delta_frame;
+        std::string window_packet;
+        stat stats;
+    };
+
+    // Lua侧以整数id持有广播器 只在other线程使用
+    class fs_frame_broadcast_mgr
+    {
+    public:
+        int create(int redundancy);
+        void destroy(int broadcast_id);
+        fs_frame_broadcast *get(int broadcast_id);
+
+    private:
+        std::vector<std::unique_ptr<fs_frame_broadcast>> broadcasts;
+        std::vector<int> free_ids;
+    };
+}
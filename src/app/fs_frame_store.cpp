@@ -0,0 +1,158 @@
+#include "app/fs_frame_store.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace avant::app;
+
+// frames字段 field 1 wire type 2
+static constexpr uint8_t FS_FRAME_RECORD_TAG = 0x0A;
+
+fs_frame_store::fs_frame_store(int capacity_frames, size_t capacity_bytes)
+    : slots(std::max(capacity_frames, 1)),
+      bytes(std::max(capacity_bytes, (size_t)64))
+{
+}
+
+void fs_frame_store::clear()
+{
+    this->first_id = 0;
+    this->first_slot = 0;
+    this->count = 0;
+    this->write_pos = 0;
+    this->used = 0;
+}
+
+void fs_frame_store::evict_oldest()
+{
+    this->used -= this->slots[this->first_slot].size;
+    this->first_slot = (this->first_slot + 1) % (int)this->slots.size();
+    ++this->first_id;
+    --this->count;
+}
+
+bool fs_frame_store::append(uint32_t frame_id, const std::string &frame)
+{
+    // 记录头 tag + varint长度
+    char head[11];
+    size_t head_len = 0;
+    head[head_len++] = (char)FS_FRAME_RECORD_TAG;
+    uint64_t len = frame.size();
+    do
+    {
+        uint8_t b = len & 0x7F;
+        len >>= 7;
+        head[head_len++] = (char)(len ? (b | 0x80) : b);
+    } while (len);
+
+    const size_t record_size = head_len + frame.size();
+    if (record_size > this->bytes.size())
+    {
+        return false;
+    }
+    if (this->count > 0 && frame_id != last_frame_id() + 1)
+    {
+        return false;
+    }
+
+    while (this->count > 0 && (this->count == (int)this->slots.size() || this->used + record_size > this->bytes.size()))
+    {
+        evict_oldest();
+    }
+    if (this->count == 0)
+    {
+        this->first_id = frame_id;
+        this->first_slot = 0;
+        this->write_pos = 0;
+    }
+
+    slot &s = this->slots[(this->first_slot + this->count) % (int)this->slots.size()];
+    s.offset = this->write_pos;
+    s.size = record_size;
+
+    // 在环尾折返 最多分两段写
+    const size_t cap = this->bytes.size();
+    auto write = [&](const char *src, size_t n)
+    {
+        const size_t first = std::min(n, cap - this->write_pos);
+        std::memcpy(this->bytes.data() + this->write_pos, src, first);
+        std::memcpy(this->bytes.data(), src + first, n - first);
+        this->write_pos = (this->write_pos + n) % cap;
+    };
+    write(head, head_len);
+    write(frame.data(), frame.size());
+
+    this->used += record_size;
+    ++this->count;
+    return true;
+}
+
+void fs_frame_store::copy_out(size_t offset, size_t size, std::string &out) const
+{
+    const size_t cap = this->bytes.size();
+    const size_t first = std::min(size, cap - offset);
+    out.append(this->bytes.data() + offset, first);
+    out.append(this->bytes.data(), size - first);
+}
+
+int fs_frame_store::frames_since(uint32_t frame_id, std::string &out) const
+{
+    if (this->count == 0)
+    {
+        return 0;
+    }
+    // 按差值比较 帧号回绕后仍然成立
+    const int64_t from = (int64_t)(int32_t)(frame_id + 1 - this->first_id);
+    if (from < 0)
+    {
+        return -1;
+    }
+    if (from >= this->count)
+    {
+        return 0;
+    }
+
+    const slot &s = this->slots[(this->first_slot + (int)from) % (int)this->slots.size()];
+    size_t size = this->write_pos >= s.offset ? this->write_pos - s.offset : this->bytes.size() - s.offset + this->write_pos;
+    // 环写满时write_pos与最老一帧的offset重合
+    if (size == 0)
+    {
+        size = this->used;
+    }
+    copy_out(s.offset, size, out);
+    return this->count - (int)from;
+}
+
+int fs_frame_store_mgr::create(int capacity_frames, size_t capacity_bytes)
+{
+    int store_id = 0;
+    if (this->free_ids.size() > 0)
+    {
+        store_id = this->free_ids.back();
+        this->free_ids.pop_back();
+    }
+    else
+    {
+        this->stores.emplace_back();
+        store_id = (int)this->stores.size();
+    }
+    this->stores[store_id - 1] = std::make_unique<fs_frame_store>(capacity_frames, capacity_bytes);
+    return store_id;
+}
+
+void fs_frame_store_mgr::destroy(int store_id)
+{
+    if (get(store_id))
+    {
+        this->stores[store_id - 1].reset();
+        this->free_ids.push_back(store_id);
+    }
+}
+
+fs_frame_store *fs_frame_store_mgr::get(int store_id)
+{
+    if (store_id <= 0 || store_id > (int)this->stores.size())
+    {
+        return nullptr;
+    }
+    return this->stores[store_id - 1].get();
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace avant::app
+{
+    // 帧同步房间的历史帧 定长环形缓冲 按frameId直接定位
+    // 每帧只编码一次 存成ProtoCSFSNotifyFrames中frames字段(field 1)的一条完整记录
+    // 连续若干条记录拼起来就是合法的ProtoCSFSNotifyFrames 断线重连补帧只需拷贝一段连续字节
+    // 帧数或字节数超出容量时淘汰最老的帧 追加与淘汰O(1) 取某帧之后的所有帧最多两次memcpy
+    class fs_frame_store
+    {
+    public:
+        fs_frame_store(int capacity_frames, size_t capacity_bytes);
+
+        // frame_id必须是上一帧加一(空缓冲时任意) frame为编码好的ProtoFSFrame 超出字节容量或帧号不连续返回false
+        bool append(uint32_t frame_id, const std::string &frame);
+        // frame_id之后(不含)的所有帧记录追加到out 返回帧数
+        // frame_id已被淘汰时返回-1 调用方需要走完整重同步 frame_id不早于最新帧时返回0
+        int frames_since(uint32_t frame_id, std::string &out) const;
+        void clear();
+
+        bool empty() const { return this->count == 0; }
+        uint32_t first_frame_id() const { return this->first_id; }
+        uint32_t last_frame_id() const { return this->first_id + this->count - 1; }
+        int frame_count() const { return this->count; }
+        size_t used_bytes() const { return this->used; }
+
+    private:
+        struct slot
+        {
+            // 记录在字节环中的起始位置与长度
+            size_t offset{0};
+            size_t size{0};
+        };
+
+        void evict_oldest();
+        void copy_out(size_t offset, size_t size, std::string &out) const;
+
+    private:
+        std::vector<slot> slots;
+        std::vector<char> bytes;
+        // 最老一帧的帧号与其在slots中的下标
+        uint32_t first_id{0};
+        int first_slot{0};
+        int count{0};
+        // 下一条记录的写入位置与已用字节数
+        size_t write_pos{0};
+        size_t used{0};
+    };
+
+    // Lua侧以整数id持有帧缓冲 只在other线程使用
+    class fs_frame_store_mgr
+    {
+    public:
+        int create(int capacity_frames, size_t capacity_bytes);
+        void destroy(int store_id);
+        fs_frame_store *get(int store_id);
+
+    private:
+        std::vector<std::unique_ptr<fs_frame_store>> stores;
+        std::vector<int> free_ids;
+    };
+}
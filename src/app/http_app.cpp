@@ -5,11 +5,20 @@
 #include "utility/mime_type.h"
 #include "utility/singleton.h"
 #include "app/lua_plugin.h"
+#include "app/app_metrics.h"
 #include <string>
 #include <filesystem>
 #include <avant-log/logger.h>
 #include <vector>
+#include <list>
+#include <mutex>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <cerrno>
+#include <cstring>
 #include <sys/stat.h>
+#include <sys/sendfile.h>
 #include "global/tunnel_id.h"
 #include "proto/proto_util.h"
 #include "zlib/zlib.h"
@@ -49,24 +58,42 @@ struct avant_http_app_reponse
         DIR = 0,
         FD = 1,
         NONE = 2,
+        BODY = 3,
+        LUA = 4,
     };
 
     void *ptr{nullptr};
     type ptr_type{NONE};
-    z_stream strm{};
-    bool use_gzip{false};
-    bool gzip_initialized{false};
+
+    // FD: 依次发送的文件区间 每段先发prefix再sendfile文件内容
+    // 200只有一段 multipart/byteranges每段带分隔头 最后一段只有结束分隔符
+    struct file_part
+    {
+        std::string prefix;
+        off_t offset;
+        int64_t length;
+    };
+    std::vector<file_part> parts;
+    size_t part_idx{0};
+    // 当前区间剩余待发送的部分
+    off_t send_offset{0};
+    int64_t send_remaining{0};
+
+    // BODY: 与gzip缓存共享的响应体 不做拷贝
+    std::shared_ptr<const std::string> body;
+    size_t body_offset{0};
+
+    // LUA: 交给worker Lua VM的请求体 以及流式响应待写出的chunk
+    std::string request_body;
+    std::string stream_pending;
+    bool stream_end{false};
 
     typedef std::tuple<std::string, size_t> DIR_TYPE;
     typedef FILE FD_TYPE;
 
     inline void destory()
     {
-        if (gzip_initialized)
-        {
-            deflateEnd(&strm);
-            gzip_initialized = false;
-        }
+        body.reset();
 
         if (ptr && ptr_type == FD)
         {
@@ -90,6 +117,341 @@ struct avant_http_app_reponse
     }
 };
 
+// 静态文件gzip预压缩缓存 所有worker线程共享
+// 以路径为索引 条目记录mtime与size(与ETag同源) 文件变化后下次访问时重新压缩替换
+class avant_http_gzip_cache
+{
+public:
+    // 缓存总字节上限 超出按LRU淘汰
+    static constexpr size_t MAX_TOTAL_BYTES = 64 * 1024 * 1024;
+    // 超过该大小的文件不压缩 直接sendfile原文
+    static constexpr int64_t MAX_FILE_BYTES = 8 * 1024 * 1024;
+
+    std::shared_ptr<const std::string> get(const std::string &path, time_t mtime, int64_t size)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto iter = index.find(path);
+            if (iter != index.end())
+            {
+                if (iter->second->mtime == mtime && iter->second->size == size)
+                {
+                    lru.splice(lru.begin(), lru, iter->second);
+                    return iter->second->body;
+                }
+                erase(iter);
+            }
+        }
+
+        // 压缩放在锁外 多个worker同时未命中时各自压缩 后写入的覆盖先写入的
+        auto body = std::make_shared<std::string>();
+        if (!compress_file(path, size, *body))
+        {
+            return nullptr;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        auto iter = index.find(path);
+        if (iter != index.end())
+        {
+            erase(iter);
+        }
+        if (body->size() > MAX_TOTAL_BYTES)
+        {
+            return body;
+        }
+        while (!lru.empty() && total_bytes + body->size() > MAX_TOTAL_BYTES)
+        {
+            erase(index.find(lru.back().path));
+        }
+        lru.push_front({path, mtime, size, body});
+        index[path] = lru.begin();
+        total_bytes += body->size();
+        return body;
+    }
+
+private:
+    struct entry
+    {
+        std::string path;
+        time_t mtime;
+        int64_t size;
+        std::shared_ptr<const std::string> body;
+    };
+
+    void erase(std::unordered_map<std::string, std::list<entry>::iterator>::iterator iter)
+    {
+        total_bytes -= iter->second->body->size();
+        lru.erase(iter->second);
+        index.erase(iter);
+    }
+
+    static bool compress_file(const std::string &path, int64_t size, std::string &out)
+    {
+        FILE *file = ::fopen(path.c_str(), "r");
+        if (!file)
+        {
+            LOG_ERROR("fopen({}, r) failed", path);
+            return false;
+        }
+        std::string raw(size, '\0');
+        size_t read_len = size > 0 ? ::fread(&raw[0], sizeof(char), raw.size(), file) : 0;
+        ::fclose(file);
+        if (read_len != raw.size())
+        {
+            LOG_ERROR("fread {} expect {} got {}", path, raw.size(), read_len);
+            return false;
+        }
+
+        z_stream strm{};
+        strm.zalloc = Z_NULL;
+        strm.zfree = Z_NULL;
+        strm.opaque = Z_NULL;
+        // using gzip format (windowBits = 15 + 16)
+        int ret = deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+        if (ret != Z_OK)
+        {
+            LOG_ERROR("deflateInit2 failed: {}", ret);
+            return false;
+        }
+        out.resize(deflateBound(&strm, raw.size()));
+        strm.next_in = (Bytef *)raw.data();
+        strm.avail_in = raw.size();
+        strm.next_out = (Bytef *)&out[0];
+        strm.avail_out = out.size();
+        ret = deflate(&strm, Z_FINISH);
+        size_t out_len = out.size() - strm.avail_out;
+        deflateEnd(&strm);
+        if (ret != Z_STREAM_END)
+        {
+            LOG_ERROR("deflate {} failed: {}", path, ret);
+            return false;
+        }
+        out.resize(out_len);
+        out.shrink_to_fit();
+        return true;
+    }
+
+private:
+    std::mutex mutex;
+    std::list<entry> lru;
+    std::unordered_map<std::string, std::list<entry>::iterator> index;
+    size_t total_bytes{0};
+};
+
+// 保留路径 返回Prometheus格式的运行时指标 不走静态文件
+static const char *AVANT_HTTP_METRICS_PATH = "/__metrics";
+
+// worker Lua VM HTTP API 状态都只在所属worker线程访问
+// 以该前缀开头的请求交给OnHttpRequest 由Lua调用avant.HttpSetAPIPrefix设置 空串表示关闭
+static thread_local std::string avant_http_api_prefix;
+// 流式响应 连接gid -> 响应对象
+static thread_local std::unordered_map<uint64_t, avant_http_app_reponse *> avant_http_lua_streams;
+// 流式响应积压超过该字节数时avant.HttpWrite返回false 由Lua自行退避
+static constexpr size_t AVANT_HTTP_STREAM_MAX_PENDING = 4 * 1024 * 1024;
+
+static bool avant_http_is_lua_api(const std::string &url)
+{
+    return avant_http_api_prefix.size() > 0 && url.compare(0, avant_http_api_prefix.size(), avant_http_api_prefix) == 0;
+}
+
+// keep-alive复用连接时也会销毁上一个请求的ctx 先记下 本tick内没有被复用的才算连接关闭
+static thread_local std::unordered_set<uint64_t> avant_http_closing_gids;
+
+static void avant_http_app_destory(avant::connection::http_ctx &ctx)
+{
+    avant_http_closing_gids.insert(ctx.get_conn_gid());
+
+    if (ctx.ptr)
+    {
+        avant_http_app_reponse *reponse_ptr = (avant_http_app_reponse *)ctx.ptr;
+        if (reponse_ptr->ptr_type == avant_http_app_reponse::LUA)
+        {
+            auto iter = avant_http_lua_streams.find(ctx.get_conn_gid());
+            if (iter != avant_http_lua_streams.end() && iter->second == reponse_ptr)
+            {
+                avant_http_lua_streams.erase(iter);
+            }
+        }
+        reponse_ptr->destory();
+
+        // LOG_DEBUG("reponse_ptr->destory() conngid {}", ctx.get_conn_gid());
+        delete reponse_ptr;
+        ctx.ptr = nullptr;
+    }
+}
+
+static const char *avant_http_reason_phrase(int status)
+{
+    switch (status)
+    {
+    case 200:
+        return "OK";
+    case 201:
+        return "Created";
+    case 204:
+        return "No Content";
+    case 400:
+        return "Bad Request";
+    case 401:
+        return "Unauthorized";
+    case 403:
+        return "Forbidden";
+    case 404:
+        return "Not Found";
+    case 405:
+        return "Method Not Allowed";
+    case 429:
+        return "Too Many Requests";
+    case 500:
+        return "Internal Server Error";
+    case 503:
+        return "Service Unavailable";
+    default:
+        return "Unknown";
+    }
+}
+
+// 在连接所属worker的Lua VM里执行OnHttpRequest
+static void avant_http_process_lua_api(avant::connection::http_ctx &ctx, const std::string &request_target)
+{
+    avant_http_app_reponse *resp = (avant_http_app_reponse *)ctx.ptr;
+    if (!resp)
+    {
+        resp = new (std::nothrow) avant_http_app_reponse;
+        if (!resp)
+        {
+            LOG_ERROR("new (std::nothrow) avant_http_app_reponse failed");
+            ctx.set_response_end(true);
+            ctx.set_conn_is_close(true);
+            return;
+        }
+        ctx.ptr = resp;
+        resp->ptr_type = avant_http_app_reponse::LUA;
+    }
+
+    std::vector<std::pair<std::string, std::string>> out_headers;
+    std::string out_body;
+    bool out_stream = false;
+    int status = utility::singleton<lua_plugin>::instance()->on_worker_lua_vm_http_request(ctx.get_worker_idx(),
+                                                                                            ctx.get_conn_gid(),
+                                                                                            ctx.method,
+                                                                                            request_target,
+                                                                                            ctx.headers,
+                                                                                            resp->request_body,
+                                                                                            out_headers,
+                                                                                            out_body,
+                                                                                            out_stream);
+    std::string().swap(resp->request_body);
+    if (status <= 0)
+    {
+        status = 404;
+        out_headers.clear();
+        out_body = "404";
+        out_stream = false;
+    }
+
+    std::string response_head = "HTTP/1.1 " + std::to_string(status) + " " + avant_http_reason_phrase(status) + "\r\nServer: avant\r\n";
+    response_head += "Connection: keep-alive\r\nKeep-Alive: timeout=60, max=10000\r\n";
+    bool has_content_type = false;
+    for (const auto &header : out_headers)
+    {
+        has_content_type = has_content_type || header.first == "Content-Type";
+        response_head += header.first + ": " + header.second + "\r\n";
+    }
+    if (!has_content_type)
+    {
+        response_head += "Content-Type: text/plain; charset=UTF-8\r\n";
+    }
+
+    if (!out_stream)
+    {
+        response_head += "Content-Length: " + std::to_string(out_body.size()) + "\r\n\r\n";
+        ctx.send_buffer_append(response_head.c_str(), response_head.size());
+        ctx.send_buffer_append(out_body.c_str(), out_body.size());
+        ctx.set_response_end(true);
+        return;
+    }
+
+    response_head += "Transfer-Encoding: chunked\r\n\r\n";
+    ctx.send_buffer_append(response_head.c_str(), response_head.size());
+    avant_http_lua_streams[ctx.get_conn_gid()] = resp;
+
+    // Lua在之后的tick里调用avant.HttpWrite/HttpEnd 写入stream_pending 这里搬进发送缓冲区
+    ctx.write_end_callback = [](connection::http_ctx &ctx) -> void
+    {
+        avant_http_app_reponse *resp = (avant_http_app_reponse *)ctx.ptr;
+        if (resp->stream_pending.size() > 0)
+        {
+            ctx.send_buffer_append(resp->stream_pending.c_str(), resp->stream_pending.size());
+            resp->stream_pending.clear();
+            return;
+        }
+        if (resp->stream_end)
+        {
+            ctx.set_response_end(true);
+        }
+    };
+}
+
+// 单个请求最多接受的Range区间数
+static constexpr size_t AVANT_HTTP_MAX_RANGES = 16;
+
+// 单次write_end_callback最多发出的字节数 避免一个大文件长时间占住worker
+static constexpr size_t AVANT_HTTP_WRITE_BYTES_PER_CALL = 1024000;
+
+// 文件区间直接从页缓存写到socket 不经过用户态缓冲
+// 返回false表示连接已不可用
+static bool avant_http_sendfile(avant::connection::http_ctx &ctx, avant_http_app_reponse &resp)
+{
+    auto conn_ptr = ctx.get_conn_ptr();
+    FILE *file = (avant_http_app_reponse::FD_TYPE *)resp.ptr;
+    size_t budget = AVANT_HTTP_WRITE_BYTES_PER_CALL;
+
+    // TLS连接内核无法加密 退回pread到发送缓冲区
+    if (conn_ptr->socket_obj.get_ssl_instance())
+    {
+        static thread_local std::vector<char> buf(AVANT_HTTP_WRITE_BYTES_PER_CALL);
+        size_t need = resp.send_remaining < (int64_t)budget ? resp.send_remaining : budget;
+        ssize_t len = ::pread(::fileno(file), buf.data(), need, resp.send_offset);
+        if (len <= 0)
+        {
+            LOG_ERROR("pread failed ret {} errno {}", len, errno);
+            return false;
+        }
+        ctx.send_buffer_append(buf.data(), len);
+        resp.send_offset += len;
+        resp.send_remaining -= len;
+        return true;
+    }
+
+    const int sock_fd = conn_ptr->socket_obj.get_fd();
+    const int file_fd = ::fileno(file);
+    while (resp.send_remaining > 0 && budget > 0)
+    {
+        size_t need = resp.send_remaining < (int64_t)budget ? resp.send_remaining : budget;
+        ssize_t len = ::sendfile(sock_fd, file_fd, &resp.send_offset, need);
+        if (len > 0)
+        {
+            resp.send_remaining -= len;
+            budget -= len;
+            continue;
+        }
+        if (len < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            break;
+        }
+        // len == 0 说明文件在发送期间被截断 Content-Length已无法兑现
+        LOG_ERROR("sendfile failed ret {} errno {} remaining {}", len, errno, resp.send_remaining);
+        return false;
+    }
+    return true;
+}
+
 struct avant_http_range
 {
     int64_t start;
@@ -114,19 +476,33 @@ bool avant_parse_range_header(const std::string &range_header,
         size_t dash_pos = range_item.find('-');
         if (dash_pos == std::string::npos)
         {
+            ranges.clear();
             return false;
         }
         std::string start_str = range_item.substr(0, dash_pos);
         std::string end_str = range_item.substr(dash_pos + 1);
+        if (start_str.empty() && end_str.empty())
+        {
+            ranges.clear();
+            return false;
+        }
 
+        // start == -1 表示后缀区间 "-N" 此时end为N
         int64_t start, end;
         try
         {
-            start = start_str.empty() ? 0 : std::stoll(start_str);
+            start = start_str.empty() ? -1 : std::stoll(start_str);
             end = end_str.empty() ? -1 : std::stoll(end_str);
         }
         catch (...)
         {
+            ranges.clear();
+            return false;
+        }
+        if ((start_str.size() > 0 && start < 0) || (end_str.size() > 0 && end < 0) ||
+            (start >= 0 && end >= 0 && end < start))
+        {
+            ranges.clear();
             return false;
         }
 
@@ -136,8 +512,52 @@ bool avant_parse_range_header(const std::string &range_header,
     return !ranges.empty();
 }
 
+// 按文件大小把请求区间换算为闭区间[start, end] 丢弃不可满足的区间
+// 返回false表示没有任何可满足的区间 应回复416
+static bool avant_resolve_ranges(std::vector<avant_http_range> &ranges, int64_t file_size)
+{
+    std::vector<avant_http_range> resolved;
+    for (const auto &range : ranges)
+    {
+        int64_t start = range.start;
+        int64_t end = range.end;
+        if (start < 0)
+        {
+            if (end <= 0)
+            {
+                continue;
+            }
+            start = end >= file_size ? 0 : file_size - end;
+            end = file_size - 1;
+        }
+        else if (end < 0 || end >= file_size)
+        {
+            end = file_size - 1;
+        }
+        if (start >= file_size)
+        {
+            continue;
+        }
+        resolved.push_back({start, end});
+    }
+    ranges.swap(resolved);
+    return !ranges.empty();
+}
+
 void http_app::on_new_connection(avant::connection::http_ctx &ctx, bool is_keep_alive_call)
 {
+    // 每个连接都挂上销毁回调 没走到process_connection就断开的连接也能计入关闭
+    ctx.destory_callback = avant_http_app_destory;
+    if (!is_keep_alive_call)
+    {
+        app_metrics::add(utility::singleton<app_metrics>::instance()->worker_slot(ctx.get_worker_idx()).conn_new_total);
+    }
+    else if (avant_http_closing_gids.erase(ctx.get_conn_gid()) == 0)
+    {
+        // 上一个请求结束后隔了tick才复用 已经计为关闭 再计一次新连接 保持当前连接数正确
+        app_metrics::add(utility::singleton<app_metrics>::instance()->worker_slot(ctx.get_worker_idx()).conn_new_total);
+    }
+
     // send new_connection protocol to other thread
     if constexpr (false)
     {
@@ -153,18 +573,7 @@ void http_app::on_new_connection(avant::connection::http_ctx &ctx, bool is_keep_
 void http_app::process_connection(avant::connection::http_ctx &ctx)
 {
     // load callback
-    ctx.destory_callback = [](avant::connection::http_ctx &ctx) -> void
-    {
-        if (ctx.ptr)
-        {
-            avant_http_app_reponse *reponse_ptr = (avant_http_app_reponse *)ctx.ptr;
-            reponse_ptr->destory();
-
-            // LOG_DEBUG("reponse_ptr->destory() conngid {}", ctx.get_conn_gid());
-            delete reponse_ptr;
-            ctx.ptr = nullptr;
-        }
-    };
+    ctx.destory_callback = avant_http_app_destory;
 
     ctx.process_callback = [](avant::connection::http_ctx &ctx) -> void
     {
@@ -322,6 +731,9 @@ void http_app::process_connection(avant::connection::http_ctx &ctx)
             return;
         }
 
+        // 交给Lua的是带query的完整请求目标
+        const std::string request_target = url;
+
         try
         {
             utility::url url_obj(url);
@@ -335,6 +747,27 @@ void http_app::process_connection(avant::connection::http_ctx &ctx)
             return;
         }
 
+        if (url == AVANT_HTTP_METRICS_PATH)
+        {
+            std::string body = utility::singleton<app_metrics>::instance()->scrape();
+            std::string response = "HTTP/1.1 200 OK\r\nServer: avant\r\n";
+            response += "Connection: keep-alive\r\nKeep-Alive: timeout=60, max=10000\r\n";
+            response += "Content-Type: text/plain; version=0.0.4; charset=UTF-8\r\n";
+            response += "Cache-Control: no-store\r\n";
+            response += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+            response += "\r\n";
+            response += body;
+            ctx.send_buffer_append(response.c_str(), response.size());
+            ctx.set_response_end(true);
+            return;
+        }
+
+        if (avant_http_is_lua_api(url))
+        {
+            avant_http_process_lua_api(ctx, request_target);
+            return;
+        }
+
         if (url == "" || url == "/")
         {
             url = "/index.html";
@@ -376,10 +809,20 @@ void http_app::process_connection(avant::connection::http_ctx &ctx)
             // std::cout << "now_etag: " << now_etag << std::endl;
             // std::cout << "now_last_modify_date: " << now_last_modify_date << std::endl;
 
-            // std::cout << "header_if_range: " << header_if_range << std::endl;
-            for (const auto &range_item : header_ranges)
+            // If-Range 与当前版本不一致时忽略Range 返回完整文件
+            if (header_ranges.size() > 0 && header_if_range.size() > 0)
+            {
+                bool if_range_match = header_if_range.front() == '"' ? (now_etag.size() > 0 && header_if_range == now_etag)
+                                                                     : (now_last_modify_date.size() > 0 && header_if_range == now_last_modify_date);
+                if (!if_range_match)
+                {
+                    header_ranges.clear();
+                }
+            }
+            // 区间过多时按RFC 9110允许的方式忽略Range
+            if (header_ranges.size() > AVANT_HTTP_MAX_RANGES)
             {
-                // std::cout << "range_item: " << range_item.start << "-" << range_item.end << std::endl;
+                header_ranges.clear();
             }
 
             // 命中缓存
@@ -422,53 +865,106 @@ void http_app::process_connection(avant::connection::http_ctx &ctx)
             }
 
             // checking mine_type for use_gzip, default using use_gzip
+            bool use_gzip = client_support_gzip &&
+                            (mime_type.find("text/") == 0 ||
+                             mime_type.find("application/javascript") == 0 ||
+                             mime_type.find("application/json") == 0 ||
+                             mime_type.find("application/xml") == 0 ||
+                             mime_type.find("image/") == 0);
+
+            struct stat st;
+            if (::stat(t_path.c_str(), &st) != 0)
             {
-                response_ptr->use_gzip = client_support_gzip &&
-                                         (mime_type.find("text/") == 0 ||
-                                          mime_type.find("application/javascript") == 0 ||
-                                          mime_type.find("application/json") == 0 ||
-                                          mime_type.find("application/xml") == 0 ||
-                                          mime_type.find("image/") == 0);
+                LOG_ERROR("stat({}) failed", t_path.c_str());
+                return_500(ctx);
+                ctx.set_response_end(true);
+                return;
+            }
 
-                if (response_ptr->use_gzip && !response_ptr->gzip_initialized)
+            // Range作用在原文字节上 部分响应不压缩
+            if (header_ranges.size() > 0)
+            {
+                use_gzip = false;
+                if (!avant_resolve_ranges(header_ranges, st.st_size))
                 {
-                    response_ptr->strm = {};
-                    response_ptr->strm.zalloc = Z_NULL;
-                    response_ptr->strm.zfree = Z_NULL;
-                    response_ptr->strm.opaque = Z_NULL;
-
-                    // using gzip format (windowBits = 15 + 16)
-                    int ret = deflateInit2(&response_ptr->strm,
-                                           Z_DEFAULT_COMPRESSION,
-                                           Z_DEFLATED,
-                                           15 + 16, // gzip 格式
-                                           8,
-                                           Z_DEFAULT_STRATEGY);
-
-                    if (ret != Z_OK)
-                    {
-                        LOG_ERROR("deflateInit2 failed: {}", ret);
-                        delete response_ptr;
-                        return_500(ctx);
-                        ctx.set_response_end(true);
-                        return;
-                    }
-                    response_ptr->gzip_initialized = true;
+                    std::string response = "HTTP/1.1 416 Range Not Satisfiable\r\nServer: avant\r\n";
+                    response += "Connection: keep-alive\r\nKeep-Alive: timeout=60, max=10000\r\n";
+                    response += "Content-Range: bytes */" + std::to_string(st.st_size) + "\r\n";
+                    response += "Content-Length: 0\r\n";
+                    response += "\r\n";
+                    ctx.send_buffer_append(response.c_str(), response.size());
+                    ctx.set_response_end(true);
+                    return;
                 }
             }
 
-            response_ptr->ptr = ::fopen(t_path.c_str(), "r");
-            if (response_ptr->ptr == NULL)
+            if (use_gzip && st.st_size <= avant_http_gzip_cache::MAX_FILE_BYTES)
             {
-                LOG_ERROR("fopen({}, r) failed", t_path.c_str());
-                return_500(ctx);
-                ctx.set_response_end(true);
-                return;
+                response_ptr->body = utility::singleton<avant_http_gzip_cache>::instance()->get(t_path.string(), st.st_mtime, st.st_size);
             }
+            use_gzip = response_ptr->body != nullptr;
 
-            ::fseek((FILE *)response_ptr->ptr, 0, SEEK_SET);
+            if (use_gzip)
+            {
+                response_ptr->ptr_type = avant_http_app_reponse::BODY;
+            }
+            else
+            {
+                response_ptr->ptr = ::fopen(t_path.c_str(), "r");
+                if (response_ptr->ptr == NULL)
+                {
+                    LOG_ERROR("fopen({}, r) failed", t_path.c_str());
+                    return_500(ctx);
+                    ctx.set_response_end(true);
+                    return;
+                }
+            }
 
-            std::string response_head = "HTTP/1.1 200 OK\r\nServer: avant\r\n";
+            int64_t content_length = 0;
+            std::string content_type_line = "Content-Type: " + mime_type + "\r\n";
+            std::string status_line = "HTTP/1.1 200 OK\r\n";
+            if (use_gzip)
+            {
+                content_length = response_ptr->body->size();
+            }
+            else if (header_ranges.size() == 1)
+            {
+                const avant_http_range &range = header_ranges.front();
+                status_line = "HTTP/1.1 206 Partial Content\r\n";
+                content_type_line += "Content-Range: bytes " + std::to_string(range.start) + "-" + std::to_string(range.end) +
+                                     "/" + std::to_string(st.st_size) + "\r\n";
+                response_ptr->parts.push_back({"", range.start, range.end - range.start + 1});
+                content_length = range.end - range.start + 1;
+            }
+            else if (header_ranges.size() > 1)
+            {
+                // boundary只需在本响应内不与内容冲突 用ETag与连接gid拼出即可
+                std::ostringstream boundary_oss;
+                boundary_oss << "avant_" << std::hex << st.st_mtime << "_" << st.st_size << "_" << ctx.get_conn_gid();
+                const std::string boundary = boundary_oss.str();
+
+                status_line = "HTTP/1.1 206 Partial Content\r\n";
+                for (const auto &range : header_ranges)
+                {
+                    std::string part_head = "\r\n--" + boundary + "\r\n";
+                    part_head += content_type_line;
+                    part_head += "Content-Range: bytes " + std::to_string(range.start) + "-" + std::to_string(range.end) +
+                                 "/" + std::to_string(st.st_size) + "\r\n\r\n";
+                    content_length += part_head.size() + (range.end - range.start + 1);
+                    response_ptr->parts.push_back({std::move(part_head), range.start, range.end - range.start + 1});
+                }
+                std::string part_tail = "\r\n--" + boundary + "--\r\n";
+                content_length += part_tail.size();
+                response_ptr->parts.push_back({std::move(part_tail), 0, 0});
+                content_type_line = "Content-Type: multipart/byteranges; boundary=" + boundary + "\r\n";
+            }
+            else
+            {
+                response_ptr->parts.push_back({"", 0, st.st_size});
+                content_length = st.st_size;
+            }
+
+            std::string response_head = status_line + "Server: avant\r\n";
             response_head += "Connection: keep-alive\r\nKeep-Alive: timeout=60, max=10000\r\n";
             if (now_etag.size() > 0)
             {
@@ -478,12 +974,17 @@ void http_app::process_connection(avant::connection::http_ctx &ctx)
             {
                 response_head += std::string("Last-Modified: ") + now_last_modify_date + "\r\n";
             }
-            response_head += "Content-Type: " + mime_type + "\r\n";
-            if (response_ptr->use_gzip)
+            response_head += content_type_line;
+            response_head += "Vary: Accept-Encoding\r\n";
+            if (use_gzip)
             {
                 response_head += "Content-Encoding: gzip\r\n";
             }
-            response_head += "Transfer-Encoding: chunked\r\n\r\n";
+            else
+            {
+                response_head += "Accept-Ranges: bytes\r\n";
+            }
+            response_head += "Content-Length: " + std::to_string(content_length) + "\r\n\r\n";
 
             ctx.send_buffer_append(response_head.c_str(), response_head.size());
 
@@ -491,62 +992,54 @@ void http_app::process_connection(avant::connection::http_ctx &ctx)
             // and the response must be set response_end to true, then write after write_end_callback will be continuously recalled
             ctx.write_end_callback = [](connection::http_ctx &ctx) -> void
             {
-                constexpr int buffer_size = 1024000; // 1000KB
-                char buf[buffer_size] = {0};
-                constexpr int compress_buffer_size = 2 * buffer_size; // 2000KB
-                char compress_buf[compress_buffer_size] = {0};
-
                 avant_http_app_reponse *resp = (avant_http_app_reponse *)ctx.ptr;
 
-                int len = ::fread(buf,
-                                  sizeof(char),
-                                  buffer_size,
-                                  (avant_http_app_reponse::FD_TYPE *)((avant_http_app_reponse *)ctx.ptr)->ptr);
-
-                if (len > 0)
+                if (resp->ptr_type == avant_http_app_reponse::BODY)
                 {
-                    if (resp->use_gzip)
+                    const std::string &body = *resp->body;
+                    if (body.size() > resp->body_offset)
                     {
-                        // using gzip
-                        resp->strm.avail_in = len;
-                        resp->strm.next_in = (Bytef *)buf;
-
-                        resp->strm.avail_out = compress_buffer_size;
-                        resp->strm.next_out = (Bytef *)compress_buf;
-
-                        int ret = deflate(&resp->strm, Z_SYNC_FLUSH);
-                        if (ret == Z_STREAM_ERROR)
-                        {
-                            LOG_ERROR("deflate failed with Z_STREAM_ERROR");
-                            ctx.set_response_end(true);
-                            return;
-                        }
-                        int exit_compressed_data_len = compress_buffer_size - resp->strm.avail_out;
-                        if (exit_compressed_data_len > 0)
-                        {
-                            std::stringstream ss;
-                            ss << std::hex << exit_compressed_data_len;
-                            std::string chunk_size = ss.str() + "\r\n";
-
-                            ctx.send_buffer_append(chunk_size.c_str(), chunk_size.size());
-                            ctx.send_buffer_append(compress_buf, exit_compressed_data_len);
-                            ctx.send_buffer_append("\r\n", 2);
-                        }
+                        size_t need_send = body.size() - resp->body_offset;
+                        need_send = need_send > AVANT_HTTP_WRITE_BYTES_PER_CALL ? AVANT_HTTP_WRITE_BYTES_PER_CALL : need_send;
+                        ctx.send_buffer_append(body.data() + resp->body_offset, need_send);
+                        resp->body_offset += need_send;
                     }
                     else
                     {
-                        std::stringstream ss;
-                        ss << std::hex << len; // convert to hex
-                        std::string chunk_size = ss.str() + "\r\n";
+                        ctx.set_response_end(true);
+                    }
+                    return;
+                }
 
-                        ctx.send_buffer_append(chunk_size.c_str(), chunk_size.size());
-                        ctx.send_buffer_append(buf, len);
-                        ctx.send_buffer_append("\r\n", 2);
+                // sendfile绕过发送缓冲区直接写socket 必须等缓冲区里的响应头先发完
+                if (ctx.get_send_buffer_size() > 0)
+                {
+                    return;
+                }
+                while (resp->send_remaining <= 0)
+                {
+                    if (resp->part_idx >= resp->parts.size())
+                    {
+                        ctx.set_response_end(true);
+                        return;
+                    }
+                    const auto &part = resp->parts[resp->part_idx++];
+                    resp->send_offset = part.offset;
+                    resp->send_remaining = part.length;
+                    if (part.prefix.size() > 0)
+                    {
+                        ctx.send_buffer_append(part.prefix.c_str(), part.prefix.size());
+                        return;
                     }
                 }
-                else
+                if (!avant_http_sendfile(ctx, *resp))
+                {
+                    ctx.set_conn_is_close(true);
+                    ctx.set_response_end(true);
+                    return;
+                }
+                if (resp->send_remaining <= 0 && resp->part_idx >= resp->parts.size() && ctx.get_send_buffer_size() == 0)
                 {
-                    ctx.send_buffer_append("0\r\n\r\n", 5);
                     ctx.set_response_end(true);
                 }
             };
@@ -663,6 +1156,24 @@ int http_app::on_body(avant::connection::http_ctx &ctx, size_t length)
 
     // processing http request body data
     {
+        // Lua API请求的body攒起来交给OnHttpRequest 其余请求丢弃
+        if (avant_http_is_lua_api(ctx.url))
+        {
+            avant_http_app_reponse *resp = (avant_http_app_reponse *)ctx.ptr;
+            if (!resp)
+            {
+                resp = new (std::nothrow) avant_http_app_reponse;
+                if (!resp)
+                {
+                    LOG_ERROR("new (std::nothrow) avant_http_app_reponse failed");
+                    return -1;
+                }
+                ctx.ptr = resp;
+                resp->ptr_type = avant_http_app_reponse::LUA;
+                ctx.destory_callback = avant_http_app_destory;
+            }
+            resp->request_body.append(ctx.get_recv_buffer_read_ptr(), recv_buffer_size);
+        }
         ctx.clear_recv_buffer();
     }
 
@@ -709,11 +1220,18 @@ void http_app::on_main_tick(avant::server::server &server_obj)
 
 void http_app::on_worker_tick(avant::workers::worker &worker_obj)
 {
+    if (!avant_http_closing_gids.empty())
+    {
+        app_metrics::add(utility::singleton<app_metrics>::instance()->worker_slot(worker_obj.get_worker_idx()).conn_close_total,
+                         avant_http_closing_gids.size());
+        avant_http_closing_gids.clear();
+    }
     utility::singleton<lua_plugin>::instance()->on_worker_tick(worker_obj.get_worker_idx());
 }
 
 void http_app::on_worker_tunnel(avant::workers::worker &worker_obj, const ProtoPackage &package, const ProtoTunnelPackage &tunnel_package)
 {
+    app_metrics::add(utility::singleton<app_metrics>::instance()->worker_slot(worker_obj.get_worker_idx()).tunnel_recv_total);
     int cmd = package.cmd();
     if (cmd == ProtoCmd::PROTO_CMD_TUNNEL_OTHER2WORKER_TEST)
     {
@@ -731,6 +1249,48 @@ void http_app::on_worker_tunnel(avant::workers::worker &worker_obj, const ProtoP
     }
 }
 
+void http_app::worker_lua_set_http_api_prefix(const std::string &prefix)
+{
+    avant_http_api_prefix = prefix;
+}
+
+bool http_app::worker_lua_http_write(uint64_t gid, const char *data, size_t len)
+{
+    auto iter = avant_http_lua_streams.find(gid);
+    if (iter == avant_http_lua_streams.end())
+    {
+        return false;
+    }
+    avant_http_app_reponse *resp = iter->second;
+    if (resp->stream_pending.size() + len > AVANT_HTTP_STREAM_MAX_PENDING)
+    {
+        return false;
+    }
+    if (len == 0)
+    {
+        return true; // 空chunk会被当作结束标记
+    }
+    std::stringstream ss;
+    ss << std::hex << len;
+    resp->stream_pending += ss.str() + "\r\n";
+    resp->stream_pending.append(data, len);
+    resp->stream_pending += "\r\n";
+    return true;
+}
+
+bool http_app::worker_lua_http_end(uint64_t gid)
+{
+    auto iter = avant_http_lua_streams.find(gid);
+    if (iter == avant_http_lua_streams.end())
+    {
+        return false;
+    }
+    iter->second->stream_pending += "0\r\n\r\n";
+    iter->second->stream_end = true;
+    avant_http_lua_streams.erase(iter);
+    return true;
+}
+
 void http_app::on_cmd_reload(avant::server::server &server_obj)
 {
     LOG_ERROR("http_app on_cmd_reload execute lua_plugin reload");
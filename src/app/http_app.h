@@ -44,6 +44,12 @@ namespace avant
             static void on_worker_tunnel(avant::workers::worker &worker_obj, const ProtoPackage &package, const ProtoTunnelPackage &tunnel_package);
 
             static void on_cmd_reload(avant::server::server &server_obj);
+
+            // Worker Lua VM HTTP API, only called on the worker thread that owns the connection
+            static void worker_lua_set_http_api_prefix(const std::string &prefix);
+            // Append a chunk to a streaming response, false if the connection is gone or too much is pending
+            static bool worker_lua_http_write(uint64_t gid, const char *data, size_t len);
+            static bool worker_lua_http_end(uint64_t gid);
         };
     }
 }
\ No newline at end of file
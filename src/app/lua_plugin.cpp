@@ -8,9 +8,26 @@
 #include "proto_res/proto_example.pb.h"
 #include "proto_res/proto_database.pb.h"
 #include "proto_res/proto_udp.pb.h"
+#include "proto_res/proto_ipc_stream.pb.h"
 #include "utility/singleton.h"
 #include "global/tunnel_id.h"
 #include "app/other_app.h"
+#include "app/http_app.h"
+#include "app/udp_session.h"
+#include "app/app_metrics.h"
+#include "app/map_quadtree.h"
+#include "app/map_voxel_index.h"
+#include "app/map_aoi.h"
+#include "app/map_snapshot.h"
+#include "app/map_physics.h"
+#include "app/map_sim.h"
+#include "app/map_tile_grid.h"
+#include "app/map_pathfind.h"
+#include "app/map_hpa.h"
+#include "app/map_flow_field.h"
+#include "app/map_input_buffer.h"
+#include "app/fs_frame_store.h"
+#include "app/fs_frame_broadcast.h"
 #include <stack>
 #include <chrono>
 
@@ -53,6 +70,88 @@ int countTableElements(lua_State *L, int tableIndex)
 }
 #endif
 
+// tick耗时与lua虚拟机内存写入当前线程的指标槽位
+static void lua_plugin_observe_tick(app_metrics::thread_slot &slot, lua_State *lua_state, std::chrono::steady_clock::time_point begin)
+{
+    uint64_t cost_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count();
+    app_metrics::observe_tick(slot, cost_us);
+    uint64_t memory_bytes = (uint64_t)lua_gc(lua_state, LUA_GCCOUNT, 0) * 1024 + lua_gc(lua_state, LUA_GCCOUNTB, 0);
+    app_metrics::set(slot.lua_memory_bytes, memory_bytes);
+    app_metrics::set_max(slot.lua_memory_max_bytes, memory_bytes);
+}
+
+// GC哨兵的__gc 计一轮后再放出一个新的哨兵 下一轮回收时再次触发
+static int lua_plugin_gc_sentinel(lua_State *lua_state)
+{
+    app_metrics::thread_slot *slot = (app_metrics::thread_slot *)lua_touserdata(lua_state, lua_upvalueindex(1));
+    app_metrics::add(slot->lua_gc_cycles_total);
+    lua_newuserdata(lua_state, 1);
+    lua_getmetatable(lua_state, 1);
+    lua_setmetatable(lua_state, -2);
+    lua_pop(lua_state, 1);
+    return 0;
+}
+
+// 虚拟机创建后调用 GC轮数写入该线程的指标槽位
+static void lua_plugin_watch_gc(app_metrics::thread_slot &slot, lua_State *lua_state)
+{
+    lua_newuserdata(lua_state, 1);
+    lua_newtable(lua_state);
+    lua_pushlightuserdata(lua_state, &slot);
+    lua_pushcclosure(lua_state, lua_plugin_gc_sentinel, 1);
+    lua_setfield(lua_state, -2, "__gc");
+    lua_setmetatable(lua_state, -2);
+    lua_pop(lua_state, 1);
+}
+
+// 空间索引查询结果写入out[1..n] 并置out[n+1]=nil 调用方可复用out避免每次分配
+static void lua_plugin_fill_handles(lua_State *lua_state, int out_idx, const std::vector<int> &handles)
+{
+    for (size_t i = 0; i < handles.size(); ++i)
+    {
+        lua_pushinteger(lua_state, handles[i]);
+        lua_rawseti(lua_state, out_idx, i + 1);
+    }
+    lua_pushnil(lua_state);
+    lua_rawseti(lua_state, out_idx, handles.size() + 1);
+}
+
+// 读出idx处的handle数组
+static void lua_plugin_read_handles(lua_State *lua_state, int idx, std::vector<int> &handles)
+{
+    handles.clear();
+    const int cnt = lua_rawlen(lua_state, idx);
+    for (int i = 1; i <= cnt; ++i)
+    {
+        lua_rawgeti(lua_state, idx, i);
+        handles.push_back(lua_tointeger(lua_state, -1));
+        lua_pop(lua_state, 1);
+    }
+}
+
+// 输入抖动缓冲统计 applied, late, dropped, duplicate, skipped
+static int lua_plugin_push_input_stat(lua_State *lua_state, const map_input_buffer::stat &stat)
+{
+    lua_pushinteger(lua_state, stat.applied);
+    lua_pushinteger(lua_state, stat.late);
+    lua_pushinteger(lua_state, stat.dropped);
+    lua_pushinteger(lua_state, stat.duplicate);
+    lua_pushinteger(lua_state, stat.skipped);
+    return 5;
+}
+
+// 流场的网格已销毁或已变化时视为失效 旧版本的场要等下一次未命中才真正丢弃
+static const map_flow_field_cache::field *lua_plugin_find_flow_field(int field_id)
+{
+    const map_flow_field_cache::field *field = singleton<map_flow_field_cache>::instance()->find(field_id);
+    if (!field)
+    {
+        return nullptr;
+    }
+    const map_tile_grid *grid = singleton<map_tile_grid_mgr>::instance()->get(field->grid_id);
+    return grid && grid->get_version() == field->version ? field : nullptr;
+}
+
 void lua_plugin::lua_plugin_lua_return_not_is_ok_print_error(int isok, lua_State *lua_state)
 {
     if (isok != LUA_OK)
@@ -187,6 +286,8 @@ void lua_plugin::on_main_init(const std::string &lua_dir, const std::string &app
     this->lua_dir = lua_dir;
     this->app_id = app_id;
 
+    singleton<app_metrics>::instance()->init(worker_cnt);
+
     // init worker lua vm
     {
         this->worker_lua_cnt = worker_cnt;
@@ -208,6 +309,7 @@ void lua_plugin::real_on_main_init()
     {
         this->lua_state = luaL_newstate();
         luaL_openlibs(this->lua_state);
+        lua_plugin_watch_gc(singleton<app_metrics>::instance()->main_slot(), this->lua_state);
         main_mount();
         std::string filename = this->lua_dir + "/Init.lua";
         int isok = luaL_dofile(this->lua_state, filename.data());
@@ -246,10 +348,12 @@ void lua_plugin::on_main_tick()
         return;
     }
 
+    auto tick_begin = std::chrono::steady_clock::now();
     int old_lua_stack_size = lua_gettop(this->lua_state);
     exe_OnMainTick();
     int new_lua_stack_size = lua_gettop(this->lua_state);
     ASSERT_LOG_EXIT(old_lua_stack_size == new_lua_stack_size);
+    lua_plugin_observe_tick(singleton<app_metrics>::instance()->main_slot(), this->lua_state, tick_begin);
 }
 
 void lua_plugin::on_worker_init(int worker_idx)
@@ -257,6 +361,7 @@ void lua_plugin::on_worker_init(int worker_idx)
     {
         this->worker_lua_state[worker_idx] = luaL_newstate();
         luaL_openlibs(this->worker_lua_state[worker_idx]);
+        lua_plugin_watch_gc(singleton<app_metrics>::instance()->worker_slot(worker_idx), this->worker_lua_state[worker_idx]);
         worker_mount(worker_idx);
         std::string filename = this->lua_dir + "/Init.lua";
         int isok = luaL_dofile(this->worker_lua_state[worker_idx], filename.data());
@@ -293,10 +398,12 @@ void lua_plugin::on_worker_tick(int worker_idx)
         return;
     }
 
+    auto tick_begin = std::chrono::steady_clock::now();
     int old_lua_stack_size = lua_gettop(this->worker_lua_state[worker_idx]);
     exe_OnWorkerTick(worker_idx);
     int new_lua_stack_size = lua_gettop(this->worker_lua_state[worker_idx]);
     ASSERT_LOG_EXIT(old_lua_stack_size == new_lua_stack_size);
+    lua_plugin_observe_tick(singleton<app_metrics>::instance()->worker_slot(worker_idx), this->worker_lua_state[worker_idx], tick_begin);
 }
 
 void lua_plugin::exe_OnMainInit()
@@ -487,6 +594,7 @@ void lua_plugin::on_other_lua_vm_recv_client_message(int cmd,
                                                      uint64_t gid,
                                                      int worker_idx)
 {
+    app_metrics::add_cmd(singleton<app_metrics>::instance()->other_slot().cmd_recv_total, cmd);
     exe_OnLuaVMRecvMessage(this->other_lua_state,
                            1,
                            cmd,
@@ -498,15 +606,34 @@ void lua_plugin::on_other_lua_vm_recv_client_message(int cmd,
 
 void lua_plugin::on_other_lua_vm_recv_ipc_message(int cmd,
                                                   const google::protobuf::Message &package,
-                                                  const std::string &app_id)
+                                                  int peer_handle,
+                                                  uint64_t rpc_id)
 {
+    app_metrics::add_cmd(singleton<app_metrics>::instance()->other_slot().cmd_recv_total, cmd);
+    static const std::string empty_str_param3;
     exe_OnLuaVMRecvMessage(this->other_lua_state,
                            2,
                            cmd,
                            package,
-                           0,
-                           0,
-                           app_id);
+                           rpc_id,
+                           peer_handle,
+                           empty_str_param3);
+}
+
+void lua_plugin::on_other_lua_vm_recv_ipc_request(int cmd,
+                                                  const google::protobuf::Message &package,
+                                                  int peer_handle,
+                                                  uint64_t rpc_id)
+{
+    app_metrics::add_cmd(singleton<app_metrics>::instance()->other_slot().cmd_recv_total, cmd);
+    static const std::string empty_str_param3;
+    exe_OnLuaVMRecvMessage(this->other_lua_state,
+                           4,
+                           cmd,
+                           package,
+                           rpc_id,
+                           peer_handle,
+                           empty_str_param3);
 }
 
 void lua_plugin::on_other_lua_vm_recv_udp_message(int cmd,
@@ -514,6 +641,7 @@ void lua_plugin::on_other_lua_vm_recv_udp_message(int cmd,
                                                   const std::string &from_ip,
                                                   int from_port)
 {
+    app_metrics::add_cmd(singleton<app_metrics>::instance()->other_slot().cmd_recv_total, cmd);
     exe_OnLuaVMRecvMessage(this->other_lua_state,
                            3,
                            cmd,
@@ -523,12 +651,98 @@ void lua_plugin::on_other_lua_vm_recv_udp_message(int cmd,
                            from_ip);
 }
 
+int lua_plugin::on_worker_lua_vm_http_request(int worker_idx,
+                                              uint64_t gid,
+                                              const std::string &method,
+                                              const std::string &path,
+                                              const std::unordered_map<std::string, std::vector<std::string>> &headers,
+                                              const std::string &body,
+                                              std::vector<std::pair<std::string, std::string>> &out_headers,
+                                              std::string &out_body,
+                                              bool &out_stream)
+{
+    lua_State *lua_ptr = this->worker_lua_state[worker_idx];
+    int old_lua_stack_size = lua_gettop(lua_ptr);
+
+    // 添加错误处理函数
+    int err_msgh = lua_plugin_push_lua_error_handler(lua_ptr);
+    lua_getglobal(lua_ptr, "OnHttpRequest");
+
+    lua_pushinteger(lua_ptr, worker_idx);
+    lua_pushstring(lua_ptr, std::to_string(gid).c_str());
+    lua_pushlstring(lua_ptr, method.c_str(), method.size());
+    lua_pushlstring(lua_ptr, path.c_str(), path.size());
+    // 同名header以", "拼接
+    lua_newtable(lua_ptr);
+    for (const auto &header : headers)
+    {
+        std::string value;
+        for (const auto &item : header.second)
+        {
+            value += value.empty() ? item : ", " + item;
+        }
+        lua_pushlstring(lua_ptr, value.c_str(), value.size());
+        lua_setfield(lua_ptr, -2, header.first.c_str());
+    }
+    lua_pushlstring(lua_ptr, body.c_str(), body.size());
+
+    // 返回 status, headers, body
+    int isok = lua_pcall(lua_ptr, 6, 3, err_msgh);
+    // 移除错误处理函数
+    lua_remove(lua_ptr, err_msgh);
+    if (isok != LUA_OK)
+    {
+        // 请求来自外部 脚本出错只回500 不退出进程
+        lua_pop(lua_ptr, 1); // 弹出错误信息
+        ASSERT_LOG_EXIT(old_lua_stack_size == lua_gettop(lua_ptr));
+        return 500;
+    }
+
+    int status = 0;
+    if (lua_isnumber(lua_ptr, -3))
+    {
+        status = lua_tointeger(lua_ptr, -3);
+    }
+    if (status != 0 && lua_istable(lua_ptr, -2))
+    {
+        lua_pushnil(lua_ptr);
+        while (lua_next(lua_ptr, -3))
+        {
+            // 不对key调用lua_tostring 避免数字key被原地转换打乱lua_next
+            if (lua_type(lua_ptr, -2) == LUA_TSTRING && lua_isstring(lua_ptr, -1))
+            {
+                out_headers.emplace_back(lua_tostring(lua_ptr, -2), lua_tostring(lua_ptr, -1));
+            }
+            lua_pop(lua_ptr, 1);
+        }
+    }
+    out_stream = false;
+    if (status != 0)
+    {
+        if (lua_isstring(lua_ptr, -1))
+        {
+            size_t len = 0;
+            const char *data = lua_tolstring(lua_ptr, -1, &len);
+            out_body.assign(data, len);
+        }
+        else
+        {
+            out_stream = lua_isnil(lua_ptr, -1);
+        }
+    }
+    lua_pop(lua_ptr, 3);
+
+    ASSERT_LOG_EXIT(old_lua_stack_size == lua_gettop(lua_ptr));
+    return status;
+}
+
 void lua_plugin::on_other_init(avant::workers::other *ptr_other_obj)
 {
     this->ptr_other_obj = ptr_other_obj;
     {
         this->other_lua_state = luaL_newstate();
         luaL_openlibs(this->other_lua_state);
+        lua_plugin_watch_gc(singleton<app_metrics>::instance()->other_slot(), this->other_lua_state);
 #if LUA_PLUGIN_LUAOPEN_EMMY_CORE
         // 加载 emmy_core 模块
         luaL_requiref(this->other_lua_state, "emmy_core", luaopen_emmy_core, 1);
@@ -571,198 +785,2734 @@ void lua_plugin::on_other_tick()
         return;
     }
 
-    int old_lua_stack_size = lua_gettop(this->other_lua_state);
-    exe_OnOtherTick();
-    int new_lua_stack_size = lua_gettop(this->other_lua_state);
-    ASSERT_LOG_EXIT(old_lua_stack_size == new_lua_stack_size);
+    auto tick_begin = std::chrono::steady_clock::now();
+    int old_lua_stack_size = lua_gettop(this->other_lua_state);
+    exe_OnOtherTick();
+    int new_lua_stack_size = lua_gettop(this->other_lua_state);
+    ASSERT_LOG_EXIT(old_lua_stack_size == new_lua_stack_size);
+    lua_plugin_observe_tick(singleton<app_metrics>::instance()->other_slot(), this->other_lua_state, tick_begin);
+}
+
+void lua_plugin::exe_OnOtherInit()
+{
+    static int isok = LUA_OK;
+    // 添加错误处理函数
+    int err_msgh = lua_plugin_push_lua_error_handler(this->other_lua_state);
+    lua_getglobal(this->other_lua_state, "OnOtherInit");
+
+    isok = lua_pcall(this->other_lua_state, 0, 0, err_msgh);
+    // 移除错误处理函数
+    lua_remove(this->other_lua_state, err_msgh);
+    ASSERT_LOG_EXIT(isok == LUA_OK);
+}
+
+void lua_plugin::exe_OnOtherStop()
+{
+    static int isok = LUA_OK;
+    // 添加错误处理函数
+    int err_msgh = lua_plugin_push_lua_error_handler(this->other_lua_state);
+    lua_getglobal(this->other_lua_state, "OnOtherStop");
+
+    isok = lua_pcall(this->other_lua_state, 0, 0, err_msgh);
+    // 移除错误处理函数
+    lua_remove(this->other_lua_state, err_msgh);
+    ASSERT_LOG_EXIT(isok == LUA_OK);
+}
+
+void lua_plugin::exe_OnOtherTick()
+{
+    static int isok = LUA_OK;
+    // 添加错误处理函数
+    int err_msgh = lua_plugin_push_lua_error_handler(this->other_lua_state);
+    lua_getglobal(this->other_lua_state, "OnOtherTick");
+
+    isok = lua_pcall(this->other_lua_state, 0, 0, err_msgh);
+    // 移除错误处理函数
+    lua_remove(this->other_lua_state, err_msgh);
+    ASSERT_LOG_EXIT(isok == LUA_OK);
+}
+
+void lua_plugin::exe_OnOtherReload()
+{
+    static int isok = LUA_OK;
+    // 添加错误处理函数
+    int err_msgh = lua_plugin_push_lua_error_handler(this->other_lua_state);
+    lua_getglobal(this->other_lua_state, "OnOtherReload");
+
+    isok = lua_pcall(this->other_lua_state, 0, 0, err_msgh);
+    // 移除错误处理函数
+    lua_remove(this->other_lua_state, err_msgh);
+    ASSERT_LOG_EXIT(isok == LUA_OK);
+}
+
+void lua_plugin::main_mount()
+{
+    static luaL_Reg main_lulibs[] = {
+        {"Logger", Logger},
+        {"Lua2Protobuf", Lua2Protobuf},
+        {"CreateNewProtobufByCmd", CreateNewProtobufByCmd},
+        {"HighresTime", HighresTime},
+        {"Monotonic", Monotonic},
+        {NULL, NULL}};
+    {
+        // mount main lua vm
+        luaL_newlib(this->lua_state, main_lulibs);
+
+        lua_pushstring(this->lua_state, this->lua_dir.c_str());
+        lua_setfield(this->lua_state, -2, "LuaDir");
+
+        lua_pushstring(this->lua_state, this->app_id.c_str());
+        lua_setfield(this->lua_state, -2, "AppID");
+
+        lua_setglobal(this->lua_state, "avant");
+    }
+}
+
+void lua_plugin::worker_mount(int worker_idx)
+{
+    static luaL_Reg worker_lulibs[] = {
+        {"Logger", Logger},
+        {"Lua2Protobuf", Lua2Protobuf},
+        {"CreateNewProtobufByCmd", CreateNewProtobufByCmd},
+        {"HighresTime", HighresTime},
+        {"Monotonic", Monotonic},
+        {"HttpSetAPIPrefix", HttpSetAPIPrefix},
+        {"HttpWrite", HttpWrite},
+        {"HttpEnd", HttpEnd},
+        {NULL, NULL}};
+    luaL_newlib(this->worker_lua_state[worker_idx], worker_lulibs);
+
+    lua_pushstring(this->worker_lua_state[worker_idx], this->lua_dir.c_str());
+    lua_setfield(this->worker_lua_state[worker_idx], -2, "LuaDir");
+
+    lua_pushstring(this->worker_lua_state[worker_idx], this->app_id.c_str());
+    lua_setfield(this->worker_lua_state[worker_idx], -2, "AppID");
+
+    lua_setglobal(this->worker_lua_state[worker_idx], "avant");
+}
+
+void lua_plugin::other_mount()
+{
+    static luaL_Reg other_lulibs[] = {
+        {"Logger", Logger},
+        {"Lua2Protobuf", Lua2Protobuf},
+        {"CreateNewProtobufByCmd", CreateNewProtobufByCmd},
+        {"HighresTime", HighresTime},
+        {"Monotonic", Monotonic},
+        {"UDPSessionCreate", UDPSessionCreate},
+        {"UDPSessionSetCmdMode", UDPSessionSetCmdMode},
+        {"GetIPCPeerHandle", GetIPCPeerHandle},
+        {"IPCCall", IPCCall},
+        {"IPCReply", IPCReply},
+        {"QuadTreeCreate", QuadTreeCreate},
+        {"QuadTreeDestroy", QuadTreeDestroy},
+        {"QuadTreeInsert", QuadTreeInsert},
+        {"QuadTreeUpdate", QuadTreeUpdate},
+        {"QuadTreeRemove", QuadTreeRemove},
+        {"QuadTreeQuery", QuadTreeQuery},
+        {"VoxelIndexCreate", VoxelIndexCreate},
+        {"VoxelIndexDestroy", VoxelIndexDestroy},
+        {"VoxelIndexInsert", VoxelIndexInsert},
+        {"VoxelIndexUpdate", VoxelIndexUpdate},
+        {"VoxelIndexRemove", VoxelIndexRemove},
+        {"VoxelIndexQueryBox", VoxelIndexQueryBox},
+        {"VoxelIndexQuerySphere", VoxelIndexQuerySphere},
+        {"VoxelIndexQueryNearest", VoxelIndexQueryNearest},
+        {"AOICreate", AOICreate},
+        {"AOIDestroy", AOIDestroy},
+        {"AOIInsert", AOIInsert},
+        {"AOIUpdate", AOIUpdate},
+        {"AOIRemove", AOIRemove},
+        {"AOIFlush", AOIFlush},
+        {"AOIFetch", AOIFetch},
+        {"SnapshotCreate", SnapshotCreate},
+        {"SnapshotDestroy", SnapshotDestroy},
+        {"SnapshotSetEntity", SnapshotSetEntity},
+        {"SnapshotSetState", SnapshotSetState},
+        {"SnapshotRemove", SnapshotRemove},
+        {"SnapshotAck", SnapshotAck},
+        {"SnapshotSetClient", SnapshotSetClient},
+        {"SnapshotSetLOD", SnapshotSetLOD},
+        {"SnapshotLODStat", SnapshotLODStat},
+        {"SnapshotSend", SnapshotSend},
+        {"PhysicsCreate", PhysicsCreate},
+        {"PhysicsDestroy", PhysicsDestroy},
+        {"PhysicsAdd", PhysicsAdd},
+        {"PhysicsRemove", PhysicsRemove},
+        {"PhysicsSetCollision", PhysicsSetCollision},
+        {"PhysicsSetInput", PhysicsSetInput},
+        {"PhysicsPushInput", PhysicsPushInput},
+        {"PhysicsSetInputDelay", PhysicsSetInputDelay},
+        {"PhysicsInputStat", PhysicsInputStat},
+        {"PhysicsGet", PhysicsGet},
+        {"PhysicsExport", PhysicsExport},
+        {"PhysicsImport", PhysicsImport},
+        {"PhysicsStep", PhysicsStep},
+        {"MapSimCreate", MapSimCreate},
+        {"MapSimDestroy", MapSimDestroy},
+        {"MapSimSetThreads", MapSimSetThreads},
+        {"MapSimTick", MapSimTick},
+        {"MapSimStat", MapSimStat},
+        {"TileGridCreate", TileGridCreate},
+        {"TileGridLoad", TileGridLoad},
+        {"TileGridSave", TileGridSave},
+        {"TileGridDestroy", TileGridDestroy},
+        {"TileGridInfo", TileGridInfo},
+        {"TileGridGetTile", TileGridGetTile},
+        {"TileGridSetTile", TileGridSetTile},
+        {"TileGridSetWalkable", TileGridSetWalkable},
+        {"TileGridIsWalkable", TileGridIsWalkable},
+        {"TileGridRaycast", TileGridRaycast},
+        {"PathFind", PathFind},
+        {"PathFindStat", PathFindStat},
+        {"HPACreate", HPACreate},
+        {"HPADestroy", HPADestroy},
+        {"HPAUpdate", HPAUpdate},
+        {"HPAFindPath", HPAFindPath},
+        {"HPAPoll", HPAPoll},
+        {"HPAInfo", HPAInfo},
+        {"FlowFieldGet", FlowFieldGet},
+        {"FlowFieldDir", FlowFieldDir},
+        {"FlowFieldDirs", FlowFieldDirs},
+        {"FlowFieldStat", FlowFieldStat},
+        {"InputBufferCreate", InputBufferCreate},
+        {"InputBufferDestroy", InputBufferDestroy},
+        {"InputBufferRemove", InputBufferRemove},
+        {"InputBufferPush", InputBufferPush},
+        {"InputBufferStep", InputBufferStep},
+        {"InputBufferStat", InputBufferStat},
+        {"FSFrameStoreCreate", FSFrameStoreCreate},
+        {"FSFrameStoreDestroy", FSFrameStoreDestroy},
+        {"FSFrameStoreAppend", FSFrameStoreAppend},
+        {"FSFrameStoreSince", FSFrameStoreSince},
+        {"FSFrameStoreSendSince", FSFrameStoreSendSince},
+        {"FSFrameStoreStat", FSFrameStoreStat},
+        {"FSBroadcastCreate", FSBroadcastCreate},
+        {"FSBroadcastDestroy", FSBroadcastDestroy},
+        {"FSBroadcastSend", FSBroadcastSend},
+        {"FSBroadcastStat", FSBroadcastStat},
+        {NULL, NULL}};
+    {
+        luaL_newlib(this->other_lua_state, other_lulibs);
+
+        lua_pushstring(this->other_lua_state, this->lua_dir.c_str());
+        lua_setfield(this->other_lua_state, -2, "LuaDir");
+
+        lua_pushstring(this->other_lua_state, this->app_id.c_str());
+        lua_setfield(this->other_lua_state, -2, "AppID");
+
+        lua_setglobal(this->other_lua_state, "avant");
+    }
+}
+
+// 返回三个值：1) seconds (integer), 2) milliseconds (integer), 3) nanoseconds_part (integer)
+int lua_plugin::HighresTime(lua_State *lua_state)
+{
+    using namespace std::chrono;
+    auto now = system_clock::now();
+    auto ns = duration_cast<nanoseconds>(now.time_since_epoch()).count();
+    auto seconds = ns / 1000000000;
+    auto nanoseconds_part = ns % 1000000000;
+    auto milliseconds = ns / 1000000;
+    lua_pushnumber(lua_state, seconds); // push seconds
+    lua_pushnumber(lua_state, milliseconds); // push milliseconds
+    lua_pushnumber(lua_state, nanoseconds_part); // pushes nanoseconds_part
+    return 3;
+}
+
+// 返回单个值：monotonic milliseconds (integer)
+int lua_plugin::Monotonic(lua_State *lua_state)
+{
+    using namespace std::chrono;
+    auto now = steady_clock::now();
+    auto ms = duration_cast<milliseconds>(now.time_since_epoch()).count();
+    lua_pushnumber(lua_state, ms);
+    return 1;
+}
+
+// avant.UDPSessionCreate(clientGID, workerIdx) -> udpToken:string
+// 为客户端连接创建UDP会话 连接断开时自动移除
+int lua_plugin::UDPSessionCreate(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 2);
+
+    int isok = lua_isnumber(lua_state, 2); // workerIdx
+    ASSERT_LOG_EXIT(isok);
+    isok = lua_isstring(lua_state, 1); // clientGID
+    ASSERT_LOG_EXIT(isok);
+
+    int worker_idx = lua_tointeger(lua_state, 2);
+    uint64_t gid = std::stoull(std::string(lua_tostring(lua_state, 1)));
+    lua_pop(lua_state, 2);
+
+    uint64_t token = singleton<udp_session_mgr>::instance()->create_session(gid, worker_idx);
+    lua_pushstring(lua_state, std::to_string(token).c_str());
+    return 1;
+}
+
+// avant.UDPSessionSetCmdMode(cmd, ProtoUDPCmdMode)
+// 配置发给客户端的cmd走哪条通道 未配置的走TCP
+int lua_plugin::UDPSessionSetCmdMode(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 2);
+
+    int isok = lua_isnumber(lua_state, 2); // mode
+    ASSERT_LOG_EXIT(isok);
+    isok = lua_isnumber(lua_state, 1); // cmd
+    ASSERT_LOG_EXIT(isok);
+
+    int mode = lua_tointeger(lua_state, 2);
+    int cmd = lua_tointeger(lua_state, 1);
+    lua_pop(lua_state, 2);
+
+    if (!ProtoUDPCmdMode_IsValid(mode))
+    {
+        LOG_ERROR("UDPSessionSetCmdMode unknow mode {} cmd {}", mode, cmd);
+        lua_pushinteger(lua_state, -1);
+        return 1;
+    }
+
+    singleton<udp_session_mgr>::instance()->set_cmd_mode(cmd, (ProtoUDPCmdMode)mode);
+    lua_pushinteger(lua_state, 0);
+    return 1;
+}
+
+// avant.GetIPCPeerHandle(appId) -> peerHandle:integer
+// app_id到IPC对端handle 同一app_id在进程内handle不变
+int lua_plugin::GetIPCPeerHandle(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 1);
+
+    int isok = lua_isstring(lua_state, 1); // appId
+    ASSERT_LOG_EXIT(isok);
+
+    size_t len = 0;
+    const char *app_id = lua_tolstring(lua_state, 1, &len);
+    int peer_handle = avant::app::other_app::other_lua_get_ipc_peer_handle(std::string(app_id, len));
+    lua_pop(lua_state, 1);
+
+    lua_pushinteger(lua_state, peer_handle);
+    return 1;
+}
+
+// avant.HttpSetAPIPrefix(prefix) 以该前缀开头的HTTP请求交给本worker的OnHttpRequest 空串关闭
+int lua_plugin::HttpSetAPIPrefix(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 1);
+
+    int isok = lua_isstring(lua_state, 1); // prefix
+    ASSERT_LOG_EXIT(isok);
+
+    size_t len = 0;
+    const char *prefix = lua_tolstring(lua_state, 1, &len);
+    avant::app::http_app::worker_lua_set_http_api_prefix(std::string(prefix, len));
+    lua_pop(lua_state, 1);
+
+    lua_pushinteger(lua_state, 0);
+    return 1;
+}
+
+// avant.HttpWrite(connGID, data) -> boolean 向流式响应追加一段数据
+int lua_plugin::HttpWrite(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 2);
+
+    int isok = lua_isstring(lua_state, 2); // data
+    ASSERT_LOG_EXIT(isok);
+    isok = lua_isstring(lua_state, 1); // connGID
+    ASSERT_LOG_EXIT(isok);
+
+    size_t len = 0;
+    const char *data = lua_tolstring(lua_state, 2, &len);
+    uint64_t gid = std::stoull(std::string(lua_tostring(lua_state, 1)));
+    bool ok = avant::app::http_app::worker_lua_http_write(gid, data, len);
+    lua_pop(lua_state, 2);
+
+    lua_pushboolean(lua_state, ok);
+    return 1;
+}
+
+// avant.HttpEnd(connGID) -> boolean 结束流式响应
+int lua_plugin::HttpEnd(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 1);
+
+    int isok = lua_isstring(lua_state, 1); // connGID
+    ASSERT_LOG_EXIT(isok);
+
+    uint64_t gid = std::stoull(std::string(lua_tostring(lua_state, 1)));
+    bool ok = avant::app::http_app::worker_lua_http_end(gid);
+    lua_pop(lua_state, 1);
+
+    lua_pushboolean(lua_state, ok);
+    return 1;
+}
+
+// avant.IPCCall(message, cmd, peerHandle, timeoutMs) -> rpcId:string|nil
+// 发出IPC RPC请求 应答或PROTO_CMD_IPC_RPC_TIMEOUT以rpcId回到OnLuaVMRecvMessage
+int lua_plugin::IPCCall(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 4);
+
+    int isok = lua_isnumber(lua_state, 4); // timeoutMs
+    ASSERT_LOG_EXIT(isok);
+    isok = lua_isnumber(lua_state, 3); // peerHandle
+    ASSERT_LOG_EXIT(isok);
+    isok = lua_isnumber(lua_state, 2); // cmd
+    ASSERT_LOG_EXIT(isok);
+    isok = lua_istable(lua_state, 1); // message
+    ASSERT_LOG_EXIT(isok);
+
+    // 负数转成uint64_t会变成几乎永不超时
+    lua_Integer timeout_arg = lua_tointeger(lua_state, 4);
+    ASSERT_LOG_EXIT(timeout_arg > 0);
+    uint64_t timeout_ms = (uint64_t)timeout_arg;
+    int peer_handle = lua_tointeger(lua_state, 3);
+    int cmd = lua_tointeger(lua_state, 2);
+    lua_pop(lua_state, 3);
+
+    uint64_t rpc_id = 0;
+    std::shared_ptr<google::protobuf::Message> msg_ptr = singleton<lua_plugin>::instance()->protobuf_cmd2message(cmd);
+    if (msg_ptr)
+    {
+        int old_lua_stack_size = lua_gettop(lua_state);
+        lua2protobuf_nostack(lua_state, *msg_ptr);
+        int new_lua_stack_size = lua_gettop(lua_state);
+        ASSERT_LOG_EXIT(old_lua_stack_size == new_lua_stack_size);
+
+        rpc_id = avant::app::other_app::other_lua_call_ipc_rpc(peer_handle, cmd, *msg_ptr, timeout_ms);
+    }
+    else
+    {
+        LOG_ERROR("IPCCall protobuf_cmd2message({}) return nullptr", cmd);
+    }
+
+    lua_pop(lua_state, 1); // 弹出message
+    if (rpc_id == 0)
+    {
+        lua_pushnil(lua_state);
+    }
+    else
+    {
+        lua_pushstring(lua_state, std::to_string(rpc_id).c_str());
+    }
+    return 1;
+}
+
+// avant.IPCReply(rpcId, message, cmd, peerHandle) -> boolean
+// 应答对端发来的IPC RPC请求 rpcId为请求到达时OnLuaVMRecvMessage带来的序号
+int lua_plugin::IPCReply(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 4);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 4)); // peerHandle
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 3)); // cmd
+    ASSERT_LOG_EXIT(lua_istable(lua_state, 2));  // message
+    ASSERT_LOG_EXIT(lua_isstring(lua_state, 1)); // rpcId
+
+    uint64_t rpc_id = std::strtoull(lua_tostring(lua_state, 1), nullptr, 10);
+    int cmd = lua_tointeger(lua_state, 3);
+    int peer_handle = lua_tointeger(lua_state, 4);
+    lua_pop(lua_state, 2);
+
+    bool ok = false;
+    std::shared_ptr<google::protobuf::Message> msg_ptr = singleton<lua_plugin>::instance()->protobuf_cmd2message(cmd);
+    if (msg_ptr)
+    {
+        int old_lua_stack_size = lua_gettop(lua_state);
+        lua2protobuf_nostack(lua_state, *msg_ptr);
+        int new_lua_stack_size = lua_gettop(lua_state);
+        ASSERT_LOG_EXIT(old_lua_stack_size == new_lua_stack_size);
+
+        ok = avant::app::other_app::other_lua_reply_ipc_rpc(peer_handle, cmd, *msg_ptr, rpc_id);
+    }
+    else
+    {
+        LOG_ERROR("IPCReply protobuf_cmd2message({}) return nullptr", cmd);
+    }
+
+    lua_pop(lua_state, 2); // 弹出message与rpcId
+    lua_pushboolean(lua_state, ok);
+    return 1;
+}
+
+int lua_plugin::Logger(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 1);
+
+    int isok = LUA_OK;
+    isok = lua_isstring(lua_state, 1);
+    ASSERT_LOG_EXIT(isok);
+
+    size_t len = 0;
+    const char *type = lua_tolstring(lua_state, 1, &len);
+    std::string str(type, len);
+    LOG_ERROR("lua => {}", str.data());
+    lua_pop(lua_state, 1);
+    lua_pushinteger(lua_state, 0);
+    return 1;
+}
+
+// avant.CreateNewProtobufByCmd(Cmd) -> table:Message|nil
+int lua_plugin::CreateNewProtobufByCmd(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 1);
+
+    int isok = lua_isnumber(lua_state, 1);
+    ASSERT_LOG_EXIT(isok);
+
+    int cmd = lua_tonumber(lua_state, 1);
+    lua_pop(lua_state, 1); // pop cmd
+
+    std::shared_ptr<google::protobuf::Message> msg_ptr = singleton<lua_plugin>::instance()->protobuf_cmd2message(cmd);
+    if (msg_ptr) // return table:message
+    {
+        int old_lua_stack_size = lua_gettop(lua_state);
+        protobuf2lua_nostack(lua_state, *msg_ptr);
+        int new_lua_stack_size = lua_gettop(lua_state);
+        ASSERT_LOG_EXIT(old_lua_stack_size == new_lua_stack_size - 1);
+    }
+    else // return nil
+    {
+        lua_pushnil(lua_state);
+    }
+
+    return 1; // return one variable
+}
+
+// avant.QuadTreeCreate(x, y, w, h, maxDepth, leafCapacity) -> treeId
+int lua_plugin::QuadTreeCreate(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 6);
+    for (int i = 1; i <= 6; ++i)
+    {
+        ASSERT_LOG_EXIT(lua_isnumber(lua_state, i));
+    }
+
+    double x = lua_tonumber(lua_state, 1);
+    double y = lua_tonumber(lua_state, 2);
+    double w = lua_tonumber(lua_state, 3);
+    double h = lua_tonumber(lua_state, 4);
+    int max_depth = lua_tointeger(lua_state, 5);
+    int leaf_capacity = lua_tointeger(lua_state, 6);
+    lua_pop(lua_state, 6);
+
+    int tree_id = singleton<map_quadtree_mgr>::instance()->create(x, y, w, h, max_depth, leaf_capacity);
+    lua_pushinteger(lua_state, tree_id);
+    return 1;
+}
+
+// avant.QuadTreeDestroy(treeId) -> integer
+int lua_plugin::QuadTreeDestroy(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 1);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // treeId
+
+    int tree_id = lua_tointeger(lua_state, 1);
+    lua_pop(lua_state, 1);
+
+    singleton<map_quadtree_mgr>::instance()->destroy(tree_id);
+    lua_pushinteger(lua_state, 0);
+    return 1;
+}
+
+// avant.QuadTreeInsert(treeId, x, y, radius) -> handle|nil
+int lua_plugin::QuadTreeInsert(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 4);
+    for (int i = 1; i <= 4; ++i)
+    {
+        ASSERT_LOG_EXIT(lua_isnumber(lua_state, i));
+    }
+
+    int tree_id = lua_tointeger(lua_state, 1);
+    double x = lua_tonumber(lua_state, 2);
+    double y = lua_tonumber(lua_state, 3);
+    double radius = lua_tonumber(lua_state, 4);
+    lua_pop(lua_state, 4);
+
+    map_quadtree *tree = singleton<map_quadtree_mgr>::instance()->get(tree_id);
+    if (!tree)
+    {
+        LOG_ERROR("QuadTreeInsert not exist treeId {}", tree_id);
+        lua_pushnil(lua_state);
+        return 1;
+    }
+    lua_pushinteger(lua_state, tree->insert(x, y, radius));
+    return 1;
+}
+
+// avant.QuadTreeUpdate(treeId, handle, x, y) -> boolean
+int lua_plugin::QuadTreeUpdate(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 4);
+    for (int i = 1; i <= 4; ++i)
+    {
+        ASSERT_LOG_EXIT(lua_isnumber(lua_state, i));
+    }
+
+    int tree_id = lua_tointeger(lua_state, 1);
+    int handle = lua_tointeger(lua_state, 2);
+    double x = lua_tonumber(lua_state, 3);
+    double y = lua_tonumber(lua_state, 4);
+    lua_pop(lua_state, 4);
+
+    map_quadtree *tree = singleton<map_quadtree_mgr>::instance()->get(tree_id);
+    lua_pushboolean(lua_state, tree && tree->update(handle, x, y));
+    return 1;
+}
+
+// avant.QuadTreeRemove(treeId, handle) -> boolean
+int lua_plugin::QuadTreeRemove(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 2);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 2)); // handle
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // treeId
+
+    int tree_id = lua_tointeger(lua_state, 1);
+    int handle = lua_tointeger(lua_state, 2);
+    lua_pop(lua_state, 2);
+
+    map_quadtree *tree = singleton<map_quadtree_mgr>::instance()->get(tree_id);
+    lua_pushboolean(lua_state, tree && tree->remove(handle));
+    return 1;
+}
+
+// avant.QuadTreeQuery(treeId, x, y, w, h, out) -> count
+int lua_plugin::QuadTreeQuery(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 6);
+    ASSERT_LOG_EXIT(lua_istable(lua_state, 6)); // out
+    for (int i = 1; i <= 5; ++i)
+    {
+        ASSERT_LOG_EXIT(lua_isnumber(lua_state, i));
+    }
+
+    int tree_id = lua_tointeger(lua_state, 1);
+    double x = lua_tonumber(lua_state, 2);
+    double y = lua_tonumber(lua_state, 3);
+    double w = lua_tonumber(lua_state, 4);
+    double h = lua_tonumber(lua_state, 5);
+
+    static std::vector<int> result;
+    result.clear();
+    map_quadtree *tree = singleton<map_quadtree_mgr>::instance()->get(tree_id);
+    if (tree)
+    {
+        tree->query(x, y, w, h, result);
+    }
+
+    lua_plugin_fill_handles(lua_state, 6, result);
+    lua_pop(lua_state, 6);
+    lua_pushinteger(lua_state, result.size());
+    return 1;
+}
+
+// avant.VoxelIndexCreate(cellSize) -> indexId
+int lua_plugin::VoxelIndexCreate(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 1);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // cellSize
+
+    double cell_size = lua_tonumber(lua_state, 1);
+    lua_pop(lua_state, 1);
+
+    int index_id = singleton<map_voxel_index_mgr>::instance()->create(cell_size);
+    lua_pushinteger(lua_state, index_id);
+    return 1;
+}
+
+// avant.VoxelIndexDestroy(indexId) -> integer
+int lua_plugin::VoxelIndexDestroy(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 1);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // indexId
+
+    int index_id = lua_tointeger(lua_state, 1);
+    lua_pop(lua_state, 1);
+
+    singleton<map_voxel_index_mgr>::instance()->destroy(index_id);
+    lua_pushinteger(lua_state, 0);
+    return 1;
+}
+
+// avant.VoxelIndexInsert(indexId, x, y, z, radius) -> handle|nil
+int lua_plugin::VoxelIndexInsert(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 5);
+    for (int i = 1; i <= 5; ++i)
+    {
+        ASSERT_LOG_EXIT(lua_isnumber(lua_state, i));
+    }
+
+    int index_id = lua_tointeger(lua_state, 1);
+    double x = lua_tonumber(lua_state, 2);
+    double y = lua_tonumber(lua_state, 3);
+    double z = lua_tonumber(lua_state, 4);
+    double radius = lua_tonumber(lua_state, 5);
+    lua_pop(lua_state, 5);
+
+    map_voxel_index *index = singleton<map_voxel_index_mgr>::instance()->get(index_id);
+    if (!index)
+    {
+        LOG_ERROR("VoxelIndexInsert not exist indexId {}", index_id);
+        lua_pushnil(lua_state);
+        return 1;
+    }
+    lua_pushinteger(lua_state, index->insert(x, y, z, radius));
+    return 1;
+}
+
+// avant.VoxelIndexUpdate(indexId, handle, x, y, z) -> boolean
+int lua_plugin::VoxelIndexUpdate(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 5);
+    for (int i = 1; i <= 5; ++i)
+    {
+        ASSERT_LOG_EXIT(lua_isnumber(lua_state, i));
+    }
+
+    int index_id = lua_tointeger(lua_state, 1);
+    int handle = lua_tointeger(lua_state, 2);
+    double x = lua_tonumber(lua_state, 3);
+    double y = lua_tonumber(lua_state, 4);
+    double z = lua_tonumber(lua_state, 5);
+    lua_pop(lua_state, 5);
+
+    map_voxel_index *index = singleton<map_voxel_index_mgr>::instance()->get(index_id);
+    lua_pushboolean(lua_state, index && index->update(handle, x, y, z));
+    return 1;
+}
+
+// avant.VoxelIndexRemove(indexId, handle) -> boolean
+int lua_plugin::VoxelIndexRemove(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 2);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 2)); // handle
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // indexId
+
+    int index_id = lua_tointeger(lua_state, 1);
+    int handle = lua_tointeger(lua_state, 2);
+    lua_pop(lua_state, 2);
+
+    map_voxel_index *index = singleton<map_voxel_index_mgr>::instance()->get(index_id);
+    lua_pushboolean(lua_state, index && index->remove(handle));
+    return 1;
+}
+
+// avant.VoxelIndexQueryBox(indexId, x, y, z, w, h, d, out) -> count
+int lua_plugin::VoxelIndexQueryBox(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 8);
+    ASSERT_LOG_EXIT(lua_istable(lua_state, 8)); // out
+    for (int i = 1; i <= 7; ++i)
+    {
+        ASSERT_LOG_EXIT(lua_isnumber(lua_state, i));
+    }
+
+    int index_id = lua_tointeger(lua_state, 1);
+    double x = lua_tonumber(lua_state, 2);
+    double y = lua_tonumber(lua_state, 3);
+    double z = lua_tonumber(lua_state, 4);
+    double w = lua_tonumber(lua_state, 5);
+    double h = lua_tonumber(lua_state, 6);
+    double d = lua_tonumber(lua_state, 7);
+
+    static std::vector<int> result;
+    result.clear();
+    map_voxel_index *index = singleton<map_voxel_index_mgr>::instance()->get(index_id);
+    if (index)
+    {
+        index->query_box(x, y, z, w, h, d, result);
+    }
+
+    lua_plugin_fill_handles(lua_state, 8, result);
+    lua_pop(lua_state, 8);
+    lua_pushinteger(lua_state, result.size());
+    return 1;
+}
+
+// avant.VoxelIndexQuerySphere(indexId, x, y, z, radius, out) -> count
+int lua_plugin::VoxelIndexQuerySphere(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 6);
+    ASSERT_LOG_EXIT(lua_istable(lua_state, 6)); // out
+    for (int i = 1; i <= 5; ++i)
+    {
+        ASSERT_LOG_EXIT(lua_isnumber(lua_state, i));
+    }
+
+    int index_id = lua_tointeger(lua_state, 1);
+    double x = lua_tonumber(lua_state, 2);
+    double y = lua_tonumber(lua_state, 3);
+    double z = lua_tonumber(lua_state, 4);
+    double radius = lua_tonumber(lua_state, 5);
+
+    static std::vector<int> result;
+    result.clear();
+    map_voxel_index *index = singleton<map_voxel_index_mgr>::instance()->get(index_id);
+    if (index)
+    {
+        index->query_sphere(x, y, z, radius, result);
+    }
+
+    lua_plugin_fill_handles(lua_state, 6, result);
+    lua_pop(lua_state, 6);
+    lua_pushinteger(lua_state, result.size());
+    return 1;
+}
+
+// avant.VoxelIndexQueryNearest(indexId, x, y, z, k, maxDist, out) -> count
+// out按距离从近到远 maxDist<=0不限距离
+int lua_plugin::VoxelIndexQueryNearest(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 7);
+    ASSERT_LOG_EXIT(lua_istable(lua_state, 7)); // out
+    for (int i = 1; i <= 6; ++i)
+    {
+        ASSERT_LOG_EXIT(lua_isnumber(lua_state, i));
+    }
+
+    int index_id = lua_tointeger(lua_state, 1);
+    double x = lua_tonumber(lua_state, 2);
+    double y = lua_tonumber(lua_state, 3);
+    double z = lua_tonumber(lua_state, 4);
+    int k = lua_tointeger(lua_state, 5);
+    double max_dist = lua_tonumber(lua_state, 6);
+
+    static std::vector<int> result;
+    result.clear();
+    map_voxel_index *index = singleton<map_voxel_index_mgr>::instance()->get(index_id);
+    if (index)
+    {
+        index->query_nearest(x, y, z, k, max_dist, result);
+    }
+
+    lua_plugin_fill_handles(lua_state, 7, result);
+    lua_pop(lua_state, 7);
+    lua_pushinteger(lua_state, result.size());
+    return 1;
+}
+
+// avant.AOICreate(x, y, w, h, enterRange, leaveRange) -> aoiId
+int lua_plugin::AOICreate(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 6);
+    for (int i = 1; i <= 6; ++i)
+    {
+        ASSERT_LOG_EXIT(lua_isnumber(lua_state, i));
+    }
+
+    double x = lua_tonumber(lua_state, 1);
+    double y = lua_tonumber(lua_state, 2);
+    double w = lua_tonumber(lua_state, 3);
+    double h = lua_tonumber(lua_state, 4);
+    double enter_range = lua_tonumber(lua_state, 5);
+    double leave_range = lua_tonumber(lua_state, 6);
+    lua_pop(lua_state, 6);
+
+    int aoi_id = singleton<map_aoi_mgr>::instance()->create(x, y, w, h, enter_range, leave_range);
+    lua_pushinteger(lua_state, aoi_id);
+    return 1;
+}
+
+// avant.AOIDestroy(aoiId) -> integer
+int lua_plugin::AOIDestroy(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 1);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // aoiId
+
+    int aoi_id = lua_tointeger(lua_state, 1);
+    lua_pop(lua_state, 1);
+
+    singleton<map_aoi_mgr>::instance()->destroy(aoi_id);
+    lua_pushinteger(lua_state, 0);
+    return 1;
+}
+
+// avant.AOIInsert(aoiId, x, y) -> handle|nil
+int lua_plugin::AOIInsert(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 3);
+    for (int i = 1; i <= 3; ++i)
+    {
+        ASSERT_LOG_EXIT(lua_isnumber(lua_state, i));
+    }
+
+    int aoi_id = lua_tointeger(lua_state, 1);
+    double x = lua_tonumber(lua_state, 2);
+    double y = lua_tonumber(lua_state, 3);
+    lua_pop(lua_state, 3);
+
+    map_aoi *aoi = singleton<map_aoi_mgr>::instance()->get(aoi_id);
+    if (!aoi)
+    {
+        LOG_ERROR("AOIInsert not exist aoiId {}", aoi_id);
+        lua_pushnil(lua_state);
+        return 1;
+    }
+    lua_pushinteger(lua_state, aoi->insert(x, y));
+    return 1;
+}
+
+// avant.AOIUpdate(aoiId, handle, x, y) -> boolean
+int lua_plugin::AOIUpdate(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 4);
+    for (int i = 1; i <= 4; ++i)
+    {
+        ASSERT_LOG_EXIT(lua_isnumber(lua_state, i));
+    }
+
+    int aoi_id = lua_tointeger(lua_state, 1);
+    int handle = lua_tointeger(lua_state, 2);
+    double x = lua_tonumber(lua_state, 3);
+    double y = lua_tonumber(lua_state, 4);
+    lua_pop(lua_state, 4);
+
+    map_aoi *aoi = singleton<map_aoi_mgr>::instance()->get(aoi_id);
+    lua_pushboolean(lua_state, aoi && aoi->update(handle, x, y));
+    return 1;
+}
+
+// avant.AOIRemove(aoiId, handle) -> boolean
+int lua_plugin::AOIRemove(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 2);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 2)); // handle
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // aoiId
+
+    int aoi_id = lua_tointeger(lua_state, 1);
+    int handle = lua_tointeger(lua_state, 2);
+    lua_pop(lua_state, 2);
+
+    map_aoi *aoi = singleton<map_aoi_mgr>::instance()->get(aoi_id);
+    lua_pushboolean(lua_state, aoi && aoi->remove(handle));
+    return 1;
+}
+
+// avant.AOIFlush(aoiId, out) -> count
+// 有待取事件的观察者handle写入out[1..count]
+int lua_plugin::AOIFlush(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 2);
+    ASSERT_LOG_EXIT(lua_istable(lua_state, 2));  // out
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // aoiId
+
+    int aoi_id = lua_tointeger(lua_state, 1);
+
+    static std::vector<int> result;
+    result.clear();
+    map_aoi *aoi = singleton<map_aoi_mgr>::instance()->get(aoi_id);
+    if (aoi)
+    {
+        aoi->flush(result);
+    }
+
+    lua_plugin_fill_handles(lua_state, 2, result);
+    lua_pop(lua_state, 2);
+    lua_pushinteger(lua_state, result.size());
+    return 1;
+}
+
+// avant.AOIFetch(aoiId, handle, enterOut, leaveOut, moveOut) -> enterCount, leaveCount, moveCount
+int lua_plugin::AOIFetch(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 5);
+    ASSERT_LOG_EXIT(lua_istable(lua_state, 5));  // moveOut
+    ASSERT_LOG_EXIT(lua_istable(lua_state, 4));  // leaveOut
+    ASSERT_LOG_EXIT(lua_istable(lua_state, 3));  // enterOut
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 2)); // handle
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // aoiId
+
+    int aoi_id = lua_tointeger(lua_state, 1);
+    int handle = lua_tointeger(lua_state, 2);
+
+    static std::vector<int> enter;
+    static std::vector<int> leave;
+    static std::vector<int> move;
+    enter.clear();
+    leave.clear();
+    move.clear();
+    map_aoi *aoi = singleton<map_aoi_mgr>::instance()->get(aoi_id);
+    if (aoi)
+    {
+        aoi->fetch(handle, enter, leave, move);
+    }
+
+    lua_plugin_fill_handles(lua_state, 3, enter);
+    lua_plugin_fill_handles(lua_state, 4, leave);
+    lua_plugin_fill_handles(lua_state, 5, move);
+    lua_pop(lua_state, 5);
+    lua_pushinteger(lua_state, enter.size());
+    lua_pushinteger(lua_state, leave.size());
+    lua_pushinteger(lua_state, move.size());
+    return 3;
+}
+
+// avant.SnapshotCreate(aoiId, posQuant, velQuant) -> encoderId
+int lua_plugin::SnapshotCreate(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 3);
+    for (int i = 1; i <= 3; ++i)
+    {
+        ASSERT_LOG_EXIT(lua_isnumber(lua_state, i));
+    }
+
+    int aoi_id = lua_tointeger(lua_state, 1);
+    double pos_quant = lua_tonumber(lua_state, 2);
+    double vel_quant = lua_tonumber(lua_state, 3);
+    lua_pop(lua_state, 3);
+
+    int encoder_id = singleton<map_snapshot_mgr>::instance()->create(aoi_id, pos_quant, vel_quant);
+    lua_pushinteger(lua_state, encoder_id);
+    return 1;
+}
+
+// avant.SnapshotDestroy(encoderId) -> integer
+int lua_plugin::SnapshotDestroy(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 1);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // encoderId
+
+    int encoder_id = lua_tointeger(lua_state, 1);
+    lua_pop(lua_state, 1);
+
+    singleton<map_snapshot_mgr>::instance()->destroy(encoder_id);
+    lua_pushinteger(lua_state, 0);
+    return 1;
+}
+
+// avant.SnapshotSetEntity(encoderId, handle, userId) -> boolean
+int lua_plugin::SnapshotSetEntity(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 3);
+    ASSERT_LOG_EXIT(lua_isstring(lua_state, 3)); // userId
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 2)); // handle
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // encoderId
+
+    int encoder_id = lua_tointeger(lua_state, 1);
+    int handle = lua_tointeger(lua_state, 2);
+    std::string user_id(lua_tostring(lua_state, 3));
+    lua_pop(lua_state, 3);
+
+    map_snapshot *snapshot = singleton<map_snapshot_mgr>::instance()->get(encoder_id);
+    if (snapshot)
+    {
+        snapshot->set_entity(handle, user_id);
+    }
+    lua_pushboolean(lua_state, snapshot != nullptr);
+    return 1;
+}
+
+// avant.SnapshotSetState(encoderId, handle, x, y, vX, vY, lastSeq, lastClientTime) -> boolean
+// lastClientTime为字符串形式的uint64
+int lua_plugin::SnapshotSetState(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 8);
+    ASSERT_LOG_EXIT(lua_isstring(lua_state, 8)); // lastClientTime
+    for (int i = 1; i <= 7; ++i)
+    {
+        ASSERT_LOG_EXIT(lua_isnumber(lua_state, i));
+    }
+
+    int encoder_id = lua_tointeger(lua_state, 1);
+    int handle = lua_tointeger(lua_state, 2);
+    double x = lua_tonumber(lua_state, 3);
+    double y = lua_tonumber(lua_state, 4);
+    double vx = lua_tonumber(lua_state, 5);
+    double vy = lua_tonumber(lua_state, 6);
+    uint32_t last_seq = (uint32_t)lua_tointeger(lua_state, 7);
+    uint64_t last_client_time = std::strtoull(lua_tostring(lua_state, 8), nullptr, 10);
+    lua_pop(lua_state, 8);
+
+    map_snapshot *snapshot = singleton<map_snapshot_mgr>::instance()->get(encoder_id);
+    if (snapshot)
+    {
+        snapshot->set_state(handle, x, y, vx, vy, last_seq, last_client_time);
+    }
+    lua_pushboolean(lua_state, snapshot != nullptr);
+    return 1;
+}
+
+// avant.SnapshotRemove(encoderId, handle) -> boolean
+int lua_plugin::SnapshotRemove(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 2);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 2)); // handle
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // encoderId
+
+    int encoder_id = lua_tointeger(lua_state, 1);
+    int handle = lua_tointeger(lua_state, 2);
+    lua_pop(lua_state, 2);
+
+    map_snapshot *snapshot = singleton<map_snapshot_mgr>::instance()->get(encoder_id);
+    if (snapshot)
+    {
+        snapshot->remove(handle);
+    }
+    lua_pushboolean(lua_state, snapshot != nullptr);
+    return 1;
+}
+
+// avant.SnapshotAck(encoderId, handle, ackSnapshotId) -> boolean
+int lua_plugin::SnapshotAck(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 3);
+    for (int i = 1; i <= 3; ++i)
+    {
+        ASSERT_LOG_EXIT(lua_isnumber(lua_state, i));
+    }
+
+    int encoder_id = lua_tointeger(lua_state, 1);
+    int handle = lua_tointeger(lua_state, 2);
+    uint32_t ack_encoder_id = (uint32_t)lua_tointeger(lua_state, 3);
+    lua_pop(lua_state, 3);
+
+    map_snapshot *snapshot = singleton<map_snapshot_mgr>::instance()->get(encoder_id);
+    if (snapshot)
+    {
+        snapshot->ack(handle, ack_encoder_id);
+    }
+    lua_pushboolean(lua_state, snapshot != nullptr);
+    return 1;
+}
+
+// avant.SnapshotSend(encoderId, handle, clientGID, workerIdx, serverTime) -> bytes
+// 编码并直接发给客户端 不经过lua表转换 无需发送时返回0 clientGID与serverTime为字符串形式的uint64
+// 必须在本步AOIFlush之后调用
+int lua_plugin::SnapshotSend(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 5);
+    ASSERT_LOG_EXIT(lua_isstring(lua_state, 5)); // serverTime
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 4)); // workerIdx
+    ASSERT_LOG_EXIT(lua_isstring(lua_state, 3)); // clientGID
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 2)); // handle
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // encoderId
+
+    int encoder_id = lua_tointeger(lua_state, 1);
+    int handle = lua_tointeger(lua_state, 2);
+    uint64_t gid = std::strtoull(lua_tostring(lua_state, 3), nullptr, 10);
+    int worker_idx = lua_tointeger(lua_state, 4);
+    uint64_t server_time = std::strtoull(lua_tostring(lua_state, 5), nullptr, 10);
+    lua_pop(lua_state, 5);
+
+    static ProtoCSMapNotifySnapshot notify;
+    map_snapshot *snapshot = singleton<map_snapshot_mgr>::instance()->get(encoder_id);
+    if (!snapshot || !snapshot->encode(handle, server_time, notify))
+    {
+        lua_pushinteger(lua_state, 0);
+        return 1;
+    }
+
+    app_metrics::add_cmd(singleton<app_metrics>::instance()->other_slot().cmd_send_total, ProtoCmd::PROTO_CMD_CS_MAP_NOTIFY_SNAPSHOT);
+    send_to_client(gid, worker_idx, ProtoCmd::PROTO_CMD_CS_MAP_NOTIFY_SNAPSHOT, notify);
+    lua_pushinteger(lua_state, notify.ByteSizeLong());
+    return 1;
+}
+
+// avant.SnapshotSetClient(encoderId, handle, clientGID, workerIdx) -> boolean
+// 登记后MapSimTick会给该客户端编码并发送快照
+int lua_plugin::SnapshotSetClient(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 4);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 4)); // workerIdx
+    ASSERT_LOG_EXIT(lua_isstring(lua_state, 3)); // clientGID
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 2)); // handle
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // encoderId
+
+    int encoder_id = lua_tointeger(lua_state, 1);
+    int handle = lua_tointeger(lua_state, 2);
+    uint64_t gid = std::strtoull(lua_tostring(lua_state, 3), nullptr, 10);
+    int worker_idx = lua_tointeger(lua_state, 4);
+    lua_pop(lua_state, 4);
+
+    map_snapshot *snapshot = singleton<map_snapshot_mgr>::instance()->get(encoder_id);
+    if (snapshot)
+    {
+        snapshot->set_client(handle, gid, worker_idx);
+    }
+    lua_pushboolean(lua_state, snapshot != nullptr);
+    return 1;
+}
+
+// avant.SnapshotSetLOD(encoderId, ranges, periods) -> boolean
+// 按距离分层降频 ranges与periods为等长数组 传空表关闭
+int lua_plugin::SnapshotSetLOD(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 3);
+    ASSERT_LOG_EXIT(lua_istable(lua_state, 3));  // periods
+    ASSERT_LOG_EXIT(lua_istable(lua_state, 2));  // ranges
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // encoderId
+
+    int encoder_id = lua_tointeger(lua_state, 1);
+    std::vector<double> ranges;
+    std::vector<int> periods;
+    const int range_cnt = lua_rawlen(lua_state, 2);
+    for (int i = 1; i <= range_cnt; ++i)
+    {
+        lua_rawgeti(lua_state, 2, i);
+        ranges.push_back(lua_tonumber(lua_state, -1));
+        lua_pop(lua_state, 1);
+    }
+    const int period_cnt = lua_rawlen(lua_state, 3);
+    for (int i = 1; i <= period_cnt; ++i)
+    {
+        lua_rawgeti(lua_state, 3, i);
+        periods.push_back(lua_tointeger(lua_state, -1));
+        lua_pop(lua_state, 1);
+    }
+    lua_pop(lua_state, 3);
+
+    map_snapshot *snapshot = singleton<map_snapshot_mgr>::instance()->get(encoder_id);
+    if (snapshot)
+    {
+        snapshot->set_lod(ranges, periods);
+    }
+    lua_pushboolean(lua_state, snapshot != nullptr);
+    return 1;
+}
+
+// avant.SnapshotLODStat(encoderId, updatesOut, savedOut) -> tierCount
+// 取出并清零各层统计 updatesOut[k]为第k层带上新状态的条目数 savedOut[k]为推迟掉的条目数
+int lua_plugin::SnapshotLODStat(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 3);
+    ASSERT_LOG_EXIT(lua_istable(lua_state, 3));  // savedOut
+    ASSERT_LOG_EXIT(lua_istable(lua_state, 2));  // updatesOut
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // encoderId
+
+    int encoder_id = lua_tointeger(lua_state, 1);
+
+    static std::vector<uint64_t> updates;
+    static std::vector<uint64_t> saved;
+    updates.clear();
+    saved.clear();
+    map_snapshot *snapshot = singleton<map_snapshot_mgr>::instance()->get(encoder_id);
+    if (snapshot)
+    {
+        snapshot->take_lod_stat(updates, saved);
+    }
+    for (size_t i = 0; i < updates.size(); ++i)
+    {
+        lua_pushinteger(lua_state, updates[i]);
+        lua_rawseti(lua_state, 2, i + 1);
+        lua_pushinteger(lua_state, saved[i]);
+        lua_rawseti(lua_state, 3, i + 1);
+    }
+    lua_pushnil(lua_state);
+    lua_rawseti(lua_state, 2, updates.size() + 1);
+    lua_pushnil(lua_state);
+    lua_rawseti(lua_state, 3, saved.size() + 1);
+    lua_pop(lua_state, 3);
+    lua_pushinteger(lua_state, updates.size());
+    return 1;
+}
+
+// avant.PhysicsCreate(width, height, aoiId, encoderId) -> physicsId
+// 状态变化的实体同步到aoiId与encoderId 不需要时传0
+int lua_plugin::PhysicsCreate(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 4);
+    for (int i = 1; i <= 4; ++i)
+    {
+        ASSERT_LOG_EXIT(lua_isnumber(lua_state, i));
+    }
+
+    double width = lua_tonumber(lua_state, 1);
+    double height = lua_tonumber(lua_state, 2);
+    int aoi_id = lua_tointeger(lua_state, 3);
+    int encoder_id = lua_tointeger(lua_state, 4);
+    lua_pop(lua_state, 4);
+
+    int physics_id = singleton<map_physics_mgr>::instance()->create(width, height, aoi_id, encoder_id);
+    lua_pushinteger(lua_state, physics_id);
+    return 1;
+}
+
+// avant.PhysicsDestroy(physicsId) -> integer
+int lua_plugin::PhysicsDestroy(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 1);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // physicsId
+
+    int physics_id = lua_tointeger(lua_state, 1);
+    lua_pop(lua_state, 1);
+
+    singleton<map_physics_mgr>::instance()->destroy(physics_id);
+    lua_pushinteger(lua_state, 0);
+    return 1;
+}
+
+// avant.PhysicsAdd(physicsId, handle, x, y, maxSpeed, accel, speedRatio, friction, bodyRadius, bodyMass, bounce) -> boolean
+int lua_plugin::PhysicsAdd(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 11);
+    for (int i = 1; i <= 11; ++i)
+    {
+        ASSERT_LOG_EXIT(lua_isnumber(lua_state, i));
+    }
+
+    int physics_id = lua_tointeger(lua_state, 1);
+    int handle = lua_tointeger(lua_state, 2);
+    double x = lua_tonumber(lua_state, 3);
+    double y = lua_tonumber(lua_state, 4);
+    double max_speed = lua_tonumber(lua_state, 5);
+    double accel = lua_tonumber(lua_state, 6);
+    double speed_ratio = lua_tonumber(lua_state, 7);
+    double friction = lua_tonumber(lua_state, 8);
+    double body_radius = lua_tonumber(lua_state, 9);
+    double body_mass = lua_tonumber(lua_state, 10);
+    double bounce = lua_tonumber(lua_state, 11);
+    lua_pop(lua_state, 11);
+
+    map_physics *physics = singleton<map_physics_mgr>::instance()->get(physics_id);
+    if (!physics)
+    {
+        LOG_ERROR("PhysicsAdd not exist physicsId {}", physics_id);
+        lua_pushboolean(lua_state, 0);
+        return 1;
+    }
+    lua_pushboolean(lua_state, physics->add(handle, x, y, max_speed, accel, speed_ratio, friction, body_radius, body_mass, bounce));
+    return 1;
+}
+
+// avant.PhysicsSetCollision(physicsId, gridId, tileSize, playerCollision) -> boolean
+// 积分后的碰撞阶段 gridId为0时不与瓦片碰撞
+int lua_plugin::PhysicsSetCollision(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 4);
+    ASSERT_LOG_EXIT(lua_isboolean(lua_state, 4)); // playerCollision
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 3));  // tileSize
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 2));  // gridId
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1));  // physicsId
+
+    int physics_id = lua_tointeger(lua_state, 1);
+    int grid_id = lua_tointeger(lua_state, 2);
+    double tile_size = lua_tonumber(lua_state, 3);
+    bool player_collision = lua_toboolean(lua_state, 4);
+    lua_pop(lua_state, 4);
+
+    map_physics *physics = singleton<map_physics_mgr>::instance()->get(physics_id);
+    if (physics)
+    {
+        physics->set_collision(grid_id, tile_size, player_collision);
+    }
+    lua_pushboolean(lua_state, physics != nullptr);
+    return 1;
+}
+
+// avant.PhysicsRemove(physicsId, handle) -> boolean
+int lua_plugin::PhysicsRemove(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 2);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 2)); // handle
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // physicsId
+
+    int physics_id = lua_tointeger(lua_state, 1);
+    int handle = lua_tointeger(lua_state, 2);
+    lua_pop(lua_state, 2);
+
+    map_physics *physics = singleton<map_physics_mgr>::instance()->get(physics_id);
+    lua_pushboolean(lua_state, physics && physics->remove(handle));
+    return 1;
+}
+
+// avant.PhysicsSetInput(physicsId, handle, dirX, dirY, seq, clientTime) -> boolean
+// dir为归一化后的方向 clientTime为字符串形式的uint64
+int lua_plugin::PhysicsSetInput(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 6);
+    ASSERT_LOG_EXIT(lua_isstring(lua_state, 6)); // clientTime
+    for (int i = 1; i <= 5; ++i)
+    {
+        ASSERT_LOG_EXIT(lua_isnumber(lua_state, i));
+    }
+
+    int physics_id = lua_tointeger(lua_state, 1);
+    int handle = lua_tointeger(lua_state, 2);
+    double dir_x = lua_tonumber(lua_state, 3);
+    double dir_y = lua_tonumber(lua_state, 4);
+    uint32_t seq = (uint32_t)lua_tointeger(lua_state, 5);
+    uint64_t client_time = std::strtoull(lua_tostring(lua_state, 6), nullptr, 10);
+    lua_pop(lua_state, 6);
+
+    map_physics *physics = singleton<map_physics_mgr>::instance()->get(physics_id);
+    lua_pushboolean(lua_state, physics && physics->set_input(handle, dir_x, dir_y, seq, client_time));
+    return 1;
+}
+
+// avant.PhysicsPushInput(physicsId, handle, dirX, dirY, seq, clientTime) -> result
+// 放进抖动缓冲 之后每步按seq最多应用一条 result为0排队 1重复 2迟到 3丢弃
+int lua_plugin::PhysicsPushInput(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 6);
+    ASSERT_LOG_EXIT(lua_isstring(lua_state, 6)); // clientTime
+    for (int i = 1; i <= 5; ++i)
+    {
+        ASSERT_LOG_EXIT(lua_isnumber(lua_state, i));
+    }
+
+    int physics_id = lua_tointeger(lua_state, 1);
+    int handle = lua_tointeger(lua_state, 2);
+    double dir_x = lua_tonumber(lua_state, 3);
+    double dir_y = lua_tonumber(lua_state, 4);
+    uint32_t seq = (uint32_t)lua_tointeger(lua_state, 5);
+    uint64_t client_time = std::strtoull(lua_tostring(lua_state, 6), nullptr, 10);
+    lua_pop(lua_state, 6);
+
+    map_physics *physics = singleton<map_physics_mgr>::instance()->get(physics_id);
+    map_input_buffer::push_result result = map_input_buffer::PUSH_DROPPED;
+    if (physics)
+    {
+        result = physics->push_input(handle, dir_x, dir_y, seq, client_time);
+    }
+    lua_pushinteger(lua_state, (int)result);
+    return 1;
+}
+
+// avant.PhysicsSetInputDelay(physicsId, delaySteps, reorderSteps) -> boolean
+// 输入到达后等delaySteps步才应用 缺了前一个seq时后面的输入再多等reorderSteps步
+int lua_plugin::PhysicsSetInputDelay(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 3);
+    for (int i = 1; i <= 3; ++i)
+    {
+        ASSERT_LOG_EXIT(lua_isnumber(lua_state, i));
+    }
+
+    int physics_id = lua_tointeger(lua_state, 1);
+    int delay_steps = lua_tointeger(lua_state, 2);
+    int reorder_steps = lua_tointeger(lua_state, 3);
+    lua_pop(lua_state, 3);
+
+    map_physics *physics = singleton<map_physics_mgr>::instance()->get(physics_id);
+    if (physics)
+    {
+        physics->set_input_delay(delay_steps, reorder_steps);
+    }
+    lua_pushboolean(lua_state, physics != nullptr);
+    return 1;
+}
+
+// avant.PhysicsInputStat(physicsId) -> applied, late, dropped, duplicate, skipped | nil
+// 返回上次调用以来的累计值并清零
+int lua_plugin::PhysicsInputStat(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 1);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // physicsId
+
+    int physics_id = lua_tointeger(lua_state, 1);
+    lua_pop(lua_state, 1);
+
+    map_physics *physics = singleton<map_physics_mgr>::instance()->get(physics_id);
+    if (!physics)
+    {
+        lua_pushnil(lua_state);
+        return 1;
+    }
+    return lua_plugin_push_input_stat(lua_state, physics->take_input_stat());
+}
+
+// avant.PhysicsGet(physicsId, handle) -> x, y, vX, vY | nil
+int lua_plugin::PhysicsGet(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 2);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 2)); // handle
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // physicsId
+
+    int physics_id = lua_tointeger(lua_state, 1);
+    int handle = lua_tointeger(lua_state, 2);
+    lua_pop(lua_state, 2);
+
+    double x = 0, y = 0, vx = 0, vy = 0;
+    map_physics *physics = singleton<map_physics_mgr>::instance()->get(physics_id);
+    if (!physics || !physics->get(handle, x, y, vx, vy))
+    {
+        lua_pushnil(lua_state);
+        return 1;
+    }
+    lua_pushnumber(lua_state, x);
+    lua_pushnumber(lua_state, y);
+    lua_pushnumber(lua_state, vx);
+    lua_pushnumber(lua_state, vy);
+    return 4;
+}
+
+// avant.PhysicsExport(physicsId, handles) -> blob | nil
+// 地图迁移 按handles顺序导出实体参数 运动状态与暂存输入 有handle不存在时返回nil
+int lua_plugin::PhysicsExport(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 2);
+    ASSERT_LOG_EXIT(lua_istable(lua_state, 2));  // handles
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // physicsId
+
+    static std::vector<int> handles;
+    int physics_id = lua_tointeger(lua_state, 1);
+    lua_plugin_read_handles(lua_state, 2, handles);
+    lua_pop(lua_state, 2);
+
+    std::string blob;
+    map_physics *physics = singleton<map_physics_mgr>::instance()->get(physics_id);
+    if (!physics || !physics->export_state(handles, blob))
+    {
+        lua_pushnil(lua_state);
+        return 1;
+    }
+    lua_pushlstring(lua_state, blob.data(), blob.size());
+    return 1;
+}
+
+// avant.PhysicsImport(physicsId, blob, handles) -> count | nil
+// 按handles顺序导入PhysicsExport的结果并同步到AOI与快照编码器 数据不对时返回nil且不加入任何实体
+int lua_plugin::PhysicsImport(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 3);
+    ASSERT_LOG_EXIT(lua_istable(lua_state, 3));  // handles
+    ASSERT_LOG_EXIT(lua_isstring(lua_state, 2)); // blob
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // physicsId
+
+    static std::vector<int> handles;
+    int physics_id = lua_tointeger(lua_state, 1);
+    size_t blob_len = 0;
+    const char *blob_ptr = lua_tolstring(lua_state, 2, &blob_len);
+    std::string blob(blob_ptr, blob_len);
+    lua_plugin_read_handles(lua_state, 3, handles);
+    lua_pop(lua_state, 3);
+
+    map_physics *physics = singleton<map_physics_mgr>::instance()->get(physics_id);
+    int count = physics ? physics->import_state(handles, blob) : -1;
+    if (count < 0)
+    {
+        LOG_ERROR("PhysicsImport failed physicsId {} handles {} bytes {}", physics_id, handles.size(), blob.size());
+        lua_pushnil(lua_state);
+        return 1;
+    }
+    lua_pushinteger(lua_state, count);
+    return 1;
+}
+
+// avant.PhysicsStep(physicsId, dtMS) -> changedCount
+int lua_plugin::PhysicsStep(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 2);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 2)); // dtMS
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // physicsId
+
+    int physics_id = lua_tointeger(lua_state, 1);
+    double dt_ms = lua_tonumber(lua_state, 2);
+    lua_pop(lua_state, 2);
+
+    map_physics *physics = singleton<map_physics_mgr>::instance()->get(physics_id);
+    lua_pushinteger(lua_state, physics ? physics->step(dt_ms) : 0);
+    return 1;
+}
+
+// avant.MapSimCreate(physicsId, aoiId, encoderId, dtMS) -> simId
+// 把一张地图的物理 AOI 快照编码器组成一个可以并行tick的模拟上下文
+int lua_plugin::MapSimCreate(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 4);
+    for (int i = 1; i <= 4; ++i)
+    {
+        ASSERT_LOG_EXIT(lua_isnumber(lua_state, i));
+    }
+
+    int physics_id = lua_tointeger(lua_state, 1);
+    int aoi_id = lua_tointeger(lua_state, 2);
+    int encoder_id = lua_tointeger(lua_state, 3);
+    double dt_ms = lua_tonumber(lua_state, 4);
+    lua_pop(lua_state, 4);
+
+    int sim_id = singleton<map_sim_mgr>::instance()->create(physics_id, aoi_id, encoder_id, dt_ms);
+    lua_pushinteger(lua_state, sim_id);
+    return 1;
+}
+
+// avant.MapSimDestroy(simId) -> integer
+int lua_plugin::MapSimDestroy(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 1);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // simId
+
+    int sim_id = lua_tointeger(lua_state, 1);
+    lua_pop(lua_state, 1);
+
+    singleton<map_sim_mgr>::instance()->destroy(sim_id);
+    lua_pushinteger(lua_state, 0);
+    return 1;
+}
+
+// avant.MapSimSetThreads(threadCnt) -> integer
+// 线程池额外线程数 0为在other线程串行tick 返回实际线程数
+int lua_plugin::MapSimSetThreads(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 1);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // threadCnt
+
+    int thread_cnt = lua_tointeger(lua_state, 1);
+    lua_pop(lua_state, 1);
+
+    map_sim_mgr *mgr = singleton<map_sim_mgr>::instance();
+    if (mgr->get_threads() != thread_cnt)
+    {
+        mgr->set_threads(thread_cnt);
+    }
+    lua_pushinteger(lua_state, mgr->get_threads());
+    return 1;
+}
+
+// avant.MapSimTick(simIds, stepCounts, syncFlags, serverTime) -> sendCount
+// simIds[i]推进stepCounts[i]个固定步长 syncFlags[i]为true时再做一次AOI判定与快照编码
+// 各地图在线程池中并行执行 全部完成后在other线程发出快照
+int lua_plugin::MapSimTick(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 4);
+    ASSERT_LOG_EXIT(lua_isstring(lua_state, 4)); // serverTime
+    ASSERT_LOG_EXIT(lua_istable(lua_state, 3));  // syncFlags
+    ASSERT_LOG_EXIT(lua_istable(lua_state, 2));  // stepCounts
+    ASSERT_LOG_EXIT(lua_istable(lua_state, 1));  // simIds
+
+    static std::vector<int> sim_ids;
+    static std::vector<int> steps;
+    static std::vector<uint8_t> syncs;
+    sim_ids.clear();
+    steps.clear();
+    syncs.clear();
+    const int sim_cnt = lua_rawlen(lua_state, 1);
+    for (int i = 1; i <= sim_cnt; ++i)
+    {
+        lua_rawgeti(lua_state, 1, i);
+        sim_ids.push_back(lua_tointeger(lua_state, -1));
+        lua_pop(lua_state, 1);
+        lua_rawgeti(lua_state, 2, i);
+        steps.push_back(lua_tointeger(lua_state, -1));
+        lua_pop(lua_state, 1);
+        lua_rawgeti(lua_state, 3, i);
+        syncs.push_back(lua_toboolean(lua_state, -1) ? 1 : 0);
+        lua_pop(lua_state, 1);
+    }
+    uint64_t server_time = std::strtoull(lua_tostring(lua_state, 4), nullptr, 10);
+    lua_pop(lua_state, 4);
+
+    int send_cnt = 0;
+    app_metrics::thread_slot &slot = singleton<app_metrics>::instance()->other_slot();
+    singleton<map_sim_mgr>::instance()->tick(sim_ids, steps, syncs, server_time, [&](const map_snapshot::outbound &item)
+                                             {
+                                                 app_metrics::add_cmd(slot.cmd_send_total, ProtoCmd::PROTO_CMD_CS_MAP_NOTIFY_SNAPSHOT);
+                                                 send_to_client(item.gid, item.worker_idx, ProtoCmd::PROTO_CMD_CS_MAP_NOTIFY_SNAPSHOT, item.msg);
+                                                 ++send_cnt; });
+    lua_pushinteger(lua_state, send_cnt);
+    return 1;
+}
+
+// avant.MapSimStat(simId) -> ticks, costUsSum, costUsMax, bytes, sends, steps, syncs | nil
+// 返回上次调用以来的累计值并清零
+int lua_plugin::MapSimStat(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 1);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // simId
+
+    int sim_id = lua_tointeger(lua_state, 1);
+    lua_pop(lua_state, 1);
+
+    map_sim *sim = singleton<map_sim_mgr>::instance()->get(sim_id);
+    if (!sim)
+    {
+        lua_pushnil(lua_state);
+        return 1;
+    }
+    map_sim::stat stat = sim->take_stat();
+    lua_pushinteger(lua_state, stat.ticks);
+    lua_pushinteger(lua_state, stat.cost_us_sum);
+    lua_pushinteger(lua_state, stat.cost_us_max);
+    lua_pushinteger(lua_state, stat.bytes);
+    lua_pushinteger(lua_state, stat.sends);
+    lua_pushinteger(lua_state, stat.steps);
+    lua_pushinteger(lua_state, stat.syncs);
+    return 7;
+}
+
+// avant.TileGridCreate(width, height, bitsPerTile) -> gridId
+// 全0的可写网格 bitsPerTile取1/2/4/8 其他值向上取
+int lua_plugin::TileGridCreate(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 3);
+    for (int i = 1; i <= 3; ++i)
+    {
+        ASSERT_LOG_EXIT(lua_isnumber(lua_state, i));
+    }
+
+    int width = lua_tointeger(lua_state, 1);
+    int height = lua_tointeger(lua_state, 2);
+    int bits = lua_tointeger(lua_state, 3);
+    lua_pop(lua_state, 3);
+
+    int grid_id = singleton<map_tile_grid_mgr>::instance()->create(width, height, bits);
+    lua_pushinteger(lua_state, grid_id);
+    return 1;
+}
+
+// avant.TileGridLoad(path) -> gridId|nil
+// mmap只读加载 同一文件已加载时共用并增加引用
+int lua_plugin::TileGridLoad(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 1);
+    ASSERT_LOG_EXIT(lua_isstring(lua_state, 1)); // path
+
+    const std::string path(lua_tostring(lua_state, 1));
+    lua_pop(lua_state, 1);
+
+    int grid_id = singleton<map_tile_grid_mgr>::instance()->load(path);
+    if (grid_id == 0)
+    {
+        LOG_ERROR("TileGridLoad failed path {}", path);
+        lua_pushnil(lua_state);
+        return 1;
+    }
+    lua_pushinteger(lua_state, grid_id);
+    return 1;
+}
+
+// avant.TileGridSave(gridId, path) -> boolean
+int lua_plugin::TileGridSave(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 2);
+    ASSERT_LOG_EXIT(lua_isstring(lua_state, 2)); // path
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // gridId
+
+    int grid_id = lua_tointeger(lua_state, 1);
+    const std::string path(lua_tostring(lua_state, 2));
+    lua_pop(lua_state, 2);
+
+    map_tile_grid *grid = singleton<map_tile_grid_mgr>::instance()->get(grid_id);
+    lua_pushboolean(lua_state, grid && grid->save(path));
+    return 1;
+}
+
+// avant.TileGridDestroy(gridId) -> integer
+// 减少引用 最后一个使用者释放时才解除映射
+int lua_plugin::TileGridDestroy(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 1);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // gridId
+
+    int grid_id = lua_tointeger(lua_state, 1);
+    lua_pop(lua_state, 1);
+
+    singleton<map_tile_grid_mgr>::instance()->destroy(grid_id);
+    lua_pushinteger(lua_state, 0);
+    return 1;
+}
+
+// avant.TileGridInfo(gridId) -> width, height, bitsPerTile, readOnly | nil
+int lua_plugin::TileGridInfo(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 1);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // gridId
+
+    int grid_id = lua_tointeger(lua_state, 1);
+    lua_pop(lua_state, 1);
+
+    map_tile_grid *grid = singleton<map_tile_grid_mgr>::instance()->get(grid_id);
+    if (!grid)
+    {
+        lua_pushnil(lua_state);
+        return 1;
+    }
+    lua_pushinteger(lua_state, grid->get_width());
+    lua_pushinteger(lua_state, grid->get_height());
+    lua_pushinteger(lua_state, grid->get_bits());
+    lua_pushboolean(lua_state, grid->is_read_only());
+    return 4;
+}
+
+// avant.TileGridGetTile(gridId, x, y) -> tile|nil
+// 坐标从0开始 越界返回nil
+int lua_plugin::TileGridGetTile(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 3);
+    for (int i = 1; i <= 3; ++i)
+    {
+        ASSERT_LOG_EXIT(lua_isnumber(lua_state, i));
+    }
+
+    int grid_id = lua_tointeger(lua_state, 1);
+    int x = lua_tointeger(lua_state, 2);
+    int y = lua_tointeger(lua_state, 3);
+    lua_pop(lua_state, 3);
+
+    map_tile_grid *grid = singleton<map_tile_grid_mgr>::instance()->get(grid_id);
+    const int tile = grid ? grid->get_tile(x, y) : -1;
+    if (tile < 0)
+    {
+        lua_pushnil(lua_state);
+        return 1;
+    }
+    lua_pushinteger(lua_state, tile);
+    return 1;
+}
+
+// avant.TileGridSetTile(gridId, x, y, tile) -> boolean
+// 只读加载的网格返回false
+int lua_plugin::TileGridSetTile(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 4);
+    for (int i = 1; i <= 4; ++i)
+    {
+        ASSERT_LOG_EXIT(lua_isnumber(lua_state, i));
+    }
+
+    int grid_id = lua_tointeger(lua_state, 1);
+    int x = lua_tointeger(lua_state, 2);
+    int y = lua_tointeger(lua_state, 3);
+    int tile = lua_tointeger(lua_state, 4);
+    lua_pop(lua_state, 4);
+
+    map_tile_grid *grid = singleton<map_tile_grid_mgr>::instance()->get(grid_id);
+    lua_pushboolean(lua_state, grid && grid->set_tile(x, y, tile));
+    return 1;
+}
+
+// avant.TileGridSetWalkable(gridId, tile, walkable) -> boolean
+int lua_plugin::TileGridSetWalkable(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 3);
+    ASSERT_LOG_EXIT(lua_isboolean(lua_state, 3)); // walkable
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 2));  // tile
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1));  // gridId
+
+    int grid_id = lua_tointeger(lua_state, 1);
+    int tile = lua_tointeger(lua_state, 2);
+    bool walkable = lua_toboolean(lua_state, 3);
+    lua_pop(lua_state, 3);
+
+    map_tile_grid *grid = singleton<map_tile_grid_mgr>::instance()->get(grid_id);
+    if (grid)
+    {
+        grid->set_walkable(tile, walkable);
+    }
+    lua_pushboolean(lua_state, grid != nullptr);
+    return 1;
+}
+
+// avant.TileGridIsWalkable(gridId, x, y) -> boolean
+int lua_plugin::TileGridIsWalkable(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 3);
+    for (int i = 1; i <= 3; ++i)
+    {
+        ASSERT_LOG_EXIT(lua_isnumber(lua_state, i));
+    }
+
+    int grid_id = lua_tointeger(lua_state, 1);
+    int x = lua_tointeger(lua_state, 2);
+    int y = lua_tointeger(lua_state, 3);
+    lua_pop(lua_state, 3);
+
+    map_tile_grid *grid = singleton<map_tile_grid_mgr>::instance()->get(grid_id);
+    lua_pushboolean(lua_state, grid && grid->is_walkable(x, y));
+    return 1;
+}
+
+// avant.TileGridRaycast(gridId, x0, y0, x1, y1) -> hit, tileX, tileY
+// 瓦片坐标系 1.0为一格 未命中只返回false
+int lua_plugin::TileGridRaycast(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 5);
+    for (int i = 1; i <= 5; ++i)
+    {
+        ASSERT_LOG_EXIT(lua_isnumber(lua_state, i));
+    }
+
+    int grid_id = lua_tointeger(lua_state, 1);
+    double x0 = lua_tonumber(lua_state, 2);
+    double y0 = lua_tonumber(lua_state, 3);
+    double x1 = lua_tonumber(lua_state, 4);
+    double y1 = lua_tonumber(lua_state, 5);
+    lua_pop(lua_state, 5);
+
+    int hit_x = 0, hit_y = 0;
+    map_tile_grid *grid = singleton<map_tile_grid_mgr>::instance()->get(grid_id);
+    if (!grid || !grid->raycast(x0, y0, x1, y1, hit_x, hit_y))
+    {
+        lua_pushboolean(lua_state, false);
+        return 1;
+    }
+    lua_pushboolean(lua_state, true);
+    lua_pushinteger(lua_state, hit_x);
+    lua_pushinteger(lua_state, hit_y);
+    return 3;
+}
+
+// avant.PathFind(gridId, startX, startY, endX, endY, useJPS, out) -> points | nil
+// 网格坐标 4方向 找到时起点到终点(含两端)每格按x, y写入out 返回格数 终点不可行走或不可达返回nil
+int lua_plugin::PathFind(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 7);
+    ASSERT_LOG_EXIT(lua_istable(lua_state, 7)); // out
+    ASSERT_LOG_EXIT(lua_isboolean(lua_state, 6)); // useJPS
+    for (int i = 1; i <= 5; ++i)
+    {
+        ASSERT_LOG_EXIT(lua_isnumber(lua_state, i));
+    }
+
+    int grid_id = lua_tointeger(lua_state, 1);
+    int start_x = lua_tointeger(lua_state, 2);
+    int start_y = lua_tointeger(lua_state, 3);
+    int end_x = lua_tointeger(lua_state, 4);
+    int end_y = lua_tointeger(lua_state, 5);
+    bool use_jps = lua_toboolean(lua_state, 6);
+
+    static std::vector<int32_t> path;
+    map_tile_grid *grid = singleton<map_tile_grid_mgr>::instance()->get(grid_id);
+    if (!grid || !singleton<map_pathfinder>::instance()->find_path(grid_id, *grid, start_x, start_y, end_x, end_y, use_jps, path))
+    {
+        lua_pop(lua_state, 7);
+        lua_pushnil(lua_state);
+        return 1;
+    }
+    for (size_t i = 0; i < path.size(); ++i)
+    {
+        lua_pushinteger(lua_state, path[i]);
+        lua_rawseti(lua_state, 7, i + 1);
+    }
+    lua_pushnil(lua_state);
+    lua_rawseti(lua_state, 7, path.size() + 1);
+    lua_pop(lua_state, 7);
+    lua_pushinteger(lua_state, path.size() / 2);
+    return 1;
+}
+
+// avant.PathFindStat() -> searches, cacheHits, expanded, failed
+// 取出并清零统计
+int lua_plugin::PathFindStat(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 0);
+
+    map_pathfinder::stat stat = singleton<map_pathfinder>::instance()->take_stat();
+    lua_pushinteger(lua_state, stat.searches);
+    lua_pushinteger(lua_state, stat.cache_hits);
+    lua_pushinteger(lua_state, stat.expanded);
+    lua_pushinteger(lua_state, stat.failed);
+    return 4;
+}
+
+// avant.HPACreate(gridId, clusterSize) -> hpaId|nil
+// 拷贝网格当前的可行走位 在寻路线程建分层寻路的抽象图 建好前的查询排队等待
+int lua_plugin::HPACreate(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 2);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 2)); // clusterSize
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // gridId
+
+    int grid_id = lua_tointeger(lua_state, 1);
+    int cluster_size = lua_tointeger(lua_state, 2);
+    lua_pop(lua_state, 2);
+
+    map_tile_grid *grid = singleton<map_tile_grid_mgr>::instance()->get(grid_id);
+    if (!grid)
+    {
+        lua_pushnil(lua_state);
+        return 1;
+    }
+    lua_pushinteger(lua_state, singleton<map_hpa_mgr>::instance()->create(*grid, cluster_size));
+    return 1;
+}
+
+// avant.HPADestroy(hpaId) -> integer
+int lua_plugin::HPADestroy(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 1);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // hpaId
+
+    int hpa_id = lua_tointeger(lua_state, 1);
+    lua_pop(lua_state, 1);
+
+    singleton<map_hpa_mgr>::instance()->destroy(hpa_id);
+    lua_pushinteger(lua_state, 0);
+    return 1;
+}
+
+// avant.HPAUpdate(hpaId, gridId, x, y, w, h) -> boolean
+// 网格区域的瓦片或可行走配置变化后调用 寻路线程只重建涉及的簇
+int lua_plugin::HPAUpdate(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 6);
+    for (int i = 1; i <= 6; ++i)
+    {
+        ASSERT_LOG_EXIT(lua_isnumber(lua_state, i));
+    }
+
+    int hpa_id = lua_tointeger(lua_state, 1);
+    int grid_id = lua_tointeger(lua_state, 2);
+    int x = lua_tointeger(lua_state, 3);
+    int y = lua_tointeger(lua_state, 4);
+    int w = lua_tointeger(lua_state, 5);
+    int h = lua_tointeger(lua_state, 6);
+    lua_pop(lua_state, 6);
+
+    map_tile_grid *grid = singleton<map_tile_grid_mgr>::instance()->get(grid_id);
+    lua_pushboolean(lua_state, grid && singleton<map_hpa_mgr>::instance()->update(hpa_id, *grid, x, y, w, h));
+    return 1;
+}
+
+// avant.HPAFindPath(hpaId, startX, startY, endX, endY) -> requestId
+// 网格坐标 提交到寻路线程 结果由HPAPoll取回 排队过多或hpaId无效返回0
+int lua_plugin::HPAFindPath(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 5);
+    for (int i = 1; i <= 5; ++i)
+    {
+        ASSERT_LOG_EXIT(lua_isnumber(lua_state, i));
+    }
+
+    int hpa_id = lua_tointeger(lua_state, 1);
+    int start_x = lua_tointeger(lua_state, 2);
+    int start_y = lua_tointeger(lua_state, 3);
+    int end_x = lua_tointeger(lua_state, 4);
+    int end_y = lua_tointeger(lua_state, 5);
+    lua_pop(lua_state, 5);
+
+    lua_pushinteger(lua_state, singleton<map_hpa_mgr>::instance()->find_path(hpa_id, start_x, start_y, end_x, end_y));
+    return 1;
+}
+
+// avant.HPAPoll(ids, paths) -> count
+// 取走已完成的查询 ids[i]为请求id paths[i]为起点到终点每格按x, y排开的数组 不可达为false
+int lua_plugin::HPAPoll(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 2);
+    ASSERT_LOG_EXIT(lua_istable(lua_state, 2)); // paths
+    ASSERT_LOG_EXIT(lua_istable(lua_state, 1)); // ids
+
+    static std::vector<map_hpa_mgr::result> results;
+    results.clear();
+    singleton<map_hpa_mgr>::instance()->poll(results);
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const map_hpa_mgr::result &r = results[i];
+        lua_pushinteger(lua_state, r.request_id);
+        lua_rawseti(lua_state, 1, i + 1);
+        if (!r.found)
+        {
+            lua_pushboolean(lua_state, false);
+        }
+        else
+        {
+            lua_createtable(lua_state, (int)r.path.size(), 0);
+            for (size_t k = 0; k < r.path.size(); ++k)
+            {
+                lua_pushinteger(lua_state, r.path[k]);
+                lua_rawseti(lua_state, -2, k + 1);
+            }
+        }
+        lua_rawseti(lua_state, 2, i + 1);
+    }
+    lua_pushnil(lua_state);
+    lua_rawseti(lua_state, 1, results.size() + 1);
+    lua_pushnil(lua_state);
+    lua_rawseti(lua_state, 2, results.size() + 1);
+    lua_pop(lua_state, 2);
+    lua_pushinteger(lua_state, results.size());
+    return 1;
+}
+
+// avant.HPAInfo(hpaId) -> ready, nodes | nil
+// ready为抽象图是否已建好 nodes为抽象节点数
+int lua_plugin::HPAInfo(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 1);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // hpaId
+
+    int hpa_id = lua_tointeger(lua_state, 1);
+    lua_pop(lua_state, 1);
+
+    map_hpa *hpa = singleton<map_hpa_mgr>::instance()->get(hpa_id);
+    if (!hpa)
+    {
+        lua_pushnil(lua_state);
+        return 1;
+    }
+    lua_pushboolean(lua_state, hpa->is_ready());
+    lua_pushinteger(lua_state, hpa->get_node_count());
+    return 2;
+}
+
+// avant.FlowFieldGet(gridId, goalX, goalY) -> fieldId|nil
+// 网格坐标 按网格版本与终点缓存 未命中时同步生成 终点不可行走或网格过大返回nil
+int lua_plugin::FlowFieldGet(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 3);
+    for (int i = 1; i <= 3; ++i)
+    {
+        ASSERT_LOG_EXIT(lua_isnumber(lua_state, i));
+    }
+
+    int grid_id = lua_tointeger(lua_state, 1);
+    int goal_x = lua_tointeger(lua_state, 2);
+    int goal_y = lua_tointeger(lua_state, 3);
+    lua_pop(lua_state, 3);
+
+    map_tile_grid *grid = singleton<map_tile_grid_mgr>::instance()->get(grid_id);
+    const int field_id = grid ? singleton<map_flow_field_cache>::instance()->get(grid_id, *grid, goal_x, goal_y) : 0;
+    if (field_id == 0)
+    {
+        lua_pushnil(lua_state);
+        return 1;
+    }
+    lua_pushinteger(lua_state, field_id);
+    return 1;
+}
+
+// avant.FlowFieldDir(fieldId, x, y) -> dx, dy | nil
+// (x,y)下一步的格子偏移 终点为0, 0 到不了终点 场已淘汰或网格已变化返回nil
+int lua_plugin::FlowFieldDir(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 3);
+    for (int i = 1; i <= 3; ++i)
+    {
+        ASSERT_LOG_EXIT(lua_isnumber(lua_state, i));
+    }
+
+    int field_id = lua_tointeger(lua_state, 1);
+    int x = lua_tointeger(lua_state, 2);
+    int y = lua_tointeger(lua_state, 3);
+    lua_pop(lua_state, 3);
+
+    const map_flow_field_cache::field *field = lua_plugin_find_flow_field(field_id);
+    const uint8_t d = field ? field->dir_at(x, y) : (uint8_t)map_flow_field_cache::DIR_NONE;
+    if (d == map_flow_field_cache::DIR_NONE)
+    {
+        lua_pushnil(lua_state);
+        return 1;
+    }
+    int dx = 0, dy = 0;
+    map_flow_field_cache::dir_delta(d, dx, dy);
+    lua_pushinteger(lua_state, dx);
+    lua_pushinteger(lua_state, dy);
+    return 2;
+}
+
+// avant.FlowFieldDirs(fieldId, points, out) -> count|nil
+// points为x1, y1, x2, y2...平铺的格子 每格的偏移按dx, dy写入out 终点与到不了终点的格子都为0, 0
+// 场已淘汰或网格已变化返回nil 一次调用查完一群实体
+int lua_plugin::FlowFieldDirs(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 3);
+    ASSERT_LOG_EXIT(lua_istable(lua_state, 3)); // out
+    ASSERT_LOG_EXIT(lua_istable(lua_state, 2)); // points
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // fieldId
+
+    int field_id = lua_tointeger(lua_state, 1);
+    const map_flow_field_cache::field *field = lua_plugin_find_flow_field(field_id);
+    if (!field)
+    {
+        lua_pop(lua_state, 3);
+        lua_pushnil(lua_state);
+        return 1;
+    }
+
+    const size_t count = lua_rawlen(lua_state, 2) / 2;
+    for (size_t i = 0; i < count; ++i)
+    {
+        lua_rawgeti(lua_state, 2, i * 2 + 1);
+        lua_rawgeti(lua_state, 2, i * 2 + 2);
+        const int x = lua_tointeger(lua_state, -2);
+        const int y = lua_tointeger(lua_state, -1);
+        lua_pop(lua_state, 2);
+
+        int dx = 0, dy = 0;
+        map_flow_field_cache::dir_delta(field->dir_at(x, y), dx, dy);
+        lua_pushinteger(lua_state, dx);
+        lua_rawseti(lua_state, 3, i * 2 + 1);
+        lua_pushinteger(lua_state, dy);
+        lua_rawseti(lua_state, 3, i * 2 + 2);
+    }
+    lua_pushnil(lua_state);
+    lua_rawseti(lua_state, 3, count * 2 + 1);
+    lua_pop(lua_state, 3);
+    lua_pushinteger(lua_state, count);
+    return 1;
+}
+
+// avant.FlowFieldStat() -> requests, cacheHits, builds, visited
+// 取出并清零统计
+int lua_plugin::FlowFieldStat(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 0);
+
+    map_flow_field_cache::stat stat = singleton<map_flow_field_cache>::instance()->take_stat();
+    lua_pushinteger(lua_state, stat.requests);
+    lua_pushinteger(lua_state, stat.cache_hits);
+    lua_pushinteger(lua_state, stat.builds);
+    lua_pushinteger(lua_state, stat.visited);
+    return 4;
 }
 
-void lua_plugin::exe_OnOtherInit()
+// avant.InputBufferCreate(delaySteps, reorderSteps) -> bufferId
+// 给Lua自己积分的地图用的输入抖动缓冲
+int lua_plugin::InputBufferCreate(lua_State *lua_state)
 {
-    static int isok = LUA_OK;
-    // 添加错误处理函数
-    int err_msgh = lua_plugin_push_lua_error_handler(this->other_lua_state);
-    lua_getglobal(this->other_lua_state, "OnOtherInit");
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 2);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 2)); // reorderSteps
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // delaySteps
 
-    isok = lua_pcall(this->other_lua_state, 0, 0, err_msgh);
-    // 移除错误处理函数
-    lua_remove(this->other_lua_state, err_msgh);
-    ASSERT_LOG_EXIT(isok == LUA_OK);
+    int delay_steps = lua_tointeger(lua_state, 1);
+    int reorder_steps = lua_tointeger(lua_state, 2);
+    lua_pop(lua_state, 2);
+
+    lua_pushinteger(lua_state, singleton<map_input_buffer_mgr>::instance()->create(delay_steps, reorder_steps));
+    return 1;
 }
 
-void lua_plugin::exe_OnOtherStop()
+// avant.InputBufferDestroy(bufferId) -> integer
+int lua_plugin::InputBufferDestroy(lua_State *lua_state)
 {
-    static int isok = LUA_OK;
-    // 添加错误处理函数
-    int err_msgh = lua_plugin_push_lua_error_handler(this->other_lua_state);
-    lua_getglobal(this->other_lua_state, "OnOtherStop");
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 1);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // bufferId
 
-    isok = lua_pcall(this->other_lua_state, 0, 0, err_msgh);
-    // 移除错误处理函数
-    lua_remove(this->other_lua_state, err_msgh);
-    ASSERT_LOG_EXIT(isok == LUA_OK);
+    int buffer_id = lua_tointeger(lua_state, 1);
+    lua_pop(lua_state, 1);
+
+    singleton<map_input_buffer_mgr>::instance()->destroy(buffer_id);
+    lua_pushinteger(lua_state, 0);
+    return 1;
 }
 
-void lua_plugin::exe_OnOtherTick()
+// avant.InputBufferRemove(bufferId, handle) -> boolean
+// 丢弃实体暂存的输入 下次从seq 1开始
+int lua_plugin::InputBufferRemove(lua_State *lua_state)
 {
-    static int isok = LUA_OK;
-    // 添加错误处理函数
-    int err_msgh = lua_plugin_push_lua_error_handler(this->other_lua_state);
-    lua_getglobal(this->other_lua_state, "OnOtherTick");
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 2);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 2)); // handle
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // bufferId
 
-    isok = lua_pcall(this->other_lua_state, 0, 0, err_msgh);
-    // 移除错误处理函数
-    lua_remove(this->other_lua_state, err_msgh);
-    ASSERT_LOG_EXIT(isok == LUA_OK);
+    int buffer_id = lua_tointeger(lua_state, 1);
+    int handle = lua_tointeger(lua_state, 2);
+    lua_pop(lua_state, 2);
+
+    map_input_buffer *buffer = singleton<map_input_buffer_mgr>::instance()->get(buffer_id);
+    if (buffer)
+    {
+        buffer->remove(handle);
+    }
+    lua_pushboolean(lua_state, buffer != nullptr);
+    return 1;
 }
 
-void lua_plugin::exe_OnOtherReload()
+// avant.InputBufferPush(bufferId, handle, dirX, dirY, dirZ, seq, clientTime) -> result
+// result为0排队 1重复 2迟到 3丢弃
+int lua_plugin::InputBufferPush(lua_State *lua_state)
 {
-    static int isok = LUA_OK;
-    // 添加错误处理函数
-    int err_msgh = lua_plugin_push_lua_error_handler(this->other_lua_state);
-    lua_getglobal(this->other_lua_state, "OnOtherReload");
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 7);
+    ASSERT_LOG_EXIT(lua_isstring(lua_state, 7)); // clientTime
+    for (int i = 1; i <= 6; ++i)
+    {
+        ASSERT_LOG_EXIT(lua_isnumber(lua_state, i));
+    }
 
-    isok = lua_pcall(this->other_lua_state, 0, 0, err_msgh);
-    // 移除错误处理函数
-    lua_remove(this->other_lua_state, err_msgh);
-    ASSERT_LOG_EXIT(isok == LUA_OK);
+    int buffer_id = lua_tointeger(lua_state, 1);
+    int handle = lua_tointeger(lua_state, 2);
+    double dir_x = lua_tonumber(lua_state, 3);
+    double dir_y = lua_tonumber(lua_state, 4);
+    double dir_z = lua_tonumber(lua_state, 5);
+    uint32_t seq = (uint32_t)lua_tointeger(lua_state, 6);
+    uint64_t client_time = std::strtoull(lua_tostring(lua_state, 7), nullptr, 10);
+    lua_pop(lua_state, 7);
+
+    map_input_buffer *buffer = singleton<map_input_buffer_mgr>::instance()->get(buffer_id);
+    map_input_buffer::push_result result = map_input_buffer::PUSH_DROPPED;
+    if (buffer)
+    {
+        result = buffer->push(handle, seq, dir_x, dir_y, dir_z, client_time);
+    }
+    lua_pushinteger(lua_state, (int)result);
+    return 1;
 }
 
-void lua_plugin::main_mount()
+// avant.InputBufferStep(bufferId, out) -> count
+// 推进一步 本步应用的输入按handle, dirX, dirY, dirZ, seq, clientTime每6个一组依次写入out
+int lua_plugin::InputBufferStep(lua_State *lua_state)
 {
-    static luaL_Reg main_lulibs[] = {
-        {"Logger", Logger},
-        {"Lua2Protobuf", Lua2Protobuf},
-        {"CreateNewProtobufByCmd", CreateNewProtobufByCmd},
-        {"HighresTime", HighresTime},
-        {"Monotonic", Monotonic},
-        {NULL, NULL}};
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 2);
+    ASSERT_LOG_EXIT(lua_istable(lua_state, 2));  // out
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // bufferId
+
+    int buffer_id = lua_tointeger(lua_state, 1);
+    map_input_buffer *buffer = singleton<map_input_buffer_mgr>::instance()->get(buffer_id);
+
+    static std::vector<map_input_buffer::input> ready;
+    ready.clear();
+    if (buffer)
     {
-        // mount main lua vm
-        luaL_newlib(this->lua_state, main_lulibs);
+        buffer->step(ready);
+    }
 
-        lua_pushstring(this->lua_state, this->lua_dir.c_str());
-        lua_setfield(this->lua_state, -2, "LuaDir");
+    int idx = 0;
+    for (const map_input_buffer::input &in : ready)
+    {
+        lua_pushinteger(lua_state, in.handle);
+        lua_rawseti(lua_state, 2, ++idx);
+        lua_pushnumber(lua_state, in.dir_x);
+        lua_rawseti(lua_state, 2, ++idx);
+        lua_pushnumber(lua_state, in.dir_y);
+        lua_rawseti(lua_state, 2, ++idx);
+        lua_pushnumber(lua_state, in.dir_z);
+        lua_rawseti(lua_state, 2, ++idx);
+        lua_pushinteger(lua_state, in.seq);
+        lua_rawseti(lua_state, 2, ++idx);
+        lua_pushstring(lua_state, std::to_string(in.client_time).c_str());
+        lua_rawseti(lua_state, 2, ++idx);
+    }
+    lua_pushnil(lua_state);
+    lua_rawseti(lua_state, 2, idx + 1);
+    lua_pop(lua_state, 2);
 
-        lua_pushstring(this->lua_state, this->app_id.c_str());
-        lua_setfield(this->lua_state, -2, "AppID");
+    lua_pushinteger(lua_state, (int)ready.size());
+    return 1;
+}
 
-        lua_setglobal(this->lua_state, "avant");
+// avant.InputBufferStat(bufferId) -> applied, late, dropped, duplicate, skipped | nil
+// 返回上次调用以来的累计值并清零
+int lua_plugin::InputBufferStat(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 1);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // bufferId
+
+    int buffer_id = lua_tointeger(lua_state, 1);
+    lua_pop(lua_state, 1);
+
+    map_input_buffer *buffer = singleton<map_input_buffer_mgr>::instance()->get(buffer_id);
+    if (!buffer)
+    {
+        lua_pushnil(lua_state);
+        return 1;
     }
+    return lua_plugin_push_input_stat(lua_state, buffer->take_stat());
 }
 
-void lua_plugin::worker_mount(int worker_idx)
+// avant.FSFrameStoreCreate(capacityFrames, capacityBytes) -> storeId
+int lua_plugin::FSFrameStoreCreate(lua_State *lua_state)
 {
-    static luaL_Reg worker_lulibs[] = {
-        {"Logger", Logger},
-        {"Lua2Protobuf", Lua2Protobuf},
-        {"CreateNewProtobufByCmd", CreateNewProtobufByCmd},
-        {"HighresTime", HighresTime},
-        {"Monotonic", Monotonic},
-        {NULL, NULL}};
-    luaL_newlib(this->worker_lua_state[worker_idx], worker_lulibs);
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 2);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 2)); // capacityBytes
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // capacityFrames
 
-    lua_pushstring(this->worker_lua_state[worker_idx], this->lua_dir.c_str());
-    lua_setfield(this->worker_lua_state[worker_idx], -2, "LuaDir");
+    int capacity_frames = lua_tointeger(lua_state, 1);
+    lua_Integer capacity_bytes = lua_tointeger(lua_state, 2);
+    lua_pop(lua_state, 2);
 
-    lua_pushstring(this->worker_lua_state[worker_idx], this->app_id.c_str());
-    lua_setfield(this->worker_lua_state[worker_idx], -2, "AppID");
+    lua_pushinteger(lua_state, singleton<fs_frame_store_mgr>::instance()->create(capacity_frames,
+                                                                                 capacity_bytes > 0 ? (size_t)capacity_bytes : 0));
+    return 1;
+}
 
-    lua_setglobal(this->worker_lua_state[worker_idx], "avant");
+// avant.FSFrameStoreDestroy(storeId) -> integer
+int lua_plugin::FSFrameStoreDestroy(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 1);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // storeId
+
+    int store_id = lua_tointeger(lua_state, 1);
+    lua_pop(lua_state, 1);
+
+    singleton<fs_frame_store_mgr>::instance()->destroy(store_id);
+    lua_pushinteger(lua_state, 0);
+    return 1;
 }
 
-void lua_plugin::other_mount()
+// avant.FSFrameStoreAppend(storeId, frameId, timestamp, commands, broadcastId) -> bytes | nil
+// commands为{userId, commandType, data}数组 编码成ProtoFSFrame存入 返回编码后的字节数 帧号不连续或超出容量返回nil
+// broadcastId非0时同一份编码一并放进广播窗口
+int lua_plugin::FSFrameStoreAppend(lua_State *lua_state)
 {
-    static luaL_Reg other_lulibs[] = {
-        {"Logger", Logger},
-        {"Lua2Protobuf", Lua2Protobuf},
-        {"CreateNewProtobufByCmd", CreateNewProtobufByCmd},
-        {"HighresTime", HighresTime},
-        {"Monotonic", Monotonic},
-        {NULL, NULL}};
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 5);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 5)); // broadcastId
+    ASSERT_LOG_EXIT(lua_istable(lua_state, 4));  // commands
+    ASSERT_LOG_EXIT(lua_isstring(lua_state, 3)); // timestamp
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 2)); // frameId
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // storeId
+
+    // 复用消息与缓冲 每帧不重新分配
+    static ProtoFSFrame frame;
+    static std::string encoded;
+    frame.Clear();
+    int store_id = lua_tointeger(lua_state, 1);
+    uint32_t frame_id = (uint32_t)lua_tointeger(lua_state, 2);
+    int broadcast_id = lua_tointeger(lua_state, 5);
+    frame.set_frameid(frame_id);
+    frame.set_timestamp(std::strtoull(lua_tostring(lua_state, 3), nullptr, 10));
+    const int command_cnt = lua_rawlen(lua_state, 4);
+    for (int i = 1; i <= command_cnt; ++i)
     {
-        luaL_newlib(this->other_lua_state, other_lulibs);
+        lua_rawgeti(lua_state, 4, i);
+        if (lua_istable(lua_state, -1))
+        {
+            ProtoFSFrameCommand *command = frame.add_commands();
+            size_t len = 0;
+            const char *str = nullptr;
+            lua_getfield(lua_state, -1, "userId");
+            if ((str = lua_tolstring(lua_state, -1, &len)))
+            {
+                command->set_userid(str, len);
+            }
+            lua_pop(lua_state, 1);
+            lua_getfield(lua_state, -1, "commandType");
+            if ((str = lua_tolstring(lua_state, -1, &len)))
+            {
+                command->set_commandtype(str, len);
+            }
+            lua_pop(lua_state, 1);
+            lua_getfield(lua_state, -1, "data");
+            if ((str = lua_tolstring(lua_state, -1, &len)))
+            {
+                command->set_data(str, len);
+            }
+            lua_pop(lua_state, 1);
+        }
+        lua_pop(lua_state, 1);
+    }
+    lua_pop(lua_state, 5);
 
-        lua_pushstring(this->other_lua_state, this->lua_dir.c_str());
-        lua_setfield(this->other_lua_state, -2, "LuaDir");
+    encoded.clear();
+    frame.SerializeToString(&encoded);
+    fs_frame_store *store = singleton<fs_frame_store_mgr>::instance()->get(store_id);
+    if (!store || !store->append(frame_id, encoded))
+    {
+        LOG_ERROR("FSFrameStoreAppend failed storeId {} frameId {} bytes {}", store_id, frame_id, encoded.size());
+        lua_pushnil(lua_state);
+        return 1;
+    }
+    if (fs_frame_broadcast *broadcast = singleton<fs_frame_broadcast_mgr>::instance()->get(broadcast_id))
+    {
+        broadcast->push(frame, encoded);
+    }
+    lua_pushinteger(lua_state, encoded.size());
+    return 1;
+}
 
-        lua_pushstring(this->other_lua_state, this->app_id.c_str());
-        lua_setfield(this->other_lua_state, -2, "AppID");
+// avant.FSFrameStoreSince(storeId, frameId) -> blob, count | nil
+// frameId之后的所有帧 blob可以直接作为ProtoCSFSNotifyFrames的编码 frameId已被淘汰返回nil
+int lua_plugin::FSFrameStoreSince(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 2);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 2)); // frameId
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // storeId
+
+    int store_id = lua_tointeger(lua_state, 1);
+    uint32_t frame_id = (uint32_t)lua_tointeger(lua_state, 2);
+    lua_pop(lua_state, 2);
+
+    std::string blob;
+    fs_frame_store *store = singleton<fs_frame_store_mgr>::instance()->get(store_id);
+    int count = store ? store->frames_since(frame_id, blob) : -1;
+    if (count < 0)
+    {
+        lua_pushnil(lua_state);
+        return 1;
+    }
+    lua_pushlstring(lua_state, blob.data(), blob.size());
+    lua_pushinteger(lua_state, count);
+    return 2;
+}
 
-        lua_setglobal(this->other_lua_state, "avant");
+// avant.FSFrameStoreSendSince(storeId, frameId, clientGID, workerIdx) -> count
+// 把frameId之后的所有帧作为PROTO_CMD_CS_FS_NOTIFY_FRAMES发给客户端 不重新编码
+// 返回发出的帧数 没有新帧返回0不发送 frameId已被淘汰返回-1
+int lua_plugin::FSFrameStoreSendSince(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 4);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 4)); // workerIdx
+    ASSERT_LOG_EXIT(lua_isstring(lua_state, 3)); // clientGID
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 2)); // frameId
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // storeId
+
+    int store_id = lua_tointeger(lua_state, 1);
+    uint32_t frame_id = (uint32_t)lua_tointeger(lua_state, 2);
+    uint64_t gid = std::strtoull(lua_tostring(lua_state, 3), nullptr, 10);
+    int worker_idx = lua_tointeger(lua_state, 4);
+    lua_pop(lua_state, 4);
+
+    std::string blob;
+    fs_frame_store *store = singleton<fs_frame_store_mgr>::instance()->get(store_id);
+    int count = store ? store->frames_since(frame_id, blob) : -1;
+    if (count > 0)
+    {
+        app_metrics::add_cmd(singleton<app_metrics>::instance()->other_slot().cmd_send_total, ProtoCmd::PROTO_CMD_CS_FS_NOTIFY_FRAMES);
+        send_encoded_to_client(gid, worker_idx, ProtoCmd::PROTO_CMD_CS_FS_NOTIFY_FRAMES, blob);
     }
+    lua_pushinteger(lua_state, count);
+    return 1;
 }
 
-// 返回三个值：1) seconds (integer), 2) milliseconds (integer), 3) nanoseconds_part (integer)
-int lua_plugin::HighresTime(lua_State *lua_state)
+// avant.FSFrameStoreStat(storeId) -> firstFrameId, lastFrameId, frames, bytes | nil
+// 没有帧时frames为0 帧号无意义
+int lua_plugin::FSFrameStoreStat(lua_State *lua_state)
 {
-    using namespace std::chrono;
-    auto now = system_clock::now();
-    auto ns = duration_cast<nanoseconds>(now.time_since_epoch()).count();
-    auto seconds = ns / 1000000000;
-    auto nanoseconds_part = ns % 1000000000;
-    auto milliseconds = ns / 1000000;
-    lua_pushnumber(lua_state, seconds); // push seconds
-    lua_pushnumber(lua_state, milliseconds); // push milliseconds
-    lua_pushnumber(lua_state, nanoseconds_part); // pushes nanoseconds_part
-    return 3;
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 1);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // storeId
+
+    int store_id = lua_tointeger(lua_state, 1);
+    lua_pop(lua_state, 1);
+
+    fs_frame_store *store = singleton<fs_frame_store_mgr>::instance()->get(store_id);
+    if (!store)
+    {
+        lua_pushnil(lua_state);
+        return 1;
+    }
+    lua_pushinteger(lua_state, store->first_frame_id());
+    lua_pushinteger(lua_state, store->last_frame_id());
+    lua_pushinteger(lua_state, store->frame_count());
+    lua_pushinteger(lua_state, store->used_bytes());
+    return 4;
 }
 
-// 返回单个值：monotonic milliseconds (integer)
-int lua_plugin::Monotonic(lua_State *lua_state)
+// avant.FSBroadcastCreate(redundancy) -> broadcastId
+// 每个广播包携带最近redundancy帧
+int lua_plugin::FSBroadcastCreate(lua_State *lua_state)
 {
-    using namespace std::chrono;
-    auto now = steady_clock::now();
-    auto ms = duration_cast<milliseconds>(now.time_since_epoch()).count();
-    lua_pushnumber(lua_state, ms);
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 1);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // redundancy
+
+    int redundancy = lua_tointeger(lua_state, 1);
+    lua_pop(lua_state, 1);
+
+    lua_pushinteger(lua_state, singleton<fs_frame_broadcast_mgr>::instance()->create(redundancy));
     return 1;
 }
 
-int lua_plugin::Logger(lua_State *lua_state)
+// avant.FSBroadcastDestroy(broadcastId) -> integer
+int lua_plugin::FSBroadcastDestroy(lua_State *lua_state)
 {
     int num = lua_gettop(lua_state);
     ASSERT_LOG_EXIT(num == 1);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // broadcastId
 
-    int isok = LUA_OK;
-    isok = lua_isstring(lua_state, 1);
-    ASSERT_LOG_EXIT(isok);
-
-    size_t len = 0;
-    const char *type = lua_tolstring(lua_state, 1, &len);
-    std::string str(type, len);
-    LOG_ERROR("lua => {}", str.data());
+    int broadcast_id = lua_tointeger(lua_state, 1);
     lua_pop(lua_state, 1);
+
+    singleton<fs_frame_broadcast_mgr>::instance()->destroy(broadcast_id);
     lua_pushinteger(lua_state, 0);
     return 1;
 }
 
-// avant.CreateNewProtobufByCmd(Cmd) -> table:Message|nil
-int lua_plugin::CreateNewProtobufByCmd(lua_State *lua_state)
+// avant.FSBroadcastSend(broadcastId, members, behindOut) -> sent
+// members按clientGID, workerIdx, lastFrameId每3个一组 lastFrameId为成员已确认的帧
+// 当前窗口包作为PROTO_CMD_CS_FS_NOTIFY_FRAME_WINDOW发给未确认最新帧的成员 所有成员共用同一份编码
+// 落后超出窗口的成员不发 其组下标(从1开始)写入behindOut 由调用方从历史帧补发
+int lua_plugin::FSBroadcastSend(lua_State *lua_state)
+{
+    int num = lua_gettop(lua_state);
+    ASSERT_LOG_EXIT(num == 3);
+    ASSERT_LOG_EXIT(lua_istable(lua_state, 3)); // behindOut
+    ASSERT_LOG_EXIT(lua_istable(lua_state, 2)); // members
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // broadcastId
+
+    int broadcast_id = lua_tointeger(lua_state, 1);
+    fs_frame_broadcast *broadcast = singleton<fs_frame_broadcast_mgr>::instance()->get(broadcast_id);
+    int sent = 0;
+    int behind_cnt = 0;
+    const int member_cnt = broadcast ? (int)lua_rawlen(lua_state, 2) / 3 : 0;
+    for (int i = 0; i < member_cnt; ++i)
+    {
+        lua_rawgeti(lua_state, 2, i * 3 + 1);
+        lua_rawgeti(lua_state, 2, i * 3 + 2);
+        lua_rawgeti(lua_state, 2, i * 3 + 3);
+        const char *gid_str = lua_tostring(lua_state, -3);
+        uint64_t gid = gid_str ? std::strtoull(gid_str, nullptr, 10) : 0;
+        int worker_idx = lua_tointeger(lua_state, -2);
+        uint32_t acked_frame_id = (uint32_t)lua_tointeger(lua_state, -1);
+        lua_pop(lua_state, 3);
+        // 没有绑定连接的成员不发
+        if (gid == 0)
+        {
+            continue;
+        }
+
+        fs_frame_broadcast::send_result result = broadcast->on_send(acked_frame_id);
+        if (result == fs_frame_broadcast::SEND_PACKET)
+        {
+            app_metrics::add_cmd(singleton<app_metrics>::instance()->other_slot().cmd_send_total,
+                                 ProtoCmd::PROTO_CMD_CS_FS_NOTIFY_FRAME_WINDOW);
+            send_encoded_to_client(gid, worker_idx, ProtoCmd::PROTO_CMD_CS_FS_NOTIFY_FRAME_WINDOW, broadcast->packet());
+            ++sent;
+        }
+        else if (result == fs_frame_broadcast::SEND_BEHIND)
+        {
+            lua_pushinteger(lua_state, i + 1);
+            lua_rawseti(lua_state, 3, ++behind_cnt);
+        }
+    }
+    lua_pushnil(lua_state);
+    lua_rawseti(lua_state, 3, behind_cnt + 1);
+    lua_pop(lua_state, 3);
+
+    lua_pushinteger(lua_state, sent);
+    return 1;
+}
+
+// avant.FSBroadcastStat(broadcastId) -> packets, bytes, frames, redundantFrames, redundancyHits, windowMisses, deltaSavedBytes | nil
+// 取出并清零统计
+int lua_plugin::FSBroadcastStat(lua_State *lua_state)
 {
     int num = lua_gettop(lua_state);
     ASSERT_LOG_EXIT(num == 1);
+    ASSERT_LOG_EXIT(lua_isnumber(lua_state, 1)); // broadcastId
 
-    int isok = lua_isnumber(lua_state, 1);
-    ASSERT_LOG_EXIT(isok);
+    int broadcast_id = lua_tointeger(lua_state, 1);
+    lua_pop(lua_state, 1);
 
-    int cmd = lua_tonumber(lua_state, 1);
-    lua_pop(lua_state, 1); // pop cmd
+    fs_frame_broadcast *broadcast = singleton<fs_frame_broadcast_mgr>::instance()->get(broadcast_id);
+    if (!broadcast)
+    {
+        lua_pushnil(lua_state);
+        return 1;
+    }
+    fs_frame_broadcast::stat stat = broadcast->take_stat();
+    lua_pushinteger(lua_state, stat.packets);
+    lua_pushinteger(lua_state, stat.bytes);
+    lua_pushinteger(lua_state, stat.frames);
+    lua_pushinteger(lua_state, stat.redundant_frames);
+    lua_pushinteger(lua_state, stat.redundancy_hits);
+    lua_pushinteger(lua_state, stat.window_misses);
+    lua_pushinteger(lua_state, stat.delta_saved_bytes);
+    return 7;
+}
 
-    std::shared_ptr<google::protobuf::Message> msg_ptr = singleton<lua_plugin>::instance()->protobuf_cmd2message(cmd);
-    if (msg_ptr) // return table:message
+void lua_plugin::send_to_client(uint64_t gid, int worker_idx, int cmd, const google::protobuf::Message &msg)
+{
+    // cmd配置为走UDP会话且客户端UDP地址已绑定时由UDP会话发出
+    if (singleton<udp_session_mgr>::instance()->try_send(gid, worker_idx, cmd, msg))
     {
-        int old_lua_stack_size = lua_gettop(lua_state);
-        protobuf2lua_nostack(lua_state, *msg_ptr);
-        int new_lua_stack_size = lua_gettop(lua_state);
-        ASSERT_LOG_EXIT(old_lua_stack_size == new_lua_stack_size - 1);
+        return;
     }
-    else // return nil
+
+    ProtoTunnelOtherLuaVM2WorkerConn tunnelOtherVM2WorkerConn;
+    tunnelOtherVM2WorkerConn.set_gid(gid);
+    tunnelOtherVM2WorkerConn.set_workeridx(worker_idx);
+    avant::proto::pack_package(*tunnelOtherVM2WorkerConn.mutable_innerprotopackage(), msg, (avant::ProtoCmd)cmd);
+
+    ProtoPackage resPackage;
+    singleton<lua_plugin>::instance()->ptr_other_obj->tunnel_forward(
+        std::vector{avant::global::tunnel_id::get().get_worker_tunnel_id(worker_idx)},
+        avant::proto::pack_package(resPackage, tunnelOtherVM2WorkerConn, ProtoCmd::PROTO_CMD_TUNNEL_OTHERLUAVM2WORKERCONN));
+    app_metrics::add(singleton<app_metrics>::instance()->other_slot().tunnel_send_total);
+}
+
+void lua_plugin::send_encoded_to_client(uint64_t gid, int worker_idx, int cmd, const std::string &protocol)
+{
+    if (singleton<udp_session_mgr>::instance()->try_send_encoded(gid, worker_idx, cmd, protocol))
     {
-        lua_pushnil(lua_state);
+        return;
     }
 
-    return 1; // return one variable
+    ProtoTunnelOtherLuaVM2WorkerConn tunnelOtherVM2WorkerConn;
+    tunnelOtherVM2WorkerConn.set_gid(gid);
+    tunnelOtherVM2WorkerConn.set_workeridx(worker_idx);
+    ProtoPackage *inner = tunnelOtherVM2WorkerConn.mutable_innerprotopackage();
+    inner->set_cmd((avant::ProtoCmd)cmd);
+    inner->set_protocol(protocol);
+
+    ProtoPackage resPackage;
+    singleton<lua_plugin>::instance()->ptr_other_obj->tunnel_forward(
+        std::vector{avant::global::tunnel_id::get().get_worker_tunnel_id(worker_idx)},
+        avant::proto::pack_package(resPackage, tunnelOtherVM2WorkerConn, ProtoCmd::PROTO_CMD_TUNNEL_OTHERLUAVM2WORKERCONN));
+    app_metrics::add(singleton<app_metrics>::instance()->other_slot().tunnel_send_total);
 }
 
 // 此处只是测试 lua其实不应该直接调用 lua_plugin::Lua2Protobuf
@@ -812,22 +3562,16 @@ int lua_plugin::Lua2Protobuf(lua_State *lua_state)
                                int64_param2,
                                msg_ptr->DebugString().c_str());
 
+        app_metrics::add_cmd(singleton<app_metrics>::instance()->other_slot().cmd_send_total, cmd);
+
         // 在这里处理lua发来的包
         if (msg_type == 1) // 发给客户端连接的包
         {
-            ProtoTunnelOtherLuaVM2WorkerConn tunnelOtherVM2WorkerConn;
-            tunnelOtherVM2WorkerConn.set_gid(uint64_param1);
-            tunnelOtherVM2WorkerConn.set_workeridx(int64_param2);
-            avant::proto::pack_package(*tunnelOtherVM2WorkerConn.mutable_innerprotopackage(), *msg_ptr, (avant::ProtoCmd)cmd);
-
-            ProtoPackage resPackage;
-            singleton<lua_plugin>::instance()->ptr_other_obj->tunnel_forward(
-                std::vector{avant::global::tunnel_id::get().get_worker_tunnel_id(int64_param2)},
-                avant::proto::pack_package(resPackage, tunnelOtherVM2WorkerConn, ProtoCmd::PROTO_CMD_TUNNEL_OTHERLUAVM2WORKERCONN));
+            send_to_client(uint64_param1, int64_param2, cmd, *msg_ptr);
         }
         else if (msg_type == 2) // ipc
         {
-            avant::app::other_app::other_lua_send_ipc_package(str_param3, cmd, *msg_ptr);
+            avant::app::other_app::other_lua_send_ipc_package(int64_param2, cmd, *msg_ptr);
         }
         else if (msg_type == 3)
         {
@@ -1248,7 +3992,9 @@ void lua_plugin::lua2protobuf_nostack(lua_State *L, const google::protobuf::Mess
                         if (lua_isstring(L, -1))
                         {
                             LOG_LUA_PLUGIN_RUNTIME("{}", lua_tostring(L, -1));
-                            reflection->AddString(frame.package_ptr, field, lua_tostring(L, -1));
+                            size_t len = 0;
+                            const char *str = lua_tolstring(L, -1, &len);
+                            reflection->AddString(frame.package_ptr, field, std::string(str, len));
                         }
                         lua_pop(L, 1);
                     }
@@ -1258,7 +4004,10 @@ void lua_plugin::lua2protobuf_nostack(lua_State *L, const google::protobuf::Mess
                     if (lua_isstring(L, -1))
                     {
                         LOG_LUA_PLUGIN_RUNTIME("{}", lua_tostring(L, -1));
-                        reflection->SetString(frame.package_ptr, field, lua_tostring(L, -1));
+                        // bytes字段可能含0 按长度取
+                        size_t len = 0;
+                        const char *str = lua_tolstring(L, -1, &len);
+                        reflection->SetString(frame.package_ptr, field, std::string(str, len));
                     }
                 }
                 lua_pop(L, 1); // field_val
@@ -1773,6 +4522,11 @@ void lua_plugin::init_message_factory()
 {
     REGISTER_MSG(ProtoCmd::PROTO_CMD_LUA_TEST, ProtoLuaTest);
 
+    REGISTER_MSG(ProtoCmd::PROTO_CMD_IPC_RPC_TIMEOUT, ProtoIPCRPCTimeout);
+    REGISTER_MSG(ProtoCmd::PROTO_CMD_IPC_MAP_HANDOFF_STATE, ProtoIPCMapHandoffState);
+    REGISTER_MSG(ProtoCmd::PROTO_CMD_IPC_MAP_HANDOFF_DELTA, ProtoIPCMapHandoffDelta);
+    REGISTER_MSG(ProtoCmd::PROTO_CMD_IPC_MAP_HANDOFF_ACK, ProtoIPCMapHandoffAck);
+
     REGISTER_MSG(ProtoCmd::PROTO_CMD_CS_REQ_EXAMPLE, ProtoCSReqExample);
     REGISTER_MSG(ProtoCmd::PROTO_CMD_CS_RES_EXAMPLE, ProtoCSResExample);
 
@@ -1790,6 +4544,14 @@ void lua_plugin::init_message_factory()
     REGISTER_MSG(ProtoCmd::PROTO_CMD_CS_RES_MAP_PONG, ProtoCSResMapPong);
     REGISTER_MSG(ProtoCmd::PROTO_CMD_CS_REQ_MAP_INPUT, ProtoCSReqMapInput);
     REGISTER_MSG(ProtoCmd::PROTO_CMD_CS_MAP_NOTIFY_STATE_DATA, ProtoCSMapNotifyStateData);
+    REGISTER_MSG(ProtoCmd::PROTO_CMD_CS_MAP_NOTIFY_SNAPSHOT, ProtoCSMapNotifySnapshot);
+    REGISTER_MSG(ProtoCmd::PROTO_CMD_CS_REQ_MAP_SNAPSHOT_ACK, ProtoCSReqMapSnapshotAck);
+    REGISTER_MSG(ProtoCmd::PROTO_CMD_CS_MAP_NOTIFY_REDIRECT, ProtoCSMapNotifyRedirect);
+    REGISTER_MSG(ProtoCmd::PROTO_CMD_CS_FS_NOTIFY_FRAMES, ProtoCSFSNotifyFrames);
+    REGISTER_MSG(ProtoCmd::PROTO_CMD_CS_FS_NOTIFY_FRAME_WINDOW, ProtoCSFSNotifyFrames);
+    REGISTER_MSG(ProtoCmd::PROTO_CMD_CS_REQ_FS_ROOM_JOIN, ProtoCSReqFSRoomJoin);
+    REGISTER_MSG(ProtoCmd::PROTO_CMD_CS_RES_FS_ROOM_JOIN, ProtoCSResFSRoomJoin);
+    REGISTER_MSG(ProtoCmd::PROTO_CMD_CS_REQ_FS_FRAME_ACK, ProtoCSReqFSFrameAck);
     REGISTER_MSG(ProtoCmd::PROTO_CMD_CS_MAP_ENTER_REQ, ProtoCSMapEnterReq);
     REGISTER_MSG(ProtoCmd::PROTO_CMD_CS_MAP_ENTER_RES, ProtoCSMapEnterRes);
     REGISTER_MSG(ProtoCmd::PROTO_CMD_CS_MAP_LEAVE_REQ, ProtoCSMapLeaveReq);
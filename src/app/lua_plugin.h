@@ -2,6 +2,8 @@
 #include <string>
 #include <memory>
 #include <unordered_map>
+#include <vector>
+#include <utility>
 #include <functional>
 #include "proto/proto_util.h"
 #include "workers/other.h"
@@ -58,12 +60,29 @@ namespace avant::app
                                                  int worker_idx);
         void on_other_lua_vm_recv_ipc_message(int cmd,
                                               const google::protobuf::Message &package,
-                                              const std::string &app_id);
+                                              int peer_handle,
+                                              uint64_t rpc_id);
+        // 对端发来的IPC RPC请求 Lua处理后调用avant.IPCReply应答
+        void on_other_lua_vm_recv_ipc_request(int cmd,
+                                              const google::protobuf::Message &package,
+                                              int peer_handle,
+                                              uint64_t rpc_id);
         void on_other_lua_vm_recv_udp_message(int cmd,
                                               const google::protobuf::Message &package,
                                               const std::string &from_ip,
                                               int from_port);
 
+        // 返回HTTP状态码 0表示Lua未处理该请求 out_stream为true时响应体由Lua后续调用avant.HttpWrite/HttpEnd发出
+        int on_worker_lua_vm_http_request(int worker_idx,
+                                          uint64_t gid,
+                                          const std::string &method,
+                                          const std::string &path,
+                                          const std::unordered_map<std::string, std::vector<std::string>> &headers,
+                                          const std::string &body,
+                                          std::vector<std::pair<std::string, std::string>> &out_headers,
+                                          std::string &out_body,
+                                          bool &out_stream);
+
         void on_other_init(avant::workers::other *ptr_other_obj);
         void on_other_stop();
         void on_other_tick();
@@ -89,6 +108,101 @@ namespace avant::app
         static int CreateNewProtobufByCmd(lua_State *lua_state);
         static int HighresTime(lua_State *lua_state);
         static int Monotonic(lua_State *lua_state);
+        static int UDPSessionCreate(lua_State *lua_state);
+        static int UDPSessionSetCmdMode(lua_State *lua_state);
+        static int GetIPCPeerHandle(lua_State *lua_state);
+        static int IPCCall(lua_State *lua_state);
+        static int IPCReply(lua_State *lua_state);
+        static int HttpSetAPIPrefix(lua_State *lua_state);
+        static int HttpWrite(lua_State *lua_state);
+        static int HttpEnd(lua_State *lua_state);
+        static int QuadTreeCreate(lua_State *lua_state);
+        static int QuadTreeDestroy(lua_State *lua_state);
+        static int QuadTreeInsert(lua_State *lua_state);
+        static int QuadTreeUpdate(lua_State *lua_state);
+        static int QuadTreeRemove(lua_State *lua_state);
+        static int QuadTreeQuery(lua_State *lua_state);
+        static int VoxelIndexCreate(lua_State *lua_state);
+        static int VoxelIndexDestroy(lua_State *lua_state);
+        static int VoxelIndexInsert(lua_State *lua_state);
+        static int VoxelIndexUpdate(lua_State *lua_state);
+        static int VoxelIndexRemove(lua_State *lua_state);
+        static int VoxelIndexQueryBox(lua_State *lua_state);
+        static int VoxelIndexQuerySphere(lua_State *lua_state);
+        static int VoxelIndexQueryNearest(lua_State *lua_state);
+        static int AOICreate(lua_State *lua_state);
+        static int AOIDestroy(lua_State *lua_state);
+        static int AOIInsert(lua_State *lua_state);
+        static int AOIUpdate(lua_State *lua_state);
+        static int AOIRemove(lua_State *lua_state);
+        static int AOIFlush(lua_State *lua_state);
+        static int AOIFetch(lua_State *lua_state);
+        static int SnapshotCreate(lua_State *lua_state);
+        static int SnapshotDestroy(lua_State *lua_state);
+        static int SnapshotSetEntity(lua_State *lua_state);
+        static int SnapshotSetState(lua_State *lua_state);
+        static int SnapshotRemove(lua_State *lua_state);
+        static int SnapshotAck(lua_State *lua_state);
+        static int SnapshotSetClient(lua_State *lua_state);
+        static int SnapshotSetLOD(lua_State *lua_state);
+        static int SnapshotLODStat(lua_State *lua_state);
+        static int SnapshotSend(lua_State *lua_state);
+        static int PhysicsCreate(lua_State *lua_state);
+        static int PhysicsDestroy(lua_State *lua_state);
+        static int PhysicsAdd(lua_State *lua_state);
+        static int PhysicsRemove(lua_State *lua_state);
+        static int PhysicsSetCollision(lua_State *lua_state);
+        static int PhysicsSetInput(lua_State *lua_state);
+        static int PhysicsPushInput(lua_State *lua_state);
+        static int PhysicsSetInputDelay(lua_State *lua_state);
+        static int PhysicsInputStat(lua_State *lua_state);
+        static int PhysicsGet(lua_State *lua_state);
+        static int PhysicsExport(lua_State *lua_state);
+        static int PhysicsImport(lua_State *lua_state);
+        static int PhysicsStep(lua_State *lua_state);
+        static int MapSimCreate(lua_State *lua_state);
+        static int MapSimDestroy(lua_State *lua_state);
+        static int MapSimSetThreads(lua_State *lua_state);
+        static int MapSimTick(lua_State *lua_state);
+        static int MapSimStat(lua_State *lua_state);
+        static int TileGridCreate(lua_State *lua_state);
+        static int TileGridLoad(lua_State *lua_state);
+        static int TileGridSave(lua_State *lua_state);
+        static int TileGridDestroy(lua_State *lua_state);
+        static int TileGridInfo(lua_State *lua_state);
+        static int TileGridGetTile(lua_State *lua_state);
+        static int TileGridSetTile(lua_State *lua_state);
+        static int TileGridSetWalkable(lua_State *lua_state);
+        static int TileGridIsWalkable(lua_State *lua_state);
+        static int TileGridRaycast(lua_State *lua_state);
+        static int PathFind(lua_State *lua_state);
+        static int PathFindStat(lua_State *lua_state);
+        static int HPACreate(lua_State *lua_state);
+        static int HPADestroy(lua_State *lua_state);
+        static int HPAUpdate(lua_State *lua_state);
+        static int HPAFindPath(lua_State *lua_state);
+        static int HPAPoll(lua_State *lua_state);
+        static int HPAInfo(lua_State *lua_state);
+        static int FlowFieldGet(lua_State *lua_state);
+        static int FlowFieldDir(lua_State *lua_state);
+        static int FlowFieldDirs(lua_State *lua_state);
+        static int FlowFieldStat(lua_State *lua_state);
+        static int InputBufferCreate(lua_State *lua_state);
+        static int InputBufferDestroy(lua_State *lua_state);
+        static int InputBufferRemove(lua_State *lua_state);
+        static int InputBufferPush(lua_State *lua_state);
+        static int InputBufferStep(lua_State *lua_state);
+        static int InputBufferStat(lua_State *lua_state);
+        static int FSFrameStoreCreate(lua_State *lua_state);
+        static int FSFrameStoreDestroy(lua_State *lua_state);
+        static int FSFrameStoreAppend(lua_State *lua_state);
+        static int FSFrameStoreSince(lua_State *lua_state);
+        static int FSFrameStoreSendSince(lua_State *lua_state);
+        static int FSFrameStoreStat(lua_State *lua_state);
+        static int FSBroadcastCreate(lua_State *lua_state);
+        static int FSBroadcastDestroy(lua_State *lua_state);
+        static int FSBroadcastSend(lua_State *lua_state);
+        static int FSBroadcastStat(lua_State *lua_state);
 
     public:
         std::shared_ptr<google::protobuf::Message> protobuf_cmd2message(int cmd);
@@ -96,6 +210,11 @@ namespace avant::app
         static void lua2protobuf_nostack(lua_State *L, const google::protobuf::Message &package);
 
     private:
+        // other线程发给客户端连接 cmd配置为走UDP会话且地址已绑定时走UDP 否则经worker的TCP连接
+        static void send_to_client(uint64_t gid, int worker_idx, int cmd, const google::protobuf::Message &msg);
+        // 同send_to_client protocol为已编码好的协议体 不再序列化
+        static void send_encoded_to_client(uint64_t gid, int worker_idx, int cmd, const std::string &protocol);
+
         void free_main_lua();
         void free_worker_lua();
         void free_other_lua();
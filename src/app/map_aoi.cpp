@@ -0,0 +1,319 @@
+#include "app/map_aoi.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace avant::app;
+
+map_aoi::map_aoi(double x, double y, double w, double h, double enter_range, double leave_range)
+    : tree(x, y, w, h, map_quadtree::DEFAULT_MAX_DEPTH, map_quadtree::DEFAULT_LEAF_CAPACITY),
+      enter_range(enter_range > 0 ? enter_range : 0),
+      leave_range(std::max(leave_range, this->enter_range))
+{
+}
+
+bool map_aoi::in_range(const entity &a, const entity &b, double range) const
+{
+    return std::fabs(a.x - b.x) < range && std::fabs(a.y - b.y) < range;
+}
+
+void map_aoi::set_pending(int entity_idx)
+{
+    entity &e = this->entities[entity_idx];
+    if (!e.pending)
+    {
+        e.pending = true;
+        this->pending_entities.push_back(entity_idx);
+    }
+}
+
+void map_aoi::erase_visible(entity &e, int entity_idx)
+{
+    auto iter = std::find(e.visible.begin(), e.visible.end(), entity_idx);
+    if (iter != e.visible.end())
+    {
+        *iter = e.visible.back();
+        e.visible.pop_back();
+    }
+}
+
+int map_aoi::insert(double x, double y)
+{
+    int entity_idx = 0;
+    if (this->free_entities.size() > 0)
+    {
+        entity_idx = this->free_entities.back();
+        this->free_entities.pop_back();
+    }
+    else
+    {
+        entity_idx = (int)this->entities.size();
+        this->entities.emplace_back();
+    }
+
+    entity &e = this->entities[entity_idx];
+    e.x = x;
+    e.y = y;
+    e.alive = true;
+    e.tree_handle = this->tree.insert(x, y, 0);
+    if ((int)this->tree2entity.size() < e.tree_handle + 1)
+    {
+        this->tree2entity.resize(e.tree_handle + 1, -1);
+    }
+    this->tree2entity[e.tree_handle] = entity_idx;
+
+    e.enter_events.push_back(entity_idx);
+    set_pending(entity_idx);
+    if (!e.dirty)
+    {
+        e.dirty = true;
+        this->dirty_entities.push_back(entity_idx);
+    }
+    return entity_idx + 1;
+}
+
+bool map_aoi::update(int handle, double x, double y)
+{
+    int entity_idx = handle - 1;
+    if (entity_idx < 0 || entity_idx >= (int)this->entities.size() || !this->entities[entity_idx].alive)
+    {
+        return false;
+    }
+
+    entity &e = this->entities[entity_idx];
+    e.x = x;
+    e.y = y;
+    this->tree.update(e.tree_handle, x, y);
+    if (!e.dirty)
+    {
+        e.dirty = true;
+        this->dirty_entities.push_back(entity_idx);
+    }
+    return true;
+}
+
+bool map_aoi::remove(int handle)
+{
+    int entity_idx = handle - 1;
+    if (entity_idx < 0 || entity_idx >= (int)this->entities.size() || !this->entities[entity_idx].alive)
+    {
+        return false;
+    }
+
+    entity &e = this->entities[entity_idx];
+    for (int other_idx : e.visible)
+    {
+        entity &other = this->entities[other_idx];
+        erase_visible(other, entity_idx);
+        other.leave_events.push_back(entity_idx);
+        set_pending(other_idx);
+    }
+
+    this->tree.remove(e.tree_handle);
+    this->tree2entity[e.tree_handle] = -1;
+    e.tree_handle = 0;
+    e.alive = false;
+    e.visible.clear();
+    e.enter_events.clear();
+    e.leave_events.clear();
+    e.move_events.clear();
+    this->removed_entities.push_back(entity_idx);
+    return true;
+}
+
+// 重新判定实体与周围实体的可见关系
+// 只有leave_range内的实体可能保持可见 原来可见但不在候选集合里的一定离开
+void map_aoi::process(int entity_idx)
+{
+    entity &e = this->entities[entity_idx];
+    const uint32_t stamp = ++this->stamp_seq;
+
+    for (int other_idx : e.visible)
+    {
+        this->entities[other_idx].visible_stamp = stamp;
+    }
+
+    this->candidates.clear();
+    this->tree.query(e.x - this->leave_range, e.y - this->leave_range, 2 * this->leave_range, 2 * this->leave_range, this->candidates);
+
+    for (int tree_handle : this->candidates)
+    {
+        int other_idx = this->tree2entity[tree_handle];
+        if (other_idx == entity_idx)
+        {
+            continue;
+        }
+        entity &other = this->entities[other_idx];
+        if (!in_range(e, other, this->leave_range))
+        {
+            continue;
+        }
+        other.stamp = stamp;
+        if (other.visible_stamp != stamp && in_range(e, other, this->enter_range))
+        {
+            e.visible.push_back(other_idx);
+            other.visible.push_back(entity_idx);
+            e.enter_events.push_back(other_idx);
+            other.enter_events.push_back(entity_idx);
+            set_pending(entity_idx);
+            set_pending(other_idx);
+        }
+    }
+
+    this->leaving.clear();
+    for (int other_idx : e.visible)
+    {
+        if (this->entities[other_idx].stamp != stamp)
+        {
+            this->leaving.push_back(other_idx);
+        }
+    }
+    for (int other_idx : this->leaving)
+    {
+        entity &other = this->entities[other_idx];
+        erase_visible(e, other_idx);
+        erase_visible(other, entity_idx);
+        e.leave_events.push_back(other_idx);
+        other.leave_events.push_back(entity_idx);
+        set_pending(entity_idx);
+        set_pending(other_idx);
+    }
+}
+
+void map_aoi::flush(std::vector<int> &out)
+{
+    // 上一步移除的实体 离开事件已经取走 现在可以复用
+    for (int entity_idx : this->removed_entities)
+    {
+        this->free_entities.push_back(entity_idx);
+    }
+    this->removed_entities.clear();
+
+    // 先把所有变化实体的可见关系判定完 再投递移动事件
+    for (int entity_idx : this->dirty_entities)
+    {
+        if (this->entities[entity_idx].alive)
+        {
+            process(entity_idx);
+        }
+    }
+
+    for (int entity_idx : this->dirty_entities)
+    {
+        entity &e = this->entities[entity_idx];
+        e.dirty = false;
+        if (!e.alive)
+        {
+            continue;
+        }
+        e.move_events.push_back(entity_idx);
+        set_pending(entity_idx);
+        for (int other_idx : e.visible)
+        {
+            this->entities[other_idx].move_events.push_back(entity_idx);
+            set_pending(other_idx);
+        }
+    }
+    this->dirty_entities.clear();
+
+    for (int entity_idx : this->pending_entities)
+    {
+        this->entities[entity_idx].pending = false;
+        if (this->entities[entity_idx].alive)
+        {
+            out.push_back(entity_idx + 1);
+        }
+    }
+    this->pending_entities.clear();
+}
+
+bool map_aoi::fetch(int handle, std::vector<int> &enter, std::vector<int> &leave, std::vector<int> &move)
+{
+    enter.clear();
+    leave.clear();
+    move.clear();
+
+    int entity_idx = handle - 1;
+    if (entity_idx < 0 || entity_idx >= (int)this->entities.size() || !this->entities[entity_idx].alive)
+    {
+        return false;
+    }
+
+    entity &e = this->entities[entity_idx];
+    // 进入后又在同一步被移除的实体只剩离开事件
+    for (int other_idx : e.enter_events)
+    {
+        if (this->entities[other_idx].alive)
+        {
+            enter.push_back(other_idx + 1);
+        }
+    }
+    for (int other_idx : e.leave_events)
+    {
+        leave.push_back(other_idx + 1);
+    }
+
+    // 新进入的实体已经带全量状态 不再重复算作移动
+    std::sort(enter.begin(), enter.end());
+    std::sort(e.move_events.begin(), e.move_events.end());
+    e.move_events.erase(std::unique(e.move_events.begin(), e.move_events.end()), e.move_events.end());
+    for (int other_idx : e.move_events)
+    {
+        if (this->entities[other_idx].alive && !std::binary_search(enter.begin(), enter.end(), other_idx + 1))
+        {
+            move.push_back(other_idx + 1);
+        }
+    }
+
+    e.enter_events.clear();
+    e.leave_events.clear();
+    e.move_events.clear();
+    return true;
+}
+
+void map_aoi::visible_handles(int handle, std::vector<int> &out) const
+{
+    int entity_idx = handle - 1;
+    if (entity_idx < 0 || entity_idx >= (int)this->entities.size() || !this->entities[entity_idx].alive)
+    {
+        return;
+    }
+    for (int other_idx : this->entities[entity_idx].visible)
+    {
+        out.push_back(other_idx + 1);
+    }
+}
+
+int map_aoi_mgr::create(double x, double y, double w, double h, double enter_range, double leave_range)
+{
+    int aoi_id = 0;
+    if (this->free_ids.size() > 0)
+    {
+        aoi_id = this->free_ids.back();
+        this->free_ids.pop_back();
+    }
+    else
+    {
+        this->aois.emplace_back();
+        aoi_id = (int)this->aois.size();
+    }
+    this->aois[aoi_id - 1] = std::make_unique<map_aoi>(x, y, w, h, enter_range, leave_range);
+    return aoi_id;
+}
+
+void map_aoi_mgr::destroy(int aoi_id)
+{
+    if (get(aoi_id))
+    {
+        this->aois[aoi_id - 1].reset();
+        this->free_ids.push_back(aoi_id);
+    }
+}
+
+map_aoi *map_aoi_mgr::get(int aoi_id)
+{
+    if (aoi_id <= 0 || aoi_id > (int)this->aois.size())
+    {
+        return nullptr;
+    }
+    return this->aois[aoi_id - 1].get();
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "app/map_quadtree.h"
+
+namespace avant::app
+{
+    // 增量AOI 供2D地图同步使用
+    // 每个实体既是观察者也是被观察者 两两可见关系对称 只在有一方移动时重新判定
+    // 两实体x与y方向距离都小于enter_range时进入视野 任一方向超过leave_range才离开 中间带防止边界来回抖动
+    // 每次flush只产生进入 离开 移动三类事件 同步开销与移动量成正比而不是与人数成正比
+    // 使用方式 每步先对状态变化的实体调用update 然后flush 再对flush返回的观察者逐个fetch事件
+    class map_aoi
+    {
+    public:
+        map_aoi(double x, double y, double w, double h, double enter_range, double leave_range);
+
+        // 返回handle >0 flush后自己收到自己的进入事件
+        int insert(double x, double y);
+        // 标记实体状态变化 坐标相同也会产生移动事件
+        bool update(int handle, double x, double y);
+        // 立即向所有能看见它的观察者投递离开事件 handle在下一次flush开始时才回收
+        bool remove(int handle);
+
+        // 处理本步所有变化的实体 有待取事件的观察者handle追加到out
+        void flush(std::vector<int> &out);
+        // 取出并清空观察者的事件 move中不含本次新进入的实体 自己移动时move中含自己
+        bool fetch(int handle, std::vector<int> &enter, std::vector<int> &leave, std::vector<int> &move);
+        // 当前视野内的实体handle 不含自己
+        void visible_handles(int handle, std::vector<int> &out) const;
+
+        size_t size() const { return this->tree.size(); }
+
+    private:
+        struct entity
+        {
+            double x{0}, y{0};
+            int tree_handle{0};
+            bool alive{false};
+            bool dirty{false};
+            bool pending{false};
+            // 本轮判定的标记 与stamp_seq相等分别表示在候选集合里 在可见集合里
+            uint32_t stamp{0};
+            uint32_t visible_stamp{0};
+            // 视野内实体通常只有几十个 用数组比哈希表对缓存更友好
+            std::vector<int> visible;
+            std::vector<int> enter_events;
+            std::vector<int> leave_events;
+            std::vector<int> move_events;
+        };
+
+        bool in_range(const entity &a, const entity &b, double range) const;
+        void set_pending(int entity_idx);
+        static void erase_visible(entity &e, int entity_idx);
+        void process(int entity_idx);
+
+    private:
+        map_quadtree tree;
+        double enter_range;
+        double leave_range;
+        std::vector<entity> entities;
+        std::vector<int> free_entities;
+        // 已移除 等下一次flush再回收的实体
+        std::vector<int> removed_entities;
+        std::vector<int> dirty_entities;
+        std::vector<int> pending_entities;
+        // 四叉树handle到实体下标
+        std::vector<int> tree2entity;
+        uint32_t stamp_seq{0};
+        std::vector<int> candidates;
+        std::vector<int> leaving;
+    };
+
+    // Lua侧以整数id持有AOI 只在other线程使用 map_sim_mgr并行tick期间只读
+    class map_aoi_mgr
+    {
+    public:
+        int create(double x, double y, double w, double h, double enter_range, double leave_range);
+        void destroy(int aoi_id);
+        map_aoi *get(int aoi_id);
+
+    private:
+        std::vector<std::unique_ptr<map_aoi>> aois;
+        std::vector<int> free_ids;
+    };
+}
@@ -0,0 +1,166 @@
+#include "app/map_flow_field.h"
+#include <iterator>
+
+using namespace avant::app;
+
+size_t map_flow_field_cache::cache_key_hash::operator()(const cache_key &key) const
+{
+    uint64_t h = key.version * 0x9E3779B97F4A7C15ull;
+    h ^= (uint64_t)(uint32_t)key.grid_id + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+    h ^= ((uint64_t)(uint32_t)key.goal_x << 32 | (uint32_t)key.goal_y) + (h << 6) + (h >> 2);
+    return (size_t)h;
+}
+
+void map_flow_field_cache::dir_delta(uint8_t d, int &dx, int &dy)
+{
+    static const int deltas[][2] = {{0, 0}, {1, 0}, {-1, 0}, {0, 1}, {0, -1}, {0, 0}};
+    if (d > DIR_GOAL)
+    {
+        d = DIR_NONE;
+    }
+    dx = deltas[d][0];
+    dy = deltas[d][1];
+}
+
+int map_flow_field_cache::get(int grid_id, const map_tile_grid &grid, int goal_x, int goal_y)
+{
+    ++this->stats.requests;
+    const cache_key key{grid_id, grid.get_version(), goal_x, goal_y};
+    auto iter = this->cache_index.find(key);
+    if (iter != this->cache_index.end())
+    {
+        ++this->stats.cache_hits;
+        this->cache.splice(this->cache.begin(), this->cache, iter->second);
+        return iter->second->field_id;
+    }
+    if (!grid.is_walkable(goal_x, goal_y) || (size_t)grid.get_width() * (size_t)grid.get_height() > MAX_CELLS)
+    {
+        return 0;
+    }
+
+    // 网格变了 同一网格旧版本的场不会再命中
+    for (auto entry = this->cache.begin(); entry != this->cache.end();)
+    {
+        auto next = std::next(entry);
+        if (entry->key.grid_id == grid_id && entry->key.version != key.version)
+        {
+            erase(entry);
+        }
+        entry = next;
+    }
+
+    if (++this->field_seq <= 0)
+    {
+        this->field_seq = 1;
+    }
+    const int field_id = this->field_seq;
+    field &f = this->fields[field_id];
+    f.grid_id = grid_id;
+    f.version = key.version;
+    f.goal_x = goal_x;
+    f.goal_y = goal_y;
+    build(grid, f);
+    this->cache_bytes += f.dirs.size();
+
+    this->cache.push_front(cache_entry{key, field_id});
+    this->cache_index[key] = this->cache.begin();
+    // 至少保留刚生成的这一张
+    while (this->cache_bytes > CACHE_BYTES && this->cache.size() > 1)
+    {
+        erase(std::prev(this->cache.end()));
+    }
+    return field_id;
+}
+
+void map_flow_field_cache::build(const map_tile_grid &grid, field &f)
+{
+    f.width = grid.get_width();
+    f.height = grid.get_height();
+    const size_t cells = (size_t)f.width * (size_t)f.height;
+    this->cost.assign(cells, UINT32_MAX);
+    f.dirs.assign(cells, DIR_NONE);
+    this->queue.clear();
+
+    // 积分场 从终点出发的波前 每格代价相同 先到的就是最短
+    static const int dirs[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    const int goal = f.goal_y * f.width + f.goal_x;
+    this->cost[goal] = 0;
+    this->queue.push_back(goal);
+    for (size_t head = 0; head < this->queue.size(); ++head)
+    {
+        const int cur = this->queue[head];
+        const int x = cur % f.width;
+        const int y = cur / f.width;
+        for (const auto &dir : dirs)
+        {
+            const int nx = x + dir[0];
+            const int ny = y + dir[1];
+            if (!grid.is_walkable(nx, ny))
+            {
+                continue;
+            }
+            const int next = ny * f.width + nx;
+            if (this->cost[next] != UINT32_MAX)
+            {
+                continue;
+            }
+            this->cost[next] = this->cost[cur] + 1;
+            this->queue.push_back(next);
+        }
+    }
+    f.reachable = (uint32_t)this->queue.size();
+    this->stats.visited += this->queue.size();
+    ++this->stats.builds;
+
+    // 方向场 只看到得了终点的格子 指向积分值最小的相邻格 相同时按右左下上的顺序
+    f.dirs[goal] = DIR_GOAL;
+    for (size_t i = 1; i < this->queue.size(); ++i)
+    {
+        const int cur = this->queue[i];
+        const int x = cur % f.width;
+        const int y = cur / f.width;
+        uint32_t best = this->cost[cur];
+        uint8_t best_dir = DIR_NONE;
+        for (int d = 0; d < 4; ++d)
+        {
+            const int nx = x + dirs[d][0];
+            const int ny = y + dirs[d][1];
+            if (nx < 0 || ny < 0 || nx >= f.width || ny >= f.height)
+            {
+                continue;
+            }
+            const uint32_t c = this->cost[ny * f.width + nx];
+            if (c < best)
+            {
+                best = c;
+                best_dir = (uint8_t)(DIR_RIGHT + d);
+            }
+        }
+        f.dirs[cur] = best_dir;
+    }
+}
+
+void map_flow_field_cache::erase(std::list<cache_entry>::iterator iter)
+{
+    auto field_iter = this->fields.find(iter->field_id);
+    if (field_iter != this->fields.end())
+    {
+        this->cache_bytes -= field_iter->second.dirs.size();
+        this->fields.erase(field_iter);
+    }
+    this->cache_index.erase(iter->key);
+    this->cache.erase(iter);
+}
+
+const map_flow_field_cache::field *map_flow_field_cache::find(int field_id) const
+{
+    auto iter = this->fields.find(field_id);
+    return iter == this->fields.end() ? nullptr : &iter->second;
+}
+
+map_flow_field_cache::stat map_flow_field_cache::take_stat()
+{
+    stat result = this->stats;
+    this->stats = stat{};
+    return result;
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include "app/map_tile_grid.h"
+
+namespace avant::app
+{
+    // 同一目标的流场 许多实体走向同一终点时代替逐个A*
+    // 从终点向外做波前扩展得到每格到终点的步数(积分场) 各格代价相同 Dijkstra即为BFS
+    // 再由积分场得出每格下一步该走的方向(方向场) 实体每步只按所在格查方向 开销与实体数无关
+    // 按(网格id, 网格版本, 终点)缓存 网格变化后同一网格旧版本的场全部丢弃 超出内存预算时LRU淘汰
+    // 只缓存方向场 每格1字节 积分场在生成时复用同一块临时数组
+    class map_flow_field_cache
+    {
+    public:
+        // 生成要遍历整张网格 在调用线程同步完成 与A*寻路一样不给4000x4000的大地图用
+        static constexpr size_t MAX_CELLS = 4u << 20;
+        static constexpr size_t CACHE_BYTES = 64u << 20;
+
+        // 方向 DIR_GOAL为终点本身 DIR_NONE为不可行走或到不了终点
+        enum dir : uint8_t
+        {
+            DIR_NONE = 0,
+            DIR_RIGHT,
+            DIR_LEFT,
+            DIR_DOWN,
+            DIR_UP,
+            DIR_GOAL,
+        };
+
+        struct field
+        {
+            int grid_id;
+            uint64_t version;
+            int goal_x, goal_y;
+            int width, height;
+            // 到达终点的格数 含终点
+            uint32_t reachable;
+            std::vector<uint8_t> dirs;
+
+            // 越界为DIR_NONE
+            uint8_t dir_at(int x, int y) const
+            {
+                if (x < 0 || y < 0 || x >= this->width || y >= this->height)
+                {
+                    return DIR_NONE;
+                }
+                return this->dirs[(size_t)y * (size_t)this->width + (size_t)x];
+            }
+        };
+
+        struct stat
+        {
+            uint64_t requests{0};
+            uint64_t cache_hits{0};
+            uint64_t builds{0};
+            // 生成时波前经过的格数
+            uint64_t visited{0};
+        };
+
+        // 返回流场id 每次生成的场id都不同 终点不可行走或网格超过MAX_CELLS返回0
+        int get(int grid_id, const map_tile_grid &grid, int goal_x, int goal_y);
+        // 已淘汰或已丢弃的场返回nullptr 调用方重新get
+        // 网格变化后旧版本的场在该网格下一次未命中时才丢弃 之前仍能找到 使用前需比较version与网格版本
+        const field *find(int field_id) const;
+        stat take_stat();
+
+        // 方向对应的格子偏移
+        static void dir_delta(uint8_t d, int &dx, int &dy);
+
+    private:
+        struct cache_key
+        {
+            int grid_id;
+            uint64_t version;
+            int goal_x, goal_y;
+
+            bool operator==(const cache_key &other) const
+            {
+                return grid_id == other.grid_id && version == other.version && goal_x == other.goal_x &&
+                       goal_y == other.goal_y;
+            }
+        };
+
+        struct cache_key_hash
+        {
+            size_t operator()(const cache_key &key) const;
+        };
+
+        struct cache_entry
+        {
+            cache_key key;
+            int field_id;
+        };
+
+        void build(const map_tile_grid &grid, field &f);
+        void erase(std::list<cache_entry>::iterator iter);
+
+    private:
+        int field_seq{0};
+        size_t cache_bytes{0};
+        std::unordered_map<int, field> fields;
+        std::list<cache_entry> cache;
+        std::unordered_map<cache_key, std::list<cache_entry>::iterator, cache_key_hash> cache_index;
+
+        // 积分场 每格到终点的步数 生成之间复用
+        std::vector<uint32_t> cost;
+        std::vector<int32_t> queue;
+
+        stat stats;
+    };
+}
@@ -0,0 +1,805 @@
+#include "app/map_hpa.h"
+#include <algorithm>
+#include <cstdlib>
+
+using namespace avant::app;
+
+// 入口段不短于该长度时在两端各设一个入口 否则只在中点设一个
+static constexpr int MAP_HPA_ENTRANCE_SPLIT = 6;
+
+static inline uint32_t map_hpa_manhattan(int x0, int y0, int x1, int y1)
+{
+    return (uint32_t)(std::abs(x1 - x0) + std::abs(y1 - y0));
+}
+
+map_hpa::map_hpa(int width, int height, int cluster_size)
+    : width(width > 0 ? width : 0),
+      height(height > 0 ? height : 0),
+      cluster_size(std::max(cluster_size, 4))
+{
+    this->clusters_x = (this->width + this->cluster_size - 1) / this->cluster_size;
+    this->clusters_y = (this->height + this->cluster_size - 1) / this->cluster_size;
+    this->clusters.resize((size_t)this->clusters_x * (size_t)this->clusters_y);
+    for (int cy = 0; cy < this->clusters_y; ++cy)
+    {
+        for (int cx = 0; cx < this->clusters_x; ++cx)
+        {
+            cluster &c = this->clusters[cy * this->clusters_x + cx];
+            c.x0 = cx * this->cluster_size;
+            c.y0 = cy * this->cluster_size;
+            c.x1 = std::min(c.x0 + this->cluster_size, this->width);
+            c.y1 = std::min(c.y0 + this->cluster_size, this->height);
+        }
+    }
+    const size_t cells = (size_t)this->cluster_size * (size_t)this->cluster_size;
+    this->bfs_stamp.assign(cells, 0);
+    this->bfs_g.assign(cells, 0);
+    this->bfs_parent.assign(cells, -1);
+    this->bfs_queue.reserve(cells);
+}
+
+void map_hpa::build(const std::vector<uint64_t> &walkable)
+{
+    this->bits = walkable;
+    this->bits.resize(((size_t)this->width * (size_t)this->height + 63) / 64, 0);
+    std::vector<int> dirty(this->clusters.size());
+    for (size_t i = 0; i < dirty.size(); ++i)
+    {
+        dirty[i] = (int)i;
+    }
+    rebuild(dirty);
+    this->ready.store(true, std::memory_order_release);
+}
+
+void map_hpa::update(int x, int y, int w, int h, const std::vector<uint64_t> &walkable)
+{
+    const int x0 = std::max(x, 0), y0 = std::max(y, 0);
+    const int x1 = std::min(x + w, this->width), y1 = std::min(y + h, this->height);
+    if (x0 >= x1 || y0 >= y1 || this->bits.empty())
+    {
+        return;
+    }
+    for (int j = y0; j < y1; ++j)
+    {
+        for (int i = x0; i < x1; ++i)
+        {
+            const size_t src = (size_t)(j - y) * (size_t)w + (size_t)(i - x);
+            const size_t dst = (size_t)j * (size_t)this->width + (size_t)i;
+            const uint64_t mask = 1ull << (dst & 63);
+            if ((walkable[src >> 6] >> (src & 63)) & 1)
+            {
+                this->bits[dst >> 6] |= mask;
+            }
+            else
+            {
+                this->bits[dst >> 6] &= ~mask;
+            }
+        }
+    }
+
+    std::vector<int> dirty;
+    for (int cy = y0 / this->cluster_size; cy <= (y1 - 1) / this->cluster_size; ++cy)
+    {
+        for (int cx = x0 / this->cluster_size; cx <= (x1 - 1) / this->cluster_size; ++cx)
+        {
+            dirty.push_back(cy * this->clusters_x + cx);
+        }
+    }
+    rebuild(dirty);
+}
+
+void map_hpa::rebuild(const std::vector<int> &dirty)
+{
+    const int cluster_cnt = (int)this->clusters.size();
+    std::vector<uint8_t> mark(cluster_cnt, 0);
+    enum
+    {
+        MARK_RIGHT = 1,
+        MARK_DOWN = 2,
+        MARK_NODES = 4,
+        MARK_TWINS = 8,
+    };
+    auto rebuild_right = [&](int id)
+    {
+        cluster &c = this->clusters[id];
+        if (!(mark[id] & MARK_RIGHT) && c.x1 < this->width)
+        {
+            mark[id] |= MARK_RIGHT;
+            build_border(c.right, c.x1 - 1, c.y0, c.x1, c.y0, 0, 1, c.y1 - c.y0);
+        }
+    };
+    auto rebuild_down = [&](int id)
+    {
+        cluster &c = this->clusters[id];
+        if (!(mark[id] & MARK_DOWN) && c.y1 < this->height)
+        {
+            mark[id] |= MARK_DOWN;
+            build_border(c.down, c.x0, c.y1 - 1, c.x0, c.y1, 1, 0, c.x1 - c.x0);
+        }
+    };
+    // 簇自身及上下左右相邻的簇 越界的为-1
+    auto around = [&](int id, int out[5])
+    {
+        const int cx = id % this->clusters_x, cy = id / this->clusters_x;
+        out[0] = id;
+        out[1] = cx > 0 ? id - 1 : -1;
+        out[2] = cx + 1 < this->clusters_x ? id + 1 : -1;
+        out[3] = cy > 0 ? id - this->clusters_x : -1;
+        out[4] = cy + 1 < this->clusters_y ? id + this->clusters_x : -1;
+    };
+
+    // 变化的簇四条边上的入口都要重建 左边与上边的入口记在相邻簇上
+    for (int id : dirty)
+    {
+        int ids[5];
+        around(id, ids);
+        rebuild_right(id);
+        rebuild_down(id);
+        if (ids[1] >= 0)
+        {
+            rebuild_right(ids[1]);
+        }
+        if (ids[3] >= 0)
+        {
+            rebuild_down(ids[3]);
+        }
+    }
+    // 入口变了的簇重建节点与簇内距离 节点编号变了的簇与其相邻簇重连跨簇的边
+    std::vector<int> node_dirty;
+    for (int id : dirty)
+    {
+        int ids[5];
+        around(id, ids);
+        for (int n : ids)
+        {
+            if (n >= 0 && !(mark[n] & MARK_NODES))
+            {
+                mark[n] |= MARK_NODES;
+                node_dirty.push_back(n);
+                build_nodes(n);
+                build_dist(n);
+            }
+        }
+    }
+    for (int id : node_dirty)
+    {
+        int ids[5];
+        around(id, ids);
+        for (int n : ids)
+        {
+            if (n >= 0 && !(mark[n] & MARK_TWINS))
+            {
+                mark[n] |= MARK_TWINS;
+                link_twins(n);
+            }
+        }
+    }
+
+    this->node_base.resize(cluster_cnt + 1);
+    int total = 0;
+    for (int id = 0; id < cluster_cnt; ++id)
+    {
+        this->node_base[id] = total;
+        total += (int)this->clusters[id].nodes.size();
+    }
+    this->node_base[cluster_cnt] = total;
+    this->node_count.store(total, std::memory_order_relaxed);
+}
+
+void map_hpa::build_border(std::vector<transition> &out, int ax, int ay, int bx, int by, int step_x, int step_y, int len)
+{
+    out.clear();
+    int run_begin = -1;
+    for (int i = 0; i <= len; ++i)
+    {
+        const bool open_cell = i < len && walkable(ax + i * step_x, ay + i * step_y) &&
+                               walkable(bx + i * step_x, by + i * step_y);
+        if (open_cell && run_begin < 0)
+        {
+            run_begin = i;
+        }
+        else if (!open_cell && run_begin >= 0)
+        {
+            const int run_len = i - run_begin;
+            auto add = [&](int k)
+            {
+                out.push_back(transition{ax + k * step_x, ay + k * step_y, bx + k * step_x, by + k * step_y});
+            };
+            if (run_len < MAP_HPA_ENTRANCE_SPLIT)
+            {
+                add(run_begin + run_len / 2);
+            }
+            else
+            {
+                add(run_begin);
+                add(i - 1);
+            }
+            run_begin = -1;
+        }
+    }
+}
+
+void map_hpa::build_nodes(int cluster_id)
+{
+    cluster &c = this->clusters[cluster_id];
+    c.nodes.clear();
+    auto add = [&c](int x, int y)
+    {
+        for (const abs_node &n : c.nodes)
+        {
+            if (n.x == x && n.y == y)
+            {
+                return;
+            }
+        }
+        abs_node n;
+        n.x = x;
+        n.y = y;
+        c.nodes.push_back(n);
+    };
+    for (const transition &t : c.right)
+    {
+        add(t.ax, t.ay);
+    }
+    for (const transition &t : c.down)
+    {
+        add(t.ax, t.ay);
+    }
+    if (c.x0 > 0)
+    {
+        for (const transition &t : this->clusters[cluster_id - 1].right)
+        {
+            add(t.bx, t.by);
+        }
+    }
+    if (c.y0 > 0)
+    {
+        for (const transition &t : this->clusters[cluster_id - this->clusters_x].down)
+        {
+            add(t.bx, t.by);
+        }
+    }
+}
+
+void map_hpa::link_twins(int cluster_id)
+{
+    cluster &c = this->clusters[cluster_id];
+    auto find = [this](int id, int x, int y)
+    {
+        const std::vector<abs_node> &nodes = this->clusters[id].nodes;
+        for (size_t i = 0; i < nodes.size(); ++i)
+        {
+            if (nodes[i].x == x && nodes[i].y == y)
+            {
+                return (int)i;
+            }
+        }
+        return -1;
+    };
+    auto link = [&](int x, int y, int twin_cluster, int twin_x, int twin_y)
+    {
+        const int idx = find(cluster_id, x, y);
+        const int twin_idx = find(twin_cluster, twin_x, twin_y);
+        if (idx < 0 || twin_idx < 0)
+        {
+            return;
+        }
+        abs_node &n = c.nodes[idx];
+        n.twin_cluster[n.twin_cnt] = twin_cluster;
+        n.twin_idx[n.twin_cnt] = twin_idx;
+        ++n.twin_cnt;
+    };
+
+    for (abs_node &n : c.nodes)
+    {
+        n.twin_cnt = 0;
+    }
+    for (const transition &t : c.right)
+    {
+        link(t.ax, t.ay, cluster_id + 1, t.bx, t.by);
+    }
+    for (const transition &t : c.down)
+    {
+        link(t.ax, t.ay, cluster_id + this->clusters_x, t.bx, t.by);
+    }
+    if (c.x0 > 0)
+    {
+        for (const transition &t : this->clusters[cluster_id - 1].right)
+        {
+            link(t.bx, t.by, cluster_id - 1, t.ax, t.ay);
+        }
+    }
+    if (c.y0 > 0)
+    {
+        for (const transition &t : this->clusters[cluster_id - this->clusters_x].down)
+        {
+            link(t.bx, t.by, cluster_id - this->clusters_x, t.ax, t.ay);
+        }
+    }
+}
+
+void map_hpa::build_dist(int cluster_id)
+{
+    cluster &c = this->clusters[cluster_id];
+    const size_t k = c.nodes.size();
+    c.dist.assign(k * k, UINT32_MAX);
+    for (size_t i = 0; i < k; ++i)
+    {
+        bfs(c, c.nodes[i].x, c.nodes[i].y);
+        for (size_t j = 0; j < k; ++j)
+        {
+            c.dist[i * k + j] = bfs_dist(c, c.nodes[j].x, c.nodes[j].y);
+        }
+    }
+}
+
+void map_hpa::bfs(const cluster &c, int sx, int sy)
+{
+    if (++this->bfs_generation == 0)
+    {
+        std::fill(this->bfs_stamp.begin(), this->bfs_stamp.end(), 0);
+        this->bfs_generation = 1;
+    }
+    const uint32_t gen = this->bfs_generation;
+    const int stride = this->cluster_size;
+    this->bfs_queue.clear();
+
+    const int start = (sy - c.y0) * stride + (sx - c.x0);
+    this->bfs_stamp[start] = gen;
+    this->bfs_g[start] = 0;
+    this->bfs_parent[start] = -1;
+    this->bfs_queue.push_back(start);
+    for (size_t head = 0; head < this->bfs_queue.size(); ++head)
+    {
+        const int cur = this->bfs_queue[head];
+        const int x = c.x0 + cur % stride;
+        const int y = c.y0 + cur / stride;
+        static const int dirs[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+        for (const auto &dir : dirs)
+        {
+            const int nx = x + dir[0];
+            const int ny = y + dir[1];
+            if (nx < c.x0 || ny < c.y0 || nx >= c.x1 || ny >= c.y1 || !walkable(nx, ny))
+            {
+                continue;
+            }
+            const int next = (ny - c.y0) * stride + (nx - c.x0);
+            if (this->bfs_stamp[next] == gen)
+            {
+                continue;
+            }
+            this->bfs_stamp[next] = gen;
+            this->bfs_g[next] = this->bfs_g[cur] + 1;
+            this->bfs_parent[next] = cur;
+            this->bfs_queue.push_back(next);
+        }
+    }
+}
+
+uint32_t map_hpa::bfs_dist(const cluster &c, int x, int y) const
+{
+    const int idx = (y - c.y0) * this->cluster_size + (x - c.x0);
+    return this->bfs_stamp[idx] == this->bfs_generation ? this->bfs_g[idx] : UINT32_MAX;
+}
+
+void map_hpa::bfs_trace(const cluster &c, int x, int y, std::vector<int32_t> &out) const
+{
+    for (int idx = (y - c.y0) * this->cluster_size + (x - c.x0); idx >= 0; idx = this->bfs_parent[idx])
+    {
+        out.push_back(c.y0 + idx / this->cluster_size);
+        out.push_back(c.x0 + idx % this->cluster_size);
+    }
+}
+
+bool map_hpa::local_path(int cluster_id, int sx, int sy, int ex, int ey, std::vector<int32_t> &out)
+{
+    const cluster &c = this->clusters[cluster_id];
+    bfs(c, sx, sy);
+    if (bfs_dist(c, ex, ey) == UINT32_MAX)
+    {
+        return false;
+    }
+    this->segment.clear();
+    bfs_trace(c, ex, ey, this->segment);
+    std::reverse(this->segment.begin(), this->segment.end());
+    // 与上一段首尾相接的格子只保留一次
+    const size_t skip = out.empty() ? 0 : 2;
+    out.insert(out.end(), this->segment.begin() + skip, this->segment.end());
+    return true;
+}
+
+map_hpa::search_node &map_hpa::visit(int id)
+{
+    search_node &n = this->search_nodes[id];
+    if (n.stamp != this->search_generation)
+    {
+        n.stamp = this->search_generation;
+        n.g = UINT32_MAX;
+        n.parent = -1;
+        n.closed = false;
+    }
+    return n;
+}
+
+bool map_hpa::find_path(int start_x, int start_y, int end_x, int end_y, std::vector<int32_t> &out)
+{
+    out.clear();
+    if (!is_ready() || start_x < 0 || start_y < 0 || start_x >= this->width || start_y >= this->height ||
+        !walkable(end_x, end_y))
+    {
+        return false;
+    }
+    if (start_x == end_x && start_y == end_y)
+    {
+        out.push_back(start_x);
+        out.push_back(start_y);
+        return true;
+    }
+    if (!walkable(start_x, start_y))
+    {
+        return find_path_blocked_start(start_x, start_y, end_x, end_y, out);
+    }
+    const int start_cluster = cluster_of(start_x, start_y);
+    const int end_cluster = cluster_of(end_x, end_y);
+    if (start_cluster == end_cluster && local_path(start_cluster, start_x, start_y, end_x, end_y, out))
+    {
+        return true;
+    }
+
+    // 起终点临时接入所在簇的抽象节点
+    const cluster &sc = this->clusters[start_cluster];
+    const cluster &ec = this->clusters[end_cluster];
+    bfs(sc, start_x, start_y);
+    this->start_dist.resize(sc.nodes.size());
+    for (size_t i = 0; i < sc.nodes.size(); ++i)
+    {
+        this->start_dist[i] = bfs_dist(sc, sc.nodes[i].x, sc.nodes[i].y);
+    }
+    bfs(ec, end_x, end_y);
+    this->end_dist.resize(ec.nodes.size());
+    for (size_t i = 0; i < ec.nodes.size(); ++i)
+    {
+        this->end_dist[i] = bfs_dist(ec, ec.nodes[i].x, ec.nodes[i].y);
+    }
+
+    const int total = this->node_base.back();
+    const int start_id = total;
+    const int goal_id = total + 1;
+    if (this->search_nodes.size() < (size_t)total + 2)
+    {
+        this->search_nodes.resize((size_t)total + 2);
+    }
+    if (++this->search_generation == 0)
+    {
+        for (search_node &n : this->search_nodes)
+        {
+            n.stamp = 0;
+        }
+        this->search_generation = 1;
+    }
+    this->open.clear();
+
+    // 抽象节点的全局编号 按node_base换回簇与簇内下标
+    auto cluster_of_id = [this](int id)
+    {
+        return (int)(std::upper_bound(this->node_base.begin(), this->node_base.end(), id) - this->node_base.begin()) - 1;
+    };
+    auto node_xy = [&](int id, int &x, int &y)
+    {
+        if (id == start_id)
+        {
+            x = start_x;
+            y = start_y;
+        }
+        else if (id == goal_id)
+        {
+            x = end_x;
+            y = end_y;
+        }
+        else
+        {
+            const int cid = cluster_of_id(id);
+            const abs_node &n = this->clusters[cid].nodes[id - this->node_base[cid]];
+            x = n.x;
+            y = n.y;
+        }
+    };
+    auto relax = [&](int from, uint32_t from_g, int id, uint32_t cost)
+    {
+        search_node &n = visit(id);
+        const uint32_t g = from_g + cost;
+        if (n.closed || g >= n.g)
+        {
+            return;
+        }
+        n.g = g;
+        n.parent = from;
+        int x = 0, y = 0;
+        node_xy(id, x, y);
+        this->open.push_back(open_item{g + map_hpa_manhattan(x, y, end_x, end_y), g, id});
+        std::push_heap(this->open.begin(), this->open.end(), open_greater());
+    };
+
+    visit(start_id).g = 0;
+    this->open.push_back(open_item{map_hpa_manhattan(start_x, start_y, end_x, end_y), 0, start_id});
+    bool found = false;
+    while (!this->open.empty())
+    {
+        std::pop_heap(this->open.begin(), this->open.end(), open_greater());
+        const open_item item = this->open.back();
+        this->open.pop_back();
+        search_node &cur = this->search_nodes[item.id];
+        if (cur.closed || item.g != cur.g)
+        {
+            continue;
+        }
+        cur.closed = true;
+        if (item.id == goal_id)
+        {
+            found = true;
+            break;
+        }
+        if (item.id == start_id)
+        {
+            for (size_t i = 0; i < sc.nodes.size(); ++i)
+            {
+                if (this->start_dist[i] != UINT32_MAX)
+                {
+                    relax(start_id, 0, this->node_base[start_cluster] + (int)i, this->start_dist[i]);
+                }
+            }
+            continue;
+        }
+
+        const int cid = cluster_of_id(item.id);
+        const cluster &c = this->clusters[cid];
+        const int idx = item.id - this->node_base[cid];
+        const size_t k = c.nodes.size();
+        for (size_t j = 0; j < k; ++j)
+        {
+            const uint32_t d = c.dist[idx * k + j];
+            if ((int)j != idx && d != UINT32_MAX)
+            {
+                relax(item.id, item.g, this->node_base[cid] + (int)j, d);
+            }
+        }
+        const abs_node &n = c.nodes[idx];
+        for (int t = 0; t < n.twin_cnt; ++t)
+        {
+            relax(item.id, item.g, this->node_base[n.twin_cluster[t]] + n.twin_idx[t], 1);
+        }
+        if (cid == end_cluster && this->end_dist[idx] != UINT32_MAX)
+        {
+            relax(item.id, item.g, goal_id, this->end_dist[idx]);
+        }
+    }
+    if (!found)
+    {
+        return false;
+    }
+
+    this->abs_path.clear();
+    for (int id = goal_id; id >= 0; id = this->search_nodes[id].parent)
+    {
+        this->abs_path.push_back(id);
+    }
+    std::reverse(this->abs_path.begin(), this->abs_path.end());
+
+    // 只在走廊经过的簇内细化 跨簇的相邻入口直接相连
+    for (size_t i = 1; i < this->abs_path.size(); ++i)
+    {
+        const int from = this->abs_path[i - 1];
+        const int to = this->abs_path[i];
+        int fx = 0, fy = 0, tx = 0, ty = 0;
+        node_xy(from, fx, fy);
+        node_xy(to, tx, ty);
+        const int from_cluster = from == start_id ? start_cluster : cluster_of(fx, fy);
+        const int to_cluster = to == goal_id ? end_cluster : cluster_of(tx, ty);
+        if (from_cluster != to_cluster)
+        {
+            out.push_back(tx);
+            out.push_back(ty);
+        }
+        else if (!local_path(from_cluster, fx, fy, tx, ty, out))
+        {
+            out.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool map_hpa::find_path_blocked_start(int start_x, int start_y, int end_x, int end_y, std::vector<int32_t> &out)
+{
+    // 相邻的可走格可能在另一个簇 起点簇内BFS接不到 逐个相邻格寻路取最短的一条
+    static const int dirs[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    std::vector<int32_t> best;
+    std::vector<int32_t> path;
+    for (const auto &dir : dirs)
+    {
+        const int nx = start_x + dir[0];
+        const int ny = start_y + dir[1];
+        if (walkable(nx, ny) && find_path(nx, ny, end_x, end_y, path) && (best.empty() || path.size() < best.size()))
+        {
+            best.swap(path);
+        }
+    }
+    out.clear();
+    if (best.empty())
+    {
+        return false;
+    }
+    out.push_back(start_x);
+    out.push_back(start_y);
+    out.insert(out.end(), best.begin(), best.end());
+    return true;
+}
+
+map_hpa_mgr::~map_hpa_mgr()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->cv.notify_all();
+    if (this->thread.joinable())
+    {
+        this->thread.join();
+    }
+}
+
+void map_hpa_mgr::submit(job &&j)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (j.kind == JOB_FIND)
+        {
+            ++this->pending_queries;
+        }
+        this->jobs.push_back(std::move(j));
+    }
+    if (!this->thread.joinable())
+    {
+        this->thread = std::thread(&map_hpa_mgr::worker_loop, this);
+    }
+    this->cv.notify_one();
+}
+
+void map_hpa_mgr::worker_loop()
+{
+    std::vector<int32_t> path;
+    while (true)
+    {
+        job j;
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->cv.wait(lock, [this]
+                          { return this->stopping || !this->jobs.empty(); });
+            if (this->stopping)
+            {
+                return;
+            }
+            j = std::move(this->jobs.front());
+            this->jobs.pop_front();
+        }
+
+        if (j.kind == JOB_BUILD)
+        {
+            j.hpa->build(j.walkable);
+        }
+        else if (j.kind == JOB_UPDATE)
+        {
+            j.hpa->update(j.x, j.y, j.w, j.h, j.walkable);
+        }
+        else
+        {
+            result r;
+            r.request_id = j.request_id;
+            r.found = j.hpa->find_path(j.x, j.y, j.end_x, j.end_y, r.path);
+            std::lock_guard<std::mutex> lock(this->mutex);
+            --this->pending_queries;
+            this->results.push_back(std::move(r));
+        }
+    }
+}
+
+int map_hpa_mgr::create(const map_tile_grid &grid, int cluster_size)
+{
+    int hpa_id = 0;
+    if (this->free_ids.size() > 0)
+    {
+        hpa_id = this->free_ids.back();
+        this->free_ids.pop_back();
+    }
+    else
+    {
+        this->hpas.emplace_back();
+        hpa_id = (int)this->hpas.size();
+    }
+    this->hpas[hpa_id - 1] = std::make_shared<map_hpa>(grid.get_width(), grid.get_height(), cluster_size);
+
+    job j;
+    j.kind = JOB_BUILD;
+    j.hpa = this->hpas[hpa_id - 1];
+    grid.copy_walkable(0, 0, grid.get_width(), grid.get_height(), j.walkable);
+    submit(std::move(j));
+    return hpa_id;
+}
+
+void map_hpa_mgr::destroy(int hpa_id)
+{
+    if (get(hpa_id))
+    {
+        this->hpas[hpa_id - 1].reset();
+        this->free_ids.push_back(hpa_id);
+    }
+}
+
+bool map_hpa_mgr::update(int hpa_id, const map_tile_grid &grid, int x, int y, int w, int h)
+{
+    if (!get(hpa_id) || w <= 0 || h <= 0)
+    {
+        return false;
+    }
+    job j;
+    j.kind = JOB_UPDATE;
+    j.hpa = this->hpas[hpa_id - 1];
+    j.x = x;
+    j.y = y;
+    j.w = w;
+    j.h = h;
+    grid.copy_walkable(x, y, w, h, j.walkable);
+    submit(std::move(j));
+    return true;
+}
+
+uint32_t map_hpa_mgr::find_path(int hpa_id, int start_x, int start_y, int end_x, int end_y)
+{
+    if (!get(hpa_id))
+    {
+        return 0;
+    }
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (this->pending_queries >= MAX_PENDING_QUERIES)
+        {
+            return 0;
+        }
+    }
+    if (++this->request_seq == 0)
+    {
+        this->request_seq = 1;
+    }
+    const uint32_t request_id = this->request_seq;
+    job j;
+    j.kind = JOB_FIND;
+    j.hpa = this->hpas[hpa_id - 1];
+    j.x = start_x;
+    j.y = start_y;
+    j.end_x = end_x;
+    j.end_y = end_y;
+    j.request_id = request_id;
+    submit(std::move(j));
+    return request_id;
+}
+
+size_t map_hpa_mgr::poll(std::vector<result> &out)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    const size_t cnt = this->results.size();
+    for (result &r : this->results)
+    {
+        out.push_back(std::move(r));
+    }
+    this->results.clear();
+    return cnt;
+}
+
+map_hpa *map_hpa_mgr::get(int hpa_id)
+{
+    if (hpa_id <= 0 || hpa_id > (int)this->hpas.size())
+    {
+        return nullptr;
+    }
+    return this->hpas[hpa_id - 1].get();
+}
@@ -0,0 +1,205 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "app/map_tile_grid.h"
+
+namespace avant::app
+{
+    // 大地图的分层寻路(HPA*) 4方向移动 每步代价1
+    // 网格按cluster_size切成方形簇 相邻簇共享边上连续可走的一段作为入口 短段取中点 长段取两端
+    // 抽象图的节点为簇内的入口格 簇内节点之间的距离在簇内BFS预先算好 跨簇的入口之间代价1
+    // 查询时起终点临时接入抽象图 抽象A*选出走廊后 只在走廊经过的簇内逐段BFS细化成逐格路径
+    // 瓦片变化时只重建涉及的簇及其相邻簇 路径接近最短但不保证最短
+    // 持有一份自己的可行走位图 只在寻路线程访问
+    class map_hpa
+    {
+    public:
+        map_hpa(int width, int height, int cluster_size);
+
+        // 以下只在寻路线程调用
+        // walkable为整张网格按行打包的可行走位 见map_tile_grid::copy_walkable
+        void build(const std::vector<uint64_t> &walkable);
+        // 区域(x,y,w,h)的可行走位变化 重建相关的簇
+        void update(int x, int y, int w, int h, const std::vector<uint64_t> &walkable);
+        // 找到时out为起点到终点(含两端)每格的x,y 否则返回false
+        // 起点不可走时先走到相邻的可走格 终点不可走时返回false
+        bool find_path(int start_x, int start_y, int end_x, int end_y, std::vector<int32_t> &out);
+
+        bool is_ready() const { return this->ready.load(std::memory_order_acquire); }
+        int get_node_count() const { return this->node_count.load(std::memory_order_relaxed); }
+
+    private:
+        // 入口 a在本簇 b在右侧或下方的相邻簇
+        struct transition
+        {
+            int32_t ax, ay, bx, by;
+        };
+
+        struct abs_node
+        {
+            int32_t x{0}, y{0};
+            // 跨簇相连的节点 一格最多同时在两条边上 每条边一个
+            int32_t twin_cluster[4]{};
+            int32_t twin_idx[4]{};
+            int twin_cnt{0};
+        };
+
+        struct cluster
+        {
+            int x0{0}, y0{0}, x1{0}, y1{0};
+            std::vector<abs_node> nodes;
+            // nodes.size()*nodes.size() 不连通为UINT32_MAX
+            std::vector<uint32_t> dist;
+            // 与右侧 下方相邻簇之间的入口
+            std::vector<transition> right, down;
+        };
+
+        struct open_item
+        {
+            uint32_t f;
+            uint32_t g;
+            int32_t id;
+        };
+
+        struct open_greater
+        {
+            bool operator()(const open_item &a, const open_item &b) const
+            {
+                return a.f != b.f ? a.f > b.f : a.g < b.g;
+            }
+        };
+
+        struct search_node
+        {
+            uint32_t stamp{0};
+            uint32_t g{0};
+            int32_t parent{-1};
+            bool closed{false};
+        };
+
+        bool walkable(int x, int y) const
+        {
+            if (x < 0 || y < 0 || x >= this->width || y >= this->height)
+            {
+                return false;
+            }
+            const size_t bit = (size_t)y * (size_t)this->width + (size_t)x;
+            return (this->bits[bit >> 6] >> (bit & 63)) & 1;
+        }
+        int cluster_of(int x, int y) const { return (y / this->cluster_size) * this->clusters_x + x / this->cluster_size; }
+
+        void rebuild(const std::vector<int> &dirty);
+        void build_border(std::vector<transition> &out, int ax, int ay, int bx, int by, int step_x, int step_y, int len);
+        void build_nodes(int cluster_id);
+        void link_twins(int cluster_id);
+        void build_dist(int cluster_id);
+
+        // 簇内BFS 从(sx,sy)出发 不出簇的矩形
+        void bfs(const cluster &c, int sx, int sy);
+        uint32_t bfs_dist(const cluster &c, int x, int y) const;
+        // 接着上一次bfs 把到(x,y)的路径逆序追加到out 每格先y后x
+        void bfs_trace(const cluster &c, int x, int y, std::vector<int32_t> &out) const;
+        bool find_path_blocked_start(int start_x, int start_y, int end_x, int end_y, std::vector<int32_t> &out);
+        bool local_path(int cluster_id, int sx, int sy, int ex, int ey, std::vector<int32_t> &out);
+
+        search_node &visit(int id);
+
+    private:
+        int width;
+        int height;
+        int cluster_size;
+        int clusters_x;
+        int clusters_y;
+        std::vector<uint64_t> bits;
+        std::vector<cluster> clusters;
+        // 每个簇第一个节点的全局编号 抽象搜索用
+        std::vector<int> node_base;
+        std::atomic<bool> ready{false};
+        std::atomic<int> node_count{0};
+
+        // 簇内BFS 按代数标记 不清零
+        std::vector<uint32_t> bfs_stamp;
+        std::vector<uint32_t> bfs_g;
+        std::vector<int32_t> bfs_parent;
+        std::vector<int32_t> bfs_queue;
+        uint32_t bfs_generation{0};
+
+        std::vector<search_node> search_nodes;
+        uint32_t search_generation{0};
+        std::vector<open_item> open;
+        std::vector<uint32_t> start_dist;
+        std::vector<uint32_t> end_dist;
+        std::vector<int32_t> abs_path;
+        std::vector<int32_t> segment;
+    };
+
+    // 分层寻路线程 建图 更新与查询按提交顺序在同一线程执行 不阻塞other线程的tick
+    // 结果放进完成队列 由other线程每tick取走
+    class map_hpa_mgr
+    {
+    public:
+        // 排队中的查询超过该值时拒绝新的查询
+        static constexpr size_t MAX_PENDING_QUERIES = 1024;
+
+        struct result
+        {
+            uint32_t request_id{0};
+            bool found{false};
+            std::vector<int32_t> path;
+        };
+
+        ~map_hpa_mgr();
+
+        // 在调用线程拷贝网格的可行走位后交给寻路线程建图
+        int create(const map_tile_grid &grid, int cluster_size);
+        // 销毁后已提交的查询仍会返回结果
+        void destroy(int hpa_id);
+        // 网格区域变化后调用 拷贝区域的可行走位交给寻路线程增量更新
+        bool update(int hpa_id, const map_tile_grid &grid, int x, int y, int w, int h);
+        // 返回请求id 失败返回0
+        uint32_t find_path(int hpa_id, int start_x, int start_y, int end_x, int end_y);
+        // 取走已完成的结果 追加到out 返回条数
+        size_t poll(std::vector<result> &out);
+        map_hpa *get(int hpa_id);
+
+    private:
+        enum job_kind
+        {
+            JOB_BUILD,
+            JOB_UPDATE,
+            JOB_FIND,
+        };
+
+        struct job
+        {
+            job_kind kind;
+            std::shared_ptr<map_hpa> hpa;
+            int x{0}, y{0}, w{0}, h{0};
+            int end_x{0}, end_y{0};
+            uint32_t request_id{0};
+            std::vector<uint64_t> walkable;
+        };
+
+        void submit(job &&j);
+        void worker_loop();
+
+    private:
+        std::vector<std::shared_ptr<map_hpa>> hpas;
+        std::vector<int> free_ids;
+        uint32_t request_seq{0};
+
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<job> jobs;
+        size_t pending_queries{0};
+        std::vector<result> results;
+        bool stopping{false};
+    };
+}
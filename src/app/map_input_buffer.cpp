@@ -0,0 +1,247 @@
+#include "app/map_input_buffer.h"
+#include <algorithm>
+#include "app/map_state_codec.h"
+
+using namespace avant::app;
+
+void map_input_buffer::set_delay(int delay_steps, int reorder_steps)
+{
+    this->delay_steps = delay_steps > 0 ? delay_steps : 0;
+    this->reorder_steps = reorder_steps > 0 ? reorder_steps : 0;
+}
+
+map_input_buffer::queue &map_input_buffer::queue_of(int handle)
+{
+    if ((int)this->queues.size() < handle)
+    {
+        this->queues.resize(handle);
+    }
+    return this->queues[handle - 1];
+}
+
+// seq之前还没到的都算跳过
+void map_input_buffer::advance(queue &q, uint32_t seq, bool applied)
+{
+    const uint32_t shift = seq - q.last_seq;
+    this->stats.skipped += shift - 1;
+    q.applied_mask = shift >= 32 ? 0 : q.applied_mask << shift;
+    if (applied)
+    {
+        q.applied_mask |= 1;
+    }
+    q.last_seq = seq;
+}
+
+void map_input_buffer::remove(int handle)
+{
+    if (handle <= 0 || handle > (int)this->queues.size())
+    {
+        return;
+    }
+    queue &q = this->queues[handle - 1];
+    if (q.pending)
+    {
+        auto iter = std::find(this->pending.begin(), this->pending.end(), handle);
+        if (iter != this->pending.end())
+        {
+            *iter = this->pending.back();
+            this->pending.pop_back();
+        }
+    }
+    q = queue{};
+}
+
+map_input_buffer::push_result map_input_buffer::push(int handle, uint32_t seq, double dir_x, double dir_y, double dir_z,
+                                                     uint64_t client_time)
+{
+    if (handle <= 0)
+    {
+        ++this->stats.dropped;
+        return PUSH_DROPPED;
+    }
+    queue &q = queue_of(handle);
+
+    // 按差值比较 seq回绕后仍然成立
+    const int32_t diff = (int32_t)(seq - q.last_seq);
+    if (diff <= 0)
+    {
+        const uint32_t back = (uint32_t)-diff;
+        if (back < 32 && ((q.applied_mask >> back) & 1))
+        {
+            ++this->stats.duplicate;
+            return PUSH_DUPLICATE;
+        }
+        ++this->stats.late;
+        return PUSH_LATE;
+    }
+
+    auto iter = std::lower_bound(q.items.begin(), q.items.end(), seq, [&q](const item &a, uint32_t s)
+                                 { return (int32_t)(a.in.seq - q.last_seq) < (int32_t)(s - q.last_seq); });
+    if (iter != q.items.end() && iter->in.seq == seq)
+    {
+        ++this->stats.duplicate;
+        return PUSH_DUPLICATE;
+    }
+
+    item it;
+    it.in.handle = handle;
+    it.in.seq = seq;
+    it.in.dir_x = dir_x;
+    it.in.dir_y = dir_y;
+    it.in.dir_z = dir_z;
+    it.in.client_time = client_time;
+    it.ready_step = this->step_no + 1 + (uint32_t)this->delay_steps;
+    q.items.insert(iter, it);
+
+    push_result result = PUSH_QUEUED;
+    if ((int)q.items.size() > WINDOW)
+    {
+        // 积压太多 丢掉最早的 不让延迟越攒越大
+        if (q.items.front().in.seq == seq)
+        {
+            result = PUSH_DROPPED;
+        }
+        advance(q, q.items.front().in.seq, false);
+        q.items.erase(q.items.begin());
+        ++this->stats.dropped;
+    }
+
+    if (!q.pending)
+    {
+        q.pending = true;
+        this->pending.push_back(handle);
+    }
+    return result;
+}
+
+size_t map_input_buffer::step(std::vector<input> &out)
+{
+    ++this->step_no;
+    size_t applied = 0;
+    for (size_t i = 0; i < this->pending.size();)
+    {
+        queue &q = this->queues[this->pending[i] - 1];
+        const item &head = q.items.front();
+        const int32_t waited = (int32_t)(this->step_no - head.ready_step);
+        // 下一个seq到了就按时应用 缺了的话后面的输入多等reorder步再跳过缺口
+        if (waited >= 0 && (head.in.seq == q.last_seq + 1 || waited >= this->reorder_steps))
+        {
+            advance(q, head.in.seq, true);
+            out.push_back(head.in);
+            q.items.erase(q.items.begin());
+            ++this->stats.applied;
+            ++applied;
+        }
+
+        if (q.items.empty())
+        {
+            q.pending = false;
+            this->pending[i] = this->pending.back();
+            this->pending.pop_back();
+            continue;
+        }
+        ++i;
+    }
+    return applied;
+}
+
+void map_input_buffer::save(int handle, std::string &out) const
+{
+    static const queue empty_queue;
+    const queue &q = handle > 0 && handle <= (int)this->queues.size() ? this->queues[handle - 1] : empty_queue;
+    map_state_put<uint32_t>(out, q.last_seq);
+    map_state_put<uint32_t>(out, q.applied_mask);
+    map_state_put<uint8_t>(out, (uint8_t)q.items.size());
+    for (const item &it : q.items)
+    {
+        map_state_put<uint32_t>(out, it.in.seq);
+        map_state_put<int32_t>(out, (int32_t)(it.ready_step - this->step_no));
+        map_state_put<double>(out, it.in.dir_x);
+        map_state_put<double>(out, it.in.dir_y);
+        map_state_put<double>(out, it.in.dir_z);
+        map_state_put<uint64_t>(out, it.in.client_time);
+    }
+}
+
+bool map_input_buffer::load(int handle, const char *&data, const char *end)
+{
+    if (handle <= 0)
+    {
+        return false;
+    }
+    remove(handle);
+
+    queue q;
+    uint8_t count = 0;
+    if (!map_state_get(data, end, q.last_seq) || !map_state_get(data, end, q.applied_mask) ||
+        !map_state_get(data, end, count) || count > WINDOW)
+    {
+        return false;
+    }
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        item it;
+        int32_t wait = 0;
+        if (!map_state_get(data, end, it.in.seq) || !map_state_get(data, end, wait) ||
+            !map_state_get(data, end, it.in.dir_x) || !map_state_get(data, end, it.in.dir_y) ||
+            !map_state_get(data, end, it.in.dir_z) || !map_state_get(data, end, it.in.client_time))
+        {
+            return false;
+        }
+        it.in.handle = handle;
+        it.ready_step = this->step_no + (uint32_t)wait;
+        q.items.push_back(it);
+    }
+
+    queue &target = queue_of(handle);
+    target = std::move(q);
+    if (!target.items.empty())
+    {
+        target.pending = true;
+        this->pending.push_back(handle);
+    }
+    return true;
+}
+
+map_input_buffer::stat map_input_buffer::take_stat()
+{
+    stat result = this->stats;
+    this->stats = stat{};
+    return result;
+}
+
+int map_input_buffer_mgr::create(int delay_steps, int reorder_steps)
+{
+    int buffer_id = 0;
+    if (this->free_ids.size() > 0)
+    {
+        buffer_id = this->free_ids.back();
+        this->free_ids.pop_back();
+    }
+    else
+    {
+        this->buffers.emplace_back();
+        buffer_id = (int)this->buffers.size();
+    }
+    this->buffers[buffer_id - 1] = std::make_unique<map_input_buffer>();
+    this->buffers[buffer_id - 1]->set_delay(delay_steps, reorder_steps);
+    return buffer_id;
+}
+
+void map_input_buffer_mgr::destroy(int buffer_id)
+{
+    if (get(buffer_id))
+    {
+        this->buffers[buffer_id - 1].reset();
+        this->free_ids.push_back(buffer_id);
+    }
+}
+
+map_input_buffer *map_input_buffer_mgr::get(int buffer_id)
+{
+    if (buffer_id <= 0 || buffer_id > (int)this->buffers.size())
+    {
+        return nullptr;
+    }
+    return this->buffers[buffer_id - 1].get();
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace avant::app
+{
+    // 玩家输入抖动缓冲 按seq排序暂存收到的输入 每个固定步长每个实体最多应用一条
+    // 输入到达后等delay步才可应用 吸收网络抖动 乱序到达的输入在窗口内重新排好
+    // 下一个seq迟迟不到时 后面的输入再等reorder步后跳过缺口 缺口之后才到的算late
+    // 实体用调用方给的handle标识 2D地图由map_physics每步内部消费 3D地图由Lua每步取出
+    class map_input_buffer
+    {
+    public:
+        // 每个实体最多暂存的输入数 超出时丢弃最早的
+        static constexpr int WINDOW = 16;
+
+        enum push_result
+        {
+            PUSH_QUEUED = 0,
+            PUSH_DUPLICATE = 1,
+            PUSH_LATE = 2,
+            PUSH_DROPPED = 3,
+        };
+
+        struct input
+        {
+            int handle{0};
+            uint32_t seq{0};
+            double dir_x{0}, dir_y{0}, dir_z{0};
+            uint64_t client_time{0};
+        };
+
+        struct stat
+        {
+            uint64_t applied{0};
+            uint64_t late{0};
+            uint64_t dropped{0};
+            uint64_t duplicate{0};
+            // 等不到而跳过的seq数
+            uint64_t skipped{0};
+        };
+
+        void set_delay(int delay_steps, int reorder_steps);
+
+        // 实体离开或handle复用前调用 之后从seq 1重新开始
+        void remove(int handle);
+        push_result push(int handle, uint32_t seq, double dir_x, double dir_y, double dir_z, uint64_t client_time);
+        // 推进一步 把本步应用的输入追加到out 返回条数
+        size_t step(std::vector<input> &out);
+
+        bool empty() const { return this->pending.empty(); }
+        stat take_stat();
+
+        // 地图迁移 把handle暂存的输入与seq窗口追加到out 还要等的步数按相对值保存
+        void save(int handle, std::string &out) const;
+        // 读出save写的一条记录恢复到handle 数据不完整时返回false且handle保持清空
+        bool load(int handle, const char *&data, const char *end);
+
+    private:
+        struct item
+        {
+            input in;
+            // 可以应用的最早步数
+            uint32_t ready_step{0};
+        };
+
+        struct queue
+        {
+            // 按seq升序
+            std::vector<item> items;
+            uint32_t last_seq{0};
+            // 第k位表示seq为last_seq-k的输入已应用 用来区分重复与迟到
+            uint32_t applied_mask{0};
+            bool pending{false};
+        };
+
+        queue &queue_of(int handle);
+        void advance(queue &q, uint32_t seq, bool applied);
+
+    private:
+        int delay_steps{1};
+        int reorder_steps{2};
+        uint32_t step_no{0};
+        std::vector<queue> queues;
+        // 有暂存输入的handle
+        std::vector<int> pending;
+        stat stats;
+    };
+
+    // Lua侧以整数id持有缓冲 只在other线程使用
+    class map_input_buffer_mgr
+    {
+    public:
+        int create(int delay_steps, int reorder_steps);
+        void destroy(int buffer_id);
+        map_input_buffer *get(int buffer_id);
+
+    private:
+        std::vector<std::unique_ptr<map_input_buffer>> buffers;
+        std::vector<int> free_ids;
+    };
+}
@@ -0,0 +1,275 @@
+#include "app/map_pathfind.h"
+#include <algorithm>
+#include <cstdlib>
+
+using namespace avant::app;
+
+static inline uint32_t map_pathfind_manhattan(int x0, int y0, int x1, int y1)
+{
+    return (uint32_t)(std::abs(x1 - x0) + std::abs(y1 - y0));
+}
+
+static inline int map_pathfind_sign(int v)
+{
+    return (v > 0) - (v < 0);
+}
+
+size_t map_pathfinder::cache_key_hash::operator()(const cache_key &key) const
+{
+    uint64_t h = key.version * 0x9E3779B97F4A7C15ull;
+    h ^= (uint64_t)(uint32_t)key.grid_id + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+    h ^= ((uint64_t)(uint32_t)key.start_x << 32 | (uint32_t)key.start_y) + (h << 6) + (h >> 2);
+    h ^= ((uint64_t)(uint32_t)key.end_x << 32 | (uint32_t)key.end_y) + (h << 6) + (h >> 2);
+    return (size_t)(h ^ (uint64_t)key.use_jps);
+}
+
+bool map_pathfinder::find_path(int grid_id, const map_tile_grid &grid, int start_x, int start_y, int end_x, int end_y,
+                               bool use_jps, std::vector<int32_t> &out)
+{
+    ++this->stats.searches;
+    const cache_key key{grid_id, grid.get_version(), start_x, start_y, end_x, end_y, use_jps};
+    auto iter = this->cache_index.find(key);
+    if (iter != this->cache_index.end())
+    {
+        ++this->stats.cache_hits;
+        this->cache.splice(this->cache.begin(), this->cache, iter->second);
+        out = iter->second->path;
+        if (!iter->second->found)
+        {
+            ++this->stats.failed;
+        }
+        return iter->second->found;
+    }
+
+    const bool found = search(grid, start_x, start_y, end_x, end_y, use_jps, out);
+    if (!found)
+    {
+        out.clear();
+        ++this->stats.failed;
+    }
+
+    // 复用最久未用的条目 不重新分配路径数组
+    if (this->cache.size() >= CACHE_CAPACITY)
+    {
+        this->cache_index.erase(this->cache.back().key);
+        this->cache.splice(this->cache.begin(), this->cache, std::prev(this->cache.end()));
+    }
+    else
+    {
+        this->cache.emplace_front();
+    }
+    cache_entry &entry = this->cache.front();
+    entry.key = key;
+    entry.found = found;
+    entry.path = out;
+    this->cache_index[key] = this->cache.begin();
+    return found;
+}
+
+map_pathfinder::node &map_pathfinder::visit(int idx)
+{
+    node &n = this->nodes[idx];
+    if (n.stamp != this->generation)
+    {
+        n.stamp = this->generation;
+        n.g = UINT32_MAX;
+        n.parent = -1;
+        n.closed = false;
+    }
+    return n;
+}
+
+void map_pathfinder::push_open(int idx, uint32_t g, uint32_t h)
+{
+    this->open.push_back(open_item{g + h, g, idx});
+    std::push_heap(this->open.begin(), this->open.end(), open_greater());
+}
+
+int map_pathfinder::jump(const map_tile_grid &grid, int x, int y, int dx, int dy, int end_x, int end_y) const
+{
+    while (true)
+    {
+        if (!grid.is_walkable(x, y))
+        {
+            return -1;
+        }
+        if (x == end_x && y == end_y)
+        {
+            return y * this->width + x;
+        }
+        if (dx != 0)
+        {
+            // 横向前进时 侧面刚离开墙角的格子是强制邻居
+            if ((grid.is_walkable(x, y - 1) && !grid.is_walkable(x - dx, y - 1)) ||
+                (grid.is_walkable(x, y + 1) && !grid.is_walkable(x - dx, y + 1)))
+            {
+                return y * this->width + x;
+            }
+        }
+        else
+        {
+            if ((grid.is_walkable(x - 1, y) && !grid.is_walkable(x - 1, y - dy)) ||
+                (grid.is_walkable(x + 1, y) && !grid.is_walkable(x + 1, y - dy)))
+            {
+                return y * this->width + x;
+            }
+            // 4方向没有对角移动 纵向前进时还要看两侧横向能否跳到跳点
+            if (jump(grid, x + 1, y, 1, 0, end_x, end_y) >= 0 || jump(grid, x - 1, y, -1, 0, end_x, end_y) >= 0)
+            {
+                return y * this->width + x;
+            }
+        }
+        x += dx;
+        y += dy;
+    }
+}
+
+bool map_pathfinder::search(const map_tile_grid &grid, int start_x, int start_y, int end_x, int end_y, bool use_jps,
+                            std::vector<int32_t> &out)
+{
+    out.clear();
+    if (!grid.in_bounds(start_x, start_y) || !grid.is_walkable(end_x, end_y))
+    {
+        return false;
+    }
+    if (start_x == end_x && start_y == end_y)
+    {
+        out.push_back(start_x);
+        out.push_back(start_y);
+        return true;
+    }
+    const size_t cells = (size_t)grid.get_width() * (size_t)grid.get_height();
+    if (cells > MAX_NODES)
+    {
+        return false;
+    }
+    if (this->nodes.size() < cells)
+    {
+        this->nodes.resize(cells);
+    }
+    this->width = grid.get_width();
+    if (++this->generation == 0)
+    {
+        // 代数回绕 全部重置一次
+        for (node &n : this->nodes)
+        {
+            n.stamp = 0;
+        }
+        this->generation = 1;
+    }
+    this->open.clear();
+
+    static const int dirs[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    const int start_idx = start_y * this->width + start_x;
+    const int end_idx = end_y * this->width + end_x;
+    visit(start_idx).g = 0;
+    push_open(start_idx, 0, map_pathfind_manhattan(start_x, start_y, end_x, end_y));
+
+    bool found = false;
+    while (!this->open.empty())
+    {
+        std::pop_heap(this->open.begin(), this->open.end(), open_greater());
+        const open_item item = this->open.back();
+        this->open.pop_back();
+        node &cur = this->nodes[item.idx];
+        // 堆里可能还有同一节点更早压入的旧项
+        if (cur.closed || item.g != cur.g)
+        {
+            continue;
+        }
+        cur.closed = true;
+        ++this->stats.expanded;
+        if (item.idx == end_idx)
+        {
+            found = true;
+            break;
+        }
+
+        const int x = item.idx % this->width;
+        const int y = item.idx / this->width;
+        // JPS按来向剪枝 起点向四周展开
+        int pdx = 0, pdy = 0;
+        if (use_jps && cur.parent >= 0)
+        {
+            pdx = map_pathfind_sign(x - cur.parent % this->width);
+            pdy = map_pathfind_sign(y - cur.parent / this->width);
+        }
+        for (const auto &dir : dirs)
+        {
+            const int nx = x + dir[0];
+            const int ny = y + dir[1];
+            // 不走回头路 横向来时只继续向前与两侧 纵向同理
+            if ((pdx != 0 && dir[0] == -pdx) || (pdy != 0 && dir[1] == -pdy))
+            {
+                continue;
+            }
+            if (!grid.is_walkable(nx, ny))
+            {
+                continue;
+            }
+            int next_idx = ny * this->width + nx;
+            if (use_jps)
+            {
+                next_idx = jump(grid, nx, ny, dir[0], dir[1], end_x, end_y);
+                if (next_idx < 0)
+                {
+                    continue;
+                }
+            }
+            node &next = visit(next_idx);
+            if (next.closed)
+            {
+                continue;
+            }
+            const int jx = next_idx % this->width;
+            const int jy = next_idx / this->width;
+            const uint32_t g = cur.g + map_pathfind_manhattan(x, y, jx, jy);
+            if (g < next.g)
+            {
+                next.g = g;
+                next.parent = item.idx;
+                push_open(next_idx, g, map_pathfind_manhattan(jx, jy, end_x, end_y));
+            }
+        }
+    }
+    if (!found)
+    {
+        return false;
+    }
+
+    // 从终点回溯 跳点之间是直线 逐格补齐 每格先y后x压入 最后整体翻转成起点开始的x,y
+    int idx = end_idx;
+    while (true)
+    {
+        int x = idx % this->width;
+        int y = idx / this->width;
+        const int parent = this->nodes[idx].parent;
+        if (parent < 0)
+        {
+            out.push_back(y);
+            out.push_back(x);
+            break;
+        }
+        const int px = parent % this->width;
+        const int py = parent / this->width;
+        const int sx = map_pathfind_sign(px - x);
+        const int sy = map_pathfind_sign(py - y);
+        while (x != px || y != py)
+        {
+            out.push_back(y);
+            out.push_back(x);
+            x += sx;
+            y += sy;
+        }
+        idx = parent;
+    }
+    std::reverse(out.begin(), out.end());
+    return true;
+}
+
+map_pathfinder::stat map_pathfinder::take_stat()
+{
+    stat result = this->stats;
+    this->stats = stat{};
+    return result;
+}
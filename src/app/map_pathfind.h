@@ -0,0 +1,107 @@
+#pragma once
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include "app/map_tile_grid.h"
+
+namespace avant::app
+{
+    // 瓦片网格上的A*寻路 4方向移动 每步代价1 曼哈顿距离为启发
+    // 开放表为二叉堆 节点数组按代数标记 查询之间复用不清零也不分配
+    // 可选跳点搜索(JPS) 只在直线上的跳点入堆 各格代价相同时路径与A*等长
+    // 结果按(网格id, 网格版本, 起终点, 是否JPS)缓存 LRU淘汰 网格变化后版本不同自然失效
+    // 节点数组按网格格数分配 超过MAX_NODES的大地图不在这里寻路
+    class map_pathfinder
+    {
+    public:
+        static constexpr size_t MAX_NODES = 4u << 20;
+        static constexpr size_t CACHE_CAPACITY = 256;
+
+        struct stat
+        {
+            uint64_t searches{0};
+            uint64_t cache_hits{0};
+            // 出堆展开的节点数
+            uint64_t expanded{0};
+            uint64_t failed{0};
+        };
+
+        // 网格坐标从0开始 找到时out为起点到终点(含两端)每格的x,y 否则返回false
+        // 起点本身不要求可行走 终点不可行走或越界直接返回false
+        bool find_path(int grid_id, const map_tile_grid &grid, int start_x, int start_y, int end_x, int end_y,
+                       bool use_jps, std::vector<int32_t> &out);
+        stat take_stat();
+
+    private:
+        struct node
+        {
+            uint32_t stamp{0};
+            uint32_t g{0};
+            int32_t parent{-1};
+            bool closed{false};
+        };
+
+        struct open_item
+        {
+            uint32_t f;
+            uint32_t g;
+            int32_t idx;
+        };
+
+        // f小的先出 f相同时g大的先出 更靠近终点
+        struct open_greater
+        {
+            bool operator()(const open_item &a, const open_item &b) const
+            {
+                return a.f != b.f ? a.f > b.f : a.g < b.g;
+            }
+        };
+
+        struct cache_key
+        {
+            int grid_id;
+            uint64_t version;
+            int start_x, start_y, end_x, end_y;
+            bool use_jps;
+
+            bool operator==(const cache_key &other) const
+            {
+                return grid_id == other.grid_id && version == other.version && start_x == other.start_x &&
+                       start_y == other.start_y && end_x == other.end_x && end_y == other.end_y &&
+                       use_jps == other.use_jps;
+            }
+        };
+
+        struct cache_key_hash
+        {
+            size_t operator()(const cache_key &key) const;
+        };
+
+        struct cache_entry
+        {
+            cache_key key;
+            bool found;
+            std::vector<int32_t> path;
+        };
+
+        bool search(const map_tile_grid &grid, int start_x, int start_y, int end_x, int end_y, bool use_jps,
+                    std::vector<int32_t> &out);
+        // 从(x,y)沿(dx,dy)直线前进 返回遇到的第一个跳点下标 撞墙返回-1
+        int jump(const map_tile_grid &grid, int x, int y, int dx, int dy, int end_x, int end_y) const;
+        // 本次查询第一次访问时重置节点
+        node &visit(int idx);
+        void push_open(int idx, uint32_t g, uint32_t h);
+
+    private:
+        std::vector<node> nodes;
+        uint32_t generation{0};
+        std::vector<open_item> open;
+        int width{0};
+
+        std::list<cache_entry> cache;
+        std::unordered_map<cache_key, std::list<cache_entry>::iterator, cache_key_hash> cache_index;
+
+        stat stats;
+    };
+}
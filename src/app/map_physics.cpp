@@ -0,0 +1,682 @@
+#include "app/map_physics.h"
+#include <algorithm>
+#include <cmath>
+#include "app/map_aoi.h"
+#include "app/map_snapshot.h"
+#include "app/map_state_codec.h"
+#include "app/map_tile_grid.h"
+#include "utility/singleton.h"
+
+using namespace avant::app;
+using namespace avant::utility;
+
+map_physics::map_physics(double width, double height, int aoi_id, int snapshot_id)
+    : width(width),
+      height(height),
+      aoi_id(aoi_id),
+      snapshot_id(snapshot_id)
+{
+}
+
+int map_physics::slot_of(int handle) const
+{
+    if (handle <= 0 || handle > (int)this->handle2slot.size())
+    {
+        return -1;
+    }
+    return this->handle2slot[handle - 1];
+}
+
+bool map_physics::add(int handle, double x, double y, double max_speed, double accel, double speed_ratio, double friction,
+                      double body_radius, double body_mass, double bounce)
+{
+    if (handle <= 0 || slot_of(handle) >= 0)
+    {
+        return false;
+    }
+    if ((int)this->handle2slot.size() < handle)
+    {
+        this->handle2slot.resize(handle, -1);
+    }
+    this->inputs.remove(handle);
+
+    this->handle2slot[handle - 1] = (int)this->slot2handle.size();
+    this->slot2handle.push_back(handle);
+    this->x.push_back(x);
+    this->y.push_back(y);
+    this->vx.push_back(0);
+    this->vy.push_back(0);
+    this->dir_x.push_back(0);
+    this->dir_y.push_back(0);
+    this->max_speed.push_back(max_speed);
+    this->accel.push_back(accel);
+    this->speed_ratio.push_back(speed_ratio);
+    this->friction.push_back(friction);
+    this->body_radius.push_back(body_radius);
+    this->body_mass.push_back(body_mass > 0 ? body_mass : 1);
+    this->bounce.push_back(bounce);
+    this->prev_x.push_back(x);
+    this->prev_y.push_back(y);
+    this->last_seq.push_back(0);
+    this->synced_seq.push_back(0);
+    this->last_client_time.push_back(0);
+    this->moved.push_back(0);
+    return true;
+}
+
+bool map_physics::remove(int handle)
+{
+    const int slot = slot_of(handle);
+    if (slot < 0)
+    {
+        return false;
+    }
+
+    const int last = (int)this->slot2handle.size() - 1;
+    if (slot != last)
+    {
+        this->x[slot] = this->x[last];
+        this->y[slot] = this->y[last];
+        this->vx[slot] = this->vx[last];
+        this->vy[slot] = this->vy[last];
+        this->dir_x[slot] = this->dir_x[last];
+        this->dir_y[slot] = this->dir_y[last];
+        this->max_speed[slot] = this->max_speed[last];
+        this->accel[slot] = this->accel[last];
+        this->speed_ratio[slot] = this->speed_ratio[last];
+        this->friction[slot] = this->friction[last];
+        this->body_radius[slot] = this->body_radius[last];
+        this->body_mass[slot] = this->body_mass[last];
+        this->bounce[slot] = this->bounce[last];
+        this->prev_x[slot] = this->prev_x[last];
+        this->prev_y[slot] = this->prev_y[last];
+        this->last_seq[slot] = this->last_seq[last];
+        this->synced_seq[slot] = this->synced_seq[last];
+        this->last_client_time[slot] = this->last_client_time[last];
+        this->slot2handle[slot] = this->slot2handle[last];
+        this->handle2slot[this->slot2handle[slot] - 1] = slot;
+    }
+
+    this->x.pop_back();
+    this->y.pop_back();
+    this->vx.pop_back();
+    this->vy.pop_back();
+    this->dir_x.pop_back();
+    this->dir_y.pop_back();
+    this->max_speed.pop_back();
+    this->accel.pop_back();
+    this->speed_ratio.pop_back();
+    this->friction.pop_back();
+    this->body_radius.pop_back();
+    this->body_mass.pop_back();
+    this->bounce.pop_back();
+    this->prev_x.pop_back();
+    this->prev_y.pop_back();
+    this->last_seq.pop_back();
+    this->synced_seq.pop_back();
+    this->last_client_time.pop_back();
+    this->moved.pop_back();
+    this->slot2handle.pop_back();
+    this->handle2slot[handle - 1] = -1;
+    this->inputs.remove(handle);
+    return true;
+}
+
+void map_physics::set_collision(int grid_id, double tile_size, bool player_collision)
+{
+    this->grid_id = grid_id;
+    this->tile_size = tile_size > 0 ? tile_size : 0;
+    this->player_collision = player_collision;
+}
+
+bool map_physics::set_input(int handle, double dir_x, double dir_y, uint32_t seq, uint64_t client_time)
+{
+    const int slot = slot_of(handle);
+    if (slot < 0)
+    {
+        return false;
+    }
+    this->dir_x[slot] = dir_x;
+    this->dir_y[slot] = dir_y;
+    this->last_seq[slot] = seq;
+    this->last_client_time[slot] = client_time;
+    return true;
+}
+
+map_input_buffer::push_result map_physics::push_input(int handle, double dir_x, double dir_y, uint32_t seq, uint64_t client_time)
+{
+    if (slot_of(handle) < 0)
+    {
+        return map_input_buffer::PUSH_DROPPED;
+    }
+    return this->inputs.push(handle, seq, dir_x, dir_y, 0, client_time);
+}
+
+bool map_physics::get(int handle, double &x, double &y, double &vx, double &vy) const
+{
+    const int slot = slot_of(handle);
+    if (slot < 0)
+    {
+        return false;
+    }
+    x = this->x[slot];
+    y = this->y[slot];
+    vx = this->vx[slot];
+    vy = this->vy[slot];
+    return true;
+}
+
+// 迁移状态的魔数与格式版本 字段增减时版本加一
+static constexpr uint32_t MAP_PHYSICS_STATE_MAGIC = 0x4F485641; // "AVHO"
+static constexpr uint8_t MAP_PHYSICS_STATE_VERSION = 1;
+
+bool map_physics::export_state(const std::vector<int> &handles, std::string &out) const
+{
+    for (int handle : handles)
+    {
+        if (slot_of(handle) < 0)
+        {
+            return false;
+        }
+    }
+
+    map_state_put<uint32_t>(out, MAP_PHYSICS_STATE_MAGIC);
+    map_state_put<uint8_t>(out, MAP_PHYSICS_STATE_VERSION);
+    map_state_put<uint32_t>(out, (uint32_t)handles.size());
+    for (int handle : handles)
+    {
+        const int slot = slot_of(handle);
+        const double fields[] = {this->x[slot], this->y[slot], this->vx[slot], this->vy[slot],
+                                 this->dir_x[slot], this->dir_y[slot], this->max_speed[slot], this->accel[slot],
+                                 this->speed_ratio[slot], this->friction[slot], this->body_radius[slot],
+                                 this->body_mass[slot], this->bounce[slot]};
+        for (double v : fields)
+        {
+            map_state_put<double>(out, v);
+        }
+        map_state_put<uint32_t>(out, this->last_seq[slot]);
+        map_state_put<uint64_t>(out, this->last_client_time[slot]);
+        this->inputs.save(handle, out);
+    }
+    return true;
+}
+
+int map_physics::import_state(const std::vector<int> &handles, const std::string &in)
+{
+    const char *data = in.data();
+    const char *end = data + in.size();
+    uint32_t magic = 0;
+    uint8_t version = 0;
+    uint32_t count = 0;
+    if (!map_state_get(data, end, magic) || !map_state_get(data, end, version) || !map_state_get(data, end, count) ||
+        magic != MAP_PHYSICS_STATE_MAGIC || version != MAP_PHYSICS_STATE_VERSION || count != handles.size())
+    {
+        return -1;
+    }
+
+    size_t imported = 0;
+    bool ok = true;
+    for (; imported < handles.size(); ++imported)
+    {
+        double f[13];
+        uint32_t seq = 0;
+        uint64_t client_time = 0;
+        for (double &v : f)
+        {
+            ok = ok && map_state_get(data, end, v);
+        }
+        ok = ok && map_state_get(data, end, seq) && map_state_get(data, end, client_time);
+        const int handle = handles[imported];
+        if (!ok || !add(handle, f[0], f[1], f[6], f[7], f[8], f[9], f[10], f[11], f[12]))
+        {
+            ok = false;
+            break;
+        }
+        if (!this->inputs.load(handle, data, end))
+        {
+            remove(handle);
+            ok = false;
+            break;
+        }
+        const int slot = slot_of(handle);
+        this->vx[slot] = f[2];
+        this->vy[slot] = f[3];
+        this->dir_x[slot] = f[4];
+        this->dir_y[slot] = f[5];
+        this->last_seq[slot] = seq;
+        this->synced_seq[slot] = seq;
+        this->last_client_time[slot] = client_time;
+    }
+    if (!ok || data != end)
+    {
+        for (size_t i = 0; i < imported; ++i)
+        {
+            remove(handles[i]);
+        }
+        return -1;
+    }
+
+    // 与step中的同步相同 目标进程的AOI与快照从迁移时的位置开始
+    map_aoi *aoi = singleton<map_aoi_mgr>::instance()->get(this->aoi_id);
+    map_snapshot *snapshot = singleton<map_snapshot_mgr>::instance()->get(this->snapshot_id);
+    for (int handle : handles)
+    {
+        const int slot = slot_of(handle);
+        if (aoi)
+        {
+            aoi->update(handle, this->x[slot], this->y[slot]);
+        }
+        if (snapshot)
+        {
+            snapshot->set_state(handle, this->x[slot], this->y[slot], this->vx[slot], this->vy[slot], this->last_seq[slot],
+                                this->last_client_time[slot]);
+        }
+    }
+    return (int)imported;
+}
+
+// 每个轴的速度更新
+// 目标速度由方向和最大速度决定 每步最多改变accel*dt 乘方向分量后的量
+// 只有乘法后紧跟floor 没有乘加 不会因浮点收缩与Lua结果不同
+static inline double map_physics_axis_velocity(double v, double dir, double speed_ratio, double max_speed, double max_delta_v)
+{
+    const double target = std::floor((dir * speed_ratio) * max_speed);
+    const double delta = target - v;
+    const double max_delta = std::fabs(std::floor(max_delta_v * dir));
+    const bool limited = (max_delta != 0) & (std::fabs(delta) > max_delta);
+    return limited ? v + std::copysign(max_delta, delta) : target;
+}
+
+// 批量积分 参数都不重叠 标注__restrict后编译器可以向量化
+// 结果只与逐实体计算的顺序和取整有关 向量化前后相同
+static void map_physics_integrate(size_t count, double dt_ms, double width, double height,
+                                  double *__restrict x, double *__restrict y,
+                                  double *__restrict vx, double *__restrict vy,
+                                  const double *__restrict dir_x, const double *__restrict dir_y,
+                                  const double *__restrict max_speed, const double *__restrict accel,
+                                  const double *__restrict speed_ratio, const double *__restrict friction,
+                                  const double *__restrict body_radius, uint64_t *__restrict moved,
+                                  double *__restrict prev_x, double *__restrict prev_y)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const double max_delta_v = std::floor(accel[i] * dt_ms);
+        double nvx = map_physics_axis_velocity(vx[i], dir_x[i], speed_ratio[i], max_speed[i], max_delta_v);
+        double nvy = map_physics_axis_velocity(vy[i], dir_y[i], speed_ratio[i], max_speed[i], max_delta_v);
+
+        double nx = x[i] + std::floor((nvx * dt_ms) / speed_ratio[i]);
+        double ny = y[i] + std::floor((nvy * dt_ms) / speed_ratio[i]);
+
+        nvx = std::floor(nvx * friction[i]);
+        nvy = std::floor(nvy * friction[i]);
+
+        // 地图边界 先判左上再判右下 与Lua顺序一致
+        const double r = body_radius[i];
+        nx = std::min(std::max(nx, r), width - r);
+        ny = std::min(std::max(ny, r), height - r);
+
+        moved[i] = (nx != x[i]) | (ny != y[i]) | (nvx != vx[i]) | (nvy != vy[i]);
+        prev_x[i] = x[i];
+        prev_y[i] = y[i];
+        x[i] = nx;
+        y[i] = ny;
+        vx[i] = nvx;
+        vy[i] = nvy;
+    }
+}
+
+int map_physics::step(double dt_ms)
+{
+    if (!this->inputs.empty())
+    {
+        this->ready_inputs.clear();
+        this->inputs.step(this->ready_inputs);
+        for (const map_input_buffer::input &in : this->ready_inputs)
+        {
+            set_input(in.handle, in.dir_x, in.dir_y, in.seq, in.client_time);
+        }
+    }
+
+    const size_t count = this->slot2handle.size();
+    map_physics_integrate(count, dt_ms, this->width, this->height,
+                          this->x.data(), this->y.data(), this->vx.data(), this->vy.data(),
+                          this->dir_x.data(), this->dir_y.data(), this->max_speed.data(), this->accel.data(),
+                          this->speed_ratio.data(), this->friction.data(), this->body_radius.data(), this->moved.data(),
+                          this->prev_x.data(), this->prev_y.data());
+
+    if (this->player_collision)
+    {
+        collide_players();
+    }
+    const map_tile_grid *grid = this->grid_id != 0 && this->tile_size > 0 ? singleton<map_tile_grid_mgr>::instance()->get(this->grid_id) : nullptr;
+    if (grid)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (this->x[i] != this->prev_x[i] || this->y[i] != this->prev_y[i])
+            {
+                this->moved[i] |= collide_tiles((int)i, *grid);
+            }
+        }
+    }
+
+    // 静止且没有新输入的实体不产生同步
+    map_aoi *aoi = singleton<map_aoi_mgr>::instance()->get(this->aoi_id);
+    map_snapshot *snapshot = singleton<map_snapshot_mgr>::instance()->get(this->snapshot_id);
+    int changed_cnt = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (!this->moved[i] && this->last_seq[i] == this->synced_seq[i])
+        {
+            continue;
+        }
+        ++changed_cnt;
+        const int handle = this->slot2handle[i];
+        this->synced_seq[i] = this->last_seq[i];
+        if (aoi)
+        {
+            aoi->update(handle, this->x[i], this->y[i]);
+        }
+        if (snapshot)
+        {
+            snapshot->set_state(handle, this->x[i], this->y[i], this->vx[i], this->vy[i], this->last_seq[i], this->last_client_time[i]);
+        }
+    }
+    return changed_cnt;
+}
+
+// 位置取整与积分一致 速度按各自speed_ratio放大后取整
+static inline double map_physics_round(double v)
+{
+    return std::floor(v + 0.5);
+}
+
+void map_physics::collide_players()
+{
+    const size_t count = this->slot2handle.size();
+    if (count < 2)
+    {
+        return;
+    }
+
+    // 格子边长取最大直径 相撞的两实体一定在相邻格子里
+    double cell = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        cell = std::max(cell, this->body_radius[i] * 2);
+    }
+    if (cell <= 0)
+    {
+        return;
+    }
+    const double inv_cell = 1.0 / cell;
+
+    // 桶数取不小于2倍实体数的2的幂 不同格子哈希到同一桶只会多出一些候选
+    size_t bucket_cnt = 1;
+    while (bucket_cnt < count * 2)
+    {
+        bucket_cnt <<= 1;
+    }
+    const uint32_t bucket_mask = (uint32_t)bucket_cnt - 1;
+    auto bucket_of = [bucket_mask](int64_t cx, int64_t cy)
+    {
+        return (uint32_t)(((uint64_t)cx * 73856093u) ^ ((uint64_t)cy * 19349663u)) & bucket_mask;
+    };
+
+    this->slot_bucket.resize(count);
+    this->bucket_start.assign(bucket_cnt + 1, 0);
+    this->bucket_slots.resize(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint32_t bucket = bucket_of((int64_t)std::floor(this->x[i] * inv_cell), (int64_t)std::floor(this->y[i] * inv_cell));
+        this->slot_bucket[i] = bucket;
+        ++this->bucket_start[bucket + 1];
+    }
+    for (size_t b = 0; b < bucket_cnt; ++b)
+    {
+        this->bucket_start[b + 1] += this->bucket_start[b];
+    }
+    // 按slot升序填入 桶内顺序固定
+    this->bucket_fill.assign(this->bucket_start.begin(), this->bucket_start.end() - 1);
+    for (size_t i = 0; i < count; ++i)
+    {
+        this->bucket_slots[this->bucket_fill[this->slot_bucket[i]]++] = (int)i;
+    }
+
+    // 碰撞前的状态 取整后与之比较决定是否需要同步
+    this->touched.assign(count, 0);
+    this->before.resize(count * 4);
+
+    uint32_t visited[9];
+    for (size_t i = 0; i < count; ++i)
+    {
+        const int64_t cx = (int64_t)std::floor(this->x[i] * inv_cell);
+        const int64_t cy = (int64_t)std::floor(this->y[i] * inv_cell);
+        int visited_cnt = 0;
+        for (int64_t ny = cy - 1; ny <= cy + 1; ++ny)
+        {
+            for (int64_t nx = cx - 1; nx <= cx + 1; ++nx)
+            {
+                const uint32_t bucket = bucket_of(nx, ny);
+                // 邻格哈希到同一个桶时只看一次
+                if (std::find(visited, visited + visited_cnt, bucket) != visited + visited_cnt)
+                {
+                    continue;
+                }
+                visited[visited_cnt++] = bucket;
+
+                for (int pos = this->bucket_start[bucket]; pos < this->bucket_start[bucket + 1]; ++pos)
+                {
+                    // 每对只在较小slot一侧处理一次 顺序固定 结果与线程无关
+                    const size_t j = (size_t)this->bucket_slots[pos];
+                    if (j <= i)
+                    {
+                        continue;
+                    }
+                    const double dx = this->x[j] - this->x[i];
+                    const double dy = this->y[j] - this->y[i];
+                    const double min_dist = this->body_radius[i] + this->body_radius[j];
+                    const double dist2 = dx * dx + dy * dy;
+                    if (dist2 >= min_dist * min_dist)
+                    {
+                        continue;
+                    }
+
+                    for (size_t k : {i, j})
+                    {
+                        if (!this->touched[k])
+                        {
+                            this->touched[k] = 1;
+                            this->before[k * 4] = this->x[k];
+                            this->before[k * 4 + 1] = this->y[k];
+                            this->before[k * 4 + 2] = this->vx[k];
+                            this->before[k * 4 + 3] = this->vy[k];
+                        }
+                    }
+
+                    // 完全重合时沿x轴分开
+                    const double dist = std::sqrt(dist2);
+                    const double nx_ = dist > 0 ? dx / dist : 1;
+                    const double ny_ = dist > 0 ? dy / dist : 0;
+                    const double inv_mi = 1.0 / this->body_mass[i];
+                    const double inv_mj = 1.0 / this->body_mass[j];
+                    const double inv_sum = inv_mi + inv_mj;
+
+                    // 穿透按质量反比分摊
+                    const double push = (min_dist - dist) / inv_sum;
+                    this->x[i] -= nx_ * push * inv_mi;
+                    this->y[i] -= ny_ * push * inv_mi;
+                    this->x[j] += nx_ * push * inv_mj;
+                    this->y[j] += ny_ * push * inv_mj;
+
+                    // 相互接近时沿法线施加冲量 速度换算成px/ms再算
+                    const double vix = this->vx[i] / this->speed_ratio[i], viy = this->vy[i] / this->speed_ratio[i];
+                    const double vjx = this->vx[j] / this->speed_ratio[j], vjy = this->vy[j] / this->speed_ratio[j];
+                    const double vn = (vjx - vix) * nx_ + (vjy - viy) * ny_;
+                    if (vn < 0)
+                    {
+                        const double e = std::max(this->bounce[i], this->bounce[j]);
+                        const double impulse = -(1 + e) * vn / inv_sum;
+                        this->vx[i] = map_physics_round((vix - impulse * inv_mi * nx_) * this->speed_ratio[i]);
+                        this->vy[i] = map_physics_round((viy - impulse * inv_mi * ny_) * this->speed_ratio[i]);
+                        this->vx[j] = map_physics_round((vjx + impulse * inv_mj * nx_) * this->speed_ratio[j]);
+                        this->vy[j] = map_physics_round((vjy + impulse * inv_mj * ny_) * this->speed_ratio[j]);
+                    }
+                }
+            }
+        }
+    }
+
+    // 相互挤住不动的实体取整后回到原位 不产生同步
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (this->touched[i])
+        {
+            const double r = this->body_radius[i];
+            this->x[i] = std::min(std::max(map_physics_round(this->x[i]), r), this->width - r);
+            this->y[i] = std::min(std::max(map_physics_round(this->y[i]), r), this->height - r);
+            this->moved[i] |= this->x[i] != this->before[i * 4] || this->y[i] != this->before[i * 4 + 1] ||
+                              this->vx[i] != this->before[i * 4 + 2] || this->vy[i] != this->before[i * 4 + 3];
+        }
+    }
+}
+
+bool map_physics::collide_tiles(int slot, const map_tile_grid &grid)
+{
+    const double r = this->body_radius[slot];
+    const double ts = this->tile_size;
+    const double end_x = this->x[slot];
+    const double end_y = this->y[slot];
+
+    // 每小步不超过半径与瓦片的一半 不会穿过整块瓦片 再逐步把圆推出重叠的瓦片
+    const double move_x = end_x - this->prev_x[slot];
+    const double move_y = end_y - this->prev_y[slot];
+    const double max_step = std::max(0.5, 0.5 * std::min(r, ts));
+    const int steps = std::max(1, (int)std::ceil(std::sqrt(move_x * move_x + move_y * move_y) / max_step));
+    double step_x = move_x / steps;
+    double step_y = move_y / steps;
+
+    double cx = this->prev_x[slot];
+    double cy = this->prev_y[slot];
+    // 所有接触法线的和 用来反弹速度
+    double hit_nx = 0, hit_ny = 0;
+    bool hit = false;
+    for (int s = 0; s < steps; ++s)
+    {
+        cx += step_x;
+        cy += step_y;
+
+        const int tx0 = (int)std::floor((cx - r) / ts), tx1 = (int)std::floor((cx + r) / ts);
+        const int ty0 = (int)std::floor((cy - r) / ts), ty1 = (int)std::floor((cy + r) / ts);
+        for (int ty = ty0; ty <= ty1; ++ty)
+        {
+            for (int tx = tx0; tx <= tx1; ++tx)
+            {
+                // 地图外由边界钳制处理
+                if (!grid.in_bounds(tx, ty) || grid.is_walkable(tx, ty))
+                {
+                    continue;
+                }
+                const double left = tx * ts, top = ty * ts;
+                const double near_x = std::min(std::max(cx, left), left + ts);
+                const double near_y = std::min(std::max(cy, top), top + ts);
+                double nx = cx - near_x, ny = cy - near_y;
+                const double dist2 = nx * nx + ny * ny;
+                if (dist2 >= r * r)
+                {
+                    continue;
+                }
+
+                double push = 0;
+                if (dist2 > 0)
+                {
+                    const double dist = std::sqrt(dist2);
+                    nx /= dist;
+                    ny /= dist;
+                    push = r - dist;
+                }
+                else
+                {
+                    // 圆心已在瓦片内 从穿透最浅的一边推出
+                    const double pen[4] = {cx - left, left + ts - cx, cy - top, top + ts - cy};
+                    const int side = (int)(std::min_element(pen, pen + 4) - pen);
+                    nx = side == 0 ? -1 : (side == 1 ? 1 : 0);
+                    ny = side == 2 ? -1 : (side == 3 ? 1 : 0);
+                    push = pen[side] + r;
+                }
+                cx += nx * push;
+                cy += ny * push;
+                hit_nx += nx;
+                hit_ny += ny;
+                hit = true;
+
+                // 剩余位移去掉指向墙内的分量 沿墙滑动
+                const double into = step_x * nx + step_y * ny;
+                if (into < 0)
+                {
+                    step_x -= into * nx;
+                    step_y -= into * ny;
+                }
+            }
+        }
+    }
+    if (!hit)
+    {
+        return false;
+    }
+
+    const double len = std::sqrt(hit_nx * hit_nx + hit_ny * hit_ny);
+    if (len > 0)
+    {
+        hit_nx /= len;
+        hit_ny /= len;
+        const double vn = this->vx[slot] * hit_nx + this->vy[slot] * hit_ny;
+        if (vn < 0)
+        {
+            const double k = (1 + this->bounce[slot]) * vn;
+            this->vx[slot] = map_physics_round(this->vx[slot] - k * hit_nx);
+            this->vy[slot] = map_physics_round(this->vy[slot] - k * hit_ny);
+        }
+    }
+    // 位置取整时朝远离墙的方向取 不会因取整又陷进瓦片
+    cx = hit_nx > 0 ? std::ceil(cx) : (hit_nx < 0 ? std::floor(cx) : map_physics_round(cx));
+    cy = hit_ny > 0 ? std::ceil(cy) : (hit_ny < 0 ? std::floor(cy) : map_physics_round(cy));
+    this->x[slot] = std::min(std::max(cx, r), this->width - r);
+    this->y[slot] = std::min(std::max(cy, r), this->height - r);
+    return true;
+}
+
+int map_physics_mgr::create(double width, double height, int aoi_id, int snapshot_id)
+{
+    int physics_id = 0;
+    if (this->free_ids.size() > 0)
+    {
+        physics_id = this->free_ids.back();
+        this->free_ids.pop_back();
+    }
+    else
+    {
+        this->physics.emplace_back();
+        physics_id = (int)this->physics.size();
+    }
+    this->physics[physics_id - 1] = std::make_unique<map_physics>(width, height, aoi_id, snapshot_id);
+    return physics_id;
+}
+
+void map_physics_mgr::destroy(int physics_id)
+{
+    if (get(physics_id))
+    {
+        this->physics[physics_id - 1].reset();
+        this->free_ids.push_back(physics_id);
+    }
+}
+
+map_physics *map_physics_mgr::get(int physics_id)
+{
+    if (physics_id <= 0 || physics_id > (int)this->physics.size())
+    {
+        return nullptr;
+    }
+    return this->physics[physics_id - 1].get();
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "app/map_input_buffer.h"
+
+namespace avant::app
+{
+    class map_tile_grid;
+
+    // 2D地图移动积分 按字段分数组存放 每个固定步长一次批量算完所有实体
+    // 积分的计算顺序与取整方式和原Lua版Map:PlayerPhysicsMove一致 不开碰撞时结果逐位相同
+    // 积分后可选碰撞阶段 实体之间圆与圆碰撞(空间哈希宽相位) 再做圆对瓦片网格的扫掠碰撞
+    // 实体用调用方给的handle标识 与地图AOI handle相同 状态变化的实体直接同步到挂接的AOI与快照编码器
+    // 客户端输入经抖动缓冲按seq排序 每步积分前每个实体最多应用一条
+    class map_physics
+    {
+    public:
+        map_physics(double width, double height, int aoi_id, int snapshot_id);
+
+        // handle已存在时返回false
+        bool add(int handle, double x, double y, double max_speed, double accel, double speed_ratio, double friction,
+                 double body_radius, double body_mass, double bounce);
+        bool remove(int handle);
+        // dir为归一化后的输入方向 seq与client_time只用于同步给客户端 立即生效
+        bool set_input(int handle, double dir_x, double dir_y, uint32_t seq, uint64_t client_time);
+        // 客户端输入放进抖动缓冲 之后的step按seq逐条应用
+        map_input_buffer::push_result push_input(int handle, double dir_x, double dir_y, uint32_t seq, uint64_t client_time);
+        void set_input_delay(int delay_steps, int reorder_steps) { this->inputs.set_delay(delay_steps, reorder_steps); }
+        map_input_buffer::stat take_input_stat() { return this->inputs.take_stat(); }
+        bool get(int handle, double &x, double &y, double &vx, double &vy) const;
+
+        // 跨进程迁移 按handles顺序把实体参数 运动状态与抖动缓冲里的输入写成紧凑二进制追加到out
+        // 有handle不存在时返回false
+        bool export_state(const std::vector<int> &handles, std::string &out) const;
+        // 按handles顺序导入export_state的结果 handles为目标进程AOI中新分配的handle
+        // 导入后立即同步到挂接的AOI与快照编码器 数据损坏或数量不符时返回-1且不留下任何实体
+        int import_state(const std::vector<int> &handles, const std::string &in);
+
+        // grid_id非0时与该网格中不可行走的瓦片碰撞 tile_size为瓦片像素边长
+        // player_collision开启实体之间的碰撞 按质量分摊穿透并按bounce反弹
+        void set_collision(int grid_id, double tile_size, bool player_collision);
+
+        // 推进一个固定步长 返回状态有变化的实体数
+        int step(double dt_ms);
+
+        size_t size() const { return this->slot2handle.size(); }
+
+    private:
+        int slot_of(int handle) const;
+        void collide_players();
+        // 从积分前位置扫掠到当前位置 碰到瓦片时沿墙滑动并反弹 返回是否碰撞
+        bool collide_tiles(int slot, const map_tile_grid &grid);
+
+    private:
+        double width;
+        double height;
+        int aoi_id;
+        int snapshot_id;
+
+        // 按slot紧密排列 移除时用末尾实体填补
+        std::vector<double> x, y;
+        std::vector<double> vx, vy;
+        std::vector<double> dir_x, dir_y;
+        std::vector<double> max_speed;
+        std::vector<double> accel;
+        std::vector<double> speed_ratio;
+        std::vector<double> friction;
+        std::vector<double> body_radius;
+        std::vector<double> body_mass;
+        std::vector<double> bounce;
+        // 本步积分前的位置 扫掠碰撞的起点
+        std::vector<double> prev_x, prev_y;
+        std::vector<uint32_t> last_seq;
+        // 最近一次同步出去时的last_seq 有新确认的输入时即使没动也要同步
+        std::vector<uint32_t> synced_seq;
+        std::vector<uint64_t> last_client_time;
+        // 本步位置或速度是否变化 与double同宽以便和积分一起向量化
+        std::vector<uint64_t> moved;
+        std::vector<int> slot2handle;
+        // handle-1到slot 不存在为-1
+        std::vector<int> handle2slot;
+
+        int grid_id{0};
+        double tile_size{0};
+        bool player_collision{false};
+        // 实体碰撞宽相位 按空间哈希桶计数排序 桶b的实体为bucket_slots[bucket_start[b]..bucket_start[b+1])
+        std::vector<uint32_t> slot_bucket;
+        std::vector<int> bucket_start;
+        std::vector<int> bucket_slots;
+        std::vector<int> bucket_fill;
+
+        map_input_buffer inputs;
+        std::vector<map_input_buffer::input> ready_inputs;
+        // 本步参与过实体碰撞的slot 及其碰撞前的x y vx vy
+        std::vector<uint8_t> touched;
+        std::vector<double> before;
+    };
+
+    // Lua侧以整数id持有物理 只在other线程使用 map_sim_mgr并行tick期间只读
+    class map_physics_mgr
+    {
+    public:
+        int create(double width, double height, int aoi_id, int snapshot_id);
+        void destroy(int physics_id);
+        map_physics *get(int physics_id);
+
+    private:
+        std::vector<std::unique_ptr<map_physics>> physics;
+        std::vector<int> free_ids;
+    };
+}
@@ -0,0 +1,340 @@
+#include "app/map_quadtree.h"
+#include <algorithm>
+
+using namespace avant::app;
+
+map_quadtree::map_quadtree(double x, double y, double w, double h, int max_depth, int leaf_capacity)
+    : max_depth(max_depth > 0 ? std::min(max_depth, MAX_DEPTH_LIMIT) : DEFAULT_MAX_DEPTH),
+      leaf_capacity(leaf_capacity > 0 ? leaf_capacity : DEFAULT_LEAF_CAPACITY)
+{
+    node root;
+    root.hw = w / 2;
+    root.hh = h / 2;
+    root.cx = x + root.hw;
+    root.cy = y + root.hh;
+    this->nodes.push_back(root);
+}
+
+bool map_quadtree::in_cell(const node &n, double x, double y) const
+{
+    return x >= n.cx - n.hw && x < n.cx + n.hw && y >= n.cy - n.hh && y < n.cy + n.hh;
+}
+
+int map_quadtree::alloc_children(int node_idx)
+{
+    int first = 0;
+    if (this->free_node_blocks.size() > 0)
+    {
+        first = this->free_node_blocks.back();
+        this->free_node_blocks.pop_back();
+    }
+    else
+    {
+        first = (int)this->nodes.size();
+        this->nodes.resize(this->nodes.size() + 4);
+    }
+
+    // resize后重新取引用
+    const node parent = this->nodes[node_idx];
+    for (int i = 0; i < 4; ++i)
+    {
+        node &child = this->nodes[first + i];
+        child = node{};
+        child.hw = parent.hw / 2;
+        child.hh = parent.hh / 2;
+        // 0左上 1右上 2左下 3右下
+        child.cx = parent.cx + ((i & 1) ? child.hw : -child.hw);
+        child.cy = parent.cy + ((i & 2) ? child.hh : -child.hh);
+        child.parent = node_idx;
+        child.depth = parent.depth + 1;
+    }
+    this->nodes[node_idx].first_child = first;
+    return first;
+}
+
+void map_quadtree::free_children(int node_idx)
+{
+    int first = this->nodes[node_idx].first_child;
+    if (first < 0)
+    {
+        return;
+    }
+    for (int i = 0; i < 4; ++i)
+    {
+        free_children(first + i);
+    }
+    this->nodes[node_idx].first_child = -1;
+    this->free_node_blocks.push_back(first);
+}
+
+void map_quadtree::link(int node_idx, int entity_idx)
+{
+    node &n = this->nodes[node_idx];
+    entity &e = this->entities[entity_idx];
+    e.node = node_idx;
+    e.prev = -1;
+    e.next = n.head;
+    if (n.head >= 0)
+    {
+        this->entities[n.head].prev = entity_idx;
+    }
+    n.head = entity_idx;
+    n.count++;
+    for (int idx = node_idx; idx >= 0; idx = this->nodes[idx].parent)
+    {
+        this->nodes[idx].subtree_count++;
+    }
+}
+
+void map_quadtree::unlink(int entity_idx)
+{
+    entity &e = this->entities[entity_idx];
+    node &n = this->nodes[e.node];
+    if (e.prev >= 0)
+    {
+        this->entities[e.prev].next = e.next;
+    }
+    else
+    {
+        n.head = e.next;
+    }
+    if (e.next >= 0)
+    {
+        this->entities[e.next].prev = e.prev;
+    }
+    n.count--;
+    for (int idx = e.node; idx >= 0; idx = this->nodes[idx].parent)
+    {
+        this->nodes[idx].subtree_count--;
+    }
+    e.node = -1;
+    e.prev = -1;
+    e.next = -1;
+}
+
+// 从根向下找到能容纳实体的最深已存在节点
+void map_quadtree::place(int entity_idx)
+{
+    const entity &e = this->entities[entity_idx];
+    int node_idx = 0;
+    if (in_cell(this->nodes[0], e.x, e.y))
+    {
+        while (this->nodes[node_idx].first_child >= 0)
+        {
+            const node &n = this->nodes[node_idx];
+            if (e.radius > std::min(n.hw, n.hh) / 2)
+            {
+                break;
+            }
+            int quadrant = (e.x >= n.cx ? 1 : 0) | (e.y >= n.cy ? 2 : 0);
+            node_idx = n.first_child + quadrant;
+        }
+    }
+    link(node_idx, entity_idx);
+
+    const node &n = this->nodes[node_idx];
+    if (n.first_child < 0 && n.count > this->leaf_capacity && n.depth < this->max_depth)
+    {
+        split(node_idx);
+    }
+}
+
+void map_quadtree::split(int node_idx)
+{
+    alloc_children(node_idx);
+
+    // 把能放进子节点的实体下沉一层 子节点超过容量时递归分裂
+    int entity_idx = this->nodes[node_idx].head;
+    while (entity_idx >= 0)
+    {
+        int next = this->entities[entity_idx].next;
+        const entity &e = this->entities[entity_idx];
+        const node &n = this->nodes[node_idx];
+        if (e.radius <= std::min(n.hw, n.hh) / 2 && in_cell(n, e.x, e.y))
+        {
+            int quadrant = (e.x >= n.cx ? 1 : 0) | (e.y >= n.cy ? 2 : 0);
+            int child_idx = n.first_child + quadrant;
+            unlink(entity_idx);
+            link(child_idx, entity_idx);
+        }
+        entity_idx = next;
+    }
+
+    int first = this->nodes[node_idx].first_child;
+    for (int i = 0; i < 4; ++i)
+    {
+        const node &child = this->nodes[first + i];
+        if (child.count > this->leaf_capacity && child.depth < this->max_depth)
+        {
+            split(first + i);
+        }
+    }
+}
+
+// 子树里已经没有实体时回收子节点 沿父节点向上检查
+void map_quadtree::shrink(int node_idx)
+{
+    for (int idx = node_idx; idx >= 0; idx = this->nodes[idx].parent)
+    {
+        const node &n = this->nodes[idx];
+        if (n.first_child >= 0 && n.subtree_count == n.count)
+        {
+            free_children(idx);
+        }
+    }
+}
+
+int map_quadtree::insert(double x, double y, double radius)
+{
+    int entity_idx = 0;
+    if (this->free_entities.size() > 0)
+    {
+        entity_idx = this->free_entities.back();
+        this->free_entities.pop_back();
+    }
+    else
+    {
+        entity_idx = (int)this->entities.size();
+        this->entities.emplace_back();
+    }
+
+    entity &e = this->entities[entity_idx];
+    e.x = x;
+    e.y = y;
+    e.radius = radius > 0 ? radius : 0;
+    e.alive = true;
+    this->max_radius = std::max(this->max_radius, e.radius);
+    place(entity_idx);
+    this->entity_cnt++;
+    return entity_idx + 1;
+}
+
+bool map_quadtree::update(int handle, double x, double y)
+{
+    int entity_idx = handle - 1;
+    if (entity_idx < 0 || entity_idx >= (int)this->entities.size() || !this->entities[entity_idx].alive)
+    {
+        return false;
+    }
+
+    entity &e = this->entities[entity_idx];
+    const node &n = this->nodes[e.node];
+    // 根节点兜底存放地图外的实体 只有圆心仍在本格内才走快路径
+    if (in_cell(n, x, y))
+    {
+        e.x = x;
+        e.y = y;
+        return true;
+    }
+
+    int old_node = e.node;
+    unlink(entity_idx);
+    e.x = x;
+    e.y = y;
+    place(entity_idx);
+    shrink(old_node);
+    return true;
+}
+
+bool map_quadtree::remove(int handle)
+{
+    int entity_idx = handle - 1;
+    if (entity_idx < 0 || entity_idx >= (int)this->entities.size() || !this->entities[entity_idx].alive)
+    {
+        return false;
+    }
+
+    int old_node = this->entities[entity_idx].node;
+    unlink(entity_idx);
+    this->entities[entity_idx].alive = false;
+    this->free_entities.push_back(entity_idx);
+    this->entity_cnt--;
+    shrink(old_node);
+    return true;
+}
+
+void map_quadtree::query(double x, double y, double w, double h, std::vector<int> &out) const
+{
+    const double min_x = x, max_x = x + w;
+    const double min_y = y, max_y = y + h;
+
+    // 每层最多压入3个兄弟节点 MAX_DEPTH_LIMIT保证不会越界
+    int stack[4 * MAX_DEPTH_LIMIT + 4];
+    int stack_size = 0;
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0)
+    {
+        int node_idx = stack[--stack_size];
+        const node &n = this->nodes[node_idx];
+        if (n.subtree_count == 0)
+        {
+            continue;
+        }
+
+        // 根节点可能挂着地图外或超大的实体 总是访问
+        if (node_idx != 0)
+        {
+            // 松散边界 本格向外扩半宽 实体都很小时只需扩出最大半径
+            const double loose = std::min(std::min(n.hw, n.hh), this->max_radius);
+            if (n.cx + n.hw + loose < min_x || n.cx - n.hw - loose >= max_x ||
+                n.cy + n.hh + loose < min_y || n.cy - n.hh - loose >= max_y)
+            {
+                continue;
+            }
+        }
+
+        for (int entity_idx = n.head; entity_idx >= 0; entity_idx = this->entities[entity_idx].next)
+        {
+            const entity &e = this->entities[entity_idx];
+            if (e.x + e.radius >= min_x && e.x - e.radius < max_x &&
+                e.y + e.radius >= min_y && e.y - e.radius < max_y)
+            {
+                out.push_back(entity_idx + 1);
+            }
+        }
+
+        if (n.first_child >= 0)
+        {
+            for (int i = 0; i < 4; ++i)
+            {
+                stack[stack_size++] = n.first_child + i;
+            }
+        }
+    }
+}
+
+int map_quadtree_mgr::create(double x, double y, double w, double h, int max_depth, int leaf_capacity)
+{
+    int tree_id = 0;
+    if (this->free_ids.size() > 0)
+    {
+        tree_id = this->free_ids.back();
+        this->free_ids.pop_back();
+    }
+    else
+    {
+        this->trees.emplace_back();
+        tree_id = (int)this->trees.size();
+    }
+    this->trees[tree_id - 1] = std::make_unique<map_quadtree>(x, y, w, h, max_depth, leaf_capacity);
+    return tree_id;
+}
+
+void map_quadtree_mgr::destroy(int tree_id)
+{
+    if (get(tree_id))
+    {
+        this->trees[tree_id - 1].reset();
+        this->free_ids.push_back(tree_id);
+    }
+}
+
+map_quadtree *map_quadtree_mgr::get(int tree_id)
+{
+    if (tree_id <= 0 || tree_id > (int)this->trees.size())
+    {
+        return nullptr;
+    }
+    return this->trees[tree_id - 1].get();
+}
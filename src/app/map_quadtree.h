@@ -0,0 +1,90 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace avant::app
+{
+    // 松散四叉树 供2D地图AOI使用
+    // 节点放在池里按下标引用 实体以稳定的整数handle引用 handle在Remove前不变
+    // 实体放在圆心所在且 半径<=节点半宽 的最深节点 节点查询边界为本格向外扩半宽(松散系数2)
+    // 实体移动后圆心仍在原节点格内时只改坐标 不动树结构
+    class map_quadtree
+    {
+    public:
+        static constexpr int DEFAULT_MAX_DEPTH = 8;
+        static constexpr int MAX_DEPTH_LIMIT = 16;
+        // 叶子实体数超过该值才分裂
+        static constexpr int DEFAULT_LEAF_CAPACITY = 8;
+
+        map_quadtree(double x, double y, double w, double h, int max_depth, int leaf_capacity);
+
+        // 返回handle >0
+        int insert(double x, double y, double radius);
+        bool update(int handle, double x, double y);
+        bool remove(int handle);
+        // 圆的包围盒与矩形[x, x+w) x [y, y+h)相交的实体handle 追加到out
+        void query(double x, double y, double w, double h, std::vector<int> &out) const;
+
+        size_t size() const { return this->entity_cnt; }
+
+    private:
+        struct node
+        {
+            double cx{0}, cy{0};
+            double hw{0}, hh{0};
+            int parent{-1};
+            int depth{0};
+            // 四个子节点在池中连续存放 -1表示叶子
+            int first_child{-1};
+            // 直接挂在本节点上的实体链表
+            int head{-1};
+            int count{0};
+            // 本节点及子树中的实体总数 用于回收空子树
+            int subtree_count{0};
+        };
+
+        struct entity
+        {
+            double x{0}, y{0}, radius{0};
+            int node{-1};
+            int prev{-1};
+            int next{-1};
+            bool alive{false};
+        };
+
+        int alloc_children(int node_idx);
+        void free_children(int node_idx);
+        void link(int node_idx, int entity_idx);
+        void unlink(int entity_idx);
+        void place(int entity_idx);
+        void split(int node_idx);
+        void shrink(int node_idx);
+        bool in_cell(const node &n, double x, double y) const;
+
+    private:
+        int max_depth;
+        int leaf_capacity;
+        std::vector<node> nodes;
+        // 空闲的四连块首下标
+        std::vector<int> free_node_blocks;
+        std::vector<entity> entities;
+        std::vector<int> free_entities;
+        size_t entity_cnt{0};
+        // 插入过的最大实体半径 用来收紧松散边界
+        double max_radius{0};
+    };
+
+    // Lua侧以整数id持有树 只在other线程使用
+    class map_quadtree_mgr
+    {
+    public:
+        int create(double x, double y, double w, double h, int max_depth, int leaf_capacity);
+        void destroy(int tree_id);
+        map_quadtree *get(int tree_id);
+
+    private:
+        std::vector<std::unique_ptr<map_quadtree>> trees;
+        std::vector<int> free_ids;
+    };
+}
@@ -0,0 +1,136 @@
+#include "app/map_sim.h"
+#include <algorithm>
+#include <chrono>
+#include "app/map_aoi.h"
+#include "app/map_physics.h"
+#include "utility/singleton.h"
+
+using namespace avant::app;
+using namespace avant::utility;
+
+map_sim::map_sim(int physics_id, int aoi_id, int snapshot_id, double dt_ms)
+    : physics_id(physics_id),
+      aoi_id(aoi_id),
+      snapshot_id(snapshot_id),
+      dt_ms(dt_ms)
+{
+}
+
+void map_sim::tick(uint64_t server_time, int steps, bool sync)
+{
+    const auto begin = std::chrono::steady_clock::now();
+
+    map_physics *physics = singleton<map_physics_mgr>::instance()->get(this->physics_id);
+    for (int i = 0; physics && i < steps; ++i)
+    {
+        physics->step(this->dt_ms);
+    }
+    this->stats.steps += steps > 0 ? steps : 0;
+
+    this->outbound_cnt = 0;
+    if (sync)
+    {
+        // 编码时逐个客户端取AOI事件 这里的watchers只是flush要求的输出
+        map_aoi *aoi = singleton<map_aoi_mgr>::instance()->get(this->aoi_id);
+        if (aoi)
+        {
+            this->watchers.clear();
+            aoi->flush(this->watchers);
+        }
+
+        map_snapshot *snapshot = singleton<map_snapshot_mgr>::instance()->get(this->snapshot_id);
+        if (snapshot)
+        {
+            this->outbound_cnt = snapshot->encode_all(server_time, this->outbound);
+        }
+
+        for (size_t i = 0; i < this->outbound_cnt; ++i)
+        {
+            this->stats.bytes += this->outbound[i].msg.ByteSizeLong();
+        }
+        this->stats.sends += this->outbound_cnt;
+        this->stats.syncs += 1;
+    }
+
+    const uint64_t cost_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count();
+    this->last_cost_us = cost_us;
+    this->stats.ticks += 1;
+    this->stats.cost_us_sum += cost_us;
+    this->stats.cost_us_max = std::max(this->stats.cost_us_max, cost_us);
+}
+
+map_sim::stat map_sim::take_stat()
+{
+    stat result = this->stats;
+    this->stats = stat{};
+    return result;
+}
+
+int map_sim_mgr::create(int physics_id, int aoi_id, int snapshot_id, double dt_ms)
+{
+    int sim_id = 0;
+    if (this->free_ids.size() > 0)
+    {
+        sim_id = this->free_ids.back();
+        this->free_ids.pop_back();
+    }
+    else
+    {
+        this->sims.emplace_back();
+        sim_id = (int)this->sims.size();
+    }
+    this->sims[sim_id - 1] = std::make_unique<map_sim>(physics_id, aoi_id, snapshot_id, dt_ms);
+    return sim_id;
+}
+
+void map_sim_mgr::destroy(int sim_id)
+{
+    if (get(sim_id))
+    {
+        this->sims[sim_id - 1].reset();
+        this->free_ids.push_back(sim_id);
+    }
+}
+
+map_sim *map_sim_mgr::get(int sim_id)
+{
+    if (sim_id <= 0 || sim_id > (int)this->sims.size())
+    {
+        return nullptr;
+    }
+    return this->sims[sim_id - 1].get();
+}
+
+void map_sim_mgr::tick(const std::vector<int> &sim_ids, const std::vector<int> &steps, const std::vector<uint8_t> &syncs,
+                       uint64_t server_time, const std::function<void(const map_snapshot::outbound &)> &send)
+{
+    this->batch.clear();
+    for (size_t i = 0; i < sim_ids.size(); ++i)
+    {
+        job item;
+        item.sim = get(sim_ids[i]);
+        item.steps = i < steps.size() ? steps[i] : 1;
+        item.sync = i < syncs.size() ? syncs[i] != 0 : true;
+        if (item.sim)
+        {
+            this->batch.push_back(item);
+        }
+    }
+
+    // 耗时长的地图先开始 减少最后只剩一张大地图在跑的尾巴
+    this->ordered.assign(this->batch.begin(), this->batch.end());
+    std::stable_sort(this->ordered.begin(), this->ordered.end(), [](const job &a, const job &b)
+                     { return a.sim->get_last_cost_us() > b.sim->get_last_cost_us(); });
+    this->pool.run(this->ordered.size(), [this, server_time](size_t i)
+                   { this->ordered[i].sim->tick(server_time, this->ordered[i].steps, this->ordered[i].sync); });
+
+    for (const job &item : this->batch)
+    {
+        const map_sim *sim = item.sim;
+        const std::vector<map_snapshot::outbound> &outbound = sim->get_outbound();
+        for (size_t i = 0; i < sim->get_outbound_cnt(); ++i)
+        {
+            send(outbound[i]);
+        }
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "app/map_snapshot.h"
+#include "app/map_tick_pool.h"
+
+namespace avant::app
+{
+    // 一张2D地图的原生模拟上下文 把同一地图的物理 AOI 快照编码器串成一次tick
+    // 一次tick先推进若干固定步长 再做一次AOI判定与快照编码 追帧时不会连续编码多轮
+    // tick只访问这三个对象与自己的发送缓冲 不同地图的tick可以在不同线程同时执行
+    // 编码好的快照先留在缓冲里 由调用线程在屏障之后统一发出
+    class map_sim
+    {
+    public:
+        struct stat
+        {
+            uint64_t ticks{0};
+            // 推进的固定步数 与ticks之差即追帧多出的步数
+            uint64_t steps{0};
+            // 做了AOI判定与编码的tick数 降级时少于ticks
+            uint64_t syncs{0};
+            uint64_t cost_us_sum{0};
+            uint64_t cost_us_max{0};
+            uint64_t bytes{0};
+            uint64_t sends{0};
+        };
+
+        map_sim(int physics_id, int aoi_id, int snapshot_id, double dt_ms);
+
+        // 物理积分steps次 -> sync时AOI判定 -> 给每个客户端编码快照
+        // 不sync时实体变化留在AOI与编码器里 下次sync一起处理
+        void tick(uint64_t server_time, int steps, bool sync);
+
+        const std::vector<map_snapshot::outbound> &get_outbound() const { return this->outbound; }
+        size_t get_outbound_cnt() const { return this->outbound_cnt; }
+        uint64_t get_last_cost_us() const { return this->last_cost_us; }
+        // 取出上次取出以来的累计统计并清零
+        stat take_stat();
+
+    private:
+        int physics_id;
+        int aoi_id;
+        int snapshot_id;
+        double dt_ms;
+
+        std::vector<int> watchers;
+        std::vector<map_snapshot::outbound> outbound;
+        size_t outbound_cnt{0};
+        uint64_t last_cost_us{0};
+        stat stats;
+    };
+
+    // Lua侧以整数id持有模拟上下文 只在other线程使用
+    class map_sim_mgr
+    {
+    public:
+        int create(int physics_id, int aoi_id, int snapshot_id, double dt_ms);
+        void destroy(int sim_id);
+        map_sim *get(int sim_id);
+
+        void set_threads(int thread_cnt) { this->pool.set_threads(thread_cnt); }
+        int get_threads() const { return this->pool.get_threads(); }
+
+        // sim_ids[i]推进steps[i]步 syncs[i]非0时再同步一次 按上次耗时从大到小交给线程池并等全部完成
+        // 随后在调用线程按sim_ids顺序把各地图编码好的快照交给send
+        // 执行期间调用线程阻塞 各mgr不会被修改
+        void tick(const std::vector<int> &sim_ids, const std::vector<int> &steps, const std::vector<uint8_t> &syncs,
+                  uint64_t server_time, const std::function<void(const map_snapshot::outbound &)> &send);
+
+    private:
+        std::vector<std::unique_ptr<map_sim>> sims;
+        std::vector<int> free_ids;
+        map_tick_pool pool;
+        struct job
+        {
+            map_sim *sim{nullptr};
+            int steps{0};
+            bool sync{false};
+        };
+        std::vector<job> batch;
+        std::vector<job> ordered;
+    };
+}
@@ -0,0 +1,428 @@
+#include "app/map_snapshot.h"
+#include <algorithm>
+#include <cmath>
+#include "app/map_aoi.h"
+#include "utility/singleton.h"
+
+using namespace avant::app;
+using namespace avant::utility;
+
+map_snapshot::map_snapshot(int aoi_id, double pos_quant, double vel_quant)
+    : aoi_id(aoi_id),
+      pos_quant(pos_quant > 0 ? pos_quant : 1),
+      vel_quant(vel_quant > 0 ? vel_quant : 1)
+{
+}
+
+void map_snapshot::set_entity(int handle, const std::string &user_id)
+{
+    if (handle <= 0)
+    {
+        return;
+    }
+    if ((int)this->entities.size() < handle)
+    {
+        this->entities.resize(handle);
+        this->clients.resize(handle);
+    }
+    entity &e = this->entities[handle - 1];
+    e = entity{};
+    e.uid = ++this->uid_seq;
+    e.user_id = user_id;
+    this->clients[handle - 1] = std::make_unique<client>();
+}
+
+void map_snapshot::set_state(int handle, double x, double y, double vx, double vy, uint32_t last_seq, uint64_t last_client_time)
+{
+    if (handle <= 0 || handle > (int)this->entities.size() || this->entities[handle - 1].uid == 0)
+    {
+        return;
+    }
+    entity &e = this->entities[handle - 1];
+    e.x = (int32_t)std::lround(x / this->pos_quant);
+    e.y = (int32_t)std::lround(y / this->pos_quant);
+    e.vx = (int32_t)std::lround(vx / this->vel_quant);
+    e.vy = (int32_t)std::lround(vy / this->vel_quant);
+    e.last_seq = last_seq;
+    e.last_client_time = last_client_time;
+}
+
+void map_snapshot::remove(int handle)
+{
+    if (handle <= 0 || handle > (int)this->entities.size())
+    {
+        return;
+    }
+    this->entities[handle - 1] = entity{};
+    this->clients[handle - 1].reset();
+}
+
+void map_snapshot::ack(int handle, uint32_t snapshot_id)
+{
+    if (handle <= 0 || handle > (int)this->clients.size() || !this->clients[handle - 1])
+    {
+        return;
+    }
+    client &c = *this->clients[handle - 1];
+    // 乱序到达的旧确认忽略
+    if (snapshot_id > c.acked_id && snapshot_id <= c.last_sent_id && find_sent(c, snapshot_id))
+    {
+        c.acked_id = snapshot_id;
+    }
+}
+
+void map_snapshot::set_client(int handle, uint64_t gid, int worker_idx)
+{
+    if (handle <= 0 || handle > (int)this->clients.size() || !this->clients[handle - 1])
+    {
+        return;
+    }
+    client &c = *this->clients[handle - 1];
+    c.gid = gid;
+    c.worker_idx = worker_idx;
+}
+
+void map_snapshot::set_lod(const std::vector<double> &ranges, const std::vector<int> &periods)
+{
+    this->lod.clear();
+    for (size_t i = 0; i < ranges.size() && i < periods.size(); ++i)
+    {
+        lod_tier_conf tier;
+        tier.range = ranges[i];
+        tier.period = periods[i] > 0 ? periods[i] : 1;
+        this->lod.push_back(tier);
+    }
+}
+
+void map_snapshot::take_lod_stat(std::vector<uint64_t> &updates, std::vector<uint64_t> &saved)
+{
+    updates.clear();
+    saved.clear();
+    for (lod_tier_conf &tier : this->lod)
+    {
+        updates.push_back(tier.updates);
+        saved.push_back(tier.saved);
+        tier.updates = 0;
+        tier.saved = 0;
+    }
+}
+
+int map_snapshot::lod_tier(const entity &self, const entity &e) const
+{
+    // 与AOI一致用x y方向较大的距离 量化单位换回像素
+    const double dist = std::max(std::abs((double)e.x - self.x), std::abs((double)e.y - self.y)) * this->pos_quant;
+    for (size_t i = 0; i + 1 < this->lod.size(); ++i)
+    {
+        if (dist < this->lod[i].range)
+        {
+            return (int)i;
+        }
+    }
+    return (int)this->lod.size() - 1;
+}
+
+const map_snapshot::sent_snapshot *map_snapshot::find_sent(const client &c, uint32_t id) const
+{
+    if (id == 0)
+    {
+        return nullptr;
+    }
+    const sent_snapshot &slot = c.history[id % HISTORY];
+    return slot.id == id ? &slot : nullptr;
+}
+
+const map_snapshot::entry *map_snapshot::find_entry(const sent_snapshot *snap, const entry &item) const
+{
+    if (!snap)
+    {
+        return nullptr;
+    }
+    auto iter = std::lower_bound(snap->entries.begin(), snap->entries.end(), item.index, [](const entry &a, uint32_t index)
+                                 { return a.index < index; });
+    if (iter == snap->entries.end() || iter->index != item.index || iter->uid != item.uid)
+    {
+        return nullptr;
+    }
+    return &*iter;
+}
+
+uint32_t map_snapshot::assign_index(client &c, uint64_t uid)
+{
+    auto iter = c.uid2index.find(uid);
+    if (iter != c.uid2index.end())
+    {
+        return iter->second;
+    }
+
+    uint32_t index = 0;
+    // 按释放顺序排队 队首都还不能复用时后面的更不能
+    if (c.free_indexes.size() > 0 && c.free_indexes.front().second <= c.acked_id)
+    {
+        index = c.free_indexes.front().first;
+        c.free_indexes.pop_front();
+    }
+    else
+    {
+        index = (uint32_t)c.index_stamp.size();
+        c.index_stamp.push_back(0);
+    }
+    c.uid2index[uid] = index;
+    return index;
+}
+
+bool map_snapshot::encode(int handle, uint64_t server_time, ProtoCSMapNotifySnapshot &out)
+{
+    if (handle <= 0 || handle > (int)this->clients.size() || !this->clients[handle - 1])
+    {
+        return false;
+    }
+    client &c = *this->clients[handle - 1];
+
+    // AOI事件只用来判断视野内是否有变化 内容以视野集合和实体状态为准
+    map_aoi *aoi = singleton<map_aoi_mgr>::instance()->get(this->aoi_id);
+    bool changed = false;
+    if (aoi)
+    {
+        aoi->fetch(handle, this->aoi_events[0], this->aoi_events[1], this->aoi_events[2]);
+        changed = this->aoi_events[0].size() > 0 || this->aoi_events[1].size() > 0 || this->aoi_events[2].size() > 0;
+    }
+    if (!changed && !c.lod_pending && (c.last_sent_id == c.acked_id || (c.acked_id != 0 && c.synced_id == c.acked_id)))
+    {
+        return false;
+    }
+
+    const uint32_t id = c.last_sent_id + 1;
+    const uint32_t pass = ++c.pass;
+    this->visible.clear();
+    this->visible.push_back(handle);
+    if (aoi)
+    {
+        aoi->visible_handles(handle, this->visible);
+    }
+
+    // 降频推迟的实体沿用上一个已发快照里的状态 这个状态被确认后就不再进入增量
+    const sent_snapshot *prev = find_sent(c, c.last_sent_id);
+    const sent_snapshot *base = find_sent(c, c.acked_id);
+    const entity &self = this->entities[handle - 1];
+    bool deferred = false;
+
+    this->current.clear();
+    for (int visible_handle : this->visible)
+    {
+        if (visible_handle > (int)this->entities.size() || this->entities[visible_handle - 1].uid == 0)
+        {
+            continue;
+        }
+        const entity &e = this->entities[visible_handle - 1];
+        entry item;
+        item.index = assign_index(c, e.uid);
+        item.uid = e.uid;
+        item.handle = visible_handle;
+        item.x = e.x;
+        item.y = e.y;
+        item.vx = e.vx;
+        item.vy = e.vy;
+        item.last_seq = e.last_seq;
+        item.last_client_time = e.last_client_time;
+
+        // 新进入的实体总是带全量状态 自己也总是更新
+        const entry *last = this->lod.size() > 0 && visible_handle != handle ? find_entry(prev, item) : nullptr;
+        if (last)
+        {
+            lod_tier_conf &tier = this->lod[lod_tier(self, e)];
+            if (!same_state(*last, item))
+            {
+                if ((pass + e.uid) % (uint32_t)tier.period != 0)
+                {
+                    item = *last;
+                    item.handle = visible_handle;
+                    deferred = true;
+                    // 推迟的状态已被确认时整条省掉 还在途时与正常更新同样要带增量
+                    const entry *old = find_entry(base, item);
+                    if (old && same_state(*old, item))
+                    {
+                        ++tier.saved;
+                    }
+                }
+                else
+                {
+                    ++tier.updates;
+                }
+            }
+        }
+        this->current.push_back(item);
+        c.index_stamp[item.index] = pass;
+    }
+    std::sort(this->current.begin(), this->current.end(), [](const entry &a, const entry &b)
+              { return a.index < b.index; });
+
+    out.Clear();
+
+    auto add_full = [&](const entry &item)
+    {
+        ProtoMapSnapshotEnter *enter = out.add_enters();
+        enter->set_index(item.index);
+        enter->set_userid(this->entities[item.handle - 1].user_id);
+        ProtoMapSnapshotEntity *ent = out.add_entities();
+        ent->set_index(item.index);
+        ent->set_x(item.x);
+        ent->set_y(item.y);
+        ent->set_vx(item.vx);
+        ent->set_vy(item.vy);
+        ent->set_lastseq(item.last_seq);
+        ent->set_lastclienttime((int64_t)item.last_client_time);
+    };
+
+    if (base)
+    {
+        // 两边都按index升序 归并比较
+        size_t base_pos = 0;
+        for (const entry &item : this->current)
+        {
+            while (base_pos < base->entries.size() && base->entries[base_pos].index < item.index)
+            {
+                out.add_removed(base->entries[base_pos].index);
+                ++base_pos;
+            }
+            const entry *old = nullptr;
+            if (base_pos < base->entries.size() && base->entries[base_pos].index == item.index)
+            {
+                old = &base->entries[base_pos];
+                ++base_pos;
+            }
+            // 下标被另一个实体复用时客户端按新实体整体覆盖
+            if (!old || old->uid != item.uid)
+            {
+                add_full(item);
+                continue;
+            }
+            if (same_state(*old, item))
+            {
+                continue;
+            }
+            ProtoMapSnapshotEntity *ent = out.add_entities();
+            ent->set_index(item.index);
+            ent->set_x(item.x - old->x);
+            ent->set_y(item.y - old->y);
+            ent->set_vx(item.vx - old->vx);
+            ent->set_vy(item.vy - old->vy);
+            ent->set_lastseq(item.last_seq - old->last_seq);
+            ent->set_lastclienttime((int64_t)(item.last_client_time - old->last_client_time));
+        }
+        for (; base_pos < base->entries.size(); ++base_pos)
+        {
+            out.add_removed(base->entries[base_pos].index);
+        }
+
+        const bool empty = out.enters_size() == 0 && out.entities_size() == 0 && out.removed_size() == 0;
+        // 在途快照里有已经撤销的变化(如进入后又在确认前离开)时 客户端确认它后会停在那个状态
+        // 只有最近发出的快照与基线一致才能停发 否则发一个空增量把客户端拉回基线
+        if (empty && (c.last_sent_id == c.acked_id || c.last_sent_same_as == c.acked_id))
+        {
+            c.synced_id = c.acked_id;
+            c.lod_pending = deferred;
+            return false;
+        }
+        out.set_baselineid(base->id);
+    }
+    else
+    {
+        out.set_baselineid(0);
+        out.set_posquant((int32_t)this->pos_quant);
+        out.set_velquant((int32_t)this->vel_quant);
+        for (const entry &item : this->current)
+        {
+            add_full(item);
+        }
+    }
+    out.set_snapshotid(id);
+    out.set_servertime(server_time);
+
+    // 上一个快照里有 这次没有的实体 释放下标
+    if (prev)
+    {
+        for (const entry &item : prev->entries)
+        {
+            if (c.index_stamp[item.index] != pass)
+            {
+                auto iter = c.uid2index.find(item.uid);
+                if (iter != c.uid2index.end() && iter->second == item.index)
+                {
+                    c.uid2index.erase(iter);
+                }
+                c.free_indexes.emplace_back(item.index, id);
+            }
+        }
+    }
+
+    sent_snapshot &slot = c.history[id % HISTORY];
+    slot.id = id;
+    slot.entries.assign(this->current.begin(), this->current.end());
+    c.last_sent_same_as = base && out.enters_size() == 0 && out.entities_size() == 0 && out.removed_size() == 0
+                              ? base->id
+                              : 0;
+    c.last_sent_id = id;
+    c.synced_id = 0;
+    c.lod_pending = deferred;
+    return true;
+}
+
+size_t map_snapshot::encode_all(uint64_t server_time, std::vector<outbound> &out)
+{
+    size_t count = 0;
+    for (int handle = 1; handle <= (int)this->clients.size(); ++handle)
+    {
+        const client *c = this->clients[handle - 1].get();
+        if (!c || c->worker_idx < 0)
+        {
+            continue;
+        }
+        if (count == out.size())
+        {
+            out.emplace_back();
+        }
+        outbound &item = out[count];
+        if (encode(handle, server_time, item.msg))
+        {
+            item.gid = c->gid;
+            item.worker_idx = c->worker_idx;
+            ++count;
+        }
+    }
+    return count;
+}
+
+int map_snapshot_mgr::create(int aoi_id, double pos_quant, double vel_quant)
+{
+    int encoder_id = 0;
+    if (this->free_ids.size() > 0)
+    {
+        encoder_id = this->free_ids.back();
+        this->free_ids.pop_back();
+    }
+    else
+    {
+        this->encoders.emplace_back();
+        encoder_id = (int)this->encoders.size();
+    }
+    this->encoders[encoder_id - 1] = std::make_unique<map_snapshot>(aoi_id, pos_quant, vel_quant);
+    return encoder_id;
+}
+
+void map_snapshot_mgr::destroy(int encoder_id)
+{
+    if (get(encoder_id))
+    {
+        this->encoders[encoder_id - 1].reset();
+        this->free_ids.push_back(encoder_id);
+    }
+}
+
+map_snapshot *map_snapshot_mgr::get(int encoder_id)
+{
+    if (encoder_id <= 0 || encoder_id > (int)this->encoders.size())
+    {
+        return nullptr;
+    }
+    return this->encoders[encoder_id - 1].get();
+}
@@ -0,0 +1,151 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "proto_res/proto_example.pb.h"
+
+namespace avant::app
+{
+    // 地图状态增量快照编码器 挂在一个map_aoi上 实体与客户端都用AOI handle标识
+    // 每个客户端保留最近HISTORY个已发快照 新快照只编码相对客户端最近确认快照变化了的字段
+    // 坐标与速度按quant量化 userId只在实体首次出现时随下标下发 之后用小整数下标引用
+    // 客户端确认的快照已经不在历史里(或从未确认)时回落为全量快照
+    // 可按与客户端自身实体的距离分层降频 远处实体不到期时沿用上次发出的状态 不产生增量
+    class map_snapshot
+    {
+    public:
+        static constexpr int HISTORY = 32;
+
+        // 一条待发快照 encode_all复用其中的消息对象
+        struct outbound
+        {
+            uint64_t gid{0};
+            int worker_idx{0};
+            ProtoCSMapNotifySnapshot msg;
+        };
+
+        map_snapshot(int aoi_id, double pos_quant, double vel_quant);
+
+        // 实体加入时登记userId 同一handle重新登记视为新实体
+        void set_entity(int handle, const std::string &user_id);
+        void set_state(int handle, double x, double y, double vx, double vy, uint32_t last_seq, uint64_t last_client_time);
+        // 实体离开地图 作为客户端的基线一并丢弃
+        void remove(int handle);
+        void ack(int handle, uint32_t snapshot_id);
+        // 登记客户端连接 encode_all只给登记过的客户端编码
+        void set_client(int handle, uint64_t gid, int worker_idx);
+        // 距离分层 x与y方向较大的距离小于ranges[k]时属于第k层 超出所有ranges的属于最后一层
+        // 第k层的实体每periods[k]次编码更新一次 各实体按uid错开 ranges为空时每次都更新
+        void set_lod(const std::vector<double> &ranges, const std::vector<int> &periods);
+        // 取出并清零各层统计 updates为带上新状态的条目数 saved为因推迟而没有进入增量的条目数
+        // 推迟的状态还未被客户端确认时仍要带增量 所以period应明显大于确认往返的步数才有收益
+        void take_lod_stat(std::vector<uint64_t> &updates, std::vector<uint64_t> &saved);
+
+        // 客户端视野有变化或上次发出的快照还未确认时编码新快照 返回false表示无需发送
+        // 必须在AOI flush之后调用 会取走该客户端的AOI事件
+        bool encode(int handle, uint64_t server_time, ProtoCSMapNotifySnapshot &out);
+        // 对所有登记过连接的客户端依次encode 需要发送的写到out前部 返回条数
+        // 只访问本编码器与其AOI 不同地图的编码器可以在不同线程同时调用
+        size_t encode_all(uint64_t server_time, std::vector<outbound> &out);
+
+    private:
+        struct entity
+        {
+            // 全局递增 区分复用同一handle的不同实体
+            uint64_t uid{0};
+            std::string user_id;
+            int32_t x{0}, y{0}, vx{0}, vy{0};
+            uint32_t last_seq{0};
+            uint64_t last_client_time{0};
+        };
+
+        struct entry
+        {
+            uint32_t index{0};
+            uint64_t uid{0};
+            int handle{0};
+            int32_t x{0}, y{0}, vx{0}, vy{0};
+            uint32_t last_seq{0};
+            uint64_t last_client_time{0};
+        };
+
+        struct sent_snapshot
+        {
+            uint32_t id{0};
+            // 按index升序
+            std::vector<entry> entries;
+        };
+
+        struct client
+        {
+            uint32_t last_sent_id{0};
+            uint32_t acked_id{0};
+            // 当前内容与该确认快照一致 无需再发
+            uint32_t synced_id{0};
+            // 最近发出的快照内容与该快照一致(相对它的空增量) 0表示不一致
+            // 客户端应用了最近发出的快照后与基线相同 才能在没有变化时停发
+            uint32_t last_sent_same_as{0};
+            // 每次编码加一 用来标记本次出现过的下标
+            uint32_t pass{0};
+            // 有实体因降频推迟了变化 视野没变也要继续编码直到发出
+            bool lod_pending{false};
+            // set_client登记的连接 worker_idx为-1表示未登记
+            uint64_t gid{0};
+            int worker_idx{-1};
+            sent_snapshot history[HISTORY];
+            std::unordered_map<uint64_t, uint32_t> uid2index;
+            // 下标最后一次出现在哪次编码里
+            std::vector<uint32_t> index_stamp;
+            // 已释放的下标与释放时的快照id 客户端确认了不早于它的快照后才能复用
+            std::deque<std::pair<uint32_t, uint32_t>> free_indexes;
+        };
+
+        uint32_t assign_index(client &c, uint64_t uid);
+        const sent_snapshot *find_sent(const client &c, uint32_t id) const;
+        // 快照里同一实体的条目 下标被别的实体复用时视为没有
+        const entry *find_entry(const sent_snapshot *snap, const entry &item) const;
+        static bool same_state(const entry &a, const entry &b)
+        {
+            return a.x == b.x && a.y == b.y && a.vx == b.vx && a.vy == b.vy && a.last_seq == b.last_seq &&
+                   a.last_client_time == b.last_client_time;
+        }
+        int lod_tier(const entity &self, const entity &e) const;
+
+    private:
+        int aoi_id;
+        double pos_quant;
+        double vel_quant;
+        uint64_t uid_seq{0};
+        std::vector<entity> entities;
+        std::vector<std::unique_ptr<client>> clients;
+        std::vector<int> visible;
+        std::vector<int> aoi_events[3];
+        std::vector<entry> current;
+
+        struct lod_tier_conf
+        {
+            double range{0};
+            int period{1};
+            uint64_t updates{0};
+            uint64_t saved{0};
+        };
+        std::vector<lod_tier_conf> lod;
+    };
+
+    // Lua侧以整数id持有编码器 只在other线程使用 map_sim_mgr并行tick期间只读
+    class map_snapshot_mgr
+    {
+    public:
+        int create(int aoi_id, double pos_quant, double vel_quant);
+        void destroy(int encoder_id);
+        map_snapshot *get(int encoder_id);
+
+    private:
+        std::vector<std::unique_ptr<map_snapshot>> encoders;
+        std::vector<int> free_ids;
+    };
+}
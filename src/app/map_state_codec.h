@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+namespace avant::app
+{
+    // 地图跨进程迁移的紧凑二进制状态 定长字段按本机字节序直接拷贝
+    // 迁移两端是同一份程序 不做字节序转换 格式变化时改版本号
+    template <typename T>
+    inline void map_state_put(std::string &out, T value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "map_state_put needs trivially copyable type");
+        out.append((const char *)&value, sizeof(T));
+    }
+
+    // 剩余字节不足时返回false 不移动data
+    template <typename T>
+    inline bool map_state_get(const char *&data, const char *end, T &value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "map_state_get needs trivially copyable type");
+        if (end - data < (std::ptrdiff_t)sizeof(T))
+        {
+            return false;
+        }
+        std::memcpy(&value, data, sizeof(T));
+        data += sizeof(T);
+        return true;
+    }
+}
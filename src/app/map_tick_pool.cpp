@@ -0,0 +1,143 @@
+#include "app/map_tick_pool.h"
+
+using namespace avant::app;
+
+map_tick_pool::~map_tick_pool()
+{
+    stop();
+}
+
+void map_tick_pool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->start_cv.notify_all();
+    for (std::thread &thread : this->threads)
+    {
+        thread.join();
+    }
+    this->threads.clear();
+    this->queues.clear();
+    this->stopping = false;
+}
+
+void map_tick_pool::set_threads(int thread_cnt)
+{
+    stop();
+    thread_cnt = thread_cnt > 0 ? thread_cnt : 0;
+    for (int i = 0; i <= thread_cnt; ++i)
+    {
+        this->queues.push_back(std::make_unique<task_queue>());
+    }
+    for (int i = 0; i < thread_cnt; ++i)
+    {
+        this->threads.emplace_back(&map_tick_pool::worker_loop, this, i);
+    }
+}
+
+bool map_tick_pool::take(int queue_idx, size_t &task)
+{
+    {
+        task_queue &own = *this->queues[queue_idx];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (own.tasks.size() > 0)
+        {
+            task = own.tasks.front();
+            own.tasks.pop_front();
+            return true;
+        }
+    }
+
+    const int queue_cnt = (int)this->queues.size();
+    for (int i = 1; i < queue_cnt; ++i)
+    {
+        task_queue &other = *this->queues[(queue_idx + i) % queue_cnt];
+        std::lock_guard<std::mutex> lock(other.mutex);
+        if (other.tasks.size() > 0)
+        {
+            task = other.tasks.back();
+            other.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void map_tick_pool::execute(int queue_idx)
+{
+    size_t task = 0;
+    while (take(queue_idx, task))
+    {
+        (*this->func)(task);
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (--this->remaining == 0)
+        {
+            this->done_cv.notify_one();
+        }
+    }
+}
+
+void map_tick_pool::worker_loop(int queue_idx)
+{
+    uint64_t seen_generation = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->start_cv.wait(lock, [&]
+                                { return this->stopping || this->generation != seen_generation; });
+            if (this->stopping)
+            {
+                return;
+            }
+            seen_generation = this->generation;
+        }
+        // 任务只在run等待期间存在 取到任务时func一定有效
+        execute(queue_idx);
+    }
+}
+
+void map_tick_pool::run(size_t task_cnt, const std::function<void(size_t)> &func)
+{
+    if (task_cnt == 0)
+    {
+        return;
+    }
+    if (this->threads.size() == 0 || task_cnt == 1)
+    {
+        for (size_t i = 0; i < task_cnt; ++i)
+        {
+            func(i);
+        }
+        return;
+    }
+
+    // 上一批刚做完的线程可能还在窃取循环里 先设好func再放任务
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->func = &func;
+        this->remaining = task_cnt;
+    }
+    // 轮流分到各队列 耗时大的任务排在前面时会被各线程先领走
+    const size_t queue_cnt = this->queues.size();
+    for (size_t i = 0; i < task_cnt; ++i)
+    {
+        task_queue &queue = *this->queues[i % queue_cnt];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(i);
+    }
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        ++this->generation;
+    }
+    this->start_cv.notify_all();
+
+    execute((int)queue_cnt - 1);
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->done_cv.wait(lock, [this]
+                       { return this->remaining == 0; });
+    this->func = nullptr;
+}
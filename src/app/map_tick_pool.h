@@ -0,0 +1,56 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace avant::app
+{
+    // 地图tick线程池 一批互不相关的任务分到各线程自己的队列
+    // 线程先从自己队列头部取 取空后从其他队列尾部窃取 调用线程也参与执行
+    // run返回即所有任务完成 相当于一次屏障 之后调用线程可以安全读取任务结果
+    class map_tick_pool
+    {
+    public:
+        ~map_tick_pool();
+
+        // 额外启动thread_cnt个线程 0表示任务全部在调用线程串行执行
+        // 不能在run执行中调用
+        void set_threads(int thread_cnt);
+        int get_threads() const { return (int)this->threads.size(); }
+
+        // 执行func(0)..func(task_cnt-1) 全部完成后返回
+        void run(size_t task_cnt, const std::function<void(size_t)> &func);
+
+    private:
+        struct task_queue
+        {
+            std::mutex mutex;
+            std::deque<size_t> tasks;
+        };
+
+        void stop();
+        void worker_loop(int queue_idx);
+        // 先取自己队列头部 再按顺序窃取其他队列尾部
+        bool take(int queue_idx, size_t &task);
+        void execute(int queue_idx);
+
+    private:
+        std::vector<std::thread> threads;
+        // 每个线程一个 最后一个属于调用线程
+        std::vector<std::unique_ptr<task_queue>> queues;
+
+        std::mutex mutex;
+        std::condition_variable start_cv;
+        std::condition_variable done_cv;
+        uint64_t generation{0};
+        size_t remaining{0};
+        bool stopping{false};
+        const std::function<void(size_t)> *func{nullptr};
+    };
+}
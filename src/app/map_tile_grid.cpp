@@ -0,0 +1,323 @@
+#include "app/map_tile_grid.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <climits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace avant::app;
+
+// 位宽只支持2的幂 一格不会跨字节 其他值向上取
+static int map_tile_grid_round_bits(int bits)
+{
+    if (bits <= 1)
+    {
+        return 1;
+    }
+    if (bits <= 2)
+    {
+        return 2;
+    }
+    if (bits <= 4)
+    {
+        return 4;
+    }
+    return 8;
+}
+
+static int map_tile_grid_log2(int v)
+{
+    int shift = 0;
+    while ((1 << shift) < v)
+    {
+        ++shift;
+    }
+    return shift;
+}
+
+uint64_t map_tile_grid::next_version()
+{
+    // 只在other线程修改网格
+    static uint64_t version_seq = 0;
+    return ++version_seq;
+}
+
+map_tile_grid::map_tile_grid(int width, int height, int bits)
+    : width(width > 0 ? width : 0),
+      height(height > 0 ? height : 0),
+      bits(map_tile_grid_round_bits(bits))
+{
+    this->bits_shift = map_tile_grid_log2(this->bits);
+    this->tiles_per_byte_shift = 3 - this->bits_shift;
+    this->tile_mask = (1 << this->bits) - 1;
+    this->owned.assign(data_bytes(), 0);
+    this->data = this->owned.data();
+    this->walkable.set(0);
+}
+
+map_tile_grid::~map_tile_grid()
+{
+    if (this->mapping)
+    {
+        ::munmap(this->mapping, this->mapping_bytes);
+    }
+}
+
+size_t map_tile_grid::data_bytes() const
+{
+    const size_t tiles = (size_t)this->width * (size_t)this->height;
+    return (tiles * this->bits + 7) / 8;
+}
+
+std::unique_ptr<map_tile_grid> map_tile_grid::load(const std::string &path)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return nullptr;
+    }
+    struct stat file_stat;
+    if (::fstat(fd, &file_stat) != 0 || (size_t)file_stat.st_size < FILE_HEADER_BYTES)
+    {
+        ::close(fd);
+        return nullptr;
+    }
+    const size_t file_bytes = (size_t)file_stat.st_size;
+    void *mapping = ::mmap(nullptr, file_bytes, PROT_READ, MAP_SHARED, fd, 0);
+    // 映射建立后文件描述符可以关闭
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        return nullptr;
+    }
+
+    const uint32_t *header = (const uint32_t *)mapping;
+    std::unique_ptr<map_tile_grid> grid(new map_tile_grid());
+    grid->mapping = mapping;
+    grid->mapping_bytes = file_bytes;
+    if (header[0] != FILE_MAGIC || header[1] != FILE_VERSION || header[2] > INT_MAX || header[3] > INT_MAX ||
+        map_tile_grid_round_bits((int)header[4]) != (int)header[4])
+    {
+        return nullptr;
+    }
+    grid->width = (int)header[2];
+    grid->height = (int)header[3];
+    grid->bits = (int)header[4];
+    grid->bits_shift = map_tile_grid_log2(grid->bits);
+    grid->tiles_per_byte_shift = 3 - grid->bits_shift;
+    grid->tile_mask = (1 << grid->bits) - 1;
+    if (file_bytes < FILE_HEADER_BYTES + grid->data_bytes())
+    {
+        return nullptr;
+    }
+    grid->data = (const uint8_t *)mapping + FILE_HEADER_BYTES;
+    grid->walkable.set(0);
+    return grid;
+}
+
+bool map_tile_grid::save(const std::string &path) const
+{
+    // 先写临时文件再改名 已映射旧文件的进程不受影响
+    const std::string tmp_path = path + ".tmp";
+    FILE *file = std::fopen(tmp_path.c_str(), "wb");
+    if (!file)
+    {
+        return false;
+    }
+    const uint32_t header[FILE_HEADER_BYTES / 4] = {FILE_MAGIC, FILE_VERSION, (uint32_t)this->width,
+                                                    (uint32_t)this->height, (uint32_t)this->bits, 0};
+    const size_t bytes = data_bytes();
+    bool ok = std::fwrite(header, sizeof(header), 1, file) == 1;
+    ok = ok && (bytes == 0 || std::fwrite(this->data, bytes, 1, file) == 1);
+    ok = (std::fclose(file) == 0) && ok;
+    if (!ok || std::rename(tmp_path.c_str(), path.c_str()) != 0)
+    {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+int map_tile_grid::get_tile(int x, int y) const
+{
+    if (!in_bounds(x, y))
+    {
+        return -1;
+    }
+    const size_t idx = (size_t)y * (size_t)this->width + (size_t)x;
+    const int offset = (int)(idx & ((1u << this->tiles_per_byte_shift) - 1)) << this->bits_shift;
+    return (this->data[idx >> this->tiles_per_byte_shift] >> offset) & this->tile_mask;
+}
+
+bool map_tile_grid::set_tile(int x, int y, int tile)
+{
+    if (is_read_only() || !in_bounds(x, y) || tile < 0 || tile > this->tile_mask)
+    {
+        return false;
+    }
+    const size_t idx = (size_t)y * (size_t)this->width + (size_t)x;
+    const int offset = (int)(idx & ((1u << this->tiles_per_byte_shift) - 1)) << this->bits_shift;
+    uint8_t &byte = this->owned[idx >> this->tiles_per_byte_shift];
+    const uint8_t value = (uint8_t)((byte & ~(this->tile_mask << offset)) | (tile << offset));
+    if (value != byte)
+    {
+        byte = value;
+        this->version = next_version();
+    }
+    return true;
+}
+
+void map_tile_grid::set_walkable(int tile, bool walkable)
+{
+    if (tile >= 0 && tile < (int)this->walkable.size() && this->walkable.test(tile) != walkable)
+    {
+        this->walkable.set(tile, walkable);
+        this->version = next_version();
+    }
+}
+
+void map_tile_grid::copy_walkable(int x, int y, int w, int h, std::vector<uint64_t> &bits) const
+{
+    w = w > 0 ? w : 0;
+    h = h > 0 ? h : 0;
+    bits.assign(((size_t)w * (size_t)h + 63) / 64, 0);
+    size_t bit = 0;
+    for (int j = 0; j < h; ++j)
+    {
+        for (int i = 0; i < w; ++i, ++bit)
+        {
+            if (is_walkable(x + i, y + j))
+            {
+                bits[bit >> 6] |= 1ull << (bit & 63);
+            }
+        }
+    }
+}
+
+// 按格遍历(Amanatides-Woo) 每次跨过最近的一条格线
+bool map_tile_grid::raycast(double x0, double y0, double x1, double y1, int &hit_x, int &hit_y) const
+{
+    int cx = (int)std::floor(x0);
+    int cy = (int)std::floor(y0);
+    const int end_x = (int)std::floor(x1);
+    const int end_y = (int)std::floor(y1);
+    const double dx = x1 - x0;
+    const double dy = y1 - y0;
+
+    const int step_x = dx > 0 ? 1 : (dx < 0 ? -1 : 0);
+    const int step_y = dy > 0 ? 1 : (dy < 0 ? -1 : 0);
+    // 沿线段前进到下一条竖/横格线的参数t 以及跨一格需要的t
+    const double delta_x = step_x != 0 ? std::fabs(1.0 / dx) : INFINITY;
+    const double delta_y = step_y != 0 ? std::fabs(1.0 / dy) : INFINITY;
+    double next_x = step_x > 0 ? (cx + 1 - x0) * delta_x : (step_x < 0 ? (x0 - cx) * delta_x : INFINITY);
+    double next_y = step_y > 0 ? (cy + 1 - y0) * delta_y : (step_y < 0 ? (y0 - cy) * delta_y : INFINITY);
+
+    const int max_cells = std::abs(end_x - cx) + std::abs(end_y - cy);
+    for (int i = 0;; ++i)
+    {
+        if (!is_walkable(cx, cy))
+        {
+            hit_x = cx;
+            hit_y = cy;
+            return true;
+        }
+        if (i >= max_cells)
+        {
+            return false;
+        }
+        if (next_x < next_y)
+        {
+            cx += step_x;
+            next_x += delta_x;
+        }
+        else
+        {
+            cy += step_y;
+            next_y += delta_y;
+        }
+    }
+}
+
+int map_tile_grid_mgr::alloc_id()
+{
+    int grid_id = 0;
+    if (this->free_ids.size() > 0)
+    {
+        grid_id = this->free_ids.back();
+        this->free_ids.pop_back();
+    }
+    else
+    {
+        this->grids.emplace_back();
+        grid_id = (int)this->grids.size();
+    }
+    return grid_id;
+}
+
+int map_tile_grid_mgr::create(int width, int height, int bits)
+{
+    const int grid_id = alloc_id();
+    slot &s = this->grids[grid_id - 1];
+    s.grid = std::make_unique<map_tile_grid>(width, height, bits);
+    s.refs = 1;
+    s.path.clear();
+    return grid_id;
+}
+
+int map_tile_grid_mgr::load(const std::string &path)
+{
+    // 同一文件用不同写法的路径引用时也只映射一次
+    char real_path[PATH_MAX];
+    const std::string key = ::realpath(path.c_str(), real_path) ? std::string(real_path) : path;
+    auto iter = this->path2id.find(key);
+    if (iter != this->path2id.end())
+    {
+        ++this->grids[iter->second - 1].refs;
+        return iter->second;
+    }
+
+    std::unique_ptr<map_tile_grid> grid = map_tile_grid::load(key);
+    if (!grid)
+    {
+        return 0;
+    }
+    const int grid_id = alloc_id();
+    slot &s = this->grids[grid_id - 1];
+    s.grid = std::move(grid);
+    s.refs = 1;
+    s.path = key;
+    this->path2id[key] = grid_id;
+    return grid_id;
+}
+
+void map_tile_grid_mgr::destroy(int grid_id)
+{
+    if (!get(grid_id))
+    {
+        return;
+    }
+    slot &s = this->grids[grid_id - 1];
+    if (--s.refs > 0)
+    {
+        return;
+    }
+    if (s.path.size() > 0)
+    {
+        this->path2id.erase(s.path);
+        s.path.clear();
+    }
+    s.grid.reset();
+    this->free_ids.push_back(grid_id);
+}
+
+map_tile_grid *map_tile_grid_mgr::get(int grid_id)
+{
+    if (grid_id <= 0 || grid_id > (int)this->grids.size())
+    {
+        return nullptr;
+    }
+    return this->grids[grid_id - 1].grid.get();
+}
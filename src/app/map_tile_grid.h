@@ -0,0 +1,111 @@
+#pragma once
+#include <bitset>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace avant::app
+{
+    // 按位压缩的瓦片网格 每格1/2/4/8位 按行连续存放 坐标从0开始
+    // 4000x4000按2位只占4MB 可以由预先生成的二进制文件mmap只读加载 页按需调入 加载不需要解析
+    // 文件格式 24字节头(magic version width height bits reserved 均为小端uint32) 后接压缩后的瓦片
+    // 不做RLE 随机访问保持O(1) 寻路与碰撞每步都要大量读取
+    class map_tile_grid
+    {
+    public:
+        static constexpr uint32_t FILE_MAGIC = 0x4D545641; // "AVTM"
+        static constexpr uint32_t FILE_VERSION = 1;
+        static constexpr size_t FILE_HEADER_BYTES = 24;
+
+        // 在堆上创建全0网格 可写
+        map_tile_grid(int width, int height, int bits);
+        ~map_tile_grid();
+        map_tile_grid(const map_tile_grid &) = delete;
+        map_tile_grid &operator=(const map_tile_grid &) = delete;
+
+        // mmap只读加载 文件不存在或格式不对返回空
+        static std::unique_ptr<map_tile_grid> load(const std::string &path);
+        bool save(const std::string &path) const;
+
+        int get_width() const { return this->width; }
+        int get_height() const { return this->height; }
+        int get_bits() const { return this->bits; }
+        bool is_read_only() const { return this->mapping != nullptr; }
+        // 瓦片或可行走配置每次变化都会换新值 所有网格共用一个递增序列 可作为寻路等缓存的键
+        uint64_t get_version() const { return this->version; }
+
+        bool in_bounds(int x, int y) const { return x >= 0 && y >= 0 && x < this->width && y < this->height; }
+        // 越界返回-1
+        int get_tile(int x, int y) const;
+        // 只读网格或越界或值超出位宽返回false
+        bool set_tile(int x, int y, int tile);
+
+        // 默认只有0可行走 共享的网格对所有使用者生效
+        // 会改变版本 分层寻路持有可行走位的拷贝 需要按整张网格HPAUpdate
+        void set_walkable(int tile, bool walkable);
+        // 越界不可行走
+        bool is_walkable(int x, int y) const
+        {
+            const int tile = get_tile(x, y);
+            return tile >= 0 && this->walkable[tile];
+        }
+
+        // 区域(x,y,w,h)内每格是否可行走 按行优先打包成位写入bits 越界的格子不可行走
+        // 给在其他线程工作的模块拷贝一份快照 网格本身只在other线程访问
+        void copy_walkable(int x, int y, int w, int h, std::vector<uint64_t> &bits) const;
+
+        // 瓦片坐标系下的线段(x0,y0)->(x1,y1) 1.0为一格 逐格遍历经过的格子
+        // 遇到不可行走的格子返回true 并给出该格坐标
+        bool raycast(double x0, double y0, double x1, double y1, int &hit_x, int &hit_y) const;
+
+    private:
+        map_tile_grid() = default;
+        size_t data_bytes() const;
+        static uint64_t next_version();
+
+    private:
+        int width{0};
+        int height{0};
+        int bits{0};
+        // 每字节格数的log2 与每格位数的log2
+        int tiles_per_byte_shift{0};
+        int bits_shift{0};
+        int tile_mask{0};
+
+        const uint8_t *data{nullptr};
+        std::vector<uint8_t> owned;
+        void *mapping{nullptr};
+        size_t mapping_bytes{0};
+
+        std::bitset<256> walkable;
+        uint64_t version{next_version()};
+    };
+
+    // Lua侧以整数id持有网格 只在other线程使用
+    // 同一文件只加载一次 布局相同的地图共用一份只读映射 按引用计数释放
+    class map_tile_grid_mgr
+    {
+    public:
+        int create(int width, int height, int bits);
+        // 失败返回0
+        int load(const std::string &path);
+        void destroy(int grid_id);
+        map_tile_grid *get(int grid_id);
+
+    private:
+        int alloc_id();
+
+    private:
+        struct slot
+        {
+            std::unique_ptr<map_tile_grid> grid;
+            int refs{0};
+            std::string path;
+        };
+        std::vector<slot> grids;
+        std::vector<int> free_ids;
+        std::unordered_map<std::string, int> path2id;
+    };
+}
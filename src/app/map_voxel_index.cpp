@@ -0,0 +1,359 @@
+#include "app/map_voxel_index.h"
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+using namespace avant::app;
+
+namespace
+{
+    constexpr int AXIS_CELLS = 1 << map_voxel_index::AXIS_BITS;
+    constexpr int AXIS_OFFSET = AXIS_CELLS / 2;
+
+    // 把低21位每位之间插入两个0
+    inline uint64_t spread_bits(uint64_t v)
+    {
+        v &= 0x1fffff;
+        v = (v | (v << 32)) & 0x1f00000000ffffULL;
+        v = (v | (v << 16)) & 0x1f0000ff0000ffULL;
+        v = (v | (v << 8)) & 0x100f00f00f00f00fULL;
+        v = (v | (v << 4)) & 0x10c30c30c30c30c3ULL;
+        v = (v | (v << 2)) & 0x1249249249249249ULL;
+        return v;
+    }
+}
+
+map_voxel_index::map_voxel_index(double cell_size)
+    : cell_size(cell_size > 0 ? cell_size : DEFAULT_CELL_SIZE),
+      inv_cell_size(1.0 / this->cell_size)
+{
+}
+
+int map_voxel_index::to_cell(double v) const
+{
+    double c = std::floor(v * this->inv_cell_size) + AXIS_OFFSET;
+    if (c < 0)
+    {
+        return 0;
+    }
+    if (c >= AXIS_CELLS)
+    {
+        return AXIS_CELLS - 1;
+    }
+    return (int)c;
+}
+
+uint64_t map_voxel_index::morton(int cx, int cy, int cz)
+{
+    return spread_bits(cx) | (spread_bits(cy) << 1) | (spread_bits(cz) << 2);
+}
+
+void map_voxel_index::link(int entity_idx, uint64_t key)
+{
+    std::vector<int> &bucket = this->cells[key];
+    entity &e = this->entities[entity_idx];
+    e.key = key;
+    e.slot = (int)bucket.size();
+    bucket.push_back(entity_idx);
+}
+
+void map_voxel_index::unlink(int entity_idx)
+{
+    entity &e = this->entities[entity_idx];
+    auto iter = this->cells.find(e.key);
+    std::vector<int> &bucket = iter->second;
+    int last = bucket.back();
+    bucket[e.slot] = last;
+    this->entities[last].slot = e.slot;
+    bucket.pop_back();
+    if (bucket.empty())
+    {
+        this->cells.erase(iter);
+    }
+    e.slot = -1;
+}
+
+const std::vector<int> *map_voxel_index::find_cell(int cx, int cy, int cz) const
+{
+    auto iter = this->cells.find(morton(cx, cy, cz));
+    return iter == this->cells.end() ? nullptr : &iter->second;
+}
+
+template <typename FUNC>
+void map_voxel_index::for_each_cell(int min_cx, int min_cy, int min_cz, int max_cx, int max_cy, int max_cz, FUNC &&func) const
+{
+    const double range_cells = (double)(max_cx - min_cx + 1) * (max_cy - min_cy + 1) * (max_cz - min_cz + 1);
+    if (range_cells > (double)this->cells.size())
+    {
+        for (const auto &cell : this->cells)
+        {
+            func(cell.second);
+        }
+        return;
+    }
+
+    for (int cz = min_cz; cz <= max_cz; ++cz)
+    {
+        for (int cy = min_cy; cy <= max_cy; ++cy)
+        {
+            for (int cx = min_cx; cx <= max_cx; ++cx)
+            {
+                const std::vector<int> *bucket = find_cell(cx, cy, cz);
+                if (bucket)
+                {
+                    func(*bucket);
+                }
+            }
+        }
+    }
+}
+
+int map_voxel_index::insert(double x, double y, double z, double radius)
+{
+    int entity_idx = 0;
+    if (this->free_entities.size() > 0)
+    {
+        entity_idx = this->free_entities.back();
+        this->free_entities.pop_back();
+    }
+    else
+    {
+        entity_idx = (int)this->entities.size();
+        this->entities.emplace_back();
+    }
+
+    entity &e = this->entities[entity_idx];
+    e.x = x;
+    e.y = y;
+    e.z = z;
+    e.radius = radius > 0 ? radius : 0;
+    e.alive = true;
+    this->max_radius = std::max(this->max_radius, e.radius);
+    link(entity_idx, morton(to_cell(x), to_cell(y), to_cell(z)));
+    this->entity_cnt++;
+    return entity_idx + 1;
+}
+
+bool map_voxel_index::update(int handle, double x, double y, double z)
+{
+    int entity_idx = handle - 1;
+    if (entity_idx < 0 || entity_idx >= (int)this->entities.size() || !this->entities[entity_idx].alive)
+    {
+        return false;
+    }
+
+    entity &e = this->entities[entity_idx];
+    e.x = x;
+    e.y = y;
+    e.z = z;
+    uint64_t key = morton(to_cell(x), to_cell(y), to_cell(z));
+    if (key != e.key)
+    {
+        unlink(entity_idx);
+        link(entity_idx, key);
+    }
+    return true;
+}
+
+bool map_voxel_index::remove(int handle)
+{
+    int entity_idx = handle - 1;
+    if (entity_idx < 0 || entity_idx >= (int)this->entities.size() || !this->entities[entity_idx].alive)
+    {
+        return false;
+    }
+
+    unlink(entity_idx);
+    this->entities[entity_idx].alive = false;
+    this->free_entities.push_back(entity_idx);
+    this->entity_cnt--;
+    return true;
+}
+
+void map_voxel_index::query_box(double x, double y, double z, double w, double h, double d, std::vector<int> &out) const
+{
+    const double min_x = x, max_x = x + w;
+    const double min_y = y, max_y = y + h;
+    const double min_z = z, max_z = z + d;
+    const double r = this->max_radius;
+
+    for_each_cell(to_cell(min_x - r), to_cell(min_y - r), to_cell(min_z - r),
+                  to_cell(max_x + r), to_cell(max_y + r), to_cell(max_z + r),
+                  [&](const std::vector<int> &bucket)
+                  {
+                      for (int entity_idx : bucket)
+                      {
+                          const entity &e = this->entities[entity_idx];
+                          if (e.x + e.radius >= min_x && e.x - e.radius < max_x &&
+                              e.y + e.radius >= min_y && e.y - e.radius < max_y &&
+                              e.z + e.radius >= min_z && e.z - e.radius < max_z)
+                          {
+                              out.push_back(entity_idx + 1);
+                          }
+                      }
+                  });
+}
+
+void map_voxel_index::query_sphere(double x, double y, double z, double r, std::vector<int> &out) const
+{
+    const double reach = r + this->max_radius;
+
+    for_each_cell(to_cell(x - reach), to_cell(y - reach), to_cell(z - reach),
+                  to_cell(x + reach), to_cell(y + reach), to_cell(z + reach),
+                  [&](const std::vector<int> &bucket)
+                  {
+                      for (int entity_idx : bucket)
+                      {
+                          const entity &e = this->entities[entity_idx];
+                          const double dx = e.x - x, dy = e.y - y, dz = e.z - z;
+                          const double limit = r + e.radius;
+                          if (dx * dx + dy * dy + dz * dz <= limit * limit)
+                          {
+                              out.push_back(entity_idx + 1);
+                          }
+                      }
+                  });
+}
+
+void map_voxel_index::query_nearest(double x, double y, double z, int k, double max_dist, std::vector<int> &out) const
+{
+    if (k <= 0 || this->entity_cnt == 0)
+    {
+        return;
+    }
+
+    const double max_dist2 = max_dist > 0 ? max_dist * max_dist : HUGE_VAL;
+    // 大顶堆 堆顶是当前第k近
+    std::priority_queue<std::pair<double, int>> best;
+    auto consider = [&](const std::vector<int> &bucket)
+    {
+        for (int entity_idx : bucket)
+        {
+            const entity &e = this->entities[entity_idx];
+            const double dx = e.x - x, dy = e.y - y, dz = e.z - z;
+            const double dist2 = dx * dx + dy * dy + dz * dz;
+            if (dist2 > max_dist2)
+            {
+                continue;
+            }
+            if ((int)best.size() < k)
+            {
+                best.emplace(dist2, entity_idx);
+            }
+            else if (dist2 < best.top().first)
+            {
+                best.pop();
+                best.emplace(dist2, entity_idx);
+            }
+        }
+    };
+
+    // 从所在格子开始按切比雪夫距离一圈圈向外扩
+    // 第ring圈扫完后 更外圈的实体距离不小于ring*cell_size
+    // 累计要扫的格子数超过已有桶数时 直接遍历全部桶更快
+    const int cx = to_cell(x), cy = to_cell(y), cz = to_cell(z);
+    double visited = 0;
+    bool brute_force = false;
+    for (int ring = 0;; ++ring)
+    {
+        const double side = 2.0 * ring + 1;
+        const double ring_cells = ring == 0 ? 1 : side * side * side - (side - 2) * (side - 2) * (side - 2);
+        if (visited + ring_cells > (double)this->cells.size())
+        {
+            brute_force = true;
+            break;
+        }
+        visited += ring_cells;
+
+        for (int dz = -ring; dz <= ring; ++dz)
+        {
+            const int z_cell = cz + dz;
+            if (z_cell < 0 || z_cell >= AXIS_CELLS)
+            {
+                continue;
+            }
+            for (int dy = -ring; dy <= ring; ++dy)
+            {
+                const int y_cell = cy + dy;
+                if (y_cell < 0 || y_cell >= AXIS_CELLS)
+                {
+                    continue;
+                }
+                // 内部行只取两端 外壳面取整行
+                const bool on_shell = dz == -ring || dz == ring || dy == -ring || dy == ring;
+                const int step = on_shell || ring == 0 ? 1 : 2 * ring;
+                for (int dx = -ring; dx <= ring; dx += step)
+                {
+                    const int x_cell = cx + dx;
+                    if (x_cell < 0 || x_cell >= AXIS_CELLS)
+                    {
+                        continue;
+                    }
+                    const std::vector<int> *bucket = find_cell(x_cell, y_cell, z_cell);
+                    if (bucket)
+                    {
+                        consider(*bucket);
+                    }
+                }
+            }
+        }
+
+        const double reach = ring * this->cell_size;
+        if (reach * reach >= max_dist2 || ((int)best.size() == k && best.top().first <= reach * reach))
+        {
+            break;
+        }
+    }
+
+    if (brute_force)
+    {
+        best = {};
+        for (const auto &cell : this->cells)
+        {
+            consider(cell.second);
+        }
+    }
+
+    const size_t begin = out.size();
+    out.resize(begin + best.size());
+    for (size_t i = out.size(); i > begin; --i)
+    {
+        out[i - 1] = best.top().second + 1;
+        best.pop();
+    }
+}
+
+int map_voxel_index_mgr::create(double cell_size)
+{
+    int index_id = 0;
+    if (this->free_ids.size() > 0)
+    {
+        index_id = this->free_ids.back();
+        this->free_ids.pop_back();
+    }
+    else
+    {
+        this->indexes.emplace_back();
+        index_id = (int)this->indexes.size();
+    }
+    this->indexes[index_id - 1] = std::make_unique<map_voxel_index>(cell_size);
+    return index_id;
+}
+
+void map_voxel_index_mgr::destroy(int index_id)
+{
+    if (get(index_id))
+    {
+        this->indexes[index_id - 1].reset();
+        this->free_ids.push_back(index_id);
+    }
+}
+
+map_voxel_index *map_voxel_index_mgr::get(int index_id)
+{
+    if (index_id <= 0 || index_id > (int)this->indexes.size())
+    {
+        return nullptr;
+    }
+    return this->indexes[index_id - 1].get();
+}
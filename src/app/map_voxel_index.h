@@ -0,0 +1,79 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace avant::app
+{
+    // 稀疏体素哈希网格 供3D地图AOI使用
+    // 按实体圆心所在的格子分桶 格子坐标交织成Morton码作为哈希key 只为有实体的格子分配桶
+    // 实体以稳定的整数handle引用 handle在Remove前不变
+    // 实体移动后仍在原格子内时只改坐标 跨格子时从旧桶swap删除再放入新桶 都是O(1)
+    class map_voxel_index
+    {
+    public:
+        static constexpr double DEFAULT_CELL_SIZE = 1024;
+        // 每个轴的格子坐标位数 超出范围的坐标夹到边缘格子
+        static constexpr int AXIS_BITS = 21;
+
+        explicit map_voxel_index(double cell_size);
+
+        // 返回handle >0
+        int insert(double x, double y, double z, double radius);
+        bool update(int handle, double x, double y, double z);
+        bool remove(int handle);
+
+        // 球的包围盒与长方体[x, x+w) x [y, y+h) x [z, z+d)相交的实体handle 追加到out
+        void query_box(double x, double y, double z, double w, double h, double d, std::vector<int> &out) const;
+        // 与以(x,y,z)为球心 半径r的球相交的实体handle 追加到out
+        void query_sphere(double x, double y, double z, double r, std::vector<int> &out) const;
+        // 圆心距离(x,y,z)最近的至多k个实体 按距离从近到远追加到out max_dist<=0表示不限距离
+        void query_nearest(double x, double y, double z, int k, double max_dist, std::vector<int> &out) const;
+
+        size_t size() const { return this->entity_cnt; }
+
+    private:
+        struct entity
+        {
+            double x{0}, y{0}, z{0}, radius{0};
+            uint64_t key{0};
+            // 在所属桶中的下标
+            int slot{-1};
+            bool alive{false};
+        };
+
+        int to_cell(double v) const;
+        static uint64_t morton(int cx, int cy, int cz);
+        void link(int entity_idx, uint64_t key);
+        void unlink(int entity_idx);
+        const std::vector<int> *find_cell(int cx, int cy, int cz) const;
+
+        // 遍历与格子范围重叠的所有桶 范围内格子比已有桶多时直接遍历全部桶
+        template <typename FUNC>
+        void for_each_cell(int min_cx, int min_cy, int min_cz, int max_cx, int max_cy, int max_cz, FUNC &&func) const;
+
+    private:
+        double cell_size;
+        double inv_cell_size;
+        std::unordered_map<uint64_t, std::vector<int>> cells;
+        std::vector<entity> entities;
+        std::vector<int> free_entities;
+        size_t entity_cnt{0};
+        // 插入过的最大实体半径 查询范围向外扩出该值
+        double max_radius{0};
+    };
+
+    // Lua侧以整数id持有索引 只在other线程使用
+    class map_voxel_index_mgr
+    {
+    public:
+        int create(double cell_size);
+        void destroy(int index_id);
+        map_voxel_index *get(int index_id);
+
+    private:
+        std::vector<std::unique_ptr<map_voxel_index>> indexes;
+        std::vector<int> free_ids;
+    };
+}
@@ -4,6 +4,8 @@
 #include "utility/singleton.h"
 #include "utility/time.h"
 #include "app/lua_plugin.h"
+#include "app/udp_session.h"
+#include "app/app_metrics.h"
 #include "global/tunnel_id.h"
 #include "server/server.h"
 #include "proto/proto_util.h"
@@ -11,11 +13,45 @@
 #include "proto_res/proto_ipc_stream.pb.h"
 #include "proto_res/proto_tunnel.pb.h"
 #include <unordered_map>
+#include <vector>
+#include <algorithm>
+#include <endian.h>
+#include <queue>
+#include <chrono>
 
 using avant::app::other_app;
 namespace utility = avant::utility;
 namespace global = avant::global;
 
+// IPC对端 第一次出现的app_id分配一个整数handle(peers下标) 断线重连沿用同一个handle
+// 收发热路径只做数组下标访问 不再拿std::string做hash查找
+class avant_ipc_peer
+{
+public:
+    std::string app_id;
+    // 已认证的连接 未连接时gid为0 ctx为nullptr
+    uint64_t gid{0};
+    avant::connection::ipc_stream_ctx *ctx{nullptr};
+
+    // 发送队列 协议包按 8字节长度+ProtoPackage 连续追加
+    // 每个other tick或超过阈值时一次send_data写出 避免下线风暴时大量小包写
+    std::string send_buffer;
+    size_t pending_package_cnt{0};
+
+    // 统计 每5秒打印一次后清零
+    uint64_t stat_send_package_cnt{0};
+    uint64_t stat_recv_package_cnt{0};
+    uint64_t stat_rpc_call_cnt{0};
+    uint64_t stat_rpc_timeout_cnt{0};
+
+    // 未返回的RPC请求数
+    size_t rpc_inflight_cnt{0};
+    uint64_t stat_flush_cnt{0};
+    uint64_t stat_flush_bytes{0};
+    size_t stat_max_depth{0};
+    size_t stat_max_flush_bytes{0};
+};
+
 class avant_authenticated_ipc_pair
 {
 public:
@@ -23,13 +59,109 @@ public:
     {
         this->other_obj = nullptr;
     }
-    std::unordered_map<uint64_t, std::string> gid2appid;
-    std::unordered_map<std::string, uint64_t> appid2gid;
+
+    int intern(const std::string &app_id)
+    {
+        auto iter = this->appid2handle.find(app_id);
+        if (iter != this->appid2handle.end())
+        {
+            return iter->second;
+        }
+        int handle = (int)this->peers.size();
+        this->peers.emplace_back();
+        this->peers.back().app_id = app_id;
+        this->appid2handle[app_id] = handle;
+        return handle;
+    }
+
+    avant_ipc_peer *get_peer(int handle)
+    {
+        if (handle < 0 || handle >= (int)this->peers.size())
+        {
+            return nullptr;
+        }
+        return &this->peers[handle];
+    }
+
+    // 下标为handle
+    std::vector<avant_ipc_peer> peers;
+    // 只在握手与Lua查询handle时使用
+    std::unordered_map<std::string, int> appid2handle;
+    std::unordered_map<uint64_t, int> gid2handle;
     avant::workers::other *other_obj;
 };
 
 static avant_authenticated_ipc_pair authenticated_ipc_pair;
 
+// 超过该字节数立即写出 不等tick
+static constexpr size_t AVANT_IPC_SEND_QUEUE_FLUSH_BYTES = 256 * 1024;
+
+// IPC RPC 请求方分配rpcId放进ProtoPackage.rpcId 应答方原样带回并置rpcReply
+// 对端发来的请求交给Lua 由avant.IPCReply应答 两端的rpcId各自分配 互不冲突
+// 未返回的请求带deadline 超时或对端断开时通知Lua PROTO_CMD_IPC_RPC_TIMEOUT
+class avant_ipc_rpc_call
+{
+public:
+    int peer_handle{-1};
+    int cmd{0};
+    uint64_t deadline_ms{0};
+};
+
+class avant_ipc_rpc_table
+{
+public:
+    uint64_t next_rpc_id{1};
+    std::unordered_map<uint64_t, avant_ipc_rpc_call> inflight;
+    // {deadline_ms, rpc_id} 小顶堆 已返回的请求在出堆时跳过
+    std::priority_queue<std::pair<uint64_t, uint64_t>,
+                        std::vector<std::pair<uint64_t, uint64_t>>,
+                        std::greater<std::pair<uint64_t, uint64_t>>>
+        deadlines;
+};
+
+static avant_ipc_rpc_table ipc_rpc_table;
+
+// 单个对端最多未返回的RPC请求数
+static constexpr size_t AVANT_IPC_RPC_MAX_INFLIGHT_PER_PEER = 1024;
+
+static uint64_t other_app_steady_ms()
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void other_app_flush_ipc_send_queue(avant_ipc_peer &peer)
+{
+    if (peer.send_buffer.empty())
+    {
+        return;
+    }
+
+    size_t flush_bytes = peer.send_buffer.size();
+    size_t flush_depth = peer.pending_package_cnt;
+    peer.pending_package_cnt = 0;
+
+    if (!peer.ctx)
+    {
+        LOG_ERROR("other_app_flush_ipc_send_queue !ipc_stream_ctx app_id[{}] drop bytes[{}]", peer.app_id.c_str(), flush_bytes);
+        peer.send_buffer.clear();
+        return;
+    }
+
+    int ret = peer.ctx->send_data(peer.send_buffer);
+    if (ret != 0)
+    {
+        LOG_ERROR("other_app_flush_ipc_send_queue ret[{}]!= 0 app_id[{}] bytes[{}]", ret, peer.app_id.c_str(), flush_bytes);
+    }
+    // clear保留容量 下次追加不再分配
+    peer.send_buffer.clear();
+
+    peer.stat_flush_cnt++;
+    peer.stat_flush_bytes += flush_bytes;
+    peer.stat_max_depth = std::max(peer.stat_max_depth, flush_depth);
+    peer.stat_max_flush_bytes = std::max(peer.stat_max_flush_bytes, flush_bytes);
+}
+
 void other_app::on_other_init(avant::workers::other &other_obj)
 {
     LOG_ERROR("other_app::on_other_init()");
@@ -45,12 +177,25 @@ void other_app::on_other_stop(avant::workers::other &other_obj)
 {
     LOG_ERROR("other_app::on_other_stop()");
     utility::singleton<lua_plugin>::instance()->on_other_stop();
+    // 停服时lua内产生的IPC包(如玩家数据落地)尽量写出
+    for (avant_ipc_peer &peer : authenticated_ipc_pair.peers)
+    {
+        other_app_flush_ipc_send_queue(peer);
+    }
 }
 
 void other_app::on_other_tick(avant::workers::other &other_obj)
 {
     // LOG_ERROR("other_app::on_other_tick()");
     utility::singleton<lua_plugin>::instance()->on_other_tick();
+    other_check_ipc_rpc_timeout();
+    // lua tick内产生的UDP会话数据在这里统一打包发出
+    utility::singleton<udp_session_mgr>::instance()->flush(other_obj);
+    // lua tick内产生的IPC包在这里每个对端一次写出
+    for (avant_ipc_peer &peer : authenticated_ipc_pair.peers)
+    {
+        other_app_flush_ipc_send_queue(peer);
+    }
 
     static utility::time time_component;
     static time_t latest_tick_time = 0;
@@ -67,6 +212,35 @@ void other_app::on_other_tick(avant::workers::other &other_obj)
             ProtoPackage package;
             avant::proto::pack_package(package, other2worker_test, ProtoCmd::PROTO_CMD_TUNNEL_OTHER2WORKER_TEST);
             other_obj.tunnel_forward(vec_worker_all_tunnel_id, package);
+            app_metrics::add(utility::singleton<app_metrics>::instance()->other_slot().tunnel_send_total, vec_worker_all_tunnel_id.size());
+        }
+
+        // ipc对端收发统计
+        for (avant_ipc_peer &peer : authenticated_ipc_pair.peers)
+        {
+            if (peer.stat_send_package_cnt == 0 && peer.stat_recv_package_cnt == 0)
+            {
+                continue;
+            }
+            LOG_ERROR("ipc peer app_id[{}] send_packages[{}] recv_packages[{}] rpc_calls[{}] rpc_timeouts[{}] rpc_inflight[{}] flushes[{}] bytes[{}] max_depth[{}] max_flush_bytes[{}]",
+                      peer.app_id.c_str(),
+                      peer.stat_send_package_cnt,
+                      peer.stat_recv_package_cnt,
+                      peer.stat_rpc_call_cnt,
+                      peer.stat_rpc_timeout_cnt,
+                      peer.rpc_inflight_cnt,
+                      peer.stat_flush_cnt,
+                      peer.stat_flush_bytes,
+                      peer.stat_max_depth,
+                      peer.stat_max_flush_bytes);
+            peer.stat_send_package_cnt = 0;
+            peer.stat_recv_package_cnt = 0;
+            peer.stat_rpc_call_cnt = 0;
+            peer.stat_rpc_timeout_cnt = 0;
+            peer.stat_flush_cnt = 0;
+            peer.stat_flush_bytes = 0;
+            peer.stat_max_depth = 0;
+            peer.stat_max_flush_bytes = 0;
         }
         latest_tick_time = tick_time;
     }
@@ -74,15 +248,9 @@ void other_app::on_other_tick(avant::workers::other &other_obj)
     if constexpr (false)
     {
         // test ipc message process
-        for (auto item : authenticated_ipc_pair.gid2appid)
+        for (avant_ipc_peer &peer : authenticated_ipc_pair.peers)
         {
-            uint64_t gid = item.first;
-            avant::connection::connection *conn = other_obj.ipc_connection_mgr.get()->get_conn_by_gid(gid);
-            if (!conn)
-            {
-                continue;
-            }
-            avant::connection::ipc_stream_ctx *ctx = dynamic_cast<avant::connection::ipc_stream_ctx *>(conn->ctx_ptr.get());
+            avant::connection::ipc_stream_ctx *ctx = peer.ctx;
             if (!ctx)
             {
                 continue;
@@ -101,6 +269,7 @@ void other_app::on_other_tick(avant::workers::other &other_obj)
 
 void other_app::on_other_tunnel(avant::workers::other &other_obj, const ProtoPackage &package, const ProtoTunnelPackage &tunnel_package)
 {
+    app_metrics::add(utility::singleton<app_metrics>::instance()->other_slot().tunnel_recv_total);
     if (package.cmd() == ProtoCmd::PROOT_CMD_TUNNEL_WORKER2OTHER_LUAVM)
     {
         ProtoTunnelWorker2OtherLuaVM worker2OtherVMPackage;
@@ -117,6 +286,11 @@ void other_app::on_other_tunnel(avant::workers::other &other_obj, const ProtoPac
         // 交给LuaVM处理
         avant::ProtoCmd cmd = worker2OtherVMPackage.innerprotopackage().cmd();
 
+        if (cmd == ProtoCmd::PROTO_CMD_TUNNEL_WORKER2OTHER_EVENT_CLOSE_CLIENT_CONNECTION)
+        {
+            utility::singleton<udp_session_mgr>::instance()->remove_session(fromGid, worker_idx);
+        }
+
         // 必须写解包操作
         std::shared_ptr<google::protobuf::Message> ptrMessage = utility::singleton<lua_plugin>::instance()->protobuf_cmd2message(cmd);
         if (!ptrMessage)
@@ -164,12 +338,30 @@ void other_app::on_close_connection(avant::connection::ipc_stream_ctx &ctx)
     uint64_t gid = ctx.get_conn_gid();
 
     // is ipc conn
-    if (authenticated_ipc_pair.gid2appid.find(gid) != authenticated_ipc_pair.gid2appid.end())
+    auto gid2handle_iter = authenticated_ipc_pair.gid2handle.find(gid);
+    if (gid2handle_iter != authenticated_ipc_pair.gid2handle.end())
     {
         // LOG_ERROR("close ipc_client gid %llu", gid);
-        std::string app_id = authenticated_ipc_pair.gid2appid[gid];
-        authenticated_ipc_pair.gid2appid.erase(gid);
-        authenticated_ipc_pair.appid2gid.erase(app_id);
+        // handle保留给重连后的同一app_id使用
+        int peer_handle = gid2handle_iter->second;
+        avant_ipc_peer &peer = authenticated_ipc_pair.peers[peer_handle];
+        authenticated_ipc_pair.gid2handle.erase(gid2handle_iter);
+        peer.gid = 0;
+        peer.ctx = nullptr;
+        peer.send_buffer.clear();
+        peer.pending_package_cnt = 0;
+
+        // 这个对端上未返回的RPC不再等deadline 下个tick直接超时
+        if (peer.rpc_inflight_cnt > 0)
+        {
+            for (auto &item : ipc_rpc_table.inflight)
+            {
+                if (item.second.peer_handle == peer_handle)
+                {
+                    ipc_rpc_table.deadlines.push({0, item.first});
+                }
+            }
+        }
     }
 }
 
@@ -248,19 +440,22 @@ void other_app::on_recv_package(avant::connection::ipc_stream_ctx &ctx, const Pr
 
             // {appId, gid} is a binary that has been successfully authenticated
             bool succ = false;
-            if (authenticated_ipc_pair.appid2gid.find(auth_appId) == authenticated_ipc_pair.appid2gid.end())
+            int auth_handle = authenticated_ipc_pair.intern(auth_appId);
+            avant_ipc_peer &peer = authenticated_ipc_pair.peers[auth_handle];
+            if (peer.gid == 0)
             {
-                if (authenticated_ipc_pair.gid2appid.find(auth_gid) == authenticated_ipc_pair.gid2appid.end())
+                if (authenticated_ipc_pair.gid2handle.find(auth_gid) == authenticated_ipc_pair.gid2handle.end())
                 {
-                    authenticated_ipc_pair.appid2gid[auth_appId] = auth_gid;
-                    authenticated_ipc_pair.gid2appid[auth_gid] = auth_appId;
+                    peer.gid = auth_gid;
+                    peer.ctx = &ctx;
+                    authenticated_ipc_pair.gid2handle[auth_gid] = auth_handle;
                     succ = true;
                 }
             }
 
             if (succ)
             {
-                LOG_ERROR("appId {}, auth_gid {} insert to authenticated_ipc_pair succ", auth_appId.c_str(), auth_gid);
+                LOG_ERROR("appId {}, auth_gid {} handle {} insert to authenticated_ipc_pair succ", auth_appId.c_str(), auth_gid, auth_handle);
             }
             else
             {
@@ -270,14 +465,31 @@ void other_app::on_recv_package(avant::connection::ipc_stream_ctx &ctx, const Pr
     }
     else
     {
-        if (authenticated_ipc_pair.gid2appid.find(ctx.get_conn_gid()) == authenticated_ipc_pair.gid2appid.end())
+        auto gid2handle_iter = authenticated_ipc_pair.gid2handle.find(ctx.get_conn_gid());
+        if (gid2handle_iter == authenticated_ipc_pair.gid2handle.end())
         {
-            LOG_ERROR("authenticated_ipc_pair.gid2appid.find(ctx.get_conn_gid()) == authenticated_ipc_pair.gid2appid.end()");
+            LOG_ERROR("authenticated_ipc_pair.gid2handle.find(ctx.get_conn_gid()) == authenticated_ipc_pair.gid2handle.end()");
             return;
         }
 
-        const std::string &from_app_id_string = authenticated_ipc_pair.gid2appid.find(ctx.get_conn_gid())->second;
-        int worker_idx = avant::global::tunnel_id::get().get_other_tunnel_id();
+        int from_peer_handle = gid2handle_iter->second;
+        avant_ipc_peer &from_peer = authenticated_ipc_pair.peers[from_peer_handle];
+        from_peer.stat_recv_package_cnt++;
+
+        uint64_t rpc_id = package.rpcid();
+        const bool rpc_request = rpc_id != 0 && !package.rpcreply();
+        if (rpc_id != 0 && !rpc_request)
+        {
+            auto inflight_iter = ipc_rpc_table.inflight.find(rpc_id);
+            if (inflight_iter == ipc_rpc_table.inflight.end() || inflight_iter->second.peer_handle != from_peer_handle)
+            {
+                // 已经超时通知过Lua的晚到应答
+                LOG_ERROR("other_app::on_recv_package drop late rpc response rpc_id {} cmd {} app_id {}", rpc_id, (int)package.cmd(), from_peer.app_id.c_str());
+                return;
+            }
+            ipc_rpc_table.inflight.erase(inflight_iter);
+            from_peer.rpc_inflight_cnt--;
+        }
 
         // 必须写解包操作
         std::shared_ptr<google::protobuf::Message> ptrMessage = utility::singleton<lua_plugin>::instance()->protobuf_cmd2message(package.cmd());
@@ -294,42 +506,142 @@ void other_app::on_recv_package(avant::connection::ipc_stream_ctx &ctx, const Pr
             return;
         }
 
+        if (rpc_request)
+        {
+            utility::singleton<lua_plugin>::instance()->on_other_lua_vm_recv_ipc_request(package.cmd(),
+                                                                                         *ptrMessage,
+                                                                                         from_peer_handle,
+                                                                                         rpc_id);
+            return;
+        }
         utility::singleton<lua_plugin>::instance()->on_other_lua_vm_recv_ipc_message(package.cmd(),
                                                                                      *ptrMessage,
-                                                                                     from_app_id_string);
+                                                                                     from_peer_handle,
+                                                                                     rpc_id);
     }
 }
 
-void other_app::other_lua_send_ipc_package(const std::string &app_id, int cmd, google::protobuf::Message &message)
+int other_app::other_lua_get_ipc_peer_handle(const std::string &app_id)
+{
+    // 还没连上的app_id也先分配handle Lua可以放心缓存
+    return authenticated_ipc_pair.intern(app_id);
+}
+
+static bool other_app_append_ipc_package(avant_ipc_peer &peer, int cmd, google::protobuf::Message &message, uint64_t rpc_id, bool rpc_reply)
 {
-    if (authenticated_ipc_pair.appid2gid.find(app_id) == authenticated_ipc_pair.appid2gid.end())
+    ProtoPackage resPackage;
+    avant::proto::pack_package(resPackage, message, (avant::ProtoCmd)cmd);
+    resPackage.set_rpcid(rpc_id);
+    resPackage.set_rpcreply(rpc_reply);
+
+    // 直接序列化到发送队列尾部 先占8字节长度再回填
+    std::string &buffer = peer.send_buffer;
+    size_t head_pos = buffer.size();
+    buffer.append(sizeof(uint64_t), '\0');
+    if (!resPackage.AppendToString(&buffer))
     {
-        LOG_ERROR("other_app::other_lua_send_ipc_package appid2gid not found app_id[{}] cmd[{}]", app_id.c_str(), cmd);
-        return;
+        LOG_ERROR("other_app_append_ipc_package AppendToString failed app_id[{}] cmd[{}]", peer.app_id.c_str(), cmd);
+        buffer.resize(head_pos);
+        return false;
     }
-    uint64_t ipc_ctx_gid = authenticated_ipc_pair.appid2gid.find(app_id)->second;
-    avant::connection::connection *ipc_conn = authenticated_ipc_pair.other_obj->ipc_connection_mgr->get_conn_by_gid(ipc_ctx_gid);
-    if (!ipc_conn)
+    uint64_t data_size = htobe64(buffer.size() - head_pos - sizeof(uint64_t));
+    buffer.replace(head_pos, sizeof(data_size), (const char *)&data_size, sizeof(data_size));
+    peer.pending_package_cnt++;
+    peer.stat_send_package_cnt++;
+
+    if (buffer.size() >= AVANT_IPC_SEND_QUEUE_FLUSH_BYTES)
     {
-        LOG_ERROR("other_app::other_lua_send_ipc_package !ipc_conn app_id[{}] cmd[{}]", app_id.c_str(), cmd);
-        return;
+        other_app_flush_ipc_send_queue(peer);
     }
+    return true;
+}
 
-    avant::connection::ipc_stream_ctx *ipc_stream_ctx = dynamic_cast<avant::connection::ipc_stream_ctx *>(ipc_conn->ctx_ptr.get());
-    if (!ipc_stream_ctx)
+void other_app::other_lua_send_ipc_package(int peer_handle, int cmd, google::protobuf::Message &message)
+{
+    avant_ipc_peer *peer = authenticated_ipc_pair.get_peer(peer_handle);
+    if (!peer || !peer->ctx)
     {
-        LOG_ERROR("other_app::other_lua_send_ipc_package !ipc_stream_ctx app_id[{}] cmd[{}]", app_id.c_str(), cmd);
+        LOG_ERROR("other_app::other_lua_send_ipc_package peer not connected handle[{}] app_id[{}] cmd[{}]",
+                  peer_handle, peer ? peer->app_id.c_str() : "", cmd);
         return;
     }
 
-    ProtoPackage resPackage;
-    resPackage.set_cmd((avant::ProtoCmd)cmd);
-    std::string data;
-    int ret = ipc_stream_ctx->send_data(avant::proto::pack_package(data, avant::proto::pack_package(resPackage, message, (avant::ProtoCmd)cmd)));
-    if (ret != 0)
+    other_app_append_ipc_package(*peer, cmd, message, 0, false);
+}
+
+uint64_t other_app::other_lua_call_ipc_rpc(int peer_handle, int cmd, google::protobuf::Message &message, uint64_t timeout_ms)
+{
+    avant_ipc_peer *peer = authenticated_ipc_pair.get_peer(peer_handle);
+    if (!peer || !peer->ctx)
     {
-        LOG_ERROR("other_app::other_lua_send_ipc_package ret[{}]!= 0 app_id[{}] cmd[{}]", ret, app_id.c_str(), cmd);
-        return;
+        LOG_ERROR("other_app::other_lua_call_ipc_rpc peer not connected handle[{}] app_id[{}] cmd[{}]",
+                  peer_handle, peer ? peer->app_id.c_str() : "", cmd);
+        return 0;
+    }
+    if (peer->rpc_inflight_cnt >= AVANT_IPC_RPC_MAX_INFLIGHT_PER_PEER)
+    {
+        LOG_ERROR("other_app::other_lua_call_ipc_rpc too many inflight app_id[{}] cmd[{}] inflight[{}]",
+                  peer->app_id.c_str(), cmd, peer->rpc_inflight_cnt);
+        return 0;
+    }
+
+    uint64_t rpc_id = ipc_rpc_table.next_rpc_id++;
+    if (!other_app_append_ipc_package(*peer, cmd, message, rpc_id, false))
+    {
+        return 0;
+    }
+
+    avant_ipc_rpc_call &call = ipc_rpc_table.inflight[rpc_id];
+    call.peer_handle = peer_handle;
+    call.cmd = cmd;
+    call.deadline_ms = other_app_steady_ms() + timeout_ms;
+    ipc_rpc_table.deadlines.push({call.deadline_ms, rpc_id});
+    peer->rpc_inflight_cnt++;
+    peer->stat_rpc_call_cnt++;
+    return rpc_id;
+}
+
+bool other_app::other_lua_reply_ipc_rpc(int peer_handle, int cmd, google::protobuf::Message &message, uint64_t rpc_id)
+{
+    avant_ipc_peer *peer = authenticated_ipc_pair.get_peer(peer_handle);
+    if (!peer || !peer->ctx || rpc_id == 0)
+    {
+        LOG_ERROR("other_app::other_lua_reply_ipc_rpc peer not connected handle[{}] app_id[{}] cmd[{}] rpc_id[{}]",
+                  peer_handle, peer ? peer->app_id.c_str() : "", cmd, rpc_id);
+        return false;
+    }
+    return other_app_append_ipc_package(*peer, cmd, message, rpc_id, true);
+}
+
+void other_app::other_check_ipc_rpc_timeout()
+{
+    uint64_t now_ms = other_app_steady_ms();
+    while (!ipc_rpc_table.deadlines.empty() && ipc_rpc_table.deadlines.top().first <= now_ms)
+    {
+        uint64_t rpc_id = ipc_rpc_table.deadlines.top().second;
+        ipc_rpc_table.deadlines.pop();
+
+        auto inflight_iter = ipc_rpc_table.inflight.find(rpc_id);
+        if (inflight_iter == ipc_rpc_table.inflight.end())
+        {
+            // 已经返回
+            continue;
+        }
+        avant_ipc_rpc_call call = inflight_iter->second;
+        ipc_rpc_table.inflight.erase(inflight_iter);
+
+        avant_ipc_peer &peer = authenticated_ipc_pair.peers[call.peer_handle];
+        peer.rpc_inflight_cnt--;
+        peer.stat_rpc_timeout_cnt++;
+        LOG_ERROR("other_app::other_check_ipc_rpc_timeout rpc_id {} cmd {} app_id {}", rpc_id, call.cmd, peer.app_id.c_str());
+
+        ProtoIPCRPCTimeout timeout_message;
+        timeout_message.set_rpcid(rpc_id);
+        timeout_message.set_reqcmd(call.cmd);
+        utility::singleton<lua_plugin>::instance()->on_other_lua_vm_recv_ipc_message(ProtoCmd::PROTO_CMD_IPC_RPC_TIMEOUT,
+                                                                                     timeout_message,
+                                                                                     call.peer_handle,
+                                                                                     rpc_id);
     }
 }
 
@@ -352,6 +664,14 @@ void other_app::on_udp_server_recvfrom(avant::workers::other &other_obj, const c
 
     int cmd = package.cmd();
 
+    if (cmd == ProtoCmd::PROTO_CMD_UDP_SESSION_DATAGRAM)
+    {
+        std::string from_ip = other_obj.udp_svr_component->udp_component_get_ip(addr);
+        int from_port = other_obj.udp_svr_component->udp_component_get_port(addr);
+        utility::singleton<udp_session_mgr>::instance()->on_recv_datagram(other_obj, package, from_ip, from_port);
+        return;
+    }
+
     std::shared_ptr<google::protobuf::Message> ptrMessage = utility::singleton<lua_plugin>::instance()->protobuf_cmd2message(cmd);
     if (!ptrMessage)
     {
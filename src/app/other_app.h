@@ -24,7 +24,13 @@ namespace avant
             static void on_process_connection(avant::connection::ipc_stream_ctx &ctx);
             static void on_recv_package(avant::connection::ipc_stream_ctx &ctx, const ProtoPackage &package);
 
-            static void other_lua_send_ipc_package(const std::string &app_id, int cmd, google::protobuf::Message &message);
+            static int other_lua_get_ipc_peer_handle(const std::string &app_id);
+            static void other_lua_send_ipc_package(int peer_handle, int cmd, google::protobuf::Message &message);
+            // 返回rpc_id 0表示发送失败(对端未连接或未返回请求过多)
+            static uint64_t other_lua_call_ipc_rpc(int peer_handle, int cmd, google::protobuf::Message &message, uint64_t timeout_ms);
+            // 应答对端发来的RPC请求 带回请求的rpc_id 对端未连接返回false
+            static bool other_lua_reply_ipc_rpc(int peer_handle, int cmd, google::protobuf::Message &message, uint64_t rpc_id);
+            static void other_check_ipc_rpc_timeout();
 
             static void on_udp_server_recvfrom(avant::workers::other &other_obj, const char *buffer,
                                                ssize_t len,
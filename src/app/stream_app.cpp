@@ -9,6 +9,7 @@
 #include "global/tunnel_id.h"
 #include "utility/singleton.h"
 #include "app/lua_plugin.h"
+#include "app/app_metrics.h"
 
 using namespace avant::app;
 namespace utility = avant::utility;
@@ -57,6 +58,7 @@ bool stream_app::on_recved_packsize(avant::connection::stream_ctx &ctx, uint64_t
 void stream_app::on_new_connection(avant::connection::stream_ctx &ctx)
 {
     // LOG_ERROR("stream_app on_new_connection gid {}", ctx.get_conn_gid());
+    app_metrics::add(utility::singleton<app_metrics>::instance()->worker_slot(ctx.get_worker_idx()).conn_new_total);
     ProtoTunnelWorker2OtherLuaVM worker2OtherLuaVMPkg;
     worker2OtherLuaVMPkg.set_gid(ctx.get_conn_gid());
     worker2OtherLuaVMPkg.set_workeridx(ctx.get_worker_idx());
@@ -73,11 +75,13 @@ void stream_app::on_new_connection(avant::connection::stream_ctx &ctx)
     ctx.tunnel_forward(
         std::vector{avant::global::tunnel_id::get().get_other_tunnel_id()},
         avant::proto::pack_package(resPackage, worker2OtherLuaVMPkg, ProtoCmd::PROOT_CMD_TUNNEL_WORKER2OTHER_LUAVM));
+    app_metrics::add(utility::singleton<app_metrics>::instance()->worker_slot(ctx.get_worker_idx()).tunnel_send_total);
 }
 
 void stream_app::on_close_connection(avant::connection::stream_ctx &ctx)
 {
     // LOG_ERROR("stream_app on_close_connection gid {}", ctx.get_conn_gid());
+    app_metrics::add(utility::singleton<app_metrics>::instance()->worker_slot(ctx.get_worker_idx()).conn_close_total);
     ProtoTunnelWorker2OtherLuaVM worker2OtherLuaVMPkg;
     worker2OtherLuaVMPkg.set_gid(ctx.get_conn_gid());
     worker2OtherLuaVMPkg.set_workeridx(ctx.get_worker_idx());
@@ -94,11 +98,14 @@ void stream_app::on_close_connection(avant::connection::stream_ctx &ctx)
     ctx.tunnel_forward(
         std::vector{avant::global::tunnel_id::get().get_other_tunnel_id()},
         avant::proto::pack_package(resPackage, worker2OtherLuaVMPkg, ProtoCmd::PROOT_CMD_TUNNEL_WORKER2OTHER_LUAVM));
+    app_metrics::add(utility::singleton<app_metrics>::instance()->worker_slot(ctx.get_worker_idx()).tunnel_send_total);
 }
 
 void stream_app::on_process_connection(avant::connection::stream_ctx &ctx)
 {
     // LOG_ERROR("stream_app on_process_connection gid {}", ctx.get_conn_gid());
+    app_metrics::thread_slot &metrics_slot = utility::singleton<app_metrics>::instance()->worker_slot(ctx.get_worker_idx());
+    app_metrics::set_max(metrics_slot.recv_buffer_max_bytes, ctx.get_recv_buffer_size());
 
     if (ctx.get_recv_buffer_size() > 2048000)
     {
@@ -151,6 +158,7 @@ void stream_app::on_process_connection(avant::connection::stream_ctx &ctx)
         }
 
         ctx.recv_buffer_move_read_ptr_n(sizeof(data_size) + data_size);
+        app_metrics::add(metrics_slot.recv_bytes_total, sizeof(data_size) + data_size);
 
         on_recv_package(ctx, protoPackage);
         package_num_per_loop++;
@@ -163,6 +171,8 @@ void stream_app::on_process_connection(avant::connection::stream_ctx &ctx)
 
 void stream_app::on_recv_package(avant::connection::stream_ctx &ctx, const ProtoPackage &package)
 {
+    app_metrics::add_cmd(utility::singleton<app_metrics>::instance()->worker_slot(ctx.get_worker_idx()).cmd_recv_total, package.cmd());
+
     ProtoTunnelWorker2OtherLuaVM worker2OtherLuaVMPkg;
     worker2OtherLuaVMPkg.set_gid(ctx.get_conn_gid());
     worker2OtherLuaVMPkg.set_workeridx(ctx.get_worker_idx());
@@ -172,6 +182,7 @@ void stream_app::on_recv_package(avant::connection::stream_ctx &ctx, const Proto
     ctx.tunnel_forward(
         std::vector{avant::global::tunnel_id::get().get_other_tunnel_id()},
         avant::proto::pack_package(resPackage, worker2OtherLuaVMPkg, ProtoCmd::PROOT_CMD_TUNNEL_WORKER2OTHER_LUAVM));
+    app_metrics::add(utility::singleton<app_metrics>::instance()->worker_slot(ctx.get_worker_idx()).tunnel_send_total);
 }
 
 int stream_app::send_sync_package(avant::connection::stream_ctx &ctx, const ProtoPackage &package)
@@ -185,11 +196,17 @@ int stream_app::send_sync_package(avant::connection::stream_ctx &ctx, const Prot
     }
 
     std::string data;
-    return ctx.send_data(avant::proto::pack_package(data, package));
+    avant::proto::pack_package(data, package);
+    app_metrics::thread_slot &metrics_slot = utility::singleton<app_metrics>::instance()->worker_slot(ctx.get_worker_idx());
+    app_metrics::add_cmd(metrics_slot.cmd_send_total, package.cmd());
+    app_metrics::add(metrics_slot.send_bytes_total, data.size());
+    app_metrics::set_max(metrics_slot.send_buffer_max_bytes, ctx.get_send_buffer_size() + data.size());
+    return ctx.send_data(data);
 }
 
 void stream_app::on_worker_tunnel(avant::workers::worker &worker_obj, const ProtoPackage &package, const ProtoTunnelPackage &tunnel_package)
 {
+    app_metrics::add(utility::singleton<app_metrics>::instance()->worker_slot(worker_obj.get_worker_idx()).tunnel_recv_total);
     int cmd = package.cmd();
     if (cmd == ProtoCmd::PROTO_CMD_TUNNEL_OTHERLUAVM2WORKERCONN)
     {
@@ -0,0 +1,423 @@
+#include "app/udp_session.h"
+#include <avant-log/logger.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "app/lua_plugin.h"
+#include "utility/singleton.h"
+#include "global/tunnel_id.h"
+#include "app/app_metrics.h"
+#include "proto_res/proto_tunnel.pb.h"
+
+using namespace avant::app;
+using namespace avant::utility;
+
+uint64_t udp_session_mgr::now_ms()
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// 序号回绕比较 s1比s2新
+bool udp_session_mgr::seq_greater(uint32_t s1, uint32_t s2)
+{
+    return s1 != s2 && (uint32_t)(s1 - s2) < 0x80000000u;
+}
+
+uint64_t udp_session_mgr::create_session(uint64_t gid, int worker_idx)
+{
+    auto conn_iter = this->conn2token.find({gid, worker_idx});
+    if (conn_iter != this->conn2token.end())
+    {
+        return conn_iter->second;
+    }
+
+    static std::mt19937_64 token_engine{std::random_device{}()};
+    uint64_t token = 0;
+    do
+    {
+        token = token_engine();
+    } while (token == 0 || this->sessions.find(token) != this->sessions.end());
+
+    udp_session &session = this->sessions[token];
+    session.token = token;
+    session.gid = gid;
+    session.worker_idx = worker_idx;
+    this->conn2token[{gid, worker_idx}] = token;
+    return token;
+}
+
+void udp_session_mgr::remove_session(uint64_t gid, int worker_idx)
+{
+    auto conn_iter = this->conn2token.find({gid, worker_idx});
+    if (conn_iter == this->conn2token.end())
+    {
+        return;
+    }
+    this->sessions.erase(conn_iter->second);
+    this->conn2token.erase(conn_iter);
+}
+
+void udp_session_mgr::set_cmd_mode(int cmd, ProtoUDPCmdMode mode)
+{
+    if (mode == ProtoUDPCmdMode::UDP_CMD_MODE_TCP)
+    {
+        this->cmd_mode.erase(cmd);
+        return;
+    }
+    this->cmd_mode[cmd] = mode;
+}
+
+ProtoUDPCmdMode udp_session_mgr::get_cmd_mode(int cmd) const
+{
+    auto iter = this->cmd_mode.find(cmd);
+    if (iter == this->cmd_mode.end())
+    {
+        return ProtoUDPCmdMode::UDP_CMD_MODE_TCP;
+    }
+    return iter->second;
+}
+
+udp_session *udp_session_mgr::find_session(uint64_t gid, int worker_idx)
+{
+    auto conn_iter = this->conn2token.find({gid, worker_idx});
+    if (conn_iter == this->conn2token.end())
+    {
+        return nullptr;
+    }
+    auto session_iter = this->sessions.find(conn_iter->second);
+    if (session_iter == this->sessions.end())
+    {
+        return nullptr;
+    }
+    return &session_iter->second;
+}
+
+ProtoPackage *udp_session_mgr::queue_package(uint64_t gid, int worker_idx, int cmd)
+{
+    ProtoUDPCmdMode mode = get_cmd_mode(cmd);
+    if (mode == ProtoUDPCmdMode::UDP_CMD_MODE_TCP)
+    {
+        return nullptr;
+    }
+
+    udp_session *session = find_session(gid, worker_idx);
+    if (!session || !session->addr_bound)
+    {
+        return nullptr;
+    }
+
+    if (mode == ProtoUDPCmdMode::UDP_CMD_MODE_UNRELIABLE_LATEST)
+    {
+        return &session->latest_queue[cmd];
+    }
+    else if (mode == ProtoUDPCmdMode::UDP_CMD_MODE_UNRELIABLE)
+    {
+        session->unreliable_queue.emplace_back();
+        return &session->unreliable_queue.back();
+    }
+
+    if (session->reliable_queue.size() >= UDP_SESSION_MAX_RELIABLE)
+    {
+        // 客户端长时间不ack 不再继续积压 交给TCP
+        LOG_ERROR("udp_session_mgr::queue_package reliable_queue full gid {} worker_idx {} cmd {}", gid, worker_idx, cmd);
+        return nullptr;
+    }
+    session->reliable_queue.emplace_back();
+    udp_session::reliable_entry &entry = session->reliable_queue.back();
+    entry.reliable_id = session->next_reliable_id++;
+    if (session->next_reliable_id == 0)
+    {
+        session->next_reliable_id = 1;
+    }
+    return &entry.package;
+}
+
+bool udp_session_mgr::try_send(uint64_t gid, int worker_idx, int cmd, const google::protobuf::Message &message)
+{
+    ProtoPackage *package = queue_package(gid, worker_idx, cmd);
+    if (!package)
+    {
+        return false;
+    }
+    avant::proto::pack_package(*package, message, (avant::ProtoCmd)cmd);
+    return true;
+}
+
+bool udp_session_mgr::try_send_encoded(uint64_t gid, int worker_idx, int cmd, const std::string &protocol)
+{
+    ProtoPackage *package = queue_package(gid, worker_idx, cmd);
+    if (!package)
+    {
+        return false;
+    }
+    package->set_cmd((avant::ProtoCmd)cmd);
+    package->set_protocol(protocol);
+    return true;
+}
+
+void udp_session_mgr::on_recv_datagram(avant::workers::other &other_obj,
+                                       const ProtoPackage &package,
+                                       const std::string &from_ip,
+                                       int from_port)
+{
+    ProtoUDPDatagram datagram;
+    if (!avant::proto::parse(datagram, package))
+    {
+        LOG_ERROR("udp_session_mgr::on_recv_datagram parse failed from {}:{}", from_ip.c_str(), from_port);
+        return;
+    }
+
+    auto session_iter = this->sessions.find(datagram.token());
+    if (session_iter == this->sessions.end())
+    {
+        LOG_ERROR("udp_session_mgr::on_recv_datagram unknow token from {}:{}", from_ip.c_str(), from_port);
+        return;
+    }
+    udp_session &session = session_iter->second;
+
+    if (!session.addr_bound || session.ip != from_ip || session.port != from_port)
+    {
+        session.addr_bound = true;
+        session.ip = from_ip;
+        session.port = from_port;
+    }
+    session.last_recv_ms = now_ms();
+
+    // 更新对端数据报的接收窗口
+    uint32_t seq = datagram.seq();
+    bool is_newest = false;
+    if (!session.recv_any)
+    {
+        session.recv_any = true;
+        session.remote_seq = seq;
+        session.remote_ack_bits = 0;
+        is_newest = true;
+    }
+    else if (seq_greater(seq, session.remote_seq))
+    {
+        uint32_t shift = seq - session.remote_seq;
+        if (shift > 32)
+        {
+            session.remote_ack_bits = 0;
+        }
+        else if (shift == 32)
+        {
+            session.remote_ack_bits = 1u << 31;
+        }
+        else
+        {
+            session.remote_ack_bits = (session.remote_ack_bits << shift) | (1u << (shift - 1));
+        }
+        session.remote_seq = seq;
+        is_newest = true;
+    }
+    else
+    {
+        uint32_t diff = session.remote_seq - seq;
+        if (diff == 0 || diff > 32 || (session.remote_ack_bits & (1u << (diff - 1))))
+        {
+            // 重复的数据报
+            return;
+        }
+        session.remote_ack_bits |= 1u << (diff - 1);
+    }
+    session.ack_dirty = true;
+
+    // 对端确认了哪些本端数据报
+    uint32_t ack = datagram.ack();
+    uint32_t ack_bits = datagram.ackbits();
+    for (auto iter = session.reliable_queue.begin(); iter != session.reliable_queue.end();)
+    {
+        bool acked = false;
+        const int sent_cnt = std::min(iter->sent_cnt, udp_session::RELIABLE_SENT_SEQS);
+        for (int i = 0; i < sent_cnt && !acked; ++i)
+        {
+            uint32_t diff = ack - iter->sent_seqs[i];
+            acked = diff == 0 || (diff <= 32 && (ack_bits & (1u << (diff - 1))));
+        }
+        iter = acked ? session.reliable_queue.erase(iter) : iter + 1;
+    }
+
+    // 先挑出要交给Lua的包 lua处理过程中会话可能被移除
+    std::vector<const ProtoPackage *> deliver_packages;
+    for (const ProtoUDPDatagramEntry &entry : datagram.entries())
+    {
+        uint32_t reliable_id = entry.reliableid();
+        if (reliable_id == 0)
+        {
+            // 不可靠有序 晚到的旧数据报内容直接丢弃
+            if (is_newest)
+            {
+                deliver_packages.push_back(&entry.package());
+            }
+            continue;
+        }
+
+        if (seq_greater(reliable_id, session.recv_reliable_max))
+        {
+            uint32_t shift = reliable_id - session.recv_reliable_max;
+            session.recv_reliable_bits = shift >= 64 ? 0 : (session.recv_reliable_bits << shift);
+            session.recv_reliable_bits |= 1;
+            session.recv_reliable_max = reliable_id;
+            deliver_packages.push_back(&entry.package());
+        }
+        else
+        {
+            uint32_t diff = session.recv_reliable_max - reliable_id;
+            if (diff < 64 && !(session.recv_reliable_bits & (1ull << diff)))
+            {
+                session.recv_reliable_bits |= 1ull << diff;
+                deliver_packages.push_back(&entry.package());
+            }
+        }
+    }
+
+    uint64_t gid = session.gid;
+    int worker_idx = session.worker_idx;
+    lua_plugin *lua_plugin_ptr = singleton<lua_plugin>::instance();
+    for (const ProtoPackage *inner_package : deliver_packages)
+    {
+        int cmd = inner_package->cmd();
+        std::shared_ptr<google::protobuf::Message> ptrMessage = lua_plugin_ptr->protobuf_cmd2message(cmd);
+        if (!ptrMessage)
+        {
+            LOG_ERROR("udp_session_mgr::on_recv_datagram unknow cmd {}", cmd);
+            continue;
+        }
+        if (!avant::proto::parse(*ptrMessage, *inner_package))
+        {
+            LOG_ERROR("udp_session_mgr::on_recv_datagram parse failed cmd {}", cmd);
+            continue;
+        }
+        // 与TCP来的客户端消息走同一个入口
+        lua_plugin_ptr->on_other_lua_vm_recv_client_message(cmd, *ptrMessage, gid, worker_idx);
+    }
+}
+
+void udp_session_mgr::unbind_session(avant::workers::other &other_obj, udp_session &session)
+{
+    LOG_ERROR("udp_session_mgr::unbind_session timeout gid {} worker_idx {} {}:{}",
+              session.gid, session.worker_idx, session.ip.c_str(), session.port);
+
+    // 未被确认的可靠包回落到TCP
+    for (udp_session::reliable_entry &entry : session.reliable_queue)
+    {
+        ProtoTunnelOtherLuaVM2WorkerConn tunnelOtherVM2WorkerConn;
+        tunnelOtherVM2WorkerConn.set_gid(session.gid);
+        tunnelOtherVM2WorkerConn.set_workeridx(session.worker_idx);
+        *tunnelOtherVM2WorkerConn.mutable_innerprotopackage() = entry.package;
+
+        ProtoPackage resPackage;
+        other_obj.tunnel_forward(
+            std::vector{avant::global::tunnel_id::get().get_worker_tunnel_id(session.worker_idx)},
+            avant::proto::pack_package(resPackage, tunnelOtherVM2WorkerConn, ProtoCmd::PROTO_CMD_TUNNEL_OTHERLUAVM2WORKERCONN));
+        app_metrics::add(singleton<app_metrics>::instance()->other_slot().tunnel_send_total);
+    }
+
+    session.addr_bound = false;
+    session.reliable_queue.clear();
+    session.unreliable_queue.clear();
+    session.latest_queue.clear();
+    session.recv_any = false;
+    session.ack_dirty = false;
+}
+
+void udp_session_mgr::send_datagram(avant::workers::other &other_obj, udp_session &session, ProtoUDPDatagram &datagram)
+{
+    datagram.set_seq(++session.local_seq);
+    datagram.set_ack(session.remote_seq);
+    datagram.set_ackbits(session.remote_ack_bits);
+    session.ack_dirty = false;
+
+    ProtoPackage package;
+    avant::proto::pack_package(package, datagram, ProtoCmd::PROTO_CMD_UDP_SESSION_DATAGRAM);
+    std::string data;
+    package.SerializeToString(&data);
+
+    int int_ret = other_obj.udp_svr_component->udp_component_client(session.ip, session.port, data.c_str(), data.size(), nullptr, 0);
+    if (int_ret != 0)
+    {
+        LOG_ERROR("udp_session_mgr::send_datagram udp_component_client failed {}:{}", session.ip.c_str(), session.port);
+    }
+}
+
+void udp_session_mgr::flush_session(avant::workers::other &other_obj, udp_session &session, uint64_t now_ms)
+{
+    ProtoUDPDatagram datagram;
+    size_t datagram_bytes = 0;
+
+    auto append_entry = [&](const ProtoPackage &package, uint32_t reliable_id) -> ProtoUDPDatagramEntry *
+    {
+        // 估算entry加上tag与长度前缀后的大小 装不下就先把当前数据报发出
+        size_t entry_bytes = package.ByteSizeLong() + 16;
+        if (datagram.entries_size() > 0 && datagram_bytes + entry_bytes > UDP_SESSION_MTU)
+        {
+            send_datagram(other_obj, session, datagram);
+            datagram.Clear();
+            datagram_bytes = 0;
+        }
+        ProtoUDPDatagramEntry *entry = datagram.add_entries();
+        entry->set_reliableid(reliable_id);
+        *entry->mutable_package() = package;
+        datagram_bytes += entry_bytes;
+        return entry;
+    };
+
+    for (udp_session::reliable_entry &entry : session.reliable_queue)
+    {
+        if (entry.sent && now_ms - entry.sent_ms < UDP_SESSION_RESEND_MS)
+        {
+            continue;
+        }
+        append_entry(entry.package, entry.reliable_id);
+        // 当前数据报发出时的seq 之前几次的seq保留 晚到的ack仍然有效
+        entry.sent_seqs[entry.sent_cnt % udp_session::RELIABLE_SENT_SEQS] = session.local_seq + 1;
+        ++entry.sent_cnt;
+        entry.sent_ms = now_ms;
+        entry.sent = true;
+    }
+
+    for (const ProtoPackage &package : session.unreliable_queue)
+    {
+        append_entry(package, 0);
+    }
+    session.unreliable_queue.clear();
+
+    for (const auto &item : session.latest_queue)
+    {
+        append_entry(item.second, 0);
+    }
+    session.latest_queue.clear();
+
+    // 没有数据也要把ack带给客户端
+    if (datagram.entries_size() > 0 || session.ack_dirty)
+    {
+        send_datagram(other_obj, session, datagram);
+    }
+}
+
+void udp_session_mgr::flush(avant::workers::other &other_obj)
+{
+    if (this->sessions.empty() || !other_obj.udp_svr_component.get())
+    {
+        return;
+    }
+
+    uint64_t now = now_ms();
+    for (auto &item : this->sessions)
+    {
+        udp_session &session = item.second;
+        if (!session.addr_bound)
+        {
+            continue;
+        }
+        if (now - session.last_recv_ms > UDP_SESSION_TIMEOUT_MS)
+        {
+            unbind_session(other_obj, session);
+            continue;
+        }
+        flush_session(other_obj, session, now);
+    }
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include "workers/other.h"
+#include "proto/proto_util.h"
+#include "proto_res/proto_udp.pb.h"
+
+namespace avant::app
+{
+    // 客户端UDP会话
+    // TCP登录成功后由Lua创建并把token下发给客户端 客户端在每个数据报里带上token
+    // 服务端以收到的第一个合法数据报绑定客户端地址 NAT地址变化时跟随token重新绑定
+    class udp_session
+    {
+    public:
+        // 可靠包重发时换新的数据报seq 记下最近几次的seq 对端确认其中任意一个都算送达
+        // 重发间隔远大于ackBits覆盖的32个数据报 更早的seq已不可能被确认
+        static constexpr int RELIABLE_SENT_SEQS = 8;
+
+        struct reliable_entry
+        {
+            uint32_t reliable_id{0};
+            ProtoPackage package;
+            // 被放进过的数据报seq 环形覆盖最早的
+            uint32_t sent_seqs[RELIABLE_SENT_SEQS]{};
+            int sent_cnt{0};
+            uint64_t sent_ms{0};
+            bool sent{false};
+        };
+
+        uint64_t token{0};
+        uint64_t gid{0};
+        int worker_idx{-1};
+
+        bool addr_bound{false};
+        std::string ip;
+        int port{0};
+        uint64_t last_recv_ms{0};
+
+        // 发送方向
+        uint32_t local_seq{0};
+        uint32_t next_reliable_id{1};
+        std::deque<reliable_entry> reliable_queue;
+        std::deque<ProtoPackage> unreliable_queue;
+        // cmd -> 本tick最新的包
+        std::map<int, ProtoPackage> latest_queue;
+
+        // 接收方向
+        bool recv_any{false};
+        uint32_t remote_seq{0};
+        uint32_t remote_ack_bits{0};
+        bool ack_dirty{false};
+        uint32_t recv_reliable_max{0};
+        uint64_t recv_reliable_bits{0};
+    };
+
+    class udp_session_mgr
+    {
+    public:
+        // 单个数据报的最大字节数 超过的单个包会独占一个数据报发出
+        static constexpr size_t UDP_SESSION_MTU = 1200;
+        // 超过该时间没收到客户端数据报 则解绑地址 发送回落到TCP
+        static constexpr uint64_t UDP_SESSION_TIMEOUT_MS = 10000;
+        // 可靠包重发间隔
+        static constexpr uint64_t UDP_SESSION_RESEND_MS = 100;
+        // 单个会话最多积压的可靠包
+        static constexpr size_t UDP_SESSION_MAX_RELIABLE = 256;
+
+        // 为客户端连接创建会话 已存在则返回原token
+        uint64_t create_session(uint64_t gid, int worker_idx);
+        void remove_session(uint64_t gid, int worker_idx);
+
+        void set_cmd_mode(int cmd, ProtoUDPCmdMode mode);
+        ProtoUDPCmdMode get_cmd_mode(int cmd) const;
+
+        // cmd配置了UDP通道且会话已绑定地址时入队返回true 否则调用方继续走TCP
+        bool try_send(uint64_t gid, int worker_idx, int cmd, const google::protobuf::Message &message);
+        // 同try_send protocol为已编码好的协议体 不再序列化
+        bool try_send_encoded(uint64_t gid, int worker_idx, int cmd, const std::string &protocol);
+
+        void on_recv_datagram(avant::workers::other &other_obj,
+                              const ProtoPackage &package,
+                              const std::string &from_ip,
+                              int from_port);
+
+        // other线程每个tick在lua tick之后调用 打包并发送所有会话的数据
+        void flush(avant::workers::other &other_obj);
+
+    private:
+        udp_session *find_session(uint64_t gid, int worker_idx);
+        // 按cmd的通道在会话中占一个待发包位置 走TCP或会话不可用时返回nullptr
+        ProtoPackage *queue_package(uint64_t gid, int worker_idx, int cmd);
+        void unbind_session(avant::workers::other &other_obj, udp_session &session);
+        void flush_session(avant::workers::other &other_obj, udp_session &session, uint64_t now_ms);
+        void send_datagram(avant::workers::other &other_obj, udp_session &session, ProtoUDPDatagram &datagram);
+
+        static uint64_t now_ms();
+        static bool seq_greater(uint32_t s1, uint32_t s2);
+
+    private:
+        // token -> session
+        std::unordered_map<uint64_t, udp_session> sessions;
+        // {gid, worker_idx} -> token
+        std::map<std::pair<uint64_t, int>, uint64_t> conn2token;
+        std::unordered_map<int, ProtoUDPCmdMode> cmd_mode;
+    };
+}
@@ -19,6 +19,7 @@
 #include "proto_res/proto_tunnel.pb.h"
 #include "utility/singleton.h"
 #include "app/lua_plugin.h"
+#include "app/app_metrics.h"
 #include <vector>
 #include "global/tunnel_id.h"
 
@@ -62,6 +63,7 @@ void websocket_app::on_worker_tick(avant::workers::worker &worker_obj)
 
 void websocket_app::on_worker_tunnel(avant::workers::worker &worker_obj, const ProtoPackage &package, const ProtoTunnelPackage &tunnel_package)
 {
+    app_metrics::add(utility::singleton<app_metrics>::instance()->worker_slot(worker_obj.get_worker_idx()).tunnel_recv_total);
     int cmd = package.cmd();
     if (cmd == ProtoCmd::PROTO_CMD_TUNNEL_OTHERLUAVM2WORKERCONN)
     {
@@ -108,6 +110,7 @@ void websocket_app::on_worker_tunnel(avant::workers::worker &worker_obj, const P
 void websocket_app::on_new_connection(avant::connection::websocket_ctx &ctx)
 {
     // LOG_ERROR("websocket_app::on_new_connection");
+    app_metrics::add(utility::singleton<app_metrics>::instance()->worker_slot(ctx.get_worker_idx()).conn_new_total);
     ProtoTunnelWorker2OtherLuaVM worker2OtherLuaVMPkg;
     worker2OtherLuaVMPkg.set_gid(ctx.get_conn_gid());
     worker2OtherLuaVMPkg.set_workeridx(ctx.get_worker_idx());
@@ -124,11 +127,13 @@ void websocket_app::on_new_connection(avant::connection::websocket_ctx &ctx)
     ctx.tunnel_forward(
         std::vector{avant::global::tunnel_id::get().get_other_tunnel_id()},
         avant::proto::pack_package(resPackage, worker2OtherLuaVMPkg, ProtoCmd::PROOT_CMD_TUNNEL_WORKER2OTHER_LUAVM));
+    app_metrics::add(utility::singleton<app_metrics>::instance()->worker_slot(ctx.get_worker_idx()).tunnel_send_total);
 }
 
 void websocket_app::on_close_connection(avant::connection::websocket_ctx &ctx)
 {
     // LOG_ERROR("websocket_app::on_close_connection");
+    app_metrics::add(utility::singleton<app_metrics>::instance()->worker_slot(ctx.get_worker_idx()).conn_close_total);
     ProtoTunnelWorker2OtherLuaVM worker2OtherLuaVMPkg;
     worker2OtherLuaVMPkg.set_gid(ctx.get_conn_gid());
     worker2OtherLuaVMPkg.set_workeridx(ctx.get_worker_idx());
@@ -145,10 +150,14 @@ void websocket_app::on_close_connection(avant::connection::websocket_ctx &ctx)
     ctx.tunnel_forward(
         std::vector{avant::global::tunnel_id::get().get_other_tunnel_id()},
         avant::proto::pack_package(resPackage, worker2OtherLuaVMPkg, ProtoCmd::PROOT_CMD_TUNNEL_WORKER2OTHER_LUAVM));
+    app_metrics::add(utility::singleton<app_metrics>::instance()->worker_slot(ctx.get_worker_idx()).tunnel_send_total);
 }
 
 void websocket_app::on_process_connection(avant::connection::websocket_ctx &ctx)
 {
+    app_metrics::thread_slot &metrics_slot = utility::singleton<app_metrics>::instance()->worker_slot(ctx.get_worker_idx());
+    app_metrics::set_max(metrics_slot.recv_buffer_max_bytes, ctx.get_recv_buffer_size());
+
     constexpr int max_package_num_per_loop = INT32_MAX;
     int package_num_per_loop = 0;
     do
@@ -289,6 +298,7 @@ void websocket_app::on_process_connection(avant::connection::websocket_ctx &ctx)
 
         {
             ctx.recv_buffer_move_read_ptr_n(index);
+            app_metrics::add(metrics_slot.recv_bytes_total, index);
             if (frame.fin)
             {
                 on_process_frame(ctx, frame);
@@ -330,6 +340,7 @@ void websocket_app::on_process_frame(avant::connection::websocket_ctx &ctx, cons
         return;
     }
     ctx.frame_payload_data.clear();
+    app_metrics::add_cmd(utility::singleton<app_metrics>::instance()->worker_slot(ctx.get_worker_idx()).cmd_recv_total, protoPackage.cmd());
 
     ProtoTunnelWorker2OtherLuaVM worker2OtherLuaVMPkg;
     worker2OtherLuaVMPkg.set_gid(ctx.get_conn_gid());
@@ -340,6 +351,7 @@ void websocket_app::on_process_frame(avant::connection::websocket_ctx &ctx, cons
     ctx.tunnel_forward(
         std::vector{avant::global::tunnel_id::get().get_other_tunnel_id()},
         avant::proto::pack_package(resPackage, worker2OtherLuaVMPkg, ProtoCmd::PROOT_CMD_TUNNEL_WORKER2OTHER_LUAVM));
+    app_metrics::add(utility::singleton<app_metrics>::instance()->worker_slot(ctx.get_worker_idx()).tunnel_send_total);
 }
 
 void websocket_app::on_client_forward_message(avant::connection::websocket_ctx &ctx,
@@ -350,6 +362,7 @@ void websocket_app::on_client_forward_message(avant::connection::websocket_ctx &
     int cmd = message.innerprotopackage().cmd();
     uint8_t first_byte = 0x80 | websocket_frame_type_2_n(websocket_frame_type::BINARY_FRAME);
     std::string data = message.innerprotopackage().SerializeAsString();
+    app_metrics::add_cmd(utility::singleton<app_metrics>::instance()->worker_slot(ctx.get_worker_idx()).cmd_send_total, cmd);
     send_sync_package(ctx, first_byte, data.c_str(), data.size());
 }
 
@@ -386,6 +399,9 @@ int websocket_app::send_sync_package(avant::connection::websocket_ctx &ctx, uint
         }
     }
     frame.insert(frame.end(), data, data + data_len);
+    app_metrics::thread_slot &metrics_slot = utility::singleton<app_metrics>::instance()->worker_slot(ctx.get_worker_idx());
+    app_metrics::add(metrics_slot.send_bytes_total, frame.size());
+    app_metrics::set_max(metrics_slot.send_buffer_max_bytes, ctx.get_send_buffer_size() + frame.size());
     return ctx.send_data(frame);
 }
 
@@ -0,0 +1,175 @@
+// map_snapshot_test.cpp
+// map_snapshot增量快照回归测试 用法见testing/README.md
+
+#include <cstdio>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "app/map_aoi.h"
+#include "app/map_snapshot.h"
+#include "utility/singleton.h"
+
+using namespace avant;
+using namespace avant::app;
+using namespace avant::utility;
+
+namespace
+{
+    int failed = 0;
+
+    void check(bool ok, const char *what)
+    {
+        std::printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+        if (!ok)
+        {
+            ++failed;
+        }
+    }
+
+    // 与testing_client.ts中MapSnapshotDecoder相同的解码 只关心实体集合
+    struct client_model
+    {
+        std::map<uint32_t, std::map<uint32_t, std::string>> snapshots;
+        uint32_t latest{0};
+
+        bool apply(const ProtoCSMapNotifySnapshot &msg)
+        {
+            std::map<uint32_t, std::string> entities;
+            if (msg.baselineid() != 0)
+            {
+                auto base = this->snapshots.find(msg.baselineid());
+                if (base == this->snapshots.end())
+                {
+                    return false;
+                }
+                entities = base->second;
+            }
+            for (uint32_t index : msg.removed())
+            {
+                entities.erase(index);
+            }
+            for (const auto &enter : msg.enters())
+            {
+                entities[enter.index()] = enter.userid();
+            }
+            this->snapshots[msg.snapshotid()] = entities;
+            if (msg.snapshotid() > this->latest)
+            {
+                this->latest = msg.snapshotid();
+            }
+            return true;
+        }
+
+        std::set<std::string> view() const
+        {
+            std::set<std::string> users;
+            auto iter = this->snapshots.find(this->latest);
+            if (iter != this->snapshots.end())
+            {
+                for (const auto &item : iter->second)
+                {
+                    users.insert(item.second);
+                }
+            }
+            return users;
+        }
+    };
+
+    struct fixture
+    {
+        int aoi_id;
+        map_aoi *aoi;
+        map_snapshot snapshot;
+        std::vector<int> watchers;
+        int self;
+
+        fixture()
+            : aoi_id(singleton<map_aoi_mgr>::instance()->create(0, 0, 10000, 10000, 600, 700)),
+              aoi(singleton<map_aoi_mgr>::instance()->get(aoi_id)),
+              snapshot(aoi_id, 1, 1)
+        {
+            this->self = add("A", 100, 100);
+            this->snapshot.set_client(this->self, 1, 0);
+        }
+
+        ~fixture()
+        {
+            singleton<map_aoi_mgr>::instance()->destroy(this->aoi_id);
+        }
+
+        int add(const std::string &user_id, double x, double y)
+        {
+            int handle = this->aoi->insert(x, y);
+            this->snapshot.set_entity(handle, user_id);
+            this->snapshot.set_state(handle, x, y, 0, 0, 0, 0);
+            return handle;
+        }
+
+        void remove(int handle)
+        {
+            this->snapshot.remove(handle);
+            this->aoi->remove(handle);
+        }
+
+        // 一步 返回是否发出了快照
+        bool step(ProtoCSMapNotifySnapshot &out)
+        {
+            this->watchers.clear();
+            this->aoi->flush(this->watchers);
+            return this->snapshot.encode(this->self, 0, out);
+        }
+    };
+
+    // 进入后在确认前离开 再确认那个带进入的快照 客户端不能留下已离开的实体
+    void test_enter_leave_before_ack(bool lose_empty_delta)
+    {
+        fixture f;
+        client_model model;
+        ProtoCSMapNotifySnapshot msg;
+
+        check(f.step(msg) && msg.baselineid() == 0, "first snapshot is full");
+        model.apply(msg);
+        f.snapshot.ack(f.self, msg.snapshotid());
+        while (f.step(msg))
+        {
+            model.apply(msg);
+            f.snapshot.ack(f.self, msg.snapshotid());
+        }
+
+        int x = f.add("X", 200, 200);
+        check(f.step(msg) && msg.enters_size() == 1, "enter X");
+        model.apply(msg);
+        const uint32_t enter_id = msg.snapshotid();
+
+        f.remove(x);
+        bool sent = f.step(msg);
+        check(sent, "leave before ack still sends a snapshot");
+        if (sent && !lose_empty_delta)
+        {
+            model.apply(msg);
+        }
+
+        // 带进入的快照的确认晚到
+        f.snapshot.ack(f.self, enter_id);
+        for (int i = 0; i < 4; ++i)
+        {
+            if (f.step(msg))
+            {
+                model.apply(msg);
+                f.snapshot.ack(f.self, msg.snapshotid());
+            }
+        }
+        check(f.step(msg) == false, "quiet after client caught up");
+        check(model.view() == std::set<std::string>{"A"},
+              lose_empty_delta ? "no ghost when the empty delta is lost" : "no ghost after late ack");
+    }
+}
+
+int main()
+{
+    test_enter_leave_before_ack(false);
+    test_enter_leave_before_ack(true);
+    std::printf(failed == 0 ? "map_snapshot_test ok\n" : "map_snapshot_test FAILED %d\n", failed);
+    return failed == 0 ? 0 : 1;
+}
@@ -10,7 +10,8 @@ import {
     ProtoCSResExample,
     ProtoCSReqLogin,
     ProtoCSResLogin,
-    ProtoCSMapNotifyStateData,
+    ProtoCSMapNotifySnapshot,
+    ProtoCSReqMapSnapshotAck,
     ProtoCSMapNotifyInitData,
     ProtoCSReqMapPing,
     ProtoCSResMapPong,
@@ -18,7 +19,11 @@ import {
     ProtoCSMapEnterReq,
     ProtoCSMapEnterRes,
     ProtoCSMapLeaveReq,
-    ProtoCSMapLeaveRes
+    ProtoCSMapLeaveRes,
+    ProtoCSFSNotifyFrames,
+    ProtoCSReqFSRoomJoin,
+    ProtoCSResFSRoomJoin,
+    ProtoCSReqFSFrameAck
 } from "./proto_res/proto_example";
 import {
     ProtoIPCStreamAuthHandshake,
@@ -35,12 +40,21 @@ const UDP_PORT = 20027;
 const RPCIP = "127.0.0.1";
 const RPCPORT = 20026;
 const APPID = "0.0.0.369";
+// RPC往返测试等待应答的时间
+const RPC_TEST_TIMEOUT_MS = 3000;
+// 本地保留的已解码快照数 与服务器每个客户端保留的已发快照数一致
+const MAP_SNAPSHOT_HISTORY = 32;
+// 帧确认测试 加入的帧同步房间 测试时长 开头补发允许的预热时间
+const FS_TEST_ROOM_ID = 6;
+const FS_TEST_DURATION_MS = 5000;
+const FS_TEST_WARMUP_MS = 1000;
 
 const IS_WEBSOCKET = false;
 
 const IS_TCP = false;
 const IS_UDP = true;
 const IS_TESTRPC = false;
+const IS_TESTFS = false;
 
 // ==========================================
 // =============== 工具函数 =================
@@ -134,12 +148,14 @@ function createCSReqMapPingPackage(): Buffer {
     return encodeProtoPackage(reqPackage);
 }
 
-function createCSReqMapInputPackage(dirX: number, dirY: number, seq: number, clientTime: string): Buffer {
+function createCSReqMapInputPackage(dirX: number, dirY: number, seq: number, clientTime: string,
+    ackSnapshotId: number): Buffer {
     const csReqMapInput: ProtoCSReqMapInput = {
         dirX: dirX,
         dirY: dirY,
         seq: seq,
         clientTime: clientTime,
+        ackSnapshotId: ackSnapshotId,
     };
 
     const reqPackage: ProtoPackage = {
@@ -150,6 +166,20 @@ function createCSReqMapInputPackage(dirX: number, dirY: number, seq: number, cli
     return encodeProtoPackage(reqPackage);
 }
 
+/** 创建 ProtoCSReqMapSnapshotAck 请求包 没有输入可捎带时单独确认快照 */
+function createCSReqMapSnapshotAckPackage(snapshotId: number): Buffer {
+    const csReqMapSnapshotAck: ProtoCSReqMapSnapshotAck = {
+        snapshotId: snapshotId,
+    };
+
+    const reqPackage: ProtoPackage = {
+        cmd: ProtoCmd.PROTO_CMD_CS_REQ_MAP_SNAPSHOT_ACK,
+        protocol: ProtoCSReqMapSnapshotAck.encode(csReqMapSnapshotAck).finish(),
+    };
+
+    return encodeProtoPackage(reqPackage);
+}
+
 function createCSMapEnterReqPackage(mapId: number): Buffer {
     const csMapEnterReq: ProtoCSMapEnterReq = {
         mapId: mapId,
@@ -176,6 +206,141 @@ function createCSMapLeaveReqPackage(): Buffer {
     return encodeProtoPackage(reqPackage);
 }
 
+/** 创建 ProtoCSReqFSRoomJoin 请求包 */
+function createCSReqFSRoomJoinPackage(roomId: number): Buffer {
+    const csReqFSRoomJoin: ProtoCSReqFSRoomJoin = {
+        roomId: roomId,
+    };
+
+    const reqPackage: ProtoPackage = {
+        cmd: ProtoCmd.PROTO_CMD_CS_REQ_FS_ROOM_JOIN,
+        protocol: ProtoCSReqFSRoomJoin.encode(csReqFSRoomJoin).finish(),
+    };
+
+    return encodeProtoPackage(reqPackage);
+}
+
+/** 创建 ProtoCSReqFSFrameAck 请求包 */
+function createCSReqFSFrameAckPackage(frameId: number): Buffer {
+    const csReqFSFrameAck: ProtoCSReqFSFrameAck = {
+        frameId: frameId,
+    };
+
+    const reqPackage: ProtoPackage = {
+        cmd: ProtoCmd.PROTO_CMD_CS_REQ_FS_FRAME_ACK,
+        protocol: ProtoCSReqFSFrameAck.encode(csReqFSFrameAck).finish(),
+    };
+
+    return encodeProtoPackage(reqPackage);
+}
+
+// ==========================================
+// ============ 地图快照解码 ================
+// ==========================================
+
+/** 快照中一个实体的量化状态 */
+interface MapSnapshotEntity {
+    userId: string;
+    x: number;
+    y: number;
+    vX: number;
+    vY: number;
+    lastSeq: number;
+    lastClientTime: bigint;
+}
+
+/**
+ * PROTO_CMD_CS_MAP_NOTIFY_SNAPSHOT 解码
+ * baselineId为0时是全量快照 否则在本地保留的baselineId快照上应用增量
+ * 基线已不在本地时丢弃该快照 不确认 服务器会继续以更早确认的快照为基线
+ */
+class MapSnapshotDecoder {
+    posQuant = 1;
+    velQuant = 1;
+    // 最近确认的快照id 0表示还没有
+    ackedId = 0;
+    private snapshots = new Map<number, Map<number, MapSnapshotEntity>>();
+
+    /** 解码成功返回snapshotId对应的实体表 */
+    apply(notify: ProtoCSMapNotifySnapshot): Map<number, MapSnapshotEntity> | null {
+        let entities: Map<number, MapSnapshotEntity>;
+        if (notify.baselineId === 0) {
+            this.posQuant = notify.posQuant;
+            this.velQuant = notify.velQuant;
+            entities = new Map();
+        } else {
+            const base = this.snapshots.get(notify.baselineId);
+            if (!base) {
+                return null;
+            }
+            entities = new Map();
+            for (const [index, entity] of base) {
+                entities.set(index, { ...entity });
+            }
+        }
+
+        for (const index of notify.removed) {
+            entities.delete(index);
+        }
+        // 新进入或下标被复用的实体带的是绝对值
+        const entered = new Set<number>();
+        for (const enter of notify.enters) {
+            entered.add(enter.index);
+            entities.set(enter.index, {
+                userId: enter.userId, x: 0, y: 0, vX: 0, vY: 0, lastSeq: 0, lastClientTime: BigInt(0)
+            });
+        }
+        for (const ent of notify.entities) {
+            const entity = entities.get(ent.index);
+            if (!entity) {
+                console.log(`[Snapshot] ${notify.snapshotId} unknown index ${ent.index}`);
+                return null;
+            }
+            if (entered.has(ent.index)) {
+                entity.x = ent.x;
+                entity.y = ent.y;
+                entity.vX = ent.vX;
+                entity.vY = ent.vY;
+                entity.lastSeq = ent.lastSeq;
+                entity.lastClientTime = BigInt(ent.lastClientTime);
+            } else {
+                entity.x += ent.x;
+                entity.y += ent.y;
+                entity.vX += ent.vX;
+                entity.vY += ent.vY;
+                // 差值按uint32回绕
+                entity.lastSeq = (entity.lastSeq + ent.lastSeq) >>> 0;
+                entity.lastClientTime = BigInt.asUintN(64, entity.lastClientTime + BigInt(ent.lastClientTime));
+            }
+        }
+
+        this.snapshots.set(notify.snapshotId, entities);
+        // Map按插入顺序遍历 先插入的最旧
+        while (this.snapshots.size > MAP_SNAPSHOT_HISTORY) {
+            const oldest = this.snapshots.keys().next().value as number;
+            this.snapshots.delete(oldest);
+        }
+        this.ackedId = notify.snapshotId;
+        return entities;
+    }
+
+    /** 换线或重连后从全量快照重新开始 */
+    reset() {
+        this.ackedId = 0;
+        this.snapshots.clear();
+    }
+
+    log(tag: string, notify: ProtoCSMapNotifySnapshot, entities: Map<number, MapSnapshotEntity>) {
+        console.log(`[${tag}] snapshot ${notify.snapshotId} baseline ${notify.baselineId} serverTime ${notify.serverTime}`
+            + ` enters ${notify.enters.length} entities ${notify.entities.length} removed ${notify.removed.length}`);
+        for (const [index, entity] of entities) {
+            console.log(`  [${index}] userId ${entity.userId} x ${entity.x * this.posQuant} y ${entity.y * this.posQuant}`
+                + ` vX ${entity.vX * this.velQuant} vY ${entity.vY * this.velQuant}`
+                + ` lastSeq ${entity.lastSeq} lastClientTime ${entity.lastClientTime}`);
+        }
+    }
+}
+
 // ==========================================
 // ============= RPC 客户端 =================
 // ==========================================
@@ -184,6 +349,9 @@ interface AvantRPCObj {
     client: net.Socket | null;
     recvBuffer: Buffer;
     appId: string | null;
+    // 本端发出的RPC请求序号 -> 发送时间
+    nextRpcId: number;
+    pendingRpc: Map<string, number>;
     SendPackage(pkg: ProtoPackage): void;
 }
 
@@ -196,6 +364,8 @@ function CreateAvantRPC(
         client: null,
         recvBuffer: Buffer.alloc(0),
         appId: null,
+        nextRpcId: 0,
+        pendingRpc: new Map<string, number>(),
         SendPackage(pkg: ProtoPackage) {
             if (!this.client) {
                 console.error("RPCObj Client is null");
@@ -232,6 +402,25 @@ function CreateAvantRPC(
                 protocol: ProtoCSReqExample.encode(exampleReq).finish(),
             };
             rpcObj.SendPackage(examplePkg);
+
+            // 以RPC请求调用mapsvr 应答须带回同一rpcId且rpcReply为true
+            rpcObj.nextRpcId += 1;
+            const rpcId = rpcObj.nextRpcId.toString();
+            const rpcReq: ProtoCSReqExample = {
+                testContext: Buffer.from(Date.now().toString(), "utf8"),
+            };
+            rpcObj.pendingRpc.set(rpcId, Date.now());
+            rpcObj.SendPackage({
+                cmd: ProtoCmd.PROTO_CMD_CS_REQ_EXAMPLE,
+                protocol: ProtoCSReqExample.encode(rpcReq).finish(),
+                rpcId: rpcId,
+                rpcReply: false,
+            });
+            setTimeout(() => {
+                if (rpcObj.pendingRpc.delete(rpcId)) {
+                    console.error(`[RPC] round trip FAILED rpcId ${rpcId} no reply in ${RPC_TEST_TIMEOUT_MS}ms`);
+                }
+            }, RPC_TEST_TIMEOUT_MS);
         });
 
         rpcObj.client = client;
@@ -258,6 +447,14 @@ function CreateAvantRPC(
                         const appIdString = handshake.appId?.toString() || "";
                         console.log("appIdString", appIdString);
                         rpcObj.appId = appIdString;
+                    } else if (recvPkg.cmd === ProtoCmd.PROTO_CMD_CS_RES_EXAMPLE && recvPkg.rpcId !== "0") {
+                        const sendTime = rpcObj.pendingRpc.get(recvPkg.rpcId);
+                        if (sendTime === undefined || !recvPkg.rpcReply) {
+                            console.error(`[RPC] round trip FAILED unexpected rpcId ${recvPkg.rpcId} rpcReply ${recvPkg.rpcReply}`);
+                        } else {
+                            rpcObj.pendingRpc.delete(recvPkg.rpcId);
+                            console.log(`[RPC] round trip ok rpcId ${recvPkg.rpcId} RTT: ${Date.now() - sendTime}ms`);
+                        }
                     } else if (recvPkg.cmd === ProtoCmd.PROTO_CMD_CS_RES_EXAMPLE) {
                         const resExample = ProtoCSResExample.decode(recvPkg.protocol);
                         const testContextStr = resExample.testContext?.toString() || "";
@@ -298,6 +495,7 @@ function startTCPClient() {
     let tcpRttSum = 0;
     let tcpRttCount = 0;
     let isLoggedIn = false; // 添加登录状态标记
+    const snapshotDecoder = new MapSnapshotDecoder();
 
     setInterval(() => {
         const avgRtt = tcpRttCount > 0 ? (tcpRttSum / tcpRttCount).toFixed(2) : "N/A";
@@ -320,6 +518,7 @@ function startTCPClient() {
 
             // 重置登录状态
             isLoggedIn = false;
+            snapshotDecoder.reset();
 
             // 先发送登录消息
             const loginPackage = createCSReqLoginPackage();
@@ -376,21 +575,15 @@ function startTCPClient() {
                             sendTCPPackage(client, nextPackage);
                         }
                     }
-                    // 处理地图状态通知
-                    else if (recvPkg.cmd === ProtoCmd.PROTO_CMD_CS_MAP_NOTIFY_STATE_DATA) {
-                        const mapData = ProtoCSMapNotifyStateData.decode(recvPkg.protocol);
-                        console.log(`[TCP] serverTime ${mapData.serverTime}`);
-
-                        if (mapData.players && mapData.players.length > 0) {
-                            const player = mapData.players[0];
-                            console.log("[TCP] Player data:");
-                            console.log("  userId:", player.userId);
-                            console.log("  x:", player.x);
-                            console.log("  y:", player.y);
-                            console.log("  vX:", player.vX);
-                            console.log("  vY:", player.vY);
-                            console.log("  lastSeq:", player.lastSeq);
-                            console.log("  lastClientTime:", player.lastClientTime);
+                    // 处理地图快照 解码后单独确认
+                    else if (recvPkg.cmd === ProtoCmd.PROTO_CMD_CS_MAP_NOTIFY_SNAPSHOT) {
+                        const notify = ProtoCSMapNotifySnapshot.decode(recvPkg.protocol);
+                        const entities = snapshotDecoder.apply(notify);
+                        if (entities) {
+                            snapshotDecoder.log("TCP", notify, entities);
+                            sendTCPPackage(client, createCSReqMapSnapshotAckPackage(notify.snapshotId));
+                        } else {
+                            console.log(`[TCP] snapshot ${notify.snapshotId} baseline ${notify.baselineId} missing`);
                         }
                     }
                     // 未知命令
@@ -419,6 +612,116 @@ function startTCPClient() {
     doConnect();
 }
 
+// ==========================================
+// ========== 帧同步房间确认测试 ============
+// ==========================================
+
+/**
+ * TCP登录后加入帧同步房间 每收到新的帧就确认
+ * 持续确认的成员应一直收到FRAME_WINDOW广播 预热之后不应再落到NOTIFY_FRAMES补发
+ */
+function startFSAckTest() {
+    let lastFrameId = 0;
+    let windowPackets = 0;
+    let catchUps = 0;
+    let catchUpsAfterWarmup = 0;
+    let gaps = 0;
+    let joinTime = 0;
+
+    const sendTCPPackage = (client: net.Socket, payload: Buffer) => {
+        const { headLen } = createTCPPackageWithHeader(payload);
+        client.write(headLen);
+        client.write(payload);
+    };
+
+    // 按顺序收下新帧 窗口中已收到的帧跳过 返回是否有新帧
+    const acceptFrames = (notify: ProtoCSFSNotifyFrames): boolean => {
+        const before = lastFrameId;
+        for (const frame of notify.frames) {
+            if (frame.frameId <= lastFrameId) {
+                continue;
+            }
+            if (frame.frameId !== lastFrameId + 1) {
+                gaps++;
+                console.error(`[FS] frame gap last ${lastFrameId} recv ${frame.frameId}`);
+            }
+            lastFrameId = frame.frameId;
+        }
+        return lastFrameId !== before;
+    };
+
+    const client = net.createConnection({ port: PORT, host: IP }, () => {
+        console.log("[FS] TCP Connected to server");
+        sendTCPPackage(client, createCSReqLoginPackage());
+    });
+
+    setTimeout(() => {
+        const ok = joinTime > 0 && windowPackets > 0 && catchUpsAfterWarmup === 0 && gaps === 0;
+        const result = `lastFrameId ${lastFrameId} windows ${windowPackets} catch-ups ${catchUps}`
+            + ` (after warmup ${catchUpsAfterWarmup}) gaps ${gaps}`;
+        if (ok) {
+            console.log(`[FS] ack test ok ${result}`);
+        } else {
+            console.error(`[FS] ack test FAILED ${result}`);
+        }
+        client.end();
+    }, FS_TEST_DURATION_MS);
+
+    let clientRecvBuffer = Buffer.alloc(0);
+    client.on("data", (data) => {
+        clientRecvBuffer = Buffer.concat([clientRecvBuffer, data]);
+
+        while (true) {
+            if (clientRecvBuffer.length <= 8) return;
+
+            const packageLen = readLengthHeader(clientRecvBuffer);
+            if (clientRecvBuffer.length < 8 + packageLen) return;
+
+            const packageData = clientRecvBuffer.subarray(8, 8 + packageLen);
+            clientRecvBuffer = clientRecvBuffer.subarray(8 + packageLen);
+
+            try {
+                const recvPkg = decodeProtoPackage(packageData);
+
+                if (recvPkg.cmd === ProtoCmd.PROTO_CMD_CS_RES_LOGIN) {
+                    const resLogin = ProtoCSResLogin.decode(recvPkg.protocol);
+                    console.log(`[FS] PROTO_CMD_CS_RES_LOGIN ret ${resLogin.ret}`);
+                    if (resLogin.ret === 0) {
+                        sendTCPPackage(client, createCSReqFSRoomJoinPackage(FS_TEST_ROOM_ID));
+                    }
+                } else if (recvPkg.cmd === ProtoCmd.PROTO_CMD_CS_RES_FS_ROOM_JOIN) {
+                    const resJoin = ProtoCSResFSRoomJoin.decode(recvPkg.protocol);
+                    console.log(`[FS] PROTO_CMD_CS_RES_FS_ROOM_JOIN ${JSON.stringify(resJoin)}`);
+                    if (resJoin.ret === 0) {
+                        joinTime = Date.now();
+                        // 中途加入从当前帧之后开始收
+                        lastFrameId = resJoin.currentFrameId;
+                    }
+                } else if (recvPkg.cmd === ProtoCmd.PROTO_CMD_CS_FS_NOTIFY_FRAME_WINDOW) {
+                    windowPackets++;
+                    if (acceptFrames(ProtoCSFSNotifyFrames.decode(recvPkg.protocol))) {
+                        sendTCPPackage(client, createCSReqFSFrameAckPackage(lastFrameId));
+                    }
+                } else if (recvPkg.cmd === ProtoCmd.PROTO_CMD_CS_FS_NOTIFY_FRAMES) {
+                    catchUps++;
+                    if (joinTime > 0 && Date.now() - joinTime > FS_TEST_WARMUP_MS) {
+                        catchUpsAfterWarmup++;
+                    }
+                    if (acceptFrames(ProtoCSFSNotifyFrames.decode(recvPkg.protocol))) {
+                        sendTCPPackage(client, createCSReqFSFrameAckPackage(lastFrameId));
+                    }
+                }
+            } catch (err: any) {
+                console.log("[FS] Decode error:", err.message);
+            }
+        }
+    });
+
+    client.on("error", (err) => {
+        console.log("[FS] error:", err.message);
+    });
+}
+
 // ==========================================
 // =========== WebSocket 客户端 =============
 // ==========================================
@@ -428,6 +731,7 @@ function startWebSocketClient() {
     let wsRttSum = 0;
     let wsRttCount = 0;
     let lastSeq = 0;
+    const snapshotDecoder = new MapSnapshotDecoder();
 
     setInterval(() => {
         const avgRtt = wsRttCount > 0 ? (wsRttSum / wsRttCount).toFixed(2) : "N/A";
@@ -459,6 +763,7 @@ function startWebSocketClient() {
 
             ws.on("open", () => {
                 console.log("WebSocket Connected to server");
+                snapshotDecoder.reset();
                 ws.send(createCSReqLoginPackage()); // 登录
                 ws.send(createCSReqExamplePackage());
                 // 进入地图2
@@ -472,12 +777,12 @@ function startWebSocketClient() {
                 intervalPerSecond = setInterval(() => {
                     // ws.send(createCSReqMapPingPackage());
                     if (!inputStop) {
-                        ws.send(createCSReqMapInputPackage(4, 3, ++lastSeq, Date.now().toString()));
+                        ws.send(createCSReqMapInputPackage(4, 3, ++lastSeq, Date.now().toString(), snapshotDecoder.ackedId));
                     }
                 }, 1000);
                 setTimeout(() => {
                     inputStop = true;
-                    ws.send(createCSReqMapInputPackage(0, 0, ++lastSeq, Date.now().toString()));
+                    ws.send(createCSReqMapInputPackage(0, 0, ++lastSeq, Date.now().toString(), snapshotDecoder.ackedId));
                 }, 10000); // 10秒后停止移动
                 // 每帧执行每秒20帧
                 intervalPerLogicFrame = setInterval(() => {
@@ -496,9 +801,16 @@ function startWebSocketClient() {
                     } else if (recvPkg.cmd === ProtoCmd.PROTO_CMD_CS_RES_EXAMPLE) {
                         // 处理示例响应
 
-                    } else if (recvPkg.cmd === ProtoCmd.PROTO_CMD_CS_MAP_NOTIFY_STATE_DATA) {
-                        const mapData = ProtoCSMapNotifyStateData.decode(recvPkg.protocol);
-                        console.log(`PROTO_CMD_CS_MAP_NOTIFY_STATE_DATA ${JSON.stringify(mapData)}`);
+                    } else if (recvPkg.cmd === ProtoCmd.PROTO_CMD_CS_MAP_NOTIFY_SNAPSHOT) {
+                        // 输入每秒一次 捎带不及时 每个快照都单独确认
+                        const notify = ProtoCSMapNotifySnapshot.decode(recvPkg.protocol);
+                        const entities = snapshotDecoder.apply(notify);
+                        if (entities) {
+                            snapshotDecoder.log("WebSocket", notify, entities);
+                            ws.send(createCSReqMapSnapshotAckPackage(notify.snapshotId));
+                        } else {
+                            console.log(`[WebSocket] snapshot ${notify.snapshotId} baseline ${notify.baselineId} missing`);
+                        }
 
                     } else if (recvPkg.cmd === ProtoCmd.PROTO_CMD_CS_MAP_NOTIFY_INIT_DATA) {
                         const initData = ProtoCSMapNotifyInitData.decode(recvPkg.protocol);
@@ -631,6 +943,7 @@ function main() {
     console.log(`IS_WEBSOCKET: ${IS_WEBSOCKET}`);
     console.log(`IS_UDP: ${IS_UDP}`);
     console.log(`IS_TESTRPC: ${IS_TESTRPC}`);
+    console.log(`IS_TESTFS: ${IS_TESTFS}`);
     console.log("=".repeat(50));
 
     if (IS_TCP) {
@@ -650,6 +963,10 @@ function main() {
             console.log(`RPC OnRecvPackage CMD = ${pkg.cmd} FROM APPID=${rpcObj.appId}`);
         });
     }
+
+    if (IS_TESTFS) {
+        startFSAckTest();
+    }
 }
 
 // 启动程序